@@ -4,6 +4,7 @@
 #ifndef SIMPLE_MIPS_EMU_COMMON_HH
 #define SIMPLE_MIPS_EMU_COMMON_HH
 
+#include <cstddef>
 #include <cstdint>
 
 /// <summary>
@@ -11,4 +12,30 @@
 /// </summary>
 bool ParseWord(char const* begin, char const* end, uint32_t& out) noexcept;
 
+/// <summary>
+/// Returns the page size of the host.
+/// </summary>
+size_t GetPageSize() noexcept;
+
+/// <summary>
+/// Sign-extends the lowest <c>numBits</c> bits of the given value.
+/// </summary>
+constexpr uint32_t SignExtend(uint32_t value, uint32_t numBits) noexcept
+{
+    // 0  if value >= 0
+    // -1 otherwise
+    uint32_t const mask = ~(value >> (numBits - 1)) + 1;
+    return value | (mask << numBits);
+}
+
+/// <summary>
+/// Shifts the given value right by <c>amount</c> bits, which is less than 32, filling the vacated
+/// bits with the sign bit.
+/// </summary>
+constexpr uint32_t ShiftRightArithmetic(uint32_t value, uint32_t amount) noexcept
+{
+    uint32_t const sign = ~(value >> 31) + 1;
+    return (value >> amount) | (~(~uint32_t { 0 } >> amount) & sign);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_DISASSEMBLY_HH
+#define SIMPLE_MIPS_EMU_DISASSEMBLY_HH
+
+#include <simple-mips-emu/Instruction.hh>
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+/// <summary>
+/// A sequence of instructions which is entered only at its first instruction and left only after
+/// its last instruction.
+/// </summary>
+struct BasicBlock
+{
+    /// <summary>
+    /// The address of the first instruction.
+    /// </summary>
+    uint32_t begin;
+
+    /// <summary>
+    /// The address right after the last instruction.
+    /// </summary>
+    uint32_t end;
+
+    /// <summary>
+    /// The addresses of the blocks the control can reach from this block. Targets outside of the
+    /// text segment and jumps through registers are not included.
+    /// </summary>
+    std::vector<uint32_t> successors;
+};
+
+/// <summary>
+/// The control-flow graph of a decoded text segment.
+/// </summary>
+class ControlFlowGraph
+{
+  private:
+    std::vector<BasicBlock> _blocks;
+    std::vector<uint32_t>   _callTargets;
+    std::vector<bool>       _leaders;
+
+  public:
+    /// <summary>
+    /// Builds the graph of the text segment whose decoded words are given.
+    /// </summary>
+    ControlFlowGraph(Instruction const* instructions, size_t numInstructions);
+
+  public:
+    /// <summary>
+    /// Returns the blocks sorted by their addresses.
+    /// </summary>
+    std::vector<BasicBlock> const& GetBlocks() const noexcept
+    {
+        return _blocks;
+    }
+
+    /// <summary>
+    /// Returns the targets of <c>jal</c>, <c>bltzal</c> and <c>bgezal</c> instructions in the text
+    /// segment, sorted and without duplicates.
+    /// </summary>
+    std::vector<uint32_t> const& GetCallTargets() const noexcept
+    {
+        return _callTargets;
+    }
+
+    /// <summary>
+    /// Returns <c>true</c> if the word at <c>index * 4</c> in the text segment starts a block.
+    /// </summary>
+    bool IsLeader(size_t index) const noexcept
+    {
+        return index < _leaders.size() && _leaders[index];
+    }
+
+    /// <summary>
+    /// Returns the block containing the given address, or <c>nullptr</c> if there is none.
+    /// </summary>
+    BasicBlock const* FindBlock(uint32_t address) const noexcept;
+};
+
+/// <summary>
+/// Returns the address the given instruction at <c>address</c> branches or jumps to. Returns
+/// <c>false</c> if the instruction does not have a static target.
+/// </summary>
+bool GetBranchTarget(Instruction const& instruction, uint32_t address, uint32_t& out) noexcept;
+
+/// <summary>
+/// Prints the given instruction at <c>address</c> in assembly syntax, e.g.
+/// <c>addiu $9, $9, -8</c>.
+/// </summary>
+void Disassemble(std::ostream& os, Instruction const& instruction, uint32_t address);
+
+/// <summary>
+/// Prints the whole text segment with block and function labels.
+/// </summary>
+void Disassemble(std::ostream&           os,
+                 Instruction const*      instructions,
+                 size_t                  numInstructions,
+                 ControlFlowGraph const& graph);
+
+#endif
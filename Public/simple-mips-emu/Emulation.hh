@@ -4,7 +4,15 @@
 #ifndef SIMPLE_MIPS_EMU_EMULATION_HH
 #define SIMPLE_MIPS_EMU_EMULATION_HH
 
+#include <simple-mips-emu/Instrumentation.hh>
 #include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
 
 enum class TickResult
 {
@@ -29,12 +37,202 @@ enum class TickResult
     /// Branch or memory R/W instruction has negative offset whose absolute value is too big.
     /// </summary>
     OffsetIsTooSmall,
+
+    /// <summary>
+    /// PC reached a breakpoint. The instruction at the breakpoint is not executed yet; call
+    /// <c>Tick</c> to execute it before running again. This is only returned by
+    /// <c>RunProgram</c>.
+    /// </summary>
+    BreakpointHit,
+
+    /// <summary>
+    /// The wall-clock budget ran out. This is only returned by <c>RunProgram</c> with
+    /// <c>RunLimits</c>.
+    /// </summary>
+    TimeLimitExceeded,
+
+    /// <summary>
+    /// The program can never terminate: it jumps to itself, or it reached a state it has been in
+    /// before. This is only returned by <c>RunProgram</c> with <c>RunLimits</c>.
+    /// </summary>
+    Stuck,
+
+    /// <summary>
+    /// The current instruction is <c>syscall</c>, which the emulator cannot run by itself. The
+    /// memory is not mutated; <c>ServiceSyscall</c> runs the call and moves PC past it.
+    /// <c>RunProgram</c> with <c>RunLimits</c> does so on its own if a host is given.
+    /// </summary>
+    Syscall,
+
+    /// <summary>
+    /// The current instruction raised an exception: <c>add</c>, <c>addi</c> or <c>sub</c>
+    /// overflowed, <c>ll</c> or <c>sc</c> got an unaligned address, or it is <c>break</c>. There
+    /// are no exception handlers, so the memory is not mutated and the program cannot continue.
+    /// </summary>
+    Trap,
 };
 
+class SyscallHost;
+
 /// <summary>
 /// Runs one instruction and mutate the given memory. If the result is not
 /// <c>TickResult::Success</c>, the memory is not mutated.
 /// </summary>
 TickResult Tick(Memory& memory) noexcept;
 
+/// <summary>
+/// Runs one instruction as <c>Tick</c> above and reports it to the given instrumentation policy.
+/// This is instantiated for the policies in <c>Instrumentation.hh</c>.
+/// </summary>
+template <typename Policy>
+TickResult Tick(Memory& memory, Policy& policy) noexcept;
+
+/// <summary>
+/// The result of <c>RunProgram</c>.
+/// </summary>
+struct RunResult
+{
+    /// <summary>
+    /// <c>TickResult::Success</c> if the run stopped because the program terminated or the
+    /// instruction limit was reached, or the result of the instruction which failed otherwise.
+    /// </summary>
+    TickResult result;
+
+    /// <summary>
+    /// The number of retired instructions.
+    /// </summary>
+    uint64_t numInstructions;
+
+    /// <summary>
+    /// The number of retired instructions which ran in closed form instead of one by one. See
+    /// <c>ProgramOptions::fastForwardLoops</c>.
+    /// </summary>
+    uint64_t numFastForwarded;
+};
+
+/// <summary>
+/// Runs at most <c>maxInstructions</c> instructions using the given decoded program, which must
+/// be decoded from the given memory. This behaves the same as calling <c>Tick</c> repeatedly, but
+/// avoids decoding each instruction again. The emulator falls back to <c>Tick</c> when PC leaves
+/// the decoded words or the program modifies its text segment. The run stops with
+/// <c>TickResult::BreakpointHit</c> when PC reaches a breakpoint of the program.
+/// </summary>
+RunResult RunProgram(Memory&        memory,
+                     Program const& program,
+                     uint64_t       maxInstructions) noexcept;
+
+/// <summary>
+/// Runs the program as <c>RunProgram</c> above and reports every instruction to the given
+/// instrumentation policy. If the policy is enabled, fused instructions run one by one and loops
+/// are never fast-forwarded.
+/// </summary>
+template <typename Policy>
+RunResult RunProgram(Memory&        memory,
+                     Program const& program,
+                     uint64_t       maxInstructions,
+                     Policy&        policy) noexcept;
+
+/// <summary>
+/// Detects states which a program can never leave. Unless it reads input, a program which reaches
+/// a state (PC, registers and memory) it has been in before loops forever.
+/// </summary>
+class StuckDetector
+{
+  private:
+    // Brent's cycle detection over the states passed to IsStuck: the state saved last is compared
+    // with every following one, and replaced after 1, 2, 4, ... comparisons. The state hashes of
+    // the memory are compared first, which only hash the pages written since the last call; the
+    // copy only confirms a match.
+    uint64_t             _savedHash;
+    std::vector<uint8_t> _saved;
+    uint64_t             _power;
+    uint64_t             _numCompared;
+
+  public:
+    StuckDetector() noexcept;
+
+  public:
+    /// <summary>
+    /// Forgets the states seen so far. This must be called when the program reads input, since
+    /// the same state may then lead somewhere else.
+    /// </summary>
+    void Reset() noexcept;
+
+    /// <summary>
+    /// Returns <c>true</c> if the program in the given memory never terminates. An instruction
+    /// which jumps or branches unconditionally to itself is detected at once. A longer loop is
+    /// detected once the states passed to consecutive calls repeat, which happens within a few
+    /// periods of the loop when the calls are made at regular intervals. At least one instruction
+    /// must be retired between calls.
+    /// </summary>
+    bool IsStuck(Memory const& memory);
+
+  private:
+    void Save(Memory const& memory, uint64_t hash);
+    bool IsSaved(Memory const& memory) const noexcept;
+};
+
+/// <summary>
+/// Limits of <c>RunProgram</c> other than the number of instructions.
+/// </summary>
+struct RunLimits
+{
+    uint64_t maxInstructions = std::numeric_limits<uint64_t>::max();
+
+    /// <summary>
+    /// The run stops with <c>TickResult::TimeLimitExceeded</c> once this point has passed.
+    /// </summary>
+    std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+
+    /// <summary>
+    /// If not null, the run stops with <c>TickResult::Stuck</c> once the detector finds the
+    /// program stuck. The detector keeps its history across runs.
+    /// </summary>
+    StuckDetector* stuckDetector = nullptr;
+
+    /// <summary>
+    /// If not null, system calls are serviced by this host. Otherwise the run stops with
+    /// <c>TickResult::Syscall</c> at the first one.
+    /// </summary>
+    SyscallHost* syscallHost = nullptr;
+
+    /// <summary>
+    /// The number of instructions between checks of the deadline and the detector. A loop which
+    /// is fast-forwarded in one step may retire more, up to <c>maxInstructions</c>.
+    /// </summary>
+    uint64_t checkInterval = 1 << 16;
+};
+
+/// <summary>
+/// Returns <c>TickResult::TimeLimitExceeded</c> or <c>TickResult::Stuck</c> if the run should stop
+/// because of the deadline or the detector of the given limits, or <c>TickResult::Success</c>
+/// otherwise. Loops which tick by themselves call this every <c>RunLimits::checkInterval</c>
+/// instructions.
+/// </summary>
+TickResult CheckLimits(Memory const& memory, RunLimits const& limits);
+
+/// <summary>
+/// Runs the system call at PC with <c>RunLimits::syscallHost</c> and returns its result, or
+/// returns <c>TickResult::Syscall</c> if there is no host. Reading input resets the stuck
+/// detector of the limits.
+/// </summary>
+TickResult ServiceSyscall(Memory& memory, RunLimits const& limits);
+
+/// <summary>
+/// Runs the program as <c>RunProgram</c> above, <c>RunLimits::checkInterval</c> instructions at a
+/// time, and calls <c>CheckLimits</c> before each of them. System calls are serviced with
+/// <c>ServiceSyscall</c>.
+/// </summary>
+RunResult RunProgram(Memory& memory, Program const& program, RunLimits const& limits);
+
+/// <summary>
+/// Runs the program as <c>RunProgram</c> above and reports every instruction to the given
+/// instrumentation policy, including the system calls serviced on the way.
+/// </summary>
+template <typename Policy>
+RunResult RunProgram(Memory&          memory,
+                     Program const&   program,
+                     RunLimits const& limits,
+                     Policy&          policy);
+
 #endif
\ No newline at end of file
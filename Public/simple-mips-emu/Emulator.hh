@@ -0,0 +1,103 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_EMULATOR_HH
+#define SIMPLE_MIPS_EMU_EMULATOR_HH
+
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/File.hh>
+#include <simple-mips-emu/ImageCache.hh>
+#include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+/// <summary>
+/// Counters kept by an <c>Emulator</c> over all its runs.
+/// </summary>
+struct EmulatorStats
+{
+    /// <summary>
+    /// The number of images loaded.
+    /// </summary>
+    uint64_t numLoads = 0;
+
+    /// <summary>
+    /// The number of times the text segment was decoded. Loading an image with the same text as
+    /// the previous one, or a <c>ProgramImage</c>, reuses the decoded program.
+    /// </summary>
+    uint64_t numDecodes = 0;
+
+    uint64_t numInstructions  = 0;
+    uint64_t numFastForwarded = 0;
+};
+
+/// <summary>
+/// A reusable emulation context. It owns the memory, the decoded program and the stats, so that
+/// running many short programs does not allocate once the buffers are large enough.
+/// </summary>
+class Emulator
+{
+  private:
+    Memory                              _memory;
+    std::optional<Program>              _program;
+    std::shared_ptr<ProgramImage const> _image;
+    ProgramOptions                      _options;
+    EmulatorStats                       _stats;
+
+  public:
+    explicit Emulator(ProgramOptions const& options = ProgramOptions {});
+
+  public:
+    /// <summary>
+    /// Loads the given image into the memory and resets the registers.
+    /// </summary>
+    void Reset(uint8_t const* text, size_t textSize, uint8_t const* data, size_t dataSize);
+
+    /// <summary>
+    /// Loads the executable at the given path. Returns the error if the file cannot be read, in
+    /// which case the state is not changed.
+    /// </summary>
+    std::optional<FileReadError> Load(std::filesystem::path const& path);
+
+    /// <summary>
+    /// Starts from the initial memory of the given image, and runs its decoded program until the
+    /// text is modified. The text is shared with the image until then, and the image is kept alive
+    /// until another one is loaded.
+    /// </summary>
+    void Reset(std::shared_ptr<ProgramImage const> image);
+
+    /// <summary>
+    /// Loads the executable at the given path through the cache. Returns the error if the file
+    /// cannot be read, in which case the state is not changed.
+    /// </summary>
+    std::optional<FileReadError> Load(ImageCache& cache, std::filesystem::path const& path);
+
+    /// <summary>
+    /// Runs the loaded program from where it stopped, as <c>RunProgram</c> does. The program is
+    /// decoded on the first run after its text changed, unless the image it was loaded from has
+    /// the same text.
+    /// </summary>
+    RunResult Run(RunLimits const& limits);
+
+    Memory& GetMemory() noexcept
+    {
+        return _memory;
+    }
+
+    Memory const& GetMemory() const noexcept
+    {
+        return _memory;
+    }
+
+    EmulatorStats const& GetStats() const noexcept
+    {
+        return _stats;
+    }
+};
+
+#endif
@@ -4,8 +4,11 @@
 #ifndef SIMPLE_MIPS_EMU_FILE_HH
 #define SIMPLE_MIPS_EMU_FILE_HH
 
+#include <simple-mips-emu/Memory.hh>
+
 #include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <variant>
 #include <vector>
 
@@ -51,4 +54,80 @@ FileReadResult ReadFile(std::filesystem::path const& path);
 /// </summary>
 FileReadResult ReadFile(std::istream& is);
 
+/// <summary>
+/// Byte order of the words in an exported memory image.
+/// </summary>
+enum class ByteOrder : uint32_t
+{
+    Big    = 0,
+    Little = 1,
+};
+
+/// <summary>
+/// Returns the byte order of the host.
+/// </summary>
+ByteOrder GetHostByteOrder() noexcept;
+
+/// <summary>
+/// The header at the beginning of an exported memory image. Its fields are little endian. The
+/// bytes of the memory follow the header.
+/// </summary>
+struct MemoryImageHeader
+{
+    constexpr static char     Magic[4] = { 'S', 'M', 'E', 'I' };
+    constexpr static uint32_t Version  = 1;
+
+    char      magic[4];
+    uint32_t  version;
+    ByteOrder byteOrder;
+
+    /// <summary>
+    /// The address of the first byte.
+    /// </summary>
+    uint32_t baseAddress;
+
+    /// <summary>
+    /// The number of bytes after the header.
+    /// </summary>
+    uint32_t length;
+
+    uint32_t reserved[3];
+};
+
+static_assert(sizeof(MemoryImageHeader) == 32);
+
+/// <summary>
+/// Represents an error occurred when writing a memory image.
+/// </summary>
+struct FileWriteError
+{
+    enum class Type
+    {
+        InvalidRange,
+        CannotWrite,
+    };
+
+    Type type;
+};
+
+/// <summary>
+/// Writes the words in [start, end] of the memory to a file at the given path in the given byte
+/// order. Note that end is inclusive. Addresses outside of the segments read as zero. Returns
+/// <c>std::nullopt</c> on success.
+/// </summary>
+std::optional<FileWriteError> ExportMemory(std::filesystem::path const& path,
+                                           Memory const&                memory,
+                                           Address                      start,
+                                           Address                      end,
+                                           ByteOrder                    byteOrder);
+
+/// <summary>
+/// Writes the whole segment to a file at the given path in the given byte order. Returns
+/// <c>std::nullopt</c> on success.
+/// </summary>
+std::optional<FileWriteError> ExportSegment(std::filesystem::path const& path,
+                                            Memory const&                memory,
+                                            Address::BaseType            base,
+                                            ByteOrder                    byteOrder);
+
 #endif
\ No newline at end of file
@@ -6,58 +6,258 @@
 
 #include <cstdint>
 
+// Each format lists its instructions as X(format, name, code). The code is the function field for
+// the formats whose operation field is 0, the rt field for the RI format, whose operation field is
+// 1, and the operation field otherwise. The enums below, the Operation enum and the decode tables
+// are all generated from these lists, so adding an entry here is enough to make the decoder
+// recognize a new instruction.
+
+#define SIMPLE_MIPS_EMU_R_FORMAT_FNS(X)                                                            \
+    X(R, ADD, 0x20)                                                                                \
+    X(R, ADDU, 0x21)                                                                               \
+    X(R, SUB, 0x22)                                                                                \
+    X(R, SUBU, 0x23)                                                                               \
+    X(R, AND, 0x24)                                                                                \
+    X(R, OR, 0x25)                                                                                 \
+    X(R, XOR, 0x26)                                                                                \
+    X(R, NOR, 0x27)                                                                                \
+    X(R, SLT, 0x2A)                                                                                \
+    X(R, SLTU, 0x2B)
+
+#define SIMPLE_MIPS_EMU_SV_FORMAT_FNS(X)                                                           \
+    X(SV, SLLV, 0x04)                                                                              \
+    X(SV, SRLV, 0x06)                                                                              \
+    X(SV, SRAV, 0x07)
+
+#define SIMPLE_MIPS_EMU_JR_FORMAT_FNS(X)                                                           \
+    X(JR, JR, 0x08)                                                                                \
+    X(JR, JALR, 0x09)
+
+#define SIMPLE_MIPS_EMU_SR_FORMAT_FNS(X)                                                           \
+    X(SR, SLL, 0x00)                                                                               \
+    X(SR, SRL, 0x02)                                                                               \
+    X(SR, SRA, 0x03)
+
+#define SIMPLE_MIPS_EMU_MD_FORMAT_FNS(X)                                                           \
+    X(MD, MULT, 0x18)                                                                              \
+    X(MD, MULTU, 0x19)                                                                             \
+    X(MD, DIV, 0x1A)                                                                               \
+    X(MD, DIVU, 0x1B)
+
+#define SIMPLE_MIPS_EMU_MF_FORMAT_FNS(X)                                                           \
+    X(MF, MFHI, 0x10)                                                                              \
+    X(MF, MFLO, 0x12)
+
+#define SIMPLE_MIPS_EMU_MT_FORMAT_FNS(X)                                                           \
+    X(MT, MTHI, 0x11)                                                                              \
+    X(MT, MTLO, 0x13)
+
+#define SIMPLE_MIPS_EMU_SYS_FORMAT_FNS(X)                                                          \
+    X(SYS, SYSCALL, 0x0C)                                                                          \
+    X(SYS, BREAK, 0x0D)
+
+#define SIMPLE_MIPS_EMU_I_FORMAT_OPS(X)                                                            \
+    X(I, ADDI, 0x08)                                                                               \
+    X(I, ADDIU, 0x09)                                                                              \
+    X(I, SLTI, 0x0A)                                                                               \
+    X(I, SLTIU, 0x0B)
+
+#define SIMPLE_MIPS_EMU_UI_FORMAT_OPS(X)                                                           \
+    X(UI, ANDI, 0x0C)                                                                              \
+    X(UI, ORI, 0x0D)                                                                               \
+    X(UI, XORI, 0x0E)
+
+#define SIMPLE_MIPS_EMU_BI_FORMAT_OPS(X)                                                           \
+    X(BI, BEQ, 0x04)                                                                               \
+    X(BI, BNE, 0x05)
+
+#define SIMPLE_MIPS_EMU_BZ_FORMAT_OPS(X)                                                           \
+    X(BZ, BLEZ, 0x06)                                                                              \
+    X(BZ, BGTZ, 0x07)
+
+#define SIMPLE_MIPS_EMU_RI_FORMAT_RTS(X)                                                           \
+    X(RI, BLTZ, 0x00)                                                                              \
+    X(RI, BGEZ, 0x01)                                                                              \
+    X(RI, BLTZAL, 0x10)                                                                            \
+    X(RI, BGEZAL, 0x11)
+
+#define SIMPLE_MIPS_EMU_II_FORMAT_OPS(X) X(II, LUI, 0x0F)
+
+#define SIMPLE_MIPS_EMU_OI_FORMAT_OPS(X)                                                           \
+    X(OI, LB, 0x20)                                                                                \
+    X(OI, LH, 0x21)                                                                                \
+    X(OI, LWL, 0x22)                                                                               \
+    X(OI, LW, 0x23)                                                                                \
+    X(OI, LBU, 0x24)                                                                               \
+    X(OI, LHU, 0x25)                                                                               \
+    X(OI, LWR, 0x26)                                                                               \
+    X(OI, SB, 0x28)                                                                                \
+    X(OI, SH, 0x29)                                                                                \
+    X(OI, SWL, 0x2A)                                                                               \
+    X(OI, SW, 0x2B)                                                                                \
+    X(OI, SWR, 0x2E)                                                                               \
+    X(OI, LL, 0x30)                                                                                \
+    X(OI, SC, 0x38)
+
+#define SIMPLE_MIPS_EMU_J_FORMAT_OPS(X)                                                            \
+    X(J, J, 0x02)                                                                                  \
+    X(J, JAL, 0x03)
+
+#define SIMPLE_MIPS_EMU_ENUM_ENTRY(format, name, code) name = code,
+
+/// <summary>
+/// Instructions with three registers. <c>add</c> and <c>sub</c> trap on signed overflow.
+/// </summary>
 enum class RFormatFn : uint32_t
 {
-    ADDU = 0x21,
-    SUBU = 0x23,
-    AND  = 0x24,
-    OR   = 0x25,
-    NOR  = 0x27,
-    SLTU = 0x2B,
+    SIMPLE_MIPS_EMU_R_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
+/// <summary>
+/// Shifts by the amount in the lowest five bits of rs.
+/// </summary>
+enum class SVFormatFn : uint32_t
+{
+    SIMPLE_MIPS_EMU_SV_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Register jumps. <c>jalr</c> stores the return address in rd.
+/// </summary>
 enum class JRFormatFn : uint32_t
 {
-    JR = 0x08,
+    SIMPLE_MIPS_EMU_JR_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
+/// <summary>
+/// Shifts by a constant amount.
+/// </summary>
 enum class SRFormatFn : uint32_t
 {
-    SLL = 0x00,
-    SRL = 0x02,
+    SIMPLE_MIPS_EMU_SR_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Multiplications and divisions into HI and LO.
+/// </summary>
+enum class MDFormatFn : uint32_t
+{
+    SIMPLE_MIPS_EMU_MD_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Moves from HI or LO to rd.
+/// </summary>
+enum class MFFormatFn : uint32_t
+{
+    SIMPLE_MIPS_EMU_MF_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Moves from rs to HI or LO.
+/// </summary>
+enum class MTFormatFn : uint32_t
+{
+    SIMPLE_MIPS_EMU_MT_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Calls into the host. The service of <c>syscall</c> is selected by $v0; see
+/// <c>SyscallHost</c>. <c>break</c> always traps.
+/// </summary>
+enum class SYSFormatFn : uint32_t
+{
+    SIMPLE_MIPS_EMU_SYS_FORMAT_FNS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
+/// <summary>
+/// Instructions with a sign-extended immediate. <c>addi</c> traps on signed overflow.
+/// </summary>
 enum class IFormatOp : uint32_t
 {
-    ADDIU = 0x09,
-    ANDI  = 0x0C,
-    ORI   = 0x0D,
-    SLTIU = 0x0B,
+    SIMPLE_MIPS_EMU_I_FORMAT_OPS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
+/// <summary>
+/// Instructions with a zero-extended immediate.
+/// </summary>
+enum class UIFormatOp : uint32_t
+{
+    SIMPLE_MIPS_EMU_UI_FORMAT_OPS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Conditional branches comparing two registers.
+/// </summary>
 enum class BIFormatOp : uint32_t
 {
-    BEQ = 0x04,
-    BNE = 0x05,
+    SIMPLE_MIPS_EMU_BI_FORMAT_OPS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Conditional branches comparing a register with zero.
+/// </summary>
+enum class BZFormatOp : uint32_t
+{
+    SIMPLE_MIPS_EMU_BZ_FORMAT_OPS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
+/// <summary>
+/// Conditional branches comparing a register with zero, selected by the rt field. The <c>al</c>
+/// variants store the return address in $ra whether they branch or not.
+/// </summary>
+enum class RIFormatRt : uint32_t
+{
+    SIMPLE_MIPS_EMU_RI_FORMAT_RTS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
+};
+
+/// <summary>
+/// Instructions with an immediate and no source register.
+/// </summary>
 enum class IIFormatOp : uint32_t
 {
-    LUI = 0x0F,
+    SIMPLE_MIPS_EMU_II_FORMAT_OPS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
+/// <summary>
+/// Loads and stores with a base register and an offset. <c>ll</c> and <c>sc</c> need an aligned
+/// address; <c>sc</c> stores only if the word still holds what <c>ll</c> read, and sets rt to 1 if
+/// it did or to 0 otherwise.
+/// </summary>
 enum class OIFormatOp : uint32_t
 {
-    LB = 0x20,
-    LW = 0x23,
-    SB = 0x28,
-    SW = 0x2B,
+    SIMPLE_MIPS_EMU_OI_FORMAT_OPS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
+/// <summary>
+/// Jumps with a 26-bit target.
+/// </summary>
 enum class JFormatOp : uint32_t
 {
-    J   = 0x02,
-    JAL = 0x03,
+    SIMPLE_MIPS_EMU_J_FORMAT_OPS(SIMPLE_MIPS_EMU_ENUM_ENTRY)
 };
 
-#endif
\ No newline at end of file
+#undef SIMPLE_MIPS_EMU_ENUM_ENTRY
+
+/// <summary>
+/// Lists every instruction of every format as X(format, name, code).
+/// </summary>
+#define SIMPLE_MIPS_EMU_ALL_INSTRUCTIONS(X)                                                        \
+    SIMPLE_MIPS_EMU_R_FORMAT_FNS(X)                                                                \
+    SIMPLE_MIPS_EMU_SV_FORMAT_FNS(X)                                                               \
+    SIMPLE_MIPS_EMU_JR_FORMAT_FNS(X)                                                               \
+    SIMPLE_MIPS_EMU_SR_FORMAT_FNS(X)                                                               \
+    SIMPLE_MIPS_EMU_MD_FORMAT_FNS(X)                                                               \
+    SIMPLE_MIPS_EMU_MF_FORMAT_FNS(X)                                                               \
+    SIMPLE_MIPS_EMU_MT_FORMAT_FNS(X)                                                               \
+    SIMPLE_MIPS_EMU_SYS_FORMAT_FNS(X)                                                              \
+    SIMPLE_MIPS_EMU_I_FORMAT_OPS(X)                                                                \
+    SIMPLE_MIPS_EMU_UI_FORMAT_OPS(X)                                                               \
+    SIMPLE_MIPS_EMU_BI_FORMAT_OPS(X)                                                               \
+    SIMPLE_MIPS_EMU_BZ_FORMAT_OPS(X)                                                               \
+    SIMPLE_MIPS_EMU_RI_FORMAT_RTS(X)                                                               \
+    SIMPLE_MIPS_EMU_II_FORMAT_OPS(X)                                                               \
+    SIMPLE_MIPS_EMU_OI_FORMAT_OPS(X)                                                               \
+    SIMPLE_MIPS_EMU_J_FORMAT_OPS(X)
+
+#endif
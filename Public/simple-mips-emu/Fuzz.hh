@@ -0,0 +1,121 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_FUZZ_HH
+#define SIMPLE_MIPS_EMU_FUZZ_HH
+
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Memory.hh>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// A randomly generated program together with its initial state.
+/// </summary>
+struct FuzzProgram
+{
+    std::vector<uint32_t>              text;
+    std::vector<uint8_t>               data;
+    std::array<uint32_t, NumRegisters> registers;
+
+    /// <summary>
+    /// Returns the memory at the start of the program.
+    /// </summary>
+    Memory MakeMemory() const;
+
+    /// <summary>
+    /// Prints the disassembly, the non-zero registers and the non-zero data words.
+    /// </summary>
+    void Print(std::ostream& os) const;
+};
+
+struct FuzzOptions
+{
+    size_t   minLength = 4;
+    size_t   maxLength = 64;
+    uint32_t dataSize  = 256;
+
+    /// <summary>
+    /// The register which holds the start of the data segment. Loads and stores mostly use it as
+    /// their base, and no instruction writes it.
+    /// </summary>
+    uint8_t dataRegister = 28;
+
+    /// <summary>
+    /// The percentage of loads and stores which use a random base and offset instead, so that
+    /// accesses outside the data segment are covered as well.
+    /// </summary>
+    uint32_t wildAccessPercent = 5;
+};
+
+/// <summary>
+/// Generates a program of valid instructions of every format. Branches and jumps target
+/// instructions of the program or its end.
+/// </summary>
+FuzzProgram GenerateProgram(std::mt19937_64& random, FuzzOptions const& options);
+
+/// <summary>
+/// Runs at most <c>maxInstructions</c> instructions of the program in the memory. An engine is
+/// called repeatedly with the same memory and continues where it stopped.
+/// </summary>
+using Engine = std::function<RunResult(Memory& memory, uint64_t maxInstructions)>;
+
+/// <summary>
+/// Creates an engine for the program in the given memory.
+/// </summary>
+using EngineFactory = std::function<Engine(Memory const& memory)>;
+
+/// <summary>
+/// The reference engine, which calls <c>Tick</c> for each instruction.
+/// </summary>
+Engine MakeTickEngine(Memory const& memory);
+
+/// <summary>
+/// The engine which runs a decoded <c>Program</c>.
+/// </summary>
+Engine MakeProgramEngine(Memory const& memory);
+
+/// <summary>
+/// The engine which runs a decoded <c>Program</c> with <c>ProgramOptions::fastForwardLoops</c>.
+/// </summary>
+Engine MakeFastForwardEngine(Memory const& memory);
+
+struct Divergence
+{
+    /// <summary>
+    /// The number of instructions both engines ran before the states were compared.
+    /// </summary>
+    uint64_t numInstructions;
+
+    /// <summary>
+    /// The first difference found, e.g. <c>R9: 0x5 != 0x6</c>.
+    /// </summary>
+    std::string reason;
+};
+
+/// <summary>
+/// Runs the program on both engines, <c>interval</c> instructions at a time, and compares the
+/// results, the registers and the segments after each step. Returns the first difference, or
+/// <c>std::nullopt</c> if the engines agree until the end or for <c>maxInstructions</c>.
+/// </summary>
+std::optional<Divergence> RunLockstep(FuzzProgram const&   program,
+                                      EngineFactory const& reference,
+                                      EngineFactory const& candidate,
+                                      uint64_t             maxInstructions,
+                                      uint64_t             interval);
+
+/// <summary>
+/// Reduces a program for which <c>fails</c> returns <c>true</c>. It drops trailing instructions,
+/// replaces instructions with <c>nop</c> (which keeps branch offsets valid) and clears registers
+/// and data words as long as <c>fails</c> still holds.
+/// </summary>
+FuzzProgram Shrink(FuzzProgram program, std::function<bool(FuzzProgram const&)> const& fails);
+
+#endif
@@ -0,0 +1,134 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_IMAGE_CACHE_HH
+#define SIMPLE_MIPS_EMU_IMAGE_CACHE_HH
+
+#include <simple-mips-emu/File.hh>
+#include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <variant>
+
+/// <summary>
+/// A parsed and decoded executable. Images are immutable, so one image can be shared by any number
+/// of runs on any threads; each run copies the initial memory and uses the decoded program as long
+/// as it does not modify its text.
+/// </summary>
+class ProgramImage
+{
+  private:
+    Memory  _memory;
+    Program _program;
+
+  public:
+    ProgramImage(Memory memory, ProgramOptions const& options);
+
+  public:
+    /// <summary>
+    /// Returns the memory at the start of the program. A copy of it has the same text version as
+    /// the decoded program.
+    /// </summary>
+    Memory const& GetMemory() const noexcept
+    {
+        return _memory;
+    }
+
+    Program const& GetProgram() const noexcept
+    {
+        return _program;
+    }
+
+    /// <summary>
+    /// Returns the approximate number of bytes the image occupies.
+    /// </summary>
+    size_t GetFootprint() const noexcept;
+};
+
+struct ImageCacheStats
+{
+    uint64_t numHits      = 0;
+    uint64_t numMisses    = 0;
+    uint64_t numEvictions = 0;
+    size_t   numImages    = 0;
+    size_t   numBytes     = 0;
+};
+
+/// <summary>
+/// The result of <c>ImageCache::Load</c>.
+/// </summary>
+using ImageLoadResult = std::variant<std::shared_ptr<ProgramImage const>, CannotRead>;
+
+/// <summary>
+/// A cache of program images keyed by the contents of their files, so that a file which changed
+/// is loaded again and the same program under another path is not. The least recently used
+/// images are evicted once the images take more than the memory budget. This is thread-safe.
+/// </summary>
+class ImageCache
+{
+  private:
+    struct Key
+    {
+        uint64_t hash1;
+        uint64_t hash2;
+        size_t   size;
+
+        bool operator==(Key const& other) const noexcept
+        {
+            return hash1 == other.hash1 && hash2 == other.hash2 && size == other.size;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(Key const& key) const noexcept
+        {
+            return static_cast<size_t>(key.hash1);
+        }
+    };
+
+    struct Entry
+    {
+        Key                                 key;
+        std::shared_ptr<ProgramImage const> image;
+        size_t                              footprint;
+    };
+
+  private:
+    size_t                                                       _budget;
+    ProgramOptions                                               _options;
+    mutable std::mutex                                           _mutex;
+    std::list<Entry>                                             _entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _index;
+    ImageCacheStats                                              _stats;
+
+  public:
+    /// <summary>
+    /// Creates a cache which keeps images up to <c>budget</c> bytes in total. Programs are decoded
+    /// with the given options.
+    /// </summary>
+    explicit ImageCache(size_t budget, ProgramOptions const& options = ProgramOptions {});
+    ImageCache(ImageCache const&) = delete;
+    ImageCache& operator=(ImageCache const&) = delete;
+
+  public:
+    /// <summary>
+    /// Returns the image of the executable at the given path. The file is always read and hashed,
+    /// but it is parsed and decoded only if no cached image has the same contents.
+    /// </summary>
+    ImageLoadResult Load(std::filesystem::path const& path);
+
+    ImageCacheStats GetStats() const;
+
+  private:
+    void Evict();
+};
+
+#endif
@@ -0,0 +1,213 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_INSTRUCTION_HH
+#define SIMPLE_MIPS_EMU_INSTRUCTION_HH
+
+#include <simple-mips-emu/Formats.hh>
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Instruction formats. Each format fixes which fields an instruction uses and how its immediate
+/// is extended.
+/// </summary>
+enum class Format : uint8_t
+{
+    None = 0,
+    R,
+    SV,
+    JR,
+    SR,
+    MD,
+    MF,
+    MT,
+    SYS,
+    I,
+    UI,
+    BI,
+    BZ,
+    RI,
+    II,
+    OI,
+    J,
+};
+
+// Loads and stores of the data segment which a validated <c>Program</c> can prove in range, as
+// X(name, size).
+#define SIMPLE_MIPS_EMU_PROVEN_ACCESSES(X)                                                         \
+    X(LB, 1)                                                                                       \
+    X(LBU, 1)                                                                                      \
+    X(LH, 2)                                                                                       \
+    X(LHU, 2)                                                                                      \
+    X(LW, 4)                                                                                       \
+    X(SB, 1)                                                                                       \
+    X(SH, 2)                                                                                       \
+    X(SW, 4)
+
+/// <summary>
+/// Operations the emulator can execute after decoding.
+/// </summary>
+enum class Operation : uint8_t
+{
+    Invalid = 0,
+
+#define SIMPLE_MIPS_EMU_OPERATION_ENTRY(format, name, code) name,
+    SIMPLE_MIPS_EMU_ALL_INSTRUCTIONS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+#undef SIMPLE_MIPS_EMU_OPERATION_ENTRY
+
+    // Fused operations. They only appear in the dispatch stream of a <c>Program</c> and execute
+    // the instruction they replace together with the following one or two instructions.
+
+    /// <summary>
+    /// <c>lui $t, hi</c> followed by <c>ori $u, $t, lo</c> (the expansion of <c>la</c>).
+    /// </summary>
+    LUI_ORI,
+
+    /// <summary>
+    /// <c>addiu</c> followed by <c>bne</c> (a typical loop tail).
+    /// </summary>
+    ADDIU_BNE,
+
+    /// <summary>
+    /// <c>lw</c>, <c>lw</c> and <c>addu</c>.
+    /// </summary>
+    LW_LW_ADDU,
+
+    /// <summary>
+    /// <c>loop: addiu $t, $t, k</c> followed by <c>bne $t, $u, loop</c> (a delay or spin loop).
+    /// All iterations run at once, which retires two instructions per iteration.
+    /// </summary>
+    ADDIU_BNE_LOOP,
+
+    // Proven accesses, e.g. <c>LW_PROVEN</c>. They replace a load or store in the dispatch stream
+    // of a <c>Program</c> whose address is proven in range as long as the base register holds the
+    // value it was proven with, and skip the range checks then. See
+    // <c>ProgramOptions::unchecked</c>.
+#define SIMPLE_MIPS_EMU_PROVEN_ENTRY(name, size) name##_PROVEN,
+    SIMPLE_MIPS_EMU_PROVEN_ACCESSES(SIMPLE_MIPS_EMU_PROVEN_ENTRY)
+#undef SIMPLE_MIPS_EMU_PROVEN_ENTRY
+
+    /// <summary>
+    /// Stops the execution before the instruction at its position. This is patched into the
+    /// dispatch stream of a <c>Program</c> by <c>Program::SetBreakpoint</c>.
+    /// </summary>
+    Breakpoint,
+};
+
+/// <summary>
+/// Returns the format of the given operation, or <c>Format::None</c> for invalid and fused
+/// operations.
+/// </summary>
+constexpr Format GetFormat(Operation operation) noexcept
+{
+    switch (operation)
+    {
+#define SIMPLE_MIPS_EMU_FORMAT_CASE(format, name, code)                                            \
+    case Operation::name: return Format::format;
+        SIMPLE_MIPS_EMU_ALL_INSTRUCTIONS(SIMPLE_MIPS_EMU_FORMAT_CASE)
+#undef SIMPLE_MIPS_EMU_FORMAT_CASE
+        default: return Format::None;
+    }
+}
+
+/// <summary>
+/// Returns the mnemonic of the given operation in upper case.
+/// </summary>
+constexpr char const* GetMnemonic(Operation operation) noexcept
+{
+    switch (operation)
+    {
+#define SIMPLE_MIPS_EMU_MNEMONIC_CASE(format, name, code)                                          \
+    case Operation::name: return #name;
+        SIMPLE_MIPS_EMU_ALL_INSTRUCTIONS(SIMPLE_MIPS_EMU_MNEMONIC_CASE)
+#undef SIMPLE_MIPS_EMU_MNEMONIC_CASE
+        case Operation::LUI_ORI: return "LUI+ORI";
+        case Operation::ADDIU_BNE: return "ADDIU+BNE";
+        case Operation::LW_LW_ADDU: return "LW+LW+ADDU";
+        case Operation::ADDIU_BNE_LOOP: return "ADDIU+BNE LOOP";
+#define SIMPLE_MIPS_EMU_PROVEN_CASE(name, size)                                                    \
+    case Operation::name##_PROVEN: return #name " PROVEN";
+        SIMPLE_MIPS_EMU_PROVEN_ACCESSES(SIMPLE_MIPS_EMU_PROVEN_CASE)
+#undef SIMPLE_MIPS_EMU_PROVEN_CASE
+        case Operation::Breakpoint: return "BREAKPOINT";
+        default: return "INVALID";
+    }
+}
+
+/// <summary>
+/// Returns the proven form of the given load or store, or <c>Operation::Invalid</c> if it has none.
+/// </summary>
+constexpr Operation GetProvenOperation(Operation operation) noexcept
+{
+    switch (operation)
+    {
+#define SIMPLE_MIPS_EMU_PROVEN_CASE(name, size)                                                    \
+    case Operation::name: return Operation::name##_PROVEN;
+        SIMPLE_MIPS_EMU_PROVEN_ACCESSES(SIMPLE_MIPS_EMU_PROVEN_CASE)
+#undef SIMPLE_MIPS_EMU_PROVEN_CASE
+        default: return Operation::Invalid;
+    }
+}
+
+/// <summary>
+/// Returns the number of instructions the given operation retires, or the least number for
+/// <c>Operation::ADDIU_BNE_LOOP</c>.
+/// </summary>
+constexpr uint32_t GetNumRetired(Operation operation) noexcept
+{
+    switch (operation)
+    {
+        case Operation::LUI_ORI: return 2;
+        case Operation::ADDIU_BNE: return 2;
+        case Operation::LW_LW_ADDU: return 3;
+        case Operation::ADDIU_BNE_LOOP: return 2;
+        case Operation::Breakpoint: return 0;
+        default: return 1;
+    }
+}
+
+/// <summary>
+/// Represents a decoded instruction. Unused fields are zero.
+/// </summary>
+struct Instruction
+{
+    Operation operation;
+    uint8_t   rs;
+    uint8_t   rt;
+    uint8_t   rd;
+
+    /// <summary>
+    /// Immediate operand. It is already sign-extended for the operations which need it. Shift
+    /// amounts and jump targets (shifted by two) are stored here as well.
+    /// </summary>
+    uint32_t immediate;
+};
+
+/// <summary>
+/// Decodes the given word. Returns an instruction with <c>Operation::Invalid</c> if the emulator
+/// cannot recognize the word.
+/// </summary>
+Instruction Decode(uint32_t word) noexcept;
+
+/// <summary>
+/// Decodes <c>numWords</c> big-endian words starting at <c>bytes</c> into <c>out</c>. This gives
+/// the same results as calling <c>Decode</c> for each word, but extracts the fields of several
+/// words at once using SIMD instructions when they are available.
+/// </summary>
+void Decode(uint8_t const* bytes, size_t numWords, Instruction* out) noexcept;
+
+/// <summary>
+/// A word which does not decode to any instruction.
+/// </summary>
+constexpr uint32_t InvalidWord = 0xFFFFFFFF;
+
+/// <summary>
+/// Returns the word which decodes to the given instruction. Fields the format of the instruction
+/// does not use are ignored. Returns <c>InvalidWord</c> for invalid and fused operations and
+/// breakpoints.
+/// </summary>
+uint32_t Encode(Instruction const& instruction) noexcept;
+
+#endif
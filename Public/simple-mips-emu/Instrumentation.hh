@@ -0,0 +1,284 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_INSTRUMENTATION_HH
+#define SIMPLE_MIPS_EMU_INSTRUMENTATION_HH
+
+#include <simple-mips-emu/Instruction.hh>
+#include <simple-mips-emu/Memory.hh>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// The instrumentation policy of an uninstrumented run. The engine is a template over its policy
+/// and calls these hooks as it runs: <c>OnFetch</c> before an instruction executes,
+/// <c>OnLoad</c>, <c>OnStore</c> and <c>OnBranch</c> while it executes, and <c>OnRetire</c> once
+/// it completed. All hooks are empty here, so this policy compiles to the plain engine.
+///
+/// Policies derive from this one, hide the hooks they need and set <c>IsEnabled</c>. Enabled
+/// policies run fused instructions one by one, so that every instruction goes through the hooks.
+/// The engine is instantiated for the policies in this header only.
+/// </summary>
+struct NoInstrumentation
+{
+    constexpr static bool IsEnabled = false;
+
+    void OnFetch(uint32_t, Instruction const&) noexcept
+    {
+    }
+
+    void OnRetire(uint32_t, Instruction const&) noexcept
+    {
+    }
+
+    /// <summary>
+    /// Called with the address and size of each load. <c>lwl</c> and <c>lwr</c> report the whole
+    /// aligned word.
+    /// </summary>
+    void OnLoad(Address, uint32_t) noexcept
+    {
+    }
+
+    /// <summary>
+    /// Called with the address and size of each completed store.
+    /// </summary>
+    void OnStore(Address, uint32_t) noexcept
+    {
+    }
+
+    /// <summary>
+    /// Called with the target of each branch or jump and whether it is taken.
+    /// </summary>
+    void OnBranch(uint32_t, bool) noexcept
+    {
+    }
+};
+
+/// <summary>
+/// Prints each retired instruction with its address and the memory it accessed, e.g.
+/// <c>0x400004: lw $9, 0($8) [load 0x10000000]</c>.
+/// </summary>
+class TracingPolicy : public NoInstrumentation
+{
+  public:
+    constexpr static bool IsEnabled = true;
+
+  private:
+    std::ostream& _os;
+
+    // The access of the instruction being executed.
+    std::optional<Address> _access;
+    bool                   _isStore;
+
+  public:
+    explicit TracingPolicy(std::ostream& os) noexcept;
+
+  public:
+    void OnFetch(uint32_t pc, Instruction const& instruction) noexcept;
+    void OnRetire(uint32_t pc, Instruction const& instruction);
+    void OnLoad(Address address, uint32_t size) noexcept;
+    void OnStore(Address address, uint32_t size) noexcept;
+};
+
+/// <summary>
+/// Counts how many times each instruction of the text segment retired.
+/// </summary>
+class ProfilingPolicy : public NoInstrumentation
+{
+  public:
+    constexpr static bool IsEnabled = true;
+
+  private:
+    std::vector<uint64_t> _counts;
+
+  public:
+    ProfilingPolicy() noexcept;
+
+  public:
+    void OnRetire(uint32_t pc, Instruction const& instruction);
+
+    /// <summary>
+    /// Returns the number of times the instruction at the given address retired.
+    /// </summary>
+    uint64_t GetCount(uint32_t pc) const noexcept;
+
+    /// <summary>
+    /// Prints the <c>maxEntries</c> instructions which retired most often, disassembled from the
+    /// given memory.
+    /// </summary>
+    void Print(std::ostream& os, Memory const& memory, size_t maxEntries) const;
+};
+
+/// <summary>
+/// Attributes retired instructions to the call paths they ran in. A shadow call stack follows the
+/// program: <c>jal</c>, <c>jalr</c> and taken <c>bltzal</c> and <c>bgezal</c> push a frame for
+/// their target, and <c>jr $ra</c> pops back to the frame whose return address it jumps to. A
+/// <c>jr $ra</c> to any other address is taken as a jump within the current function, so that
+/// tail calls and hand-written control flow only blur the paths instead of breaking them.
+/// </summary>
+class CallGraphPolicy : public NoInstrumentation
+{
+  public:
+    constexpr static bool IsEnabled = true;
+
+    /// <summary>
+    /// Calls nested deeper than this are attributed to the deepest path, which keeps deep
+    /// recursion from growing the call tree without bound.
+    /// </summary>
+    constexpr static size_t MaxDepth = 512;
+
+  private:
+    // The call paths form a tree whose root is the entry function.
+    struct Node
+    {
+        uint32_t function;
+        uint32_t parent;
+        uint64_t numRetired;
+    };
+
+    struct Frame
+    {
+        uint32_t node;
+        uint32_t returnAddress;
+    };
+
+    std::vector<Node> _nodes;
+
+    // The child of each node per callee, keyed by the node in the upper half and the callee in
+    // the lower half.
+    std::unordered_map<uint64_t, uint32_t> _children;
+    std::vector<Frame>                     _stack;
+    uint32_t                               _current;
+
+    // The branch of the instruction being executed.
+    uint32_t _target;
+    bool     _taken;
+
+  public:
+    /// <summary>
+    /// Creates a profiler whose root frame is the function at <c>entry</c>.
+    /// </summary>
+    explicit CallGraphPolicy(uint32_t entry = Address::MakeText(0));
+
+  public:
+    void OnRetire(uint32_t pc, Instruction const& instruction)
+    {
+        ++_nodes[_current].numRetired;
+
+        switch (instruction.operation)
+        {
+            case Operation::JAL:
+            case Operation::JALR: Call(_target, pc + 4); break;
+            case Operation::BLTZAL:
+            case Operation::BGEZAL:
+            {
+                if (_taken)
+                    Call(_target, pc + 4);
+                break;
+            }
+            case Operation::JR:
+            {
+                if (instruction.rs == Memory::RA)
+                    Return(_target);
+                break;
+            }
+            default: break;
+        }
+    }
+
+    void OnBranch(uint32_t target, bool taken) noexcept
+    {
+        _target = target;
+        _taken  = taken;
+    }
+
+    /// <summary>
+    /// Returns the depth of the shadow call stack; the entry function is at depth 0.
+    /// </summary>
+    size_t GetDepth() const noexcept
+    {
+        return _stack.size();
+    }
+
+    /// <summary>
+    /// Writes a line of <c>caller;callee count</c> for each call path which retired
+    /// instructions, with the functions named by their addresses, e.g.
+    /// <c>0x400000;0x400040 12</c>. This is the folded format flame graph tools read.
+    /// </summary>
+    void WriteFolded(std::ostream& os) const;
+
+  private:
+    void Call(uint32_t target, uint32_t returnAddress);
+    void Return(uint32_t target) noexcept;
+};
+
+struct InstrumentationStats
+{
+    uint64_t numRetired        = 0;
+    uint64_t numLoads          = 0;
+    uint64_t numStores         = 0;
+    uint64_t numBytesLoaded    = 0;
+    uint64_t numBytesStored    = 0;
+    uint64_t numBranches       = 0;
+    uint64_t numTakenBranches  = 0;
+
+    /// <summary>
+    /// The number of retired instructions of each operation, indexed by <c>Operation</c>.
+    /// </summary>
+    std::array<uint64_t, 256> numRetiredByOperation {};
+};
+
+/// <summary>
+/// Counts retired instructions by operation, memory accesses and branches.
+/// </summary>
+class StatsPolicy : public NoInstrumentation
+{
+  public:
+    constexpr static bool IsEnabled = true;
+
+  private:
+    InstrumentationStats _stats;
+
+  public:
+    void OnRetire(uint32_t, Instruction const& instruction) noexcept
+    {
+        ++_stats.numRetired;
+        ++_stats.numRetiredByOperation[static_cast<size_t>(instruction.operation)];
+    }
+
+    void OnLoad(Address, uint32_t size) noexcept
+    {
+        ++_stats.numLoads;
+        _stats.numBytesLoaded += size;
+    }
+
+    void OnStore(Address, uint32_t size) noexcept
+    {
+        ++_stats.numStores;
+        _stats.numBytesStored += size;
+    }
+
+    void OnBranch(uint32_t, bool taken) noexcept
+    {
+        ++_stats.numBranches;
+        _stats.numTakenBranches += taken ? 1 : 0;
+    }
+
+    InstrumentationStats const& GetStats() const noexcept
+    {
+        return _stats;
+    }
+
+    /// <summary>
+    /// Prints the counters and the operations which retired, most frequent first.
+    /// </summary>
+    void Print(std::ostream& os) const;
+};
+
+#endif
@@ -4,9 +4,13 @@
 #ifndef SIMPLE_MIPS_EMU_MEMORY_HH
 #define SIMPLE_MIPS_EMU_MEMORY_HH
 
+#include <simple-mips-emu/PageHashes.hh>
+#include <simple-mips-emu/SegmentPool.hh>
+
 #include <array>
 #include <cstdint>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 #include <vector>
 
@@ -15,6 +19,11 @@
 /// </summary>
 constexpr size_t NumRegisters = 32;
 
+/// <summary>
+/// Number of entries in the register file: the registers, PC, HI and LO
+/// </summary>
+constexpr size_t RegisterFileSize = NumRegisters + 3;
+
 /// <summary>
 /// Represents an address in the memory.
 /// </summary>
@@ -68,6 +77,48 @@ struct Address
     }
 };
 
+/// <summary>
+/// Addresses in [begin, end]. Note that end is inclusive.
+/// </summary>
+struct AddressRange
+{
+    Address begin;
+    Address end;
+};
+
+class Memory;
+
+/// <summary>
+/// The differences between two states. See <c>Diff</c>.
+/// </summary>
+struct MemoryDiff
+{
+    /// <summary>
+    /// The indices of the registers which differ in increasing order, where R32 is PC, R33 is HI
+    /// and R34 is LO.
+    /// </summary>
+    std::vector<uint32_t> registers;
+
+    /// <summary>
+    /// The ranges of words which differ in increasing order of address. Adjacent words which differ
+    /// form one range.
+    /// </summary>
+    std::vector<AddressRange> ranges;
+
+    bool IsEmpty() const noexcept
+    {
+        return registers.empty() && ranges.empty();
+    }
+};
+
+/// <summary>
+/// Compares the registers and the words of the segments of two states. Words past the end of a
+/// segment compare as zero, as <c>GetWord</c> reads them. Pages whose hashes are up to date in
+/// both states are only compared through their hashes, so pages which are the same are not read
+/// as long as <c>GetStateHash</c> was called for both states since they were last written.
+/// </summary>
+MemoryDiff Diff(Memory const& lhs, Memory const& rhs);
+
 /// <summary>
 /// Memory represents a state of the device at the specific time point.
 /// </summary>
@@ -75,13 +126,36 @@ class Memory
 {
   public:
     constexpr static uint32_t PC = NumRegisters;
+    constexpr static uint32_t HI = NumRegisters + 1;
+    constexpr static uint32_t LO = NumRegisters + 2;
     constexpr static uint32_t RA = NumRegisters - 1;
+    constexpr static uint32_t V0 = 2;
+    constexpr static uint32_t A0 = 4;
+
+    /// <summary>
+    /// The bytes of a segment. Segments own whole host pages so that their pages can be protected
+    /// without affecting anything else, and their pages are recycled through the
+    /// <c>SegmentPool</c> of the thread which releases them.
+    /// </summary>
+    using Segment = SegmentBuffer;
 
   private:
-    std::array<uint32_t, NumRegisters + 1> _registerFile;
-    std::vector<uint8_t>                   _text;
-    std::vector<uint8_t>                   _data;
+    std::array<uint32_t, RegisterFileSize> _registerFile;
+    Segment                                _text;
+    Segment                                _data;
     uint32_t                               _textSize, _dataSize;
+    uint64_t                               _textVersion;
+    uint32_t                               _coreId;
+
+    // The hashes of the segments, which are brought up to date by GetStateHash. The hashes of a
+    // shared data segment are never up to date, as other memories write to it.
+    mutable PageHashes _textHashes;
+    mutable PageHashes _dataHashes;
+
+    // The link of the last ll, which the next sc checks.
+    bool     _linked;
+    uint32_t _linkAddress;
+    uint32_t _linkValue;
 
   public:
     uint32_t GetTextSize() const
@@ -94,19 +168,153 @@ class Memory
         return _dataSize;
     }
 
+    /// <summary>
+    /// Returns an identifier of the contents of the text segment. It changes whenever the text
+    /// segment is modified, and no two memories share it unless one is a copy of the other whose
+    /// text has not been modified since.
+    /// </summary>
+    uint64_t GetTextVersion() const noexcept
+    {
+        return _textVersion;
+    }
+
+    /// <summary>
+    /// Returns the number of the core this memory belongs to. It is 0 unless it is set.
+    /// </summary>
+    uint32_t GetCoreId() const noexcept
+    {
+        return _coreId;
+    }
+
+    void SetCoreId(uint32_t coreId) noexcept
+    {
+        _coreId = coreId;
+    }
+
   private:
-    std::vector<uint8_t>&       GetSegmentByBase(Address::BaseType base);
-    std::vector<uint8_t> const& GetSegmentByBase(Address::BaseType base) const;
+    /// <summary>
+    /// Returns the hash of the given page of the given segment if it is up to date.
+    /// </summary>
+    std::optional<uint64_t> GetPageHash(Address::BaseType base, size_t page) const noexcept;
+
+    friend MemoryDiff Diff(Memory const& lhs, Memory const& rhs);
+
+    /// <summary>
+    /// Records a write of <c>size</c> bytes at the given address, which is in its segment.
+    /// </summary>
+    void MarkWritten(Address address, uint32_t size) noexcept;
+
+    /// <summary>
+    /// Returns the given segment for writing. A text segment shared by <c>ResetFrom</c> is copied
+    /// first.
+    /// </summary>
+    Segment& GetSegmentByBase(Address::BaseType base);
+
+    /// <summary>
+    /// Returns <c>true</c> if the given segment is a data segment which other memories share, so
+    /// that its bytes must be accessed atomically.
+    /// </summary>
+    bool IsShared(Segment const& segment) const noexcept
+    {
+        return &segment == &_data && _data.IsBorrowed();
+    }
+
+  public:
+    /// <summary>
+    /// Returns the bytes of the given segment.
+    /// </summary>
+    Segment const& GetSegmentByBase(Address::BaseType base) const;
 
   public:
     Memory(uint32_t textSize, uint32_t dataSize);
-    Memory(std::vector<uint8_t>&& text, std::vector<uint8_t>&& data) noexcept;
+    Memory(std::vector<uint8_t> const& text, std::vector<uint8_t> const& data);
     Memory(Memory const&)     = default;
     Memory(Memory&&) noexcept = default;
     Memory& operator=(Memory const&) = default;
     Memory& operator=(Memory&&) noexcept = default;
 
   public:
+    /// <summary>
+    /// Replaces the segments with the given bytes and resets the registers, which leaves the memory
+    /// in the same state as a newly constructed one apart from its core ID. The segment buffers are
+    /// reused when they are large enough. The text version changes only if the text does.
+    /// </summary>
+    void Reset(uint8_t const* text, size_t textSize, uint8_t const* data, size_t dataSize);
+
+    /// <summary>
+    /// Leaves the memory in the state of <c>initial</c> apart from its core ID. The registers and
+    /// the data segment are copied into the existing buffers, but the text segment refers to the
+    /// one of <c>initial</c> until the program writes to it, so that many memories can start from
+    /// one image without copying its text. <c>initial</c> must outlive the memory or the next
+    /// reset of it, and keep its text meanwhile.
+    /// </summary>
+    void ResetFrom(Memory const& initial);
+
+    /// <summary>
+    /// Changes the size of the data segment. Added bytes are zero. The segment may move, so
+    /// pointers into it do not apply to it afterwards. Throws <c>std::logic_error</c> if it is
+    /// pinned.
+    /// </summary>
+    void ResizeData(uint32_t dataSize);
+
+    /// <summary>
+    /// Pins or unpins the data segment. While it is pinned, its bytes stay where they are:
+    /// resetting the memory or resizing the segment throws <c>std::logic_error</c>, and sbrk
+    /// fails.
+    /// </summary>
+    void PinData(bool pinned) noexcept
+    {
+        _data.Pin(pinned);
+    }
+
+    bool IsDataPinned() const noexcept
+    {
+        return _data.IsPinned();
+    }
+
+    /// <summary>
+    /// Makes the data segment refer to the bytes of <c>data</c>, so that memories sharing them see
+    /// the stores of each other. <c>data</c> must outlive the memory and keep its size meanwhile.
+    /// Resetting the memory or resizing its data segment makes the segment its own again. The data
+    /// segment must not be pinned.
+    /// </summary>
+    void ShareData(Segment& data) noexcept;
+
+    /// <summary>
+    /// Returns <c>true</c> if the data segment refers to bytes given to <c>ShareData</c>.
+    /// </summary>
+    bool IsDataShared() const noexcept
+    {
+        return _data.IsBorrowed();
+    }
+
+    /// <summary>
+    /// Returns the bytes of the data segment, which move when it is resized. Accesses through them
+    /// skip the range checks of <c>GetWord</c> and <c>SetWord</c>, so they must be proven in range.
+    /// </summary>
+    uint8_t* GetDataBytes() noexcept
+    {
+        return _data.data();
+    }
+
+    /// <summary>
+    /// Records a write of <c>size</c> bytes at the given offset of the data segment made through
+    /// <c>GetDataBytes</c>, which the state hash does not see otherwise.
+    /// </summary>
+    void MarkDataWritten(uint32_t offset, uint32_t size) noexcept
+    {
+        _dataHashes.MarkWritten(offset, size);
+    }
+
+    /// <summary>
+    /// Returns a hash of the registers and the segments, so that two states are almost certainly
+    /// the same if their hashes are. Only the pages written since the last call are hashed again,
+    /// so the call costs little when few pages changed; as it updates the cached hashes, it must
+    /// not run concurrently with other accesses to the memory. A shared data segment is hashed as
+    /// a whole on every call. The core ID and the link of <c>LoadLinked</c> are not hashed.
+    /// </summary>
+    uint64_t GetStateHash() const noexcept;
+
     /// <summary>
     /// Returns <c>true</c> if PC is at the end of the text segment.
     /// </summary>
@@ -123,12 +331,12 @@ class Memory
     void Load(Address::BaseType base, std::vector<uint8_t> const& data) noexcept;
 
     /// <summary>
-    /// Returns the value of the given register. Note that R32 is PC.
+    /// Returns the value of the given register. Note that R32 is PC, R33 is HI and R34 is LO.
     /// </summary>
     uint32_t GetRegister(uint32_t registerIdx) const;
 
     /// <summary>
-    /// Assign the given word to the given reigster. Note that R32 is PC.
+    /// Assign the given word to the given reigster. Note that R32 is PC, R33 is HI and R34 is LO.
     /// </summary>
     void SetRegister(uint32_t registerIdx, uint32_t newValue);
 
@@ -142,6 +350,16 @@ class Memory
     /// </summary>
     void SetByte(Address address, uint8_t byte);
 
+    /// <summary>
+    /// Returns the halfword at the given address in big endian.
+    /// </summary>
+    uint16_t GetHalf(Address address) const noexcept;
+
+    /// <summary>
+    /// Assign the given halfword to the given memory location in big endian.
+    /// </summary>
+    void SetHalf(Address address, uint16_t half);
+
     /// <summary>
     /// Returns the word at the given address in big endian.
     /// </summary>
@@ -153,6 +371,28 @@ class Memory
     /// </summary>
     void SetWord(Address address, uint32_t word);
 
+    /// <summary>
+    /// Returns the word at the given address, which must be a multiple of 4, and links it: the
+    /// next <c>StoreConditional</c> to the address stores only if the word still has this value.
+    /// The load is atomic with respect to <c>StoreConditional</c> of other memories sharing the
+    /// segment.
+    /// </summary>
+    uint32_t LoadLinked(Address address) noexcept;
+
+    /// <summary>
+    /// Stores the given word at the given address, which must be a multiple of 4, if the address
+    /// is linked and the word there still has the linked value, and returns whether it did. The
+    /// check and the store are one atomic operation on the host, so exactly one of the memories
+    /// sharing the segment succeeds on the same value. The link is cleared in any case. Throws
+    /// <c>std::out_of_range</c> as <c>SetWord</c> does.
+    ///
+    /// Only the value is compared, which approximates MIPS, where any store to the word in between
+    /// makes the store fail: stores which put the linked value back (A to B to A) go unnoticed.
+    /// Guest code which relies on sc to detect such ABA sequences, e.g. a lock-free stack popping
+    /// with ll/sc on its head, may therefore succeed where the hardware would fail.
+    /// </summary>
+    bool StoreConditional(Address address, uint32_t word);
+
     /// <summary>
     /// Prints the values of the registers.
     /// </summary>
@@ -0,0 +1,87 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_MULTICORE_HH
+#define SIMPLE_MIPS_EMU_MULTICORE_HH
+
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct MulticoreOptions
+{
+    size_t numCores = 1;
+
+    /// <summary>
+    /// If not zero, the cores take turns on the calling thread, each running this many
+    /// instructions at a time in the order of their IDs, so that every run interleaves them the
+    /// same way. Otherwise each core runs on a thread of its own.
+    /// </summary>
+    uint64_t quantum = 0;
+};
+
+/// <summary>
+/// Runs a program on several cores. Each core is a <c>Memory</c> with its own registers, PC and
+/// copy of the text segment, and all of them share one data segment. The cores start in the same
+/// state and tell each other apart with <c>SyscallCode::GetCoreId</c>. Loads and stores are plain
+/// host accesses, so only <c>ll</c> and <c>sc</c> synchronize the cores, and a core which modifies
+/// its text segment does not affect the others.
+/// </summary>
+class Multicore
+{
+  private:
+    Memory::Segment     _data;
+    std::vector<Memory> _cores;
+    Program             _program;
+    MulticoreOptions    _options;
+    std::mutex          _syscallMutex;
+
+  public:
+    /// <summary>
+    /// Creates the cores from the given memory; core 0 gets ID 0 and so on. At least one core is
+    /// created.
+    /// </summary>
+    Multicore(Memory const&           memory,
+              MulticoreOptions const& options,
+              ProgramOptions const&   programOptions = ProgramOptions {});
+    Multicore(Multicore const&) = delete;
+    Multicore& operator=(Multicore const&) = delete;
+
+  public:
+    size_t GetNumCores() const noexcept
+    {
+        return _cores.size();
+    }
+
+    /// <summary>
+    /// Returns the memory of the given core. Its data segment is shared with the other cores.
+    /// </summary>
+    Memory const& GetCore(size_t index) const
+    {
+        return _cores.at(index);
+    }
+
+    /// <summary>
+    /// Returns <c>true</c> if every core is terminated.
+    /// </summary>
+    bool IsTerminated() const noexcept;
+
+    /// <summary>
+    /// Runs every core until it terminates, fails or retires <c>limits.maxInstructions</c>
+    /// instructions, and returns the result of each core; a failing core stops only itself. The
+    /// system calls of all cores are serviced by <c>limits.syscallHost</c> one at a time. The stuck
+    /// detector is not used, as a core waiting for another one repeats its state without being
+    /// stuck.
+    /// </summary>
+    std::vector<RunResult> Run(RunLimits const& limits);
+
+  private:
+    RunResult RunCore(Memory& core, RunLimits const& limits);
+};
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_PAGE_HASHES_HH
+#define SIMPLE_MIPS_EMU_PAGE_HASHES_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/// <summary>
+/// The hashes of the pages of a segment and of the whole segment, which are kept up to date
+/// lazily: a write only marks its pages as stale, and <c>Update</c> hashes the stale pages again.
+/// The hash of the segment is a sum over its pages, so updating it costs as much as the pages
+/// written since the last update, and a segment has the same hash however it got its bytes.
+/// </summary>
+class PageHashes
+{
+  public:
+    constexpr static uint32_t PageShift = 12;
+    constexpr static uint32_t PageSize  = uint32_t { 1 } << PageShift;
+
+  private:
+    std::vector<uint64_t> _hashes;
+    std::vector<uint8_t>  _isStale;
+    bool                  _hasStale;
+
+    // The sum of the hashes of the pages mixed with their indices, including the outdated hashes
+    // of stale pages.
+    uint64_t _root;
+
+  public:
+    /// <summary>
+    /// Creates the hashes of a segment of <c>size</c> bytes, whose pages are all stale.
+    /// </summary>
+    explicit PageHashes(size_t size = 0);
+
+  public:
+    /// <summary>
+    /// Marks all pages as stale, for a segment which now has <c>size</c> bytes.
+    /// </summary>
+    void Reset(size_t size);
+
+    /// <summary>
+    /// Marks the pages of <c>size</c> bytes at <c>offset</c>, which are in the segment, as stale.
+    /// </summary>
+    void MarkWritten(uint32_t offset, uint32_t size) noexcept
+    {
+        _isStale[offset >> PageShift]              = 1;
+        _isStale[(offset + size - 1) >> PageShift] = 1;
+        _hasStale                                  = true;
+    }
+
+    size_t GetNumPages() const noexcept
+    {
+        return _hashes.size();
+    }
+
+    /// <summary>
+    /// Returns the hash of the given page, or <c>std::nullopt</c> if the page is stale.
+    /// </summary>
+    std::optional<uint64_t> GetPageHash(size_t page) const noexcept
+    {
+        if (_isStale[page])
+            return std::nullopt;
+        return _hashes[page];
+    }
+
+    /// <summary>
+    /// Hashes the stale pages of the given segment again and returns the hash of the segment.
+    /// </summary>
+    uint64_t Update(uint8_t const* bytes, size_t size) noexcept;
+
+    /// <summary>
+    /// Returns the hash <c>Update</c> returns for the given segment without keeping any hashes.
+    /// </summary>
+    static uint64_t Compute(uint8_t const* bytes, size_t size) noexcept;
+};
+
+#endif
@@ -0,0 +1,201 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_PROGRAM_HH
+#define SIMPLE_MIPS_EMU_PROGRAM_HH
+
+#include <simple-mips-emu/Disassembly.hh>
+#include <simple-mips-emu/Instruction.hh>
+#include <simple-mips-emu/Memory.hh>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+struct ProgramOptions
+{
+    /// <summary>
+    /// Runs loops of the form <c>loop: addiu $t, $t, k; bne $t, $u, loop</c> in constant time
+    /// instead of iteration by iteration. The registers and the number of retired instructions are
+    /// the same as those of step-by-step execution.
+    /// </summary>
+    bool fastForwardLoops = false;
+
+    /// <summary>
+    /// Runs the loads and stores whose addresses the validation proves in the data segment
+    /// without range checks, provided the program passes validation. An address is proven when its
+    /// base register is set by <c>lui</c>, <c>ori</c> and <c>addiu</c> with constants earlier in
+    /// the same basic block. Each such access still compares its base register with the proven
+    /// value and falls back to the checked access otherwise, e.g. when a jump through a register
+    /// lands in the middle of the block.
+    /// </summary>
+    bool unchecked = false;
+};
+
+/// <summary>
+/// A word of a text segment which fails validation.
+/// </summary>
+struct ValidationError
+{
+    enum class Type
+    {
+        /// <summary>
+        /// The word does not decode to a supported instruction.
+        /// </summary>
+        InvalidInstruction,
+
+        /// <summary>
+        /// The word is a branch or jump whose target is outside of the text segment. Jumping to the
+        /// end of the segment, which terminates the program, is allowed.
+        /// </summary>
+        TargetOutOfText,
+    };
+
+    Type     type;
+    uint32_t address;
+};
+
+/// <summary>
+/// Program is the decoded form of a text segment.
+/// </summary>
+class Program
+{
+  private:
+    std::vector<Instruction> _instructions;
+    std::vector<Operation>   _dispatch;
+    ControlFlowGraph         _graph;
+    ProgramOptions           _options;
+    size_t                   _numFused;
+    uint64_t                 _textVersion;
+
+    std::vector<ValidationError>         _errors;
+    std::vector<std::optional<uint32_t>> _provenBases;
+    size_t                               _numProven;
+    uint32_t                             _provenDataSize;
+
+  private:
+    Operation Fuse(size_t index) const noexcept;
+    void      UpdateDispatch(size_t index) noexcept;
+    void      Validate();
+    void      ProveAccesses(Memory const& memory);
+
+  public:
+    /// <summary>
+    /// Decodes the text segment of the given memory, builds its control-flow graph, validates it
+    /// and fuses common instruction sequences inside each basic block.
+    /// </summary>
+    explicit Program(Memory const& memory, ProgramOptions const& options = ProgramOptions {});
+
+  public:
+    /// <summary>
+    /// Returns the number of decoded words.
+    /// </summary>
+    size_t GetSize() const noexcept
+    {
+        return _instructions.size();
+    }
+
+    /// <summary>
+    /// Returns the number of fused operations in the dispatch stream.
+    /// </summary>
+    size_t GetNumFused() const noexcept
+    {
+        return _numFused;
+    }
+
+    /// <summary>
+    /// Returns the words which failed validation, sorted by their addresses.
+    /// </summary>
+    std::vector<ValidationError> const& GetValidationErrors() const noexcept
+    {
+        return _errors;
+    }
+
+    /// <summary>
+    /// Returns the number of loads and stores proven in range. This is 0 unless
+    /// <c>ProgramOptions::unchecked</c> is set and the program passed validation.
+    /// </summary>
+    size_t GetNumProven() const noexcept
+    {
+        return _numProven;
+    }
+
+    /// <summary>
+    /// Returns the data size the proofs assume. A memory with a smaller data segment must not be
+    /// run with this program's dispatch stream.
+    /// </summary>
+    uint32_t GetProvenDataSize() const noexcept
+    {
+        return _provenDataSize;
+    }
+
+    /// <summary>
+    /// Returns the value of the base register the access at <c>index * 4</c> in the text segment
+    /// was proven with. The dispatch operation there is a proven access only if this has a value.
+    /// </summary>
+    std::optional<uint32_t> GetProvenBase(size_t index) const noexcept
+    {
+        return index < _provenBases.size() ? _provenBases[index] : std::nullopt;
+    }
+
+    /// <summary>
+    /// Returns the text version of the memory this program was decoded from.
+    /// </summary>
+    uint64_t GetTextVersion() const noexcept
+    {
+        return _textVersion;
+    }
+
+    /// <summary>
+    /// Returns the control-flow graph of the text segment.
+    /// </summary>
+    ControlFlowGraph const& GetGraph() const noexcept
+    {
+        return _graph;
+    }
+
+    /// <summary>
+    /// Returns all decoded instructions.
+    /// </summary>
+    std::vector<Instruction> const& GetInstructions() const noexcept
+    {
+        return _instructions;
+    }
+
+    /// <summary>
+    /// Returns the instruction decoded from the word at <c>index * 4</c> in the text segment.
+    /// </summary>
+    Instruction const& GetInstruction(size_t index) const noexcept
+    {
+        return _instructions[index];
+    }
+
+    /// <summary>
+    /// Returns the operation to dispatch when PC points at <c>index * 4</c> in the text segment.
+    /// This is either the operation of <c>GetInstruction(index)</c> or a fused operation.
+    /// </summary>
+    Operation GetDispatchOperation(size_t index) const noexcept
+    {
+        return _dispatch[index];
+    }
+
+    /// <summary>
+    /// Patches a breakpoint into the dispatch stream at the given address. This does not slow
+    /// down the execution of other instructions. Returns <c>false</c> if the address does not
+    /// point at a decoded word.
+    /// </summary>
+    bool SetBreakpoint(uint32_t address) noexcept;
+
+    /// <summary>
+    /// Restores the original dispatch stream at the given address. Returns <c>false</c> if there
+    /// is no breakpoint at the address.
+    /// </summary>
+    bool RemoveBreakpoint(uint32_t address) noexcept;
+
+    /// <summary>
+    /// Returns <c>true</c> if there is a breakpoint at the given address.
+    /// </summary>
+    bool HasBreakpoint(uint32_t address) const noexcept;
+};
+
+#endif
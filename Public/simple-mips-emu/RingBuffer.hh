@@ -0,0 +1,114 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_RING_BUFFER_HH
+#define SIMPLE_MIPS_EMU_RING_BUFFER_HH
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// A lock-free ring buffer with one producer thread and one consumer thread.
+/// </summary>
+template <typename T>
+class RingBuffer
+{
+  private:
+    constexpr static size_t CacheLineSize = 64;
+
+    // The indices grow without wrapping; only their lower bits select a slot. Each side keeps a
+    // copy of the other side's index and reloads it only when the buffer looks full or empty, so
+    // the two sides rarely touch the same cache line.
+    alignas(CacheLineSize) std::atomic<size_t> _head;
+    size_t _cachedTail;
+
+    alignas(CacheLineSize) std::atomic<size_t> _tail;
+    size_t _cachedHead;
+
+    alignas(CacheLineSize) std::vector<T> _slots;
+    size_t _mask;
+
+  public:
+    /// <summary>
+    /// Creates a buffer which holds at least <c>capacity</c> elements.
+    /// </summary>
+    explicit RingBuffer(size_t capacity) :
+        _head { 0 },
+        _cachedTail { 0 },
+        _tail { 0 },
+        _cachedHead { 0 }
+    {
+        size_t size = 1;
+        while (size < capacity) size *= 2;
+
+        _slots.resize(size);
+        _mask = size - 1;
+    }
+
+    RingBuffer(RingBuffer const&) = delete;
+    RingBuffer& operator=(RingBuffer const&) = delete;
+
+  public:
+    /// <summary>
+    /// Appends the given element. Returns <c>false</c> if the buffer is full. Only the producer
+    /// may call this.
+    /// </summary>
+    bool TryPush(T const& value) noexcept
+    {
+        size_t const tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cachedHead == _slots.size())
+        {
+            _cachedHead = _head.load(std::memory_order_acquire);
+            if (tail - _cachedHead == _slots.size())
+                return false;
+        }
+
+        _slots[tail & _mask] = value;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// <summary>
+    /// Appends the given element, waiting for the consumer while the buffer is full. Only the
+    /// producer may call this.
+    /// </summary>
+    void Push(T const& value) noexcept
+    {
+        while (!TryPush(value)) std::this_thread::yield();
+    }
+
+    /// <summary>
+    /// Removes up to <c>maxCount</c> elements into <c>out</c> and returns their number. Only the
+    /// consumer may call this.
+    /// </summary>
+    size_t TryPop(T* out, size_t maxCount) noexcept
+    {
+        size_t const head = _head.load(std::memory_order_relaxed);
+        if (head == _cachedTail)
+        {
+            _cachedTail = _tail.load(std::memory_order_acquire);
+            if (head == _cachedTail)
+                return 0;
+        }
+
+        size_t count = _cachedTail - head;
+        if (count > maxCount)
+            count = maxCount;
+
+        for (size_t i = 0; i < count; ++i) out[i] = _slots[(head + i) & _mask];
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /// <summary>
+    /// Returns <c>true</c> if there is nothing to pop. Only the consumer may call this.
+    /// </summary>
+    bool IsEmpty() const noexcept
+    {
+        return _head.load(std::memory_order_relaxed) == _tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_SAMPLING_HH
+#define SIMPLE_MIPS_EMU_SAMPLING_HH
+
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Instrumentation.hh>
+#include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+struct SamplingOptions
+{
+    /// <summary>
+    /// The number of instructions from one sample point to the next.
+    /// </summary>
+    uint64_t period = 1000000;
+
+    /// <summary>
+    /// The number of instructions each sample runs in detail before it is measured, so that the
+    /// state of the detailed model does not start cold.
+    /// </summary>
+    uint64_t warmup = 10000;
+
+    /// <summary>
+    /// The number of instructions measured in each sample.
+    /// </summary>
+    uint64_t length = 10000;
+
+    size_t numWorkers = 1;
+
+    /// <summary>
+    /// The limits of the fast-forwarded run. Samples only use the deadline; they service system
+    /// calls with a host per worker whose output is discarded and whose input is empty.
+    /// </summary>
+    RunLimits limits {};
+};
+
+/// <summary>
+/// The result of one detailed sample.
+/// </summary>
+struct SampleResult
+{
+    /// <summary>
+    /// The number of instructions the fast-forwarded run retired before the sample point.
+    /// </summary>
+    uint64_t position;
+
+    /// <summary>
+    /// The number of warm-up instructions, which is less than <c>SamplingOptions::warmup</c> only
+    /// if the sample stopped during the warm-up.
+    /// </summary>
+    uint64_t numWarmup;
+
+    /// <summary>
+    /// How the sample stopped: <c>TickResult::Success</c> if it ran its length or the program
+    /// terminated.
+    /// </summary>
+    TickResult result;
+
+    /// <summary>
+    /// The counters of the measured instructions.
+    /// </summary>
+    InstrumentationStats stats;
+};
+
+struct SamplingResult
+{
+    /// <summary>
+    /// The result of the fast-forwarded run.
+    /// </summary>
+    RunResult run;
+
+    /// <summary>
+    /// The samples in order of their positions.
+    /// </summary>
+    std::vector<SampleResult> samples;
+};
+
+/// <summary>
+/// An estimate of a counter per retired instruction over the whole run.
+/// </summary>
+struct SampledRate
+{
+    double mean;
+
+    /// <summary>
+    /// The half width of the 95% confidence interval of the mean, which is infinite with fewer
+    /// than two samples.
+    /// </summary>
+    double halfWidth;
+
+    size_t numSamples;
+};
+
+/// <summary>
+/// Runs the program in the given memory with the uninstrumented engine, and takes a checkpoint of
+/// the state every <c>options.period</c> instructions. Each checkpoint runs the warm-up and the
+/// measured instructions with <c>StatsPolicy</c> on one of <c>options.numWorkers</c> threads while
+/// the fast-forwarded run goes on. A checkpoint copies the registers and the data segment but
+/// shares the text segment as long as the program does not modify it. Samples which reach a point
+/// where the program reads input see none. Throws <c>std::invalid_argument</c> if the period or
+/// the length is zero.
+/// </summary>
+SamplingResult RunSampled(Memory& memory, Program const& program, SamplingOptions const& options);
+
+/// <summary>
+/// Estimates the given counter per retired instruction from the samples which measured any
+/// instruction, as the mean of their rates.
+/// </summary>
+SampledRate EstimateRate(SamplingResult const& result, uint64_t InstrumentationStats::*counter);
+
+/// <summary>
+/// Prints the estimated rates of the loads, stores and branches and the totals they extrapolate
+/// to over the fast-forwarded run.
+/// </summary>
+void PrintEstimates(std::ostream& os, SamplingResult const& result);
+
+#endif
@@ -0,0 +1,184 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_SCHEDULER_HH
+#define SIMPLE_MIPS_EMU_SCHEDULER_HH
+
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Emulator.hh>
+#include <simple-mips-emu/Program.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SchedulerOptions
+{
+    size_t numWorkers = 1;
+
+    /// <summary>
+    /// The number of instructions a guest runs before it goes back to the queue.
+    /// </summary>
+    uint64_t quantum = 1 << 16;
+
+    /// <summary>
+    /// The number of quanta a new guest runs before the guests which are already queued, so that
+    /// short guests finish with little waiting however many long ones there are.
+    /// </summary>
+    uint64_t startCredit = 4;
+};
+
+struct GuestOptions
+{
+    /// <summary>
+    /// The share of the workers the guest gets: while guests are queued together, each retires
+    /// instructions in proportion to its priority. Must be positive.
+    /// </summary>
+    uint32_t priority = 1;
+
+    /// <summary>
+    /// The instruction budget of the guest over all its quanta.
+    /// </summary>
+    uint64_t maxInstructions = std::numeric_limits<uint64_t>::max();
+
+    /// <summary>
+    /// The guest stops with <c>TickResult::TimeLimitExceeded</c> once this point has passed, which
+    /// counts the time it waits in the queue.
+    /// </summary>
+    std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+
+    /// <summary>
+    /// What the guest reads with system calls.
+    /// </summary>
+    std::string input {};
+
+    /// <summary>
+    /// What the guest prints past this many bytes is dropped.
+    /// </summary>
+    uint64_t maxOutputSize = SyscallHost::DefaultMaxOutputSize;
+};
+
+/// <summary>
+/// What a guest did, and how the scheduler treated it.
+/// </summary>
+struct GuestResult
+{
+    uint64_t id;
+
+    /// <summary>
+    /// The result over all quanta of the guest.
+    /// </summary>
+    RunResult run;
+
+    uint64_t numQuanta;
+
+    /// <summary>
+    /// The time from the submission of the guest to the end of its last quantum.
+    /// </summary>
+    std::chrono::steady_clock::duration latency;
+
+    /// <summary>
+    /// The total and the longest time the guest waited in the queue.
+    /// </summary>
+    std::chrono::steady_clock::duration waitTime;
+    std::chrono::steady_clock::duration maxWaitTime;
+
+    /// <summary>
+    /// What the guest printed with system calls.
+    /// </summary>
+    std::string output;
+};
+
+struct SchedulerStats
+{
+    uint64_t numSubmitted    = 0;
+    uint64_t numFinished     = 0;
+    uint64_t numQuanta       = 0;
+    uint64_t numInstructions = 0;
+
+    /// <summary>
+    /// The number of guests which are queued or running.
+    /// </summary>
+    size_t numGuests = 0;
+};
+
+/// <summary>
+/// Runs many guests on a fixed set of workers, a quantum at a time. A worker takes the guest which
+/// has had the least time for its priority, runs it for a quantum with <c>Emulator::Run</c> and
+/// queues it again, until it terminates, fails or uses up its budget. Guests start with a credit
+/// of a few quanta, so that a worker takes a new guest as soon as it finishes its current quantum.
+/// </summary>
+class Scheduler
+{
+  public:
+    /// <summary>
+    /// Called on a worker when a guest finishes, with the emulator it ran in.
+    /// </summary>
+    using Callback = std::function<void(Emulator& emulator, GuestResult result)>;
+
+  private:
+    struct Guest;
+
+    SchedulerOptions                    _options;
+    ProgramOptions                      _programOptions;
+    mutable std::mutex                  _mutex;
+    std::condition_variable             _changed;
+    std::vector<std::unique_ptr<Guest>> _queue;
+    std::vector<Emulator>               _idle;
+    double                              _virtualTime;
+    SchedulerStats                      _stats;
+    bool                                _stopping;
+    std::vector<std::thread>            _workers;
+
+  public:
+    /// <summary>
+    /// Starts the workers. Throws <c>std::invalid_argument</c> if the quantum is zero.
+    /// </summary>
+    explicit Scheduler(SchedulerOptions const& options,
+                       ProgramOptions const&   programOptions = ProgramOptions {});
+    Scheduler(Scheduler const&) = delete;
+    Scheduler& operator=(Scheduler const&) = delete;
+
+    /// <summary>
+    /// Runs the guests which are left to the end, and stops the workers.
+    /// </summary>
+    ~Scheduler() noexcept;
+
+  public:
+    /// <summary>
+    /// Returns an emulator to load a guest into, reusing the buffers of a finished guest if there
+    /// is one.
+    /// </summary>
+    Emulator Acquire();
+
+    /// <summary>
+    /// Queues the program loaded in the given emulator and returns the ID of the guest. Throws
+    /// <c>std::invalid_argument</c> if the priority is zero.
+    /// </summary>
+    uint64_t Submit(Emulator emulator, GuestOptions options, Callback onFinished);
+
+    /// <summary>
+    /// Waits until every guest submitted so far has finished.
+    /// </summary>
+    void Wait();
+
+    SchedulerStats GetStats() const;
+
+  private:
+    static bool IsLater(std::unique_ptr<Guest> const& lhs,
+                        std::unique_ptr<Guest> const& rhs) noexcept;
+
+    void Work();
+};
+
+#endif
@@ -0,0 +1,233 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_SEGMENT_POOL_HH
+#define SIMPLE_MIPS_EMU_SEGMENT_POOL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct SegmentPoolStats
+{
+    /// <summary>
+    /// The number of blocks handed out, including reused ones.
+    /// </summary>
+    uint64_t numAllocations = 0;
+
+    uint64_t numReuses = 0;
+
+    /// <summary>
+    /// The number of bytes cleared for reused blocks. Blocks from the host are already zero.
+    /// </summary>
+    uint64_t numBytesZeroed = 0;
+
+    /// <summary>
+    /// The number of bytes in blocks which are kept for reuse.
+    /// </summary>
+    size_t numCachedBytes = 0;
+};
+
+/// <summary>
+/// A per-thread pool of page-aligned blocks for segments. Sizes are rounded up to a power of two
+/// pages, and released blocks are kept by size class until they are requested again, so that
+/// repeated runs neither go through the global allocator nor fault in fresh pages. Blocks come from
+/// the host zeroed, and a block remembers how many of its leading bytes may have been written;
+/// only those are cleared, and only when the block is requested with zeros again.
+/// </summary>
+class SegmentPool
+{
+  public:
+    struct Block
+    {
+        uint8_t* bytes    = nullptr;
+        size_t   capacity = 0;
+
+        /// <summary>
+        /// All bytes from this offset on are zero.
+        /// </summary>
+        size_t dirty = 0;
+    };
+
+  private:
+    /// <summary>
+    /// Blocks of up to <c>1 &lt;&lt; (NumClasses - 1)</c> pages are pooled. Larger ones go back
+    /// to the host when they are released.
+    /// </summary>
+    constexpr static size_t NumClasses = 16;
+
+  private:
+    std::array<std::vector<Block>, NumClasses> _freeBlocks;
+    size_t                                     _maxCachedBytes;
+    SegmentPoolStats                           _stats;
+
+  public:
+    SegmentPool() noexcept;
+    SegmentPool(SegmentPool const&) = delete;
+    SegmentPool& operator=(SegmentPool const&) = delete;
+    ~SegmentPool() noexcept;
+
+  public:
+    /// <summary>
+    /// Returns the pool of the calling thread, or <c>nullptr</c> while the thread is exiting and
+    /// its pool is already destroyed.
+    /// </summary>
+    static SegmentPool* GetLocal() noexcept;
+
+    /// <summary>
+    /// Returns a block of at least <c>size</c> bytes. If <c>zeroed</c> is <c>true</c>, the first
+    /// <c>size</c> bytes are zero; otherwise the caller is expected to overwrite them. In both
+    /// cases the block is marked as dirty up to <c>size</c>.
+    /// </summary>
+    Block Allocate(size_t size, bool zeroed);
+
+    /// <summary>
+    /// Keeps the block for reuse, or returns it to the host if it is too large or the pool already
+    /// holds <c>GetMaxCachedBytes()</c> bytes. The block may come from another thread's pool.
+    /// </summary>
+    void Release(Block block) noexcept;
+
+    /// <summary>
+    /// Returns all kept blocks to the host.
+    /// </summary>
+    void Trim() noexcept;
+
+    size_t GetMaxCachedBytes() const noexcept
+    {
+        return _maxCachedBytes;
+    }
+
+    void SetMaxCachedBytes(size_t maxCachedBytes) noexcept;
+
+    SegmentPoolStats const& GetStats() const noexcept
+    {
+        return _stats;
+    }
+
+  private:
+    static size_t GetClass(size_t size) noexcept;
+};
+
+/// <summary>
+/// The bytes of a segment in a block of the calling thread's <c>SegmentPool</c>. It provides the
+/// parts of <c>std::vector</c> which segments are used through; unlike a vector, creating a zeroed
+/// buffer only clears what the previous owner of its block may have written. A buffer may also
+/// borrow the block of another one, so that several segments share the same bytes.
+/// </summary>
+class SegmentBuffer
+{
+  private:
+    SegmentPool::Block _block;
+    size_t             _size;
+    bool               _borrowed;
+    bool               _pinned;
+
+  public:
+    SegmentBuffer() noexcept;
+
+    /// <summary>
+    /// Creates a buffer of <c>size</c> zero bytes.
+    /// </summary>
+    explicit SegmentBuffer(size_t size);
+
+    SegmentBuffer(uint8_t const* bytes, size_t size);
+    SegmentBuffer(SegmentBuffer const& other);
+    SegmentBuffer(SegmentBuffer&& other) noexcept;
+    SegmentBuffer& operator=(SegmentBuffer const& other);
+    SegmentBuffer& operator=(SegmentBuffer&& other) noexcept;
+    ~SegmentBuffer() noexcept;
+
+  public:
+    /// <summary>
+    /// Replaces the contents with the given bytes. The block is kept if it is large enough. Throws
+    /// <c>std::logic_error</c> if the buffer is pinned.
+    /// </summary>
+    void assign(uint8_t const* first, uint8_t const* last);
+
+    /// <summary>
+    /// Changes the size, keeping the contents up to the smaller size. Added bytes are zero. The
+    /// block is kept if it is large enough. Throws <c>std::logic_error</c> if the buffer is pinned.
+    /// </summary>
+    void resize(size_t size);
+
+    /// <summary>
+    /// Pins or unpins the buffer. The bytes of a pinned buffer are not replaced or moved by
+    /// <c>assign</c> and <c>resize</c>, so that the protection of their pages can be changed.
+    /// Copies are not pinned.
+    /// </summary>
+    void Pin(bool pinned) noexcept
+    {
+        _pinned = pinned;
+    }
+
+    bool IsPinned() const noexcept
+    {
+        return _pinned;
+    }
+
+    /// <summary>
+    /// Makes the buffer refer to the bytes of <c>owner</c> instead of a block of its own. The owner
+    /// must outlive the buffer and keep its block meanwhile. Copies of a borrowing buffer own their
+    /// blocks, and assigning to or resizing it makes it own a block again.
+    /// </summary>
+    void Borrow(SegmentBuffer& owner) noexcept;
+
+    bool IsBorrowed() const noexcept
+    {
+        return _borrowed;
+    }
+
+    size_t size() const noexcept
+    {
+        return _size;
+    }
+
+    uint8_t* data() noexcept
+    {
+        return _block.bytes;
+    }
+
+    uint8_t const* data() const noexcept
+    {
+        return _block.bytes;
+    }
+
+    uint8_t* begin() noexcept
+    {
+        return _block.bytes;
+    }
+
+    uint8_t const* begin() const noexcept
+    {
+        return _block.bytes;
+    }
+
+    uint8_t* end() noexcept
+    {
+        return _block.bytes + _size;
+    }
+
+    uint8_t const* end() const noexcept
+    {
+        return _block.bytes + _size;
+    }
+
+    uint8_t& operator[](size_t offset) noexcept
+    {
+        return _block.bytes[offset];
+    }
+
+    uint8_t const& operator[](size_t offset) const noexcept
+    {
+        return _block.bytes[offset];
+    }
+
+    uint8_t& at(size_t offset);
+    uint8_t const& at(size_t offset) const;
+
+  private:
+    void Release() noexcept;
+};
+
+#endif
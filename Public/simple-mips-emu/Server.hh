@@ -0,0 +1,218 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_SERVER_HH
+#define SIMPLE_MIPS_EMU_SERVER_HH
+
+#include <simple-mips-emu/Emulator.hh>
+#include <simple-mips-emu/ImageCache.hh>
+#include <simple-mips-emu/Program.hh>
+#include <simple-mips-emu/Scheduler.hh>
+#include <simple-mips-emu/Trace.hh>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Messages are a 32-bit little-endian length followed by that many bytes. Integers in messages are
+// little-endian as well.
+//
+// Request:  id (u64), max instructions (u64), time limit in ms or 0 (u64), number of ranges (u32),
+//           ranges (u32 begin, u32 end each), then either 0 (u8), text size (u32), text, data size
+//           (u32), data; or 1 (u8) followed by a path of at most 4096 bytes, which takes the rest
+//           of the message.
+// Response: id (u64), status (u32), retired instructions (u64), output, which takes the rest of
+//           the message.
+//
+// Jobs read no input, and what they print with syscall is part of their output.
+//
+// The server runs a job for at most 2^36 instructions and 60 s, whatever the request asks for,
+// and drops what it prints past 16 MiB. A connection is not read while 16 of its jobs are
+// unanswered.
+
+/// <summary>
+/// A program to run in server mode, together with what to report.
+/// </summary>
+struct JobRequest
+{
+    /// <summary>
+    /// Chosen by the client and copied into the response. Responses of a connection may arrive in
+    /// any order.
+    /// </summary>
+    uint64_t id = 0;
+
+    uint64_t maxInstructions = std::numeric_limits<uint64_t>::max();
+
+    /// <summary>
+    /// The wall-clock budget in milliseconds, or zero for none. In server mode it counts from when
+    /// the request is read, and it is at most 60 s.
+    /// </summary>
+    uint64_t timeLimitMs = 0;
+
+    /// <summary>
+    /// Memory ranges to dump after the registers. Each must span less than 4 MiB, and all of them
+    /// at most 16 MiB.
+    /// </summary>
+    std::vector<AddressRange> ranges;
+
+    /// <summary>
+    /// The path of an executable in the format <c>ReadFile</c> reads. If it is empty, the
+    /// segments below are run instead.
+    /// </summary>
+    std::string path;
+
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+};
+
+struct JobResponse
+{
+    /// <summary>
+    /// The status of a job which could not be run, e.g. because its program cannot be read.
+    /// </summary>
+    constexpr static uint32_t InvalidJob = 0xFFFFFFFF;
+
+    uint64_t id = 0;
+
+    /// <summary>
+    /// The <c>TickResult</c> of the run, or <c>InvalidJob</c>.
+    /// </summary>
+    uint32_t status = InvalidJob;
+
+    uint64_t numInstructions = 0;
+
+    /// <summary>
+    /// What the program printed, followed by the registers and the ranges as <c>runfile</c> prints
+    /// them at the end, or the reason why the job is invalid.
+    /// </summary>
+    std::string output;
+};
+
+/// <summary>
+/// Returns the payload of the message for the given request.
+/// </summary>
+std::vector<uint8_t> EncodeJobRequest(JobRequest const& request);
+
+/// <summary>
+/// Parses the payload of a request message. Returns <c>std::nullopt</c> if it is malformed.
+/// </summary>
+std::optional<JobRequest> DecodeJobRequest(uint8_t const* bytes, size_t size);
+
+/// <summary>
+/// Returns the payload of the message for the given response.
+/// </summary>
+std::vector<uint8_t> EncodeJobResponse(JobResponse const& response);
+
+/// <summary>
+/// Parses the payload of a response message. Returns <c>std::nullopt</c> if it is malformed.
+/// </summary>
+std::optional<JobResponse> DecodeJobResponse(uint8_t const* bytes, size_t size);
+
+/// <summary>
+/// Runs the given job on the emulator, reusing its buffers. Programs given by path are loaded
+/// through the cache unless it is null.
+/// </summary>
+JobResponse RunJob(Emulator& emulator, JobRequest const& request, ImageCache* cache = nullptr);
+
+/// <summary>
+/// Runs jobs received over a Unix domain socket on a pool of workers. Jobs are loaded as they are
+/// read and run by a <c>Scheduler</c> a quantum at a time, so that short jobs do not wait behind
+/// long ones, and emulators are reused across jobs. Programs given by path are shared through an
+/// <c>ImageCache</c>. A response is sent as soon as its job finishes, by a thread of its
+/// connection, so that a client which does not read stalls only its own connection.
+/// </summary>
+class Server
+{
+  private:
+    struct Connection;
+
+  private:
+    std::filesystem::path                  _path;
+    ImageCache                             _cache;
+    int                                    _listener;
+    std::mutex                             _mutex;
+    std::condition_variable                _changed;
+    std::vector<std::weak_ptr<Connection>> _connections;
+    size_t                                 _numReaders;
+    bool                                   _stopping;
+
+    // Last, so that the jobs which are left finish before anything else goes away.
+    Scheduler _scheduler;
+
+  public:
+    Server(std::filesystem::path path,
+           size_t                numWorkers,
+           ProgramOptions const& options,
+           size_t                cacheBudget = 64 << 20,
+           uint64_t              quantum     = SchedulerOptions {}.quantum);
+    Server(Server const&) = delete;
+    Server& operator=(Server const&) = delete;
+    ~Server() noexcept;
+
+  public:
+    ImageCacheStats GetCacheStats() const
+    {
+        return _cache.GetStats();
+    }
+
+    /// <summary>
+    /// Returns <c>true</c> if server mode is supported on this host.
+    /// </summary>
+    static bool IsSupported() noexcept;
+
+    /// <summary>
+    /// Creates the socket, replacing a stale socket file at the path. Clients can connect once this
+    /// returns <c>true</c>.
+    /// </summary>
+    bool Listen() noexcept;
+
+    /// <summary>
+    /// Accepts connections and runs their jobs until <c>Stop</c> is called. Jobs which are queued
+    /// by then still run. The socket file is removed before this returns.
+    /// </summary>
+    void Serve();
+
+    /// <summary>
+    /// Makes <c>Serve</c> return. This may be called from any thread.
+    /// </summary>
+    void Stop() noexcept;
+
+  private:
+    void Read(std::shared_ptr<Connection> connection);
+    void Submit(std::shared_ptr<Connection> const& connection, JobRequest request);
+    void Respond(Connection& connection, JobResponse response);
+    void Write(Connection& connection);
+};
+
+/// <summary>
+/// A client of <c>Server</c> which sends jobs and receives their responses.
+/// </summary>
+class ServerClient
+{
+  private:
+    int _fd;
+
+  public:
+    ServerClient() noexcept;
+    ServerClient(ServerClient const&) = delete;
+    ServerClient& operator=(ServerClient const&) = delete;
+    ~ServerClient() noexcept;
+
+  public:
+    bool Connect(std::filesystem::path const& path) noexcept;
+    bool Send(JobRequest const& request);
+
+    /// <summary>
+    /// Waits for the next response. Returns <c>std::nullopt</c> if the connection is closed.
+    /// </summary>
+    std::optional<JobResponse> Receive();
+};
+
+#endif
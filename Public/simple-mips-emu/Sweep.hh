@@ -0,0 +1,129 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_SWEEP_HH
+#define SIMPLE_MIPS_EMU_SWEEP_HH
+
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/File.hh>
+#include <simple-mips-emu/ImageCache.hh>
+#include <simple-mips-emu/Memory.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <variant>
+#include <vector>
+
+/// <summary>
+/// A register or consecutive words of memory which the inputs of a sweep are written to or its
+/// outputs are read from.
+/// </summary>
+struct SweepField
+{
+    enum class Kind
+    {
+        Register,
+        Memory,
+    };
+
+    Kind kind;
+
+    /// <summary>
+    /// The index of the register, or the address of the first word.
+    /// </summary>
+    uint32_t location;
+
+    /// <summary>
+    /// The number of words. A register has one.
+    /// </summary>
+    uint32_t numWords;
+
+    static SweepField MakeRegister(uint32_t index) noexcept
+    {
+        return SweepField { Kind::Register, index, 1 };
+    }
+
+    static SweepField MakeMemory(Address address, uint32_t numWords) noexcept
+    {
+        return SweepField { Kind::Memory, address, numWords };
+    }
+};
+
+struct SweepOptions
+{
+    /// <summary>
+    /// Where the words of each input go, in order.
+    /// </summary>
+    std::vector<SweepField> inputs {};
+
+    /// <summary>
+    /// Which words are recorded after each run, in order.
+    /// </summary>
+    std::vector<SweepField> outputs {};
+
+    size_t numWorkers = 1;
+
+    /// <summary>
+    /// The limits of each run, except for the deadline which applies to the whole sweep. If a
+    /// stuck detector is given, each worker uses one of its own instead. System calls are
+    /// serviced by a host per worker whose output is discarded and whose input is empty.
+    /// </summary>
+    RunLimits limits {};
+};
+
+/// <summary>
+/// The results of a sweep, stored by column so that each output can be read as one array.
+/// </summary>
+struct SweepResult
+{
+    size_t numInputs = 0;
+
+    /// <summary>
+    /// Column <c>c</c> of input <c>i</c> is at <c>c * numInputs + i</c>. Column 0 holds the
+    /// <c>TickResult</c> each run stopped with, and the output words follow in order.
+    /// </summary>
+    std::vector<uint32_t> columns {};
+
+    uint64_t numInstructions = 0;
+};
+
+/// <summary>
+/// Returns the number of words the given fields hold.
+/// </summary>
+size_t GetSweepWidth(std::vector<SweepField> const& fields) noexcept;
+
+/// <summary>
+/// Runs the program of the image once for each input on <c>options.numWorkers</c> threads.
+/// <c>inputs</c> holds the inputs one after another, each of <c>GetSweepWidth(options.inputs)</c>
+/// words. Every run starts from the initial memory of the image with the input written over it;
+/// the text segment and the decoded program are shared by all runs, so each run costs little more
+/// than the emulation itself. Throws <c>std::invalid_argument</c> if a field is outside of the
+/// registers or the segments.
+/// </summary>
+SweepResult RunSweep(ProgramImage const&          image,
+                     std::vector<uint32_t> const& inputs,
+                     SweepOptions const&          options);
+
+/// <summary>
+/// The union of all possible return values of <c>ReadSweepInputs</c>
+/// </summary>
+using SweepInputsReadResult = std::variant<std::vector<uint32_t>, CannotRead>;
+
+/// <summary>
+/// Reads the inputs of a sweep from a file of words in the given byte order. Its size must be a
+/// multiple of <c>width</c> words.
+/// </summary>
+SweepInputsReadResult
+    ReadSweepInputs(std::filesystem::path const& path, size_t width, ByteOrder byteOrder);
+
+/// <summary>
+/// Writes the columns of the result one after another as words in the given byte order. Returns
+/// <c>std::nullopt</c> on success.
+/// </summary>
+std::optional<FileWriteError> WriteSweepResult(std::filesystem::path const& path,
+                                               SweepResult const&           result,
+                                               ByteOrder                    byteOrder);
+
+#endif
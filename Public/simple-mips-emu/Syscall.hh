@@ -0,0 +1,111 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_SYSCALL_HH
+#define SIMPLE_MIPS_EMU_SYSCALL_HH
+
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Memory.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+
+/// <summary>
+/// The services of <c>syscall</c>, selected by $v0. The codes and conventions follow SPIM.
+/// </summary>
+enum class SyscallCode : uint32_t
+{
+    /// <summary>
+    /// Prints $a0 as a signed decimal number.
+    /// </summary>
+    PrintInt = 1,
+
+    /// <summary>
+    /// Prints the NUL-terminated string at $a0.
+    /// </summary>
+    PrintString = 4,
+
+    /// <summary>
+    /// Reads a decimal number into $v0. It is 0 if no number can be read.
+    /// </summary>
+    ReadInt = 5,
+
+    /// <summary>
+    /// Grows the data segment by $a0 bytes and returns the address of the new bytes in $v0, or
+    /// -1 if $a0 is negative, the segment would become too large, or it is shared between cores
+    /// or pinned by watchpoints.
+    /// The old end and the size are rounded up to words.
+    /// </summary>
+    Sbrk = 9,
+
+    /// <summary>
+    /// Terminates the program by moving PC to the end of the text segment.
+    /// </summary>
+    Exit = 10,
+
+    /// <summary>
+    /// Prints the lowest byte of $a0 as a character.
+    /// </summary>
+    PrintChar = 11,
+
+    /// <summary>
+    /// Returns the ID of the calling core in $v0; see <c>Multicore</c>. This is not a SPIM
+    /// service.
+    /// </summary>
+    GetCoreId = 100,
+};
+
+/// <summary>
+/// Services system calls with host streams. Output is collected in a large buffer and written to
+/// the stream only when the buffer is full, when input is read and on <c>Flush</c>, so that many
+/// small prints cost no more than appending to a string. Strings are printed straight from the
+/// segment which holds them. Output past <c>maxOutputSize</c> bytes is dropped.
+/// </summary>
+class SyscallHost
+{
+  public:
+    constexpr static size_t   DefaultBufferSize    = 1 << 20;
+    constexpr static uint32_t DefaultMaxDataSize   = 1 << 28;
+    constexpr static uint64_t DefaultMaxOutputSize = std::numeric_limits<uint64_t>::max();
+
+  private:
+    std::ostream& _output;
+    std::istream& _input;
+    std::string   _buffer;
+    size_t        _bufferSize;
+    uint32_t      _maxDataSize;
+    uint64_t      _maxOutputSize;
+    uint64_t      _outputSize;
+
+  public:
+    SyscallHost(std::ostream& output,
+                std::istream& input,
+                size_t        bufferSize    = DefaultBufferSize,
+                uint32_t      maxDataSize   = DefaultMaxDataSize,
+                uint64_t      maxOutputSize = DefaultMaxOutputSize);
+    SyscallHost(SyscallHost const&) = delete;
+    SyscallHost& operator=(SyscallHost const&) = delete;
+    ~SyscallHost() noexcept;
+
+  public:
+    /// <summary>
+    /// Runs the system call at PC and moves PC past it. Returns
+    /// <c>TickResult::InvalidInstruction</c> for an unknown service and
+    /// <c>TickResult::MemoryOutOfRange</c> for a string which does not end within its segment;
+    /// the memory is not mutated then.
+    /// </summary>
+    TickResult Service(Memory& memory);
+
+    /// <summary>
+    /// Writes the buffered output to the stream.
+    /// </summary>
+    void Flush();
+
+  private:
+    void Write(char const* bytes, size_t size);
+};
+
+#endif
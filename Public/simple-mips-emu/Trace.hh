@@ -0,0 +1,258 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_TRACE_HH
+#define SIMPLE_MIPS_EMU_TRACE_HH
+
+#include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/RingBuffer.hh>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// The part of the state a dump shows: the registers and the words in a range of the memory.
+/// </summary>
+class StateSnapshot
+{
+  private:
+    std::array<uint32_t, NumRegisters + 1> _registers;
+    std::optional<AddressRange>            _range;
+    std::vector<uint32_t>                  _words;
+
+  public:
+    explicit StateSnapshot(std::optional<AddressRange> range = std::nullopt);
+
+  public:
+    /// <summary>
+    /// Copies the registers and the words in the range from the given memory. This does not
+    /// allocate.
+    /// </summary>
+    void Capture(Memory const& memory) noexcept;
+
+    /// <summary>
+    /// Returns the value of the given register. Note that R32 is PC.
+    /// </summary>
+    uint32_t GetRegister(uint32_t registerIdx) const noexcept
+    {
+        return _registers[registerIdx];
+    }
+
+    void SetRegister(uint32_t registerIdx, uint32_t newValue) noexcept
+    {
+        _registers[registerIdx] = newValue;
+    }
+
+    /// <summary>
+    /// Returns the number of words in the range.
+    /// </summary>
+    size_t GetNumWords() const noexcept
+    {
+        return _words.size();
+    }
+
+    /// <summary>
+    /// Returns the <c>index</c>-th word in the range.
+    /// </summary>
+    uint32_t GetWord(size_t index) const noexcept
+    {
+        return _words[index];
+    }
+
+    void SetWord(size_t index, uint32_t newValue) noexcept
+    {
+        _words[index] = newValue;
+    }
+
+    /// <summary>
+    /// Returns the address of the <c>index</c>-th word in the range.
+    /// </summary>
+    uint32_t GetWordAddress(size_t index) const noexcept
+    {
+        return static_cast<uint32_t>(_range->begin) + static_cast<uint32_t>(index * 4);
+    }
+
+    /// <summary>
+    /// Prints the snapshot in the same format as <c>Memory::DumpRegisters</c> followed by
+    /// <c>Memory::DumpMemory</c>.
+    /// </summary>
+    void Dump(std::ostream& os) const;
+
+    /// <summary>
+    /// Returns <c>true</c> if the registers except for PC and the words are the same as the other
+    /// snapshot's.
+    /// </summary>
+    bool HasSameValues(StateSnapshot const& other) const noexcept;
+};
+
+/// <summary>
+/// Conditions which dump the state after a tick. A tick is dumped if any of them holds.
+/// </summary>
+struct DumpTriggers
+{
+    /// <summary>
+    /// Dumps after every <c>every</c>-th tick. Zero disables the trigger.
+    /// </summary>
+    uint64_t every = 0;
+
+    /// <summary>
+    /// Dumps when the PC moves into the range from outside of it.
+    /// </summary>
+    std::optional<AddressRange> pcRange = std::nullopt;
+
+    /// <summary>
+    /// Dumps when a register or a word in the dumped memory range changes.
+    /// </summary>
+    bool onChange = false;
+
+    /// <summary>
+    /// Dumps the first <c>first</c> ticks.
+    /// </summary>
+    uint64_t first = 0;
+
+    /// <summary>
+    /// Dumps the last <c>last</c> ticks once the emulation ends. They are kept in a ring buffer
+    /// until then.
+    /// </summary>
+    uint64_t last = 0;
+
+    bool IsEnabled() const noexcept
+    {
+        return every != 0 || pcRange || onChange || first != 0 || last != 0;
+    }
+};
+
+/// <summary>
+/// Evaluates <c>DumpTriggers</c> after each tick. No tick is dumped twice: <c>DumpLast</c> skips
+/// the last ticks which the other triggers have dumped already.
+/// </summary>
+class DumpSampler
+{
+  private:
+    struct Entry
+    {
+        StateSnapshot state;
+        bool          dumped;
+    };
+
+  private:
+    DumpTriggers       _triggers;
+    uint32_t           _pcBegin, _pcEnd;
+    uint64_t           _numTicks;
+    uint64_t           _nextSample;
+    bool               _wasInRange;
+    std::vector<Entry> _ring;
+    uint64_t           _ringCapacity;
+    size_t             _ringPos;
+
+  public:
+    /// <summary>
+    /// Creates a sampler which starts from the current state of the given memory. Snapshots
+    /// include the words in <c>range</c>.
+    /// </summary>
+    DumpSampler(DumpTriggers const&         triggers,
+                std::optional<AddressRange> range,
+                Memory const&               memory);
+
+  public:
+    /// <summary>
+    /// Evaluates the triggers on the state after a tick. Returns <c>true</c> if the state should
+    /// be dumped now.
+    /// </summary>
+    bool OnTick(Memory const& memory);
+
+    /// <summary>
+    /// Prints the last ticks kept for <c>DumpTriggers::last</c> which were not dumped yet.
+    /// </summary>
+    void DumpLast(std::ostream& os);
+};
+
+/// <summary>
+/// A change of the state sent from the emulation to the thread of a <c>TraceWriter</c>.
+/// </summary>
+struct TraceRecord
+{
+    enum class Kind : uint32_t
+    {
+        /// <summary>
+        /// Register <c>index</c> changed to <c>value</c>.
+        /// </summary>
+        Register,
+
+        /// <summary>
+        /// The <c>index</c>-th word in the dumped range changed to <c>value</c>.
+        /// </summary>
+        Word,
+
+        /// <summary>
+        /// The state with all the changes so far should be dumped.
+        /// </summary>
+        Dump,
+    };
+
+    Kind     kind;
+    uint32_t index;
+    uint32_t value;
+};
+
+/// <summary>
+/// Writes dumps on a dedicated thread. <c>Dump</c> only sends the registers and words which changed
+/// since the previous dump through a lock-free ring buffer; the thread applies them to its own
+/// copy of the state, formats it and writes it out. When the buffer is full, <c>Dump</c> waits for
+/// the thread, and while it is empty, the thread sleeps until <c>Dump</c> or <c>Close</c> wakes
+/// it.
+///
+/// Nothing else may write to the stream until <c>Close</c> returns.
+/// </summary>
+class TraceWriter
+{
+  private:
+    std::ostream&           _os;
+    StateSnapshot           _sent;
+    StateSnapshot           _written;
+    RingBuffer<TraceRecord> _records;
+    std::atomic<bool>       _closed;
+    std::atomic<bool>       _sleeping;
+    std::mutex              _mutex;
+    std::condition_variable _pushed;
+    std::thread             _thread;
+
+  public:
+    /// <summary>
+    /// Starts the thread. The dumps show the words in <c>range</c> and start from the current
+    /// state of the given memory.
+    /// </summary>
+    TraceWriter(std::ostream&               os,
+                std::optional<AddressRange> range,
+                Memory const&               memory,
+                size_t                      capacity = 1 << 16);
+    TraceWriter(TraceWriter const&) = delete;
+    TraceWriter& operator=(TraceWriter const&) = delete;
+    ~TraceWriter() noexcept;
+
+  public:
+    /// <summary>
+    /// Queues a dump of the current state of the given memory.
+    /// </summary>
+    void Dump(Memory const& memory) noexcept;
+
+    /// <summary>
+    /// Writes the queued dumps and stops the thread.
+    /// </summary>
+    void Close() noexcept;
+
+  private:
+    void Send(TraceRecord const& record) noexcept;
+    void Wake() noexcept;
+    void Run() noexcept;
+};
+
+#endif
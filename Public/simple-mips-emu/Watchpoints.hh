@@ -0,0 +1,142 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef SIMPLE_MIPS_EMU_WATCHPOINTS_HH
+#define SIMPLE_MIPS_EMU_WATCHPOINTS_HH
+
+#include <simple-mips-emu/Memory.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// What happens after a watched word changes.
+/// </summary>
+enum class WatchAction
+{
+    /// <summary>
+    /// Records the change and continues.
+    /// </summary>
+    Resume,
+
+    /// <summary>
+    /// Records the change and stops the emulation after the instruction which made it.
+    /// </summary>
+    Stop,
+};
+
+/// <summary>
+/// A change of a watched word.
+/// </summary>
+struct WatchpointHit
+{
+    /// <summary>
+    /// The address of the instruction which changed the word.
+    /// </summary>
+    uint32_t pc;
+
+    /// <summary>
+    /// The address of the word.
+    /// </summary>
+    uint32_t address;
+
+    uint32_t oldValue;
+    uint32_t newValue;
+};
+
+/// <summary>
+/// Write watchpoints on words of the data segment. The host pages containing watched words are
+/// write-protected, and a signal handler records the changes made to them. Pages without watched
+/// words are left alone, so stores to them cost nothing.
+///
+/// Watchpoints are only supported on x86-64 Linux, where the trap flag steps over the store. The
+/// signal handlers and their state are process-wide, so only one instance can watch at a time, and
+/// only stores made by the thread which runs the memory are handled; the memory must not be run or
+/// shared by other threads meanwhile. The data segment is pinned while words are watched, so it
+/// cannot be resized or reset, and sbrk fails.
+/// </summary>
+class Watchpoints
+{
+  private:
+    struct Range
+    {
+        uint32_t    begin;
+        uint32_t    end;
+        WatchAction action;
+    };
+
+  private:
+    Memory&                    _memory;
+    std::vector<Range>         _ranges;
+    std::vector<size_t>        _pages;
+    std::vector<WatchpointHit> _hits;
+    size_t                     _maxHits;
+    size_t                     _numDroppedHits;
+    bool                       _stopped;
+    uint32_t                   _stoppedPC;
+
+  public:
+    /// <summary>
+    /// Creates watchpoints on the data segment of the given memory. At most <c>maxHits</c> changes
+    /// are recorded; the following ones are only counted.
+    /// </summary>
+    explicit Watchpoints(Memory& memory, size_t maxHits = 4096);
+    Watchpoints(Watchpoints const&) = delete;
+    Watchpoints& operator=(Watchpoints const&) = delete;
+    ~Watchpoints() noexcept;
+
+  public:
+    /// <summary>
+    /// Returns <c>true</c> if watchpoints are supported on this host.
+    /// </summary>
+    static bool IsSupported() noexcept;
+
+    /// <summary>
+    /// Watches words in [start, end] of the data segment. Note that end is inclusive. Returns
+    /// <c>false</c> if watchpoints are not supported, another instance is active, or the range is
+    /// not in the data segment.
+    /// </summary>
+    bool Watch(Address start, Address end, WatchAction action);
+
+    /// <summary>
+    /// Removes all watchpoints and unprotects the pages.
+    /// </summary>
+    void Clear() noexcept;
+
+    /// <summary>
+    /// Returns the recorded changes in the order they happened.
+    /// </summary>
+    std::vector<WatchpointHit> const& GetHits() const noexcept
+    {
+        return _hits;
+    }
+
+    /// <summary>
+    /// Returns the number of changes which were not recorded because there were too many.
+    /// </summary>
+    size_t GetNumDroppedHits() const noexcept
+    {
+        return _numDroppedHits;
+    }
+
+    /// <summary>
+    /// Returns <c>true</c> if a <c>WatchAction::Stop</c> watchpoint stopped the emulation. The PC
+    /// is at the end of the text segment until <c>Resume</c> is called.
+    /// </summary>
+    bool IsStopped() const noexcept
+    {
+        return _stopped;
+    }
+
+    /// <summary>
+    /// Moves the PC to the instruction after the one which hit the watchpoint, so that the
+    /// emulation can continue.
+    /// </summary>
+    void Resume() noexcept;
+
+  private:
+    friend struct WatchpointsHandler;
+};
+
+#endif
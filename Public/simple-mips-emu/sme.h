@@ -0,0 +1,93 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+// The C interface of the emulator, exported by the simple-mips-emu-c shared library. Functions
+// and status codes are only ever added, so programs built against an older version of this
+// header keep working.
+
+#ifndef SIMPLE_MIPS_EMU_SME_H
+#define SIMPLE_MIPS_EMU_SME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#    if defined(SIMPLE_MIPS_EMU_C_EXPORTS)
+#        define SME_API __declspec(dllexport)
+#    else
+#        define SME_API __declspec(dllimport)
+#    endif
+#else
+#    define SME_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An emulator instance. Instances are independent; a single instance must not be used by two
+// threads at once.
+typedef struct sme_emulator sme_emulator;
+
+// Status codes. The values up to SME_TRAP match the stop reasons of a run.
+#define SME_OK                      0
+#define SME_ALREADY_TERMINATED      1
+#define SME_INVALID_INSTRUCTION     2
+#define SME_MEMORY_OUT_OF_RANGE     3
+#define SME_OFFSET_IS_TOO_SMALL     4
+#define SME_BREAKPOINT_HIT          5
+#define SME_TIME_LIMIT_EXCEEDED     6
+#define SME_STUCK                   7
+#define SME_SYSCALL                 8
+#define SME_TRAP                    9
+#define SME_INVALID_ARGUMENT        100
+#define SME_OUT_OF_MEMORY           101
+#define SME_CANNOT_READ_FILE        102
+
+// Any other failure inside the library. No function lets an exception through.
+#define SME_INTERNAL_ERROR          103
+
+// Creates an emulator with an empty memory. Returns NULL if out of memory.
+SME_API sme_emulator* sme_create(void);
+
+// Destroys the emulator. NULL is ignored.
+SME_API void sme_destroy(sme_emulator* emulator);
+
+// Loads the given segments and resets the registers. Buffers of the previous image are reused
+// when they are large enough, and the decoded text is reused when the text is the same.
+SME_API int sme_load(sme_emulator* emulator,
+                     uint8_t const* text,
+                     size_t         text_size,
+                     uint8_t const* data,
+                     size_t         data_size);
+
+// Loads the executable at the given path, in the format runfile reads.
+SME_API int sme_load_file(sme_emulator* emulator, char const* path);
+
+// Runs at most max_instructions instructions, or until time_limit_ms milliseconds have passed
+// if it is not zero. Returns the stop reason; SME_OK means the program terminated or the
+// instruction limit was reached. The number of retired instructions is stored in
+// num_instructions unless it is NULL. System calls are not serviced: the run stops with
+// SME_SYSCALL and PC at the call.
+SME_API int sme_run(sme_emulator* emulator,
+                    uint64_t      max_instructions,
+                    uint64_t      time_limit_ms,
+                    uint64_t*     num_instructions);
+
+// Returns 1 if the program has terminated, or 0 otherwise.
+SME_API int sme_is_terminated(sme_emulator const* emulator);
+
+// Reads register index (32 is PC, 33 is HI and 34 is LO) into value.
+SME_API int sme_read_register(sme_emulator const* emulator, uint32_t index, uint32_t* value);
+
+// Copies size bytes starting at address into out. The bytes must lie in one segment.
+SME_API int sme_read_mem(sme_emulator const* emulator,
+                         uint32_t            address,
+                         void*               out,
+                         size_t              size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
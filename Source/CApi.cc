@@ -0,0 +1,157 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Emulator.hh>
+#include <simple-mips-emu/sme.h>
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+struct sme_emulator
+{
+    Emulator emulator;
+};
+
+namespace
+{
+
+static_assert(static_cast<int>(TickResult::Success) == SME_OK);
+static_assert(static_cast<int>(TickResult::AlreadyTerminated) == SME_ALREADY_TERMINATED);
+static_assert(static_cast<int>(TickResult::InvalidInstruction) == SME_INVALID_INSTRUCTION);
+static_assert(static_cast<int>(TickResult::MemoryOutOfRange) == SME_MEMORY_OUT_OF_RANGE);
+static_assert(static_cast<int>(TickResult::OffsetIsTooSmall) == SME_OFFSET_IS_TOO_SMALL);
+static_assert(static_cast<int>(TickResult::BreakpointHit) == SME_BREAKPOINT_HIT);
+static_assert(static_cast<int>(TickResult::TimeLimitExceeded) == SME_TIME_LIMIT_EXCEEDED);
+static_assert(static_cast<int>(TickResult::Stuck) == SME_STUCK);
+static_assert(static_cast<int>(TickResult::Syscall) == SME_SYSCALL);
+static_assert(static_cast<int>(TickResult::Trap) == SME_TRAP);
+
+}
+
+sme_emulator* sme_create(void)
+{
+    try
+    {
+        return new sme_emulator;
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void sme_destroy(sme_emulator* emulator)
+{
+    delete emulator;
+}
+
+int sme_load(sme_emulator*  emulator,
+             uint8_t const* text,
+             size_t         text_size,
+             uint8_t const* data,
+             size_t         data_size)
+{
+    if (!emulator || (!text && text_size != 0) || (!data && data_size != 0)
+        || text_size % 4 != 0 || text_size > UINT32_MAX || data_size > UINT32_MAX)
+        return SME_INVALID_ARGUMENT;
+
+    try
+    {
+        emulator->emulator.Reset(text, text_size, data, data_size);
+        return SME_OK;
+    }
+    catch (std::bad_alloc const&)
+    {
+        return SME_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return SME_INTERNAL_ERROR;
+    }
+}
+
+int sme_load_file(sme_emulator* emulator, char const* path)
+{
+    if (!emulator || !path)
+        return SME_INVALID_ARGUMENT;
+
+    try
+    {
+        return emulator->emulator.Load(path) ? SME_CANNOT_READ_FILE : SME_OK;
+    }
+    catch (std::bad_alloc const&)
+    {
+        return SME_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        // The path could not be examined, e.g. because it is too long for the host.
+        return SME_CANNOT_READ_FILE;
+    }
+}
+
+int sme_run(sme_emulator* emulator,
+            uint64_t      max_instructions,
+            uint64_t      time_limit_ms,
+            uint64_t*     num_instructions)
+{
+    if (!emulator)
+        return SME_INVALID_ARGUMENT;
+
+    RunLimits limits;
+    limits.maxInstructions = max_instructions;
+    if (time_limit_ms != 0)
+    {
+        std::chrono::milliseconds const timeLimit { time_limit_ms };
+        limits.deadline = std::chrono::steady_clock::now() + timeLimit;
+    }
+
+    try
+    {
+        RunResult const result = emulator->emulator.Run(limits);
+        if (num_instructions)
+            *num_instructions = result.numInstructions;
+        return static_cast<int>(result.result);
+    }
+    catch (std::bad_alloc const&)
+    {
+        return SME_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return SME_INTERNAL_ERROR;
+    }
+}
+
+int sme_is_terminated(sme_emulator const* emulator)
+{
+    return emulator && emulator->emulator.GetMemory().IsTerminated() ? 1 : 0;
+}
+
+int sme_read_register(sme_emulator const* emulator, uint32_t index, uint32_t* value)
+{
+    if (!emulator || !value || index >= RegisterFileSize)
+        return SME_INVALID_ARGUMENT;
+
+    *value = emulator->emulator.GetMemory().GetRegister(index);
+    return SME_OK;
+}
+
+int sme_read_mem(sme_emulator const* emulator, uint32_t address, void* out, size_t size)
+{
+    if (!emulator || (!out && size != 0))
+        return SME_INVALID_ARGUMENT;
+
+    Address const start = Address::MakeFromWord(address);
+    if (address < static_cast<uint32_t>(Address::BaseType::Text))
+        return SME_MEMORY_OUT_OF_RANGE;
+
+    Memory::Segment const& segment = emulator->emulator.GetMemory().GetSegmentByBase(start.base);
+    if (start.offset > segment.size() || size > segment.size() - start.offset)
+        return SME_MEMORY_OUT_OF_RANGE;
+
+    if (size != 0)
+        std::memcpy(out, segment.data() + start.offset, size);
+    return SME_OK;
+}
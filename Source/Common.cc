@@ -7,6 +7,12 @@
 #include <regex>
 #include <string>
 
+#ifdef _WIN32
+#    include <Windows.h>
+#else
+#    include <unistd.h>
+#endif
+
 bool ParseWord(char const* begin, char const* end, uint32_t& out) noexcept
 {
     std::regex  re { "^ *0x([0-9a-fA-F]+) *$" };
@@ -29,3 +35,17 @@ bool ParseWord(char const* begin, char const* end, uint32_t& out) noexcept
         return false;
     }
 }
+
+size_t GetPageSize() noexcept
+{
+#ifdef _WIN32
+    static size_t const pageSize = [] {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return static_cast<size_t>(info.dwPageSize);
+    }();
+#else
+    static size_t const pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return pageSize;
+}
@@ -0,0 +1,349 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Disassembly.hh>
+#include <simple-mips-emu/Memory.hh>
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+
+/// <summary>
+/// Returns <c>true</c> if the instruction after the given one does not run right after it.
+/// </summary>
+bool EndsBlock(Operation operation) noexcept
+{
+    switch (operation)
+    {
+        case Operation::BEQ:
+        case Operation::BNE:
+        case Operation::BLEZ:
+        case Operation::BGTZ:
+        case Operation::BLTZ:
+        case Operation::BGEZ:
+        case Operation::BLTZAL:
+        case Operation::BGEZAL:
+        case Operation::J:
+        case Operation::JAL:
+        case Operation::JR:
+        case Operation::JALR:
+        case Operation::BREAK:
+        case Operation::Invalid: return true;
+        default: return false;
+    }
+}
+
+/// <summary>
+/// Returns <c>true</c> if the control can reach the next instruction from the given one.
+/// </summary>
+bool FallsThrough(Operation operation) noexcept
+{
+    switch (operation)
+    {
+        case Operation::J:
+        case Operation::JR:
+        case Operation::BREAK:
+        case Operation::Invalid: return false;
+        default: return true;
+    }
+}
+
+void PrintRegister(std::ostream& os, uint8_t reg)
+{
+    os << '$' << std::dec << static_cast<uint32_t>(reg);
+}
+
+void PrintHex(std::ostream& os, uint32_t value)
+{
+    os << "0x" << std::hex << value;
+}
+
+}
+
+ControlFlowGraph::ControlFlowGraph(Instruction const* instructions, size_t numInstructions) :
+    _leaders(numInstructions, false)
+{
+    uint32_t const textBase = Address::MakeText(0);
+    uint32_t const textEnd  = textBase + static_cast<uint32_t>(numInstructions * 4);
+
+    auto toIndex = [textBase](uint32_t address) { return (address - textBase) / 4; };
+    auto inText  = [textBase, textEnd](uint32_t address) {
+        return textBase <= address && address < textEnd && address % 4 == 0;
+    };
+
+    if (numInstructions > 0)
+        _leaders[0] = true;
+
+    for (size_t i = 0; i < numInstructions; ++i)
+    {
+        Instruction const& instruction = instructions[i];
+        uint32_t const     address     = textBase + static_cast<uint32_t>(i * 4);
+
+        uint32_t target;
+        if (GetBranchTarget(instruction, address, target) && inText(target))
+        {
+            _leaders[toIndex(target)] = true;
+            Operation const operation = instruction.operation;
+            if (operation == Operation::JAL || operation == Operation::BLTZAL
+                || operation == Operation::BGEZAL)
+                _callTargets.push_back(target);
+        }
+
+        if (EndsBlock(instruction.operation) && i + 1 < numInstructions)
+            _leaders[i + 1] = true;
+    }
+
+    std::sort(_callTargets.begin(), _callTargets.end());
+    _callTargets.erase(std::unique(_callTargets.begin(), _callTargets.end()), _callTargets.end());
+
+    for (size_t i = 0; i < numInstructions;)
+    {
+        size_t end = i + 1;
+        while (end < numInstructions && !_leaders[end]) ++end;
+
+        BasicBlock block;
+        block.begin = textBase + static_cast<uint32_t>(i * 4);
+        block.end   = textBase + static_cast<uint32_t>(end * 4);
+
+        Instruction const& last        = instructions[end - 1];
+        uint32_t const     lastAddress = block.end - 4;
+
+        uint32_t target;
+        if (GetBranchTarget(last, lastAddress, target) && inText(target))
+            block.successors.push_back(target);
+        if (FallsThrough(last.operation) && inText(block.end)
+            && std::find(block.successors.begin(), block.successors.end(), block.end)
+                   == block.successors.end())
+            block.successors.push_back(block.end);
+
+        _blocks.push_back(std::move(block));
+        i = end;
+    }
+}
+
+BasicBlock const* ControlFlowGraph::FindBlock(uint32_t address) const noexcept
+{
+    auto it = std::upper_bound(_blocks.begin(),
+                               _blocks.end(),
+                               address,
+                               [](uint32_t address, BasicBlock const& block) {
+                                   return address < block.begin;
+                               });
+    if (it == _blocks.begin())
+        return nullptr;
+
+    --it;
+    if (address < it->end)
+        return std::addressof(*it);
+    else
+        return nullptr;
+}
+
+bool GetBranchTarget(Instruction const& instruction, uint32_t address, uint32_t& out) noexcept
+{
+    switch (instruction.operation)
+    {
+        case Operation::BEQ:
+        case Operation::BNE:
+        case Operation::BLEZ:
+        case Operation::BGTZ:
+        case Operation::BLTZ:
+        case Operation::BGEZ:
+        case Operation::BLTZAL:
+        case Operation::BGEZAL:
+        {
+            out = address + 4 + instruction.immediate * 4;
+            return true;
+        }
+        case Operation::J:
+        case Operation::JAL:
+        {
+            out = instruction.immediate | ((address + 4) & 0xF0000000);
+            return true;
+        }
+        default: return false;
+    }
+}
+
+void Disassemble(std::ostream& os, Instruction const& instruction, uint32_t address)
+{
+    std::ios_base::fmtflags flags = os.flags();
+
+    for (char const* c = GetMnemonic(instruction.operation); *c; ++c)
+        os << static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+
+    switch (GetFormat(instruction.operation))
+    {
+        case Format::R:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rd);
+            os << ", ";
+            PrintRegister(os, instruction.rs);
+            os << ", ";
+            PrintRegister(os, instruction.rt);
+            break;
+        }
+        case Format::SV:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rd);
+            os << ", ";
+            PrintRegister(os, instruction.rt);
+            os << ", ";
+            PrintRegister(os, instruction.rs);
+            break;
+        }
+        case Format::JR:
+        {
+            os << ' ';
+            if (instruction.operation == Operation::JALR)
+            {
+                PrintRegister(os, instruction.rd);
+                os << ", ";
+            }
+            PrintRegister(os, instruction.rs);
+            break;
+        }
+        case Format::MD:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rs);
+            os << ", ";
+            PrintRegister(os, instruction.rt);
+            break;
+        }
+        case Format::MF:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rd);
+            break;
+        }
+        case Format::MT:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rs);
+            break;
+        }
+        case Format::SR:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rd);
+            os << ", ";
+            PrintRegister(os, instruction.rt);
+            os << ", " << std::dec << instruction.immediate;
+            break;
+        }
+        case Format::I:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rt);
+            os << ", ";
+            PrintRegister(os, instruction.rs);
+            os << ", " << std::dec << static_cast<int32_t>(instruction.immediate);
+            break;
+        }
+        case Format::UI:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rt);
+            os << ", ";
+            PrintRegister(os, instruction.rs);
+            os << ", ";
+            PrintHex(os, instruction.immediate);
+            break;
+        }
+        case Format::BI:
+        {
+            uint32_t target = 0;
+            GetBranchTarget(instruction, address, target);
+
+            os << ' ';
+            PrintRegister(os, instruction.rs);
+            os << ", ";
+            PrintRegister(os, instruction.rt);
+            os << ", ";
+            PrintHex(os, target);
+            break;
+        }
+        case Format::BZ:
+        case Format::RI:
+        {
+            uint32_t target = 0;
+            GetBranchTarget(instruction, address, target);
+
+            os << ' ';
+            PrintRegister(os, instruction.rs);
+            os << ", ";
+            PrintHex(os, target);
+            break;
+        }
+        case Format::II:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rt);
+            os << ", ";
+            PrintHex(os, instruction.immediate);
+            break;
+        }
+        case Format::OI:
+        {
+            os << ' ';
+            PrintRegister(os, instruction.rt);
+            os << ", " << std::dec << static_cast<int32_t>(instruction.immediate) << '(';
+            PrintRegister(os, instruction.rs);
+            os << ')';
+            break;
+        }
+        case Format::J:
+        {
+            uint32_t target = 0;
+            GetBranchTarget(instruction, address, target);
+
+            os << ' ';
+            PrintHex(os, target);
+            break;
+        }
+        default: break;
+    }
+
+    os.flags(flags);
+}
+
+void Disassemble(std::ostream&           os,
+                 Instruction const*      instructions,
+                 size_t                  numInstructions,
+                 ControlFlowGraph const& graph)
+{
+    std::ios_base::fmtflags flags = os.flags();
+
+    auto const& callTargets = graph.GetCallTargets();
+    for (BasicBlock const& block : graph.GetBlocks())
+    {
+        if (std::binary_search(callTargets.begin(), callTargets.end(), block.begin))
+            os << "func_" << std::hex << block.begin << ":\n";
+        os << "block_" << std::hex << block.begin << ":\n";
+
+        for (uint32_t address = block.begin; address < block.end; address += 4)
+        {
+            size_t const index = (address - Address::MakeText(0)) / 4;
+            if (index >= numInstructions)
+                break;
+
+            os << "    " << Address::MakeFromWord(address) << ":  ";
+            Disassemble(os, instructions[index], address);
+            os << '\n';
+        }
+
+        if (!block.successors.empty())
+        {
+            os << "    # ->";
+            for (uint32_t successor : block.successors) os << " block_" << std::hex << successor;
+            os << '\n';
+        }
+    }
+
+    os.flags(flags);
+}
@@ -1,279 +1,898 @@
 // Copyright (c) 2021 Chanjung Kim. All rights reserved.
 // Licensed under the MIT License.
 
+#include <simple-mips-emu/Common.hh>
 #include <simple-mips-emu/Emulation.hh>
-#include <simple-mips-emu/Formats.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
 
 namespace
 {
 
-template <typename T, typename... Ts>
-inline bool IsOneOf(T value, Ts... ts) noexcept
+/// <summary>
+/// Returns <c>true</c> if the sum of the given values overflows as signed integers.
+/// </summary>
+constexpr bool AddOverflows(uint32_t lhs, uint32_t rhs) noexcept
 {
-    return ((static_cast<T>(ts) == value) || ...);
+    uint32_t const sum = lhs + rhs;
+    return ((lhs ^ sum) & (rhs ^ sum)) >> 31 != 0;
 }
 
-constexpr uint32_t SignExtend(uint32_t value, uint32_t numBits) noexcept
+/// <summary>
+/// Returns <c>true</c> if the difference of the given values overflows as signed integers.
+/// </summary>
+constexpr bool SubtractOverflows(uint32_t lhs, uint32_t rhs) noexcept
 {
-    // 0  if value >= 0
-    // -1 otherwise
-    uint32_t const mask = ~(value >> (numBits - 1)) + 1;
-    return value | (mask << numBits);
+    uint32_t const difference = lhs - rhs;
+    return ((lhs ^ rhs) & (lhs ^ difference)) >> 31 != 0;
 }
 
-TickResult TickHandleR(Memory& memory, uint32_t current)
+/// <summary>
+/// Branches by the immediate of the given instruction if <c>taken</c> is <c>true</c>, or advances
+/// PC otherwise.
+/// </summary>
+template <typename Policy>
+inline void Branch(Memory& memory, Instruction const& instruction, bool taken, Policy& policy)
 {
-    uint32_t const operation = (current >> 26) & 0b111111;
-    if (operation != 0)
-        return TickResult::InvalidInstruction;
+    uint32_t const pcValue = memory.GetRegister(Memory::PC);
+    // PC is not advanced yet
+    uint32_t const newPcValue = pcValue + 4 + instruction.immediate * 4;
+
+    policy.OnBranch(newPcValue, taken);
+    if (taken)
+        memory.SetRegister(Memory::PC, newPcValue);
+    else
+        memory.AdvancePC();
+}
 
-    uint32_t const function = (current >> 0) & 0b111111;
-    if (IsOneOf(function,
-                RFormatFn::ADDU,
-                RFormatFn::SUBU,
-                RFormatFn::AND,
-                RFormatFn::NOR,
-                RFormatFn::OR,
-                RFormatFn::SLTU))
+/// <summary>
+/// Executes the given instruction assuming its operation is <c>Op</c> and reports its accesses
+/// and branches to the policy. Only non-fused operations are supported.
+/// </summary>
+template <Operation Op, typename Policy>
+inline TickResult Execute(Memory& memory, Instruction const& instruction, Policy& policy)
+{
+    if constexpr (GetFormat(Op) == Format::R)
     {
         // instruction is R format
-        uint32_t const source1     = (current >> 21) & 0b11111;
-        uint32_t const source2     = (current >> 16) & 0b11111;
-        uint32_t const destination = (current >> 11) & 0b11111;
-
-        uint32_t const source1Value = memory.GetRegister(source1);
-        uint32_t const source2Value = memory.GetRegister(source2);
+        uint32_t const source1Value = memory.GetRegister(instruction.rs);
+        uint32_t const source2Value = memory.GetRegister(instruction.rt);
 
         uint32_t destinationValue;
-        switch (static_cast<RFormatFn>(function))
+        if constexpr (Op == Operation::ADD || Op == Operation::ADDU)
+        {
+            if (Op == Operation::ADD && AddOverflows(source1Value, source2Value))
+                return TickResult::Trap;
+            destinationValue = source1Value + source2Value;
+        }
+        else if constexpr (Op == Operation::SUB || Op == Operation::SUBU)
         {
-            case RFormatFn::ADDU: destinationValue = source1Value + source2Value; break;
-            case RFormatFn::SUBU: destinationValue = source1Value - source2Value; break;
-            case RFormatFn::AND: destinationValue = source1Value & source2Value; break;
-            case RFormatFn::NOR: destinationValue = ~(source1Value | source2Value); break;
-            case RFormatFn::OR: destinationValue = source1Value | source2Value; break;
-            case RFormatFn::SLTU: destinationValue = source1Value < source2Value; break;
-            default: return TickResult::InvalidInstruction;
+            if (Op == Operation::SUB && SubtractOverflows(source1Value, source2Value))
+                return TickResult::Trap;
+            destinationValue = source1Value - source2Value;
         }
-        memory.SetRegister(destination, destinationValue);
+        else if constexpr (Op == Operation::AND)
+            destinationValue = source1Value & source2Value;
+        else if constexpr (Op == Operation::NOR)
+            destinationValue = ~(source1Value | source2Value);
+        else if constexpr (Op == Operation::OR)
+            destinationValue = source1Value | source2Value;
+        else if constexpr (Op == Operation::XOR)
+            destinationValue = source1Value ^ source2Value;
+        else if constexpr (Op == Operation::SLT)
+            destinationValue = static_cast<uint32_t>(static_cast<int32_t>(source1Value)
+                                                     < static_cast<int32_t>(source2Value));
+        else
+            destinationValue = source1Value < source2Value;
+
+        memory.SetRegister(instruction.rd, destinationValue);
         memory.AdvancePC();
+    }
+    else if constexpr (GetFormat(Op) == Format::SV)
+    {
+        // instruction is SV format
+        uint32_t const amount      = memory.GetRegister(instruction.rs) & 0b11111;
+        uint32_t const sourceValue = memory.GetRegister(instruction.rt);
 
-        return TickResult::Success;
+        uint32_t destinationValue;
+        if constexpr (Op == Operation::SLLV)
+            destinationValue = sourceValue << amount;
+        else if constexpr (Op == Operation::SRLV)
+            destinationValue = sourceValue >> amount;
+        else
+            destinationValue = ShiftRightArithmetic(sourceValue, amount);
+
+        memory.SetRegister(instruction.rd, destinationValue);
+        memory.AdvancePC();
     }
-    else if (IsOneOf(function, JRFormatFn::JR))
+    else if constexpr (Op == Operation::JR || Op == Operation::JALR)
     {
         // instruction is JR format
-        uint32_t const source = (current >> 21) & 0b11111;
+        uint32_t const target = memory.GetRegister(instruction.rs);
 
-        memory.SetRegister(Memory::PC, memory.GetRegister(source));
-
-        return TickResult::Success;
+        if constexpr (Op == Operation::JALR)
+            memory.SetRegister(instruction.rd, memory.GetRegister(Memory::PC) + 4);
+        policy.OnBranch(target, true);
+        memory.SetRegister(Memory::PC, target);
     }
-    else if (IsOneOf(function, SRFormatFn::SLL, SRFormatFn::SRL))
+    else if constexpr (GetFormat(Op) == Format::SR)
     {
         // instruction is SR format
-        uint32_t const source      = (current >> 16) & 0b11111;
-        uint32_t const destination = (current >> 11) & 0b11111;
-        uint32_t const shiftAmount = (current >> 6) & 0b11111;
-
-        uint32_t const sourceValue = memory.GetRegister(source);
+        uint32_t const sourceValue = memory.GetRegister(instruction.rt);
 
         uint32_t destinationValue;
-        switch (static_cast<SRFormatFn>(function))
-        {
-            case SRFormatFn::SLL: destinationValue = sourceValue << shiftAmount; break;
-            case SRFormatFn::SRL: destinationValue = sourceValue >> shiftAmount; break;
-            default: return TickResult::InvalidInstruction;
-        }
-        memory.SetRegister(destination, destinationValue);
-        memory.AdvancePC();
+        if constexpr (Op == Operation::SLL)
+            destinationValue = sourceValue << instruction.immediate;
+        else if constexpr (Op == Operation::SRL)
+            destinationValue = sourceValue >> instruction.immediate;
+        else
+            destinationValue = ShiftRightArithmetic(sourceValue, instruction.immediate);
 
-        return TickResult::Success;
+        memory.SetRegister(instruction.rd, destinationValue);
+        memory.AdvancePC();
     }
-
-    return TickResult::InvalidInstruction;
-}
-
-TickResult TickHandleI(Memory& memory, uint32_t current)
-{
-    uint32_t const operation = (current >> 26) & 0b111111;
-    if (IsOneOf(operation, IFormatOp::ADDIU, IFormatOp::ANDI, IFormatOp::ORI, IFormatOp::SLTIU))
+    else if constexpr (GetFormat(Op) == Format::MD)
     {
-        // instruction is I format
-        uint32_t const source      = (current >> 21) & 0b11111;
-        uint32_t const destination = (current >> 16) & 0b11111;
-        uint32_t const immediate   = (current >> 0) & 0xFFFF;
+        // instruction is MD format
+        uint32_t const source1Value = memory.GetRegister(instruction.rs);
+        uint32_t const source2Value = memory.GetRegister(instruction.rt);
 
-        uint32_t const sourceValue = memory.GetRegister(source);
-
-        uint32_t destinationValue;
-        switch (static_cast<IFormatOp>(operation))
+        if constexpr (Op == Operation::MULT || Op == Operation::MULTU)
         {
-            case IFormatOp::ADDIU:
-            {
-                destinationValue = sourceValue + SignExtend(immediate, 16);
-                break;
-            }
-            case IFormatOp::ANDI:
-            {
-                destinationValue = sourceValue & immediate;
-                break;
-            }
-            case IFormatOp::ORI:
+            uint64_t product;
+            if constexpr (Op == Operation::MULT)
+                product = static_cast<uint64_t>(int64_t { static_cast<int32_t>(source1Value) }
+                                                * static_cast<int32_t>(source2Value));
+            else
+                product = uint64_t { source1Value } * source2Value;
+
+            memory.SetRegister(Memory::HI, static_cast<uint32_t>(product >> 32));
+            memory.SetRegister(Memory::LO, static_cast<uint32_t>(product));
+        }
+        else if (source2Value != 0)
+        {
+            // The results of a division by zero are unpredictable; HI and LO are left as they are.
+            if constexpr (Op == Operation::DIV)
             {
-                destinationValue = sourceValue | immediate;
-                break;
+                int64_t const dividend = static_cast<int32_t>(source1Value);
+                int64_t const divisor  = static_cast<int32_t>(source2Value);
+
+                memory.SetRegister(Memory::HI, static_cast<uint32_t>(dividend % divisor));
+                memory.SetRegister(Memory::LO, static_cast<uint32_t>(dividend / divisor));
             }
-            case IFormatOp::SLTIU:
+            else
             {
-                destinationValue
-                    = static_cast<uint32_t>(static_cast<int32_t>(sourceValue)
-                                            < static_cast<int32_t>(SignExtend(immediate, 16)));
-                break;
+                memory.SetRegister(Memory::HI, source1Value % source2Value);
+                memory.SetRegister(Memory::LO, source1Value / source2Value);
             }
-            default: return TickResult::InvalidInstruction;
         }
-        memory.SetRegister(destination, destinationValue);
+
+        memory.AdvancePC();
+    }
+    else if constexpr (GetFormat(Op) == Format::MF)
+    {
+        // instruction is MF format
+        uint32_t const source = Op == Operation::MFHI ? Memory::HI : Memory::LO;
+        memory.SetRegister(instruction.rd, memory.GetRegister(source));
+        memory.AdvancePC();
+    }
+    else if constexpr (GetFormat(Op) == Format::MT)
+    {
+        // instruction is MT format
+        uint32_t const destination = Op == Operation::MTHI ? Memory::HI : Memory::LO;
+        memory.SetRegister(destination, memory.GetRegister(instruction.rs));
         memory.AdvancePC();
+    }
+    else if constexpr (GetFormat(Op) == Format::I || GetFormat(Op) == Format::UI)
+    {
+        // instruction is I or UI format
+        uint32_t const sourceValue = memory.GetRegister(instruction.rs);
+
+        uint32_t destinationValue;
+        if constexpr (Op == Operation::ADDI || Op == Operation::ADDIU)
+        {
+            if (Op == Operation::ADDI && AddOverflows(sourceValue, instruction.immediate))
+                return TickResult::Trap;
+            destinationValue = sourceValue + instruction.immediate;
+        }
+        else if constexpr (Op == Operation::ANDI)
+            destinationValue = sourceValue & instruction.immediate;
+        else if constexpr (Op == Operation::ORI)
+            destinationValue = sourceValue | instruction.immediate;
+        else if constexpr (Op == Operation::XORI)
+            destinationValue = sourceValue ^ instruction.immediate;
+        else if constexpr (Op == Operation::SLTI)
+            destinationValue = static_cast<uint32_t>(static_cast<int32_t>(sourceValue)
+                                                     < static_cast<int32_t>(instruction.immediate));
+        else
+            // The immediate is sign-extended, but the comparison is unsigned.
+            destinationValue = sourceValue < instruction.immediate;
 
-        return TickResult::Success;
+        memory.SetRegister(instruction.rt, destinationValue);
+        memory.AdvancePC();
     }
-    else if (IsOneOf(operation, BIFormatOp::BEQ, BIFormatOp::BNE))
+    else if constexpr (Op == Operation::BEQ || Op == Operation::BNE)
     {
         // instruction is BI format
-        uint32_t const pc = memory.GetRegister(Memory::PC);
+        uint32_t const source1Value = memory.GetRegister(instruction.rs);
+        uint32_t const source2Value = memory.GetRegister(instruction.rt);
 
-        uint32_t const source1 = (current >> 21) & 0b11111;
-        uint32_t const source2 = (current >> 16) & 0b11111;
-        uint32_t const offset  = SignExtend((current >> 0) & 0xFFFF, 16);
+        Branch(memory,
+               instruction,
+               (source1Value == source2Value) == (Op == Operation::BEQ),
+               policy);
+    }
+    else if constexpr (GetFormat(Op) == Format::BZ || GetFormat(Op) == Format::RI)
+    {
+        // instruction is BZ or RI format
+        int32_t const sourceValue = static_cast<int32_t>(memory.GetRegister(instruction.rs));
+
+        bool taken;
+        if constexpr (Op == Operation::BLEZ)
+            taken = sourceValue <= 0;
+        else if constexpr (Op == Operation::BGTZ)
+            taken = sourceValue > 0;
+        else if constexpr (Op == Operation::BLTZ || Op == Operation::BLTZAL)
+            taken = sourceValue < 0;
+        else
+            taken = sourceValue >= 0;
 
-        uint32_t const source1Value = memory.GetRegister(source1);
-        uint32_t const source2Value = memory.GetRegister(source2);
+        if constexpr (Op == Operation::BLTZAL || Op == Operation::BGEZAL)
+            memory.SetRegister(Memory::RA, memory.GetRegister(Memory::PC) + 4);
+        Branch(memory, instruction, taken, policy);
+    }
+    else if constexpr (Op == Operation::LUI)
+    {
+        // instruction is II format
+        memory.SetRegister(instruction.rt, instruction.immediate << 16);
+        memory.AdvancePC();
+    }
+    else if constexpr (GetFormat(Op) == Format::OI)
+    {
+        // instruction is OI format
+        uint32_t const operand1Value = memory.GetRegister(instruction.rs);
+        Address const  address = Address::MakeFromWord(operand1Value + instruction.immediate);
+
+        // lwl, lwr, swl and swr access the part of the aligned word from or up to the address.
+        Address const  aligned { address.base, address.offset & ~uint32_t { 3 } };
+        uint32_t const leftShift  = (address.offset & 3) * 8;
+        uint32_t const rightShift = 24 - leftShift;
 
-        if ((source1Value == source2Value)
-            == (static_cast<BIFormatOp>(operation) == BIFormatOp::BEQ))
+        if constexpr (Op == Operation::LB || Op == Operation::LBU)
+        {
+            uint32_t const value = memory.GetByte(address);
+            memory.SetRegister(instruction.rt, Op == Operation::LB ? SignExtend(value, 8) : value);
+            policy.OnLoad(address, 1);
+        }
+        else if constexpr (Op == Operation::LH || Op == Operation::LHU)
+        {
+            uint32_t const value = memory.GetHalf(address);
+            memory.SetRegister(instruction.rt, Op == Operation::LH ? SignExtend(value, 16) : value);
+            policy.OnLoad(address, 2);
+        }
+        else if constexpr (Op == Operation::LW)
+        {
+            memory.SetRegister(instruction.rt, memory.GetWord(address));
+            policy.OnLoad(address, 4);
+        }
+        else if constexpr (Op == Operation::LWL)
+        {
+            uint32_t const kept = memory.GetRegister(instruction.rt) & ((1u << leftShift) - 1);
+            memory.SetRegister(instruction.rt, memory.GetWord(aligned) << leftShift | kept);
+            policy.OnLoad(aligned, 4);
+        }
+        else if constexpr (Op == Operation::LWR)
+        {
+            uint32_t const kept = memory.GetRegister(instruction.rt) & ~(~0u >> rightShift);
+            memory.SetRegister(instruction.rt, memory.GetWord(aligned) >> rightShift | kept);
+            policy.OnLoad(aligned, 4);
+        }
+        else if constexpr (Op == Operation::SB)
+        {
+            uint32_t const value = memory.GetRegister(instruction.rt);
+            memory.SetByte(address, static_cast<uint8_t>(value & 0xFF));
+            policy.OnStore(address, 1);
+        }
+        else if constexpr (Op == Operation::SH)
         {
-            uint32_t const pcValue = memory.GetRegister(Memory::PC);
-            // PC is not advanced yet
-            uint32_t const newPcValue = pcValue + 4 + offset * 4;
+            uint32_t const value = memory.GetRegister(instruction.rt);
+            memory.SetHalf(address, static_cast<uint16_t>(value & 0xFFFF));
+            policy.OnStore(address, 2);
+        }
+        else if constexpr (Op == Operation::SW)
+        {
+            memory.SetWord(address, memory.GetRegister(instruction.rt));
+            policy.OnStore(address, 4);
+        }
+        else if constexpr (Op == Operation::SWL)
+        {
+            uint32_t const kept = memory.GetWord(aligned) & ~(~0u >> leftShift);
+            memory.SetWord(aligned, memory.GetRegister(instruction.rt) >> leftShift | kept);
+            policy.OnStore(aligned, 4);
+        }
+        else if constexpr (Op == Operation::LL || Op == Operation::SC)
+        {
+            // The host atomics which implement them need aligned words.
+            if (address.offset != aligned.offset)
+                return TickResult::Trap;
 
-            memory.SetRegister(Memory::PC, newPcValue);
+            if constexpr (Op == Operation::LL)
+            {
+                memory.SetRegister(instruction.rt, memory.LoadLinked(address));
+                policy.OnLoad(address, 4);
+            }
+            else
+            {
+                bool const stored =
+                    memory.StoreConditional(address, memory.GetRegister(instruction.rt));
+                memory.SetRegister(instruction.rt, stored ? 1 : 0);
+                if (stored)
+                    policy.OnStore(address, 4);
+            }
         }
         else
         {
-            memory.AdvancePC();
+            uint32_t const kept = memory.GetWord(aligned) & ~(~0u << rightShift);
+            memory.SetWord(aligned, memory.GetRegister(instruction.rt) << rightShift | kept);
+            policy.OnStore(aligned, 4);
         }
 
-        return TickResult::Success;
+        memory.AdvancePC();
     }
-    else if (IsOneOf(operation, IIFormatOp::LUI))
+    else if constexpr (Op == Operation::J || Op == Operation::JAL)
     {
-        // instruction is II format
+        // instruction is J format
+        uint32_t const pcValue = memory.GetRegister(Memory::PC);
+        uint32_t const target  = instruction.immediate | ((pcValue + 4) & 0xF0000000);
+
+        if constexpr (Op == Operation::JAL)
+            memory.SetRegister(Memory::RA, pcValue + 4);
+        policy.OnBranch(target, true);
+        memory.SetRegister(Memory::PC, target);
+    }
+    else if constexpr (Op == Operation::SYSCALL)
+    {
+        // instruction is SYS format; the caller services it
+        return TickResult::Syscall;
+    }
+    else if constexpr (Op == Operation::BREAK)
+    {
+        return TickResult::Trap;
+    }
+    else
+    {
+        return TickResult::InvalidInstruction;
+    }
+
+    return TickResult::Success;
+}
+
+/// <summary>
+/// Executes the given instruction with the operation stored in it.
+/// </summary>
+template <typename Policy>
+TickResult Execute(Memory& memory, Instruction const& instruction, Policy& policy)
+{
+    switch (instruction.operation)
+    {
+#define SIMPLE_MIPS_EMU_EXECUTE_CASE(format, name, code)                                           \
+    case Operation::name: return Execute<Operation::name>(memory, instruction, policy);
+        SIMPLE_MIPS_EMU_ALL_INSTRUCTIONS(SIMPLE_MIPS_EMU_EXECUTE_CASE)
+#undef SIMPLE_MIPS_EMU_EXECUTE_CASE
+        default: return TickResult::InvalidInstruction;
+    }
+}
 
-        uint32_t const destination = (current >> 16) & 0b11111;
-        uint32_t const immediate   = (current >> 0) & 0xFFFF;
+/// <summary>
+/// Executes the given load or store of operation <c>Op</c>, whose address the program proved in
+/// the data segment when its base register holds <c>base</c>. The range checks are skipped in that
+/// case, and the checked access runs otherwise.
+/// </summary>
+template <Operation Op, typename Policy>
+inline TickResult
+    ExecuteProven(Memory& memory, Instruction const& instruction, uint32_t base, Policy& policy)
+{
+    // The bytes of a shared data segment are only accessed through the memory, atomically.
+    if (memory.GetRegister(instruction.rs) != base || memory.IsDataShared())
+        return Execute<Op>(memory, instruction, policy);
 
-        memory.SetRegister(destination, immediate << 16);
-        memory.AdvancePC();
+    uint32_t const offset = base + instruction.immediate - Address::MakeData(0);
+    uint8_t* const ptr    = memory.GetDataBytes() + offset;
 
-        return TickResult::Success;
+    if constexpr (Op == Operation::LB || Op == Operation::LBU)
+    {
+        uint32_t const value = ptr[0];
+        memory.SetRegister(instruction.rt, Op == Operation::LB ? SignExtend(value, 8) : value);
     }
-    else if (IsOneOf(operation, OIFormatOp::LB, OIFormatOp::LW, OIFormatOp::SB, OIFormatOp::SW))
+    else if constexpr (Op == Operation::LH || Op == Operation::LHU)
     {
-        // instruction is OI format
+        uint32_t const value = uint32_t { ptr[0] } << 8 | ptr[1];
+        memory.SetRegister(instruction.rt, Op == Operation::LH ? SignExtend(value, 16) : value);
+    }
+    else if constexpr (Op == Operation::LW)
+    {
+        memory.SetRegister(instruction.rt,
+                           uint32_t { ptr[0] } << 24 | uint32_t { ptr[1] } << 16
+                               | uint32_t { ptr[2] } << 8 | ptr[3]);
+    }
+    else
+    {
+        uint32_t const value = memory.GetRegister(instruction.rt);
+        uint8_t const  bytes[4] { static_cast<uint8_t>(value >> 24 & 0xFF),
+                                 static_cast<uint8_t>(value >> 16 & 0xFF),
+                                 static_cast<uint8_t>(value >> 8 & 0xFF),
+                                 static_cast<uint8_t>(value & 0xFF) };
+
+        // The stored bytes are the low ones of the register, written with a single store.
+        if constexpr (Op == Operation::SB)
+            ptr[0] = bytes[3];
+        else if constexpr (Op == Operation::SH)
+            std::memcpy(ptr, bytes + 2, 2);
+        else
+            std::memcpy(ptr, bytes, 4);
+        memory.MarkDataWritten(offset, Op == Operation::SB ? 1 : Op == Operation::SH ? 2 : 4);
+    }
+
+    memory.AdvancePC();
+    return TickResult::Success;
+}
+
+/// <summary>
+/// Returns the number of iterations of <c>loop: addiu $t, $t, step; bne $t, $u, loop</c> which
+/// start with <c>$t == value</c> and <c>$u == target</c>, or <c>std::nullopt</c> if the loop never
+/// ends. The first iteration always runs, and $t is compared after it is incremented.
+/// </summary>
+std::optional<uint64_t> GetNumIterations(uint32_t value, uint32_t step, uint32_t target) noexcept
+{
+    // The number of iterations n is the least n >= 1 with n * step == target - value modulo 2^32.
+    uint32_t const distance = target - value;
+    if (step == 0)
+        return distance == 0 ? std::optional<uint64_t> { 1 } : std::nullopt;
+
+    // With step = odd * 2^shift, a solution exists iff distance is a multiple of 2^shift, and it
+    // is unique modulo 2^(32 - shift).
+    uint32_t shift = 0;
+    while ((step >> shift & 1) == 0) ++shift;
+    if ((distance & ((uint32_t { 1 } << shift) - 1)) != 0)
+        return std::nullopt;
+
+    uint32_t const odd = step >> shift;
+
+    // Newton's iteration doubles the correct low bits each time, starting from the 3 bits which
+    // odd gets right as its own inverse.
+    uint32_t inverse = odd;
+    for (int i = 0; i < 4; ++i) inverse *= 2 - odd * inverse;
+
+    uint64_t const modulus = uint64_t { 1 } << (32 - shift);
+    uint64_t const rtn     = static_cast<uint32_t>((distance >> shift) * inverse) & (modulus - 1);
+    return rtn == 0 ? modulus : rtn;
+}
+
+/// <summary>
+/// Runs at most <c>maxIterations</c> iterations, but at least one, of the loop fused into
+/// <c>Operation::ADDIU_BNE_LOOP</c> at PC and returns their number.
+/// </summary>
+uint64_t RunLoop(Memory&            memory,
+                 Instruction const& addiu,
+                 Instruction const& bne,
+                 uint64_t           maxIterations) noexcept
+{
+    uint32_t const counter = addiu.rt;
+    uint32_t const other   = bne.rs == counter ? bne.rt : bne.rs;
 
-        uint32_t const operand1 = (current >> 21) & 0b11111;
-        uint32_t const operand2 = (current >> 16) & 0b11111;
-        uint32_t const offset   = SignExtend((current >> 0) & 0xFFFF, 16);
+    std::optional<uint64_t> const numIterations = GetNumIterations(
+        memory.GetRegister(counter), addiu.immediate, memory.GetRegister(other));
+    bool const     ends = numIterations && *numIterations <= maxIterations;
+    uint64_t const rtn  = ends ? *numIterations : std::max<uint64_t>(maxIterations, 1);
 
-        uint32_t const operand1Value = memory.GetRegister(operand1);
-        Address const  address       = Address::MakeFromWord(operand1Value + offset);
+    memory.SetRegister(counter,
+                       memory.GetRegister(counter) + static_cast<uint32_t>(rtn) * addiu.immediate);
+    if (ends)
+        memory.SetRegister(Memory::PC, memory.GetRegister(Memory::PC) + 8);
 
-        switch (static_cast<OIFormatOp>(operation))
+    return rtn;
+}
+
+/// <summary>
+/// Runs the decoded program until PC leaves the decoded words or the text segment is modified.
+/// Returns <c>false</c> in that case, so that the caller can continue with <c>Tick()</c>. The
+/// data segment must be at least as large as the proofs of the program assume. A fast-forwarded
+/// loop may run past <c>maxInstructions</c> up to <c>maxFastForwarded</c>, which is not less.
+/// </summary>
+template <typename Policy>
+bool RunDecoded(Memory&        memory,
+                Program const& program,
+                uint64_t       maxInstructions,
+                uint64_t       maxFastForwarded,
+                RunResult&     rtn,
+                Policy&        policy)
+{
+    uint32_t const textBase = Address::MakeText(0);
+    size_t const   size     = program.GetSize();
+
+    while (rtn.numInstructions < maxInstructions && !memory.IsTerminated())
+    {
+        uint32_t const offset = memory.GetRegister(Memory::PC) - textBase;
+        size_t const   index  = offset / 4;
+
+        if (offset % 4 != 0 || index >= size)
+            return false;
+
+        Instruction const* instruction = std::addressof(program.GetInstruction(index));
+        Operation          operation   = program.GetDispatchOperation(index);
+
+        // Fused operations must not retire more instructions than allowed, and instrumented runs
+        // report every instruction.
+        uint64_t const limit =
+            operation == Operation::ADDIU_BNE_LOOP ? maxFastForwarded : maxInstructions;
+        if (limit - rtn.numInstructions < GetNumRetired(operation)
+            || (Policy::IsEnabled && operation != Operation::Breakpoint))
+            operation = instruction->operation;
+
+        if constexpr (Policy::IsEnabled)
+        {
+            if (operation != Operation::Breakpoint)
+                policy.OnFetch(textBase + offset, *instruction);
+        }
+
+        TickResult result;
+        switch (operation)
         {
-            case OIFormatOp::LB:
+#define SIMPLE_MIPS_EMU_EXECUTE_CASE(format, name, code)                                           \
+    case Operation::name: result = Execute<Operation::name>(memory, *instruction, policy); break;
+            SIMPLE_MIPS_EMU_ALL_INSTRUCTIONS(SIMPLE_MIPS_EMU_EXECUTE_CASE)
+#undef SIMPLE_MIPS_EMU_EXECUTE_CASE
+            case Operation::LUI_ORI:
             {
-                uint32_t const value = SignExtend(memory.GetByte(address), 8);
-                memory.SetRegister(operand2, value);
+                Execute<Operation::LUI>(memory, instruction[0], policy);
+                result = Execute<Operation::ORI>(memory, instruction[1], policy);
                 break;
             }
-            case OIFormatOp::LW:
+            case Operation::ADDIU_BNE:
             {
-                uint32_t const value = memory.GetWord(address);
-                memory.SetRegister(operand2, value);
+                Execute<Operation::ADDIU>(memory, instruction[0], policy);
+                result = Execute<Operation::BNE>(memory, instruction[1], policy);
                 break;
             }
-            case OIFormatOp::SB:
+            case Operation::LW_LW_ADDU:
             {
-                uint32_t const value = memory.GetRegister(operand2);
-                memory.SetByte(address, static_cast<uint8_t>(value & 0xFF));
+                Execute<Operation::LW>(memory, instruction[0], policy);
+                Execute<Operation::LW>(memory, instruction[1], policy);
+                result = Execute<Operation::ADDU>(memory, instruction[2], policy);
                 break;
             }
-            case OIFormatOp::SW:
+            case Operation::ADDIU_BNE_LOOP:
             {
-                uint32_t const value = memory.GetRegister(operand2);
-                memory.SetWord(address, value);
+                uint64_t const maxIterations = (maxFastForwarded - rtn.numInstructions) / 2;
+                uint64_t const numIterations =
+                    RunLoop(memory, instruction[0], instruction[1], maxIterations);
+
+                // The iterations after the first are counted here; the first is counted below.
+                rtn.numInstructions += numIterations * 2 - 2;
+                rtn.numFastForwarded += numIterations * 2;
+                result = TickResult::Success;
                 break;
             }
-            default: return TickResult::InvalidInstruction;
+#define SIMPLE_MIPS_EMU_PROVEN_CASE(name, size)                                                    \
+    case Operation::name##_PROVEN:                                                                 \
+    {                                                                                              \
+        uint32_t const base = *program.GetProvenBase(index);                                       \
+        result = ExecuteProven<Operation::name>(memory, *instruction, base, policy);               \
+        break;                                                                                     \
+    }
+            SIMPLE_MIPS_EMU_PROVEN_ACCESSES(SIMPLE_MIPS_EMU_PROVEN_CASE)
+#undef SIMPLE_MIPS_EMU_PROVEN_CASE
+            case Operation::Breakpoint: result = TickResult::BreakpointHit; break;
+            default: result = TickResult::InvalidInstruction; break;
         }
 
-        memory.AdvancePC();
-        return TickResult::Success;
+        if (result != TickResult::Success)
+        {
+            rtn.result = result;
+            return true;
+        }
+        rtn.numInstructions += GetNumRetired(operation);
+        policy.OnRetire(textBase + offset, *instruction);
+
+        if (memory.GetTextVersion() != program.GetTextVersion())
+            return false;
     }
 
-    return TickResult::InvalidInstruction;
+    return true;
 }
 
-TickResult TickHandleJ(Memory& memory, uint32_t current)
+/// <summary>
+/// Returns <c>true</c> if the instruction at PC jumps or branches to itself unconditionally.
+/// </summary>
+bool JumpsToItself(Memory const& memory) noexcept
 {
-    uint32_t const operation = (current >> 26) & 0b111111;
-    uint32_t const pcValue   = memory.GetRegister(Memory::PC);
-    uint32_t const target    = ((current & 0x03FFFFFF) << 2) | ((pcValue + 4) & 0xF0000000);
+    uint32_t const    pc          = memory.GetRegister(Memory::PC);
+    Instruction const instruction = Decode(memory.GetWord(Address::MakeFromWord(pc)));
 
-    if (operation == static_cast<uint32_t>(JFormatOp::J))
-    {
-        memory.SetRegister(Memory::PC, target);
-        return TickResult::Success;
-    }
-    else if (operation == static_cast<uint32_t>(JFormatOp::JAL))
+    switch (instruction.operation)
     {
-        memory.SetRegister(Memory::RA, pcValue + 4);
-        memory.SetRegister(Memory::PC, target);
-        return TickResult::Success;
+        case Operation::J:
+        case Operation::JAL: return (instruction.immediate | ((pc + 4) & 0xF0000000)) == pc;
+        case Operation::BEQ:
+            return instruction.rs == instruction.rt
+                   && instruction.immediate == static_cast<uint32_t>(-1);
+        case Operation::BLEZ:
+        case Operation::BGEZ:
+            return instruction.rs == 0 && instruction.immediate == static_cast<uint32_t>(-1);
+        default: return false;
     }
+}
 
-    return TickResult::InvalidInstruction;
+std::array<uint32_t, RegisterFileSize> GetRegisters(Memory const& memory) noexcept
+{
+    std::array<uint32_t, RegisterFileSize> rtn;
+    for (uint32_t idx = 0; idx < RegisterFileSize; ++idx) rtn[idx] = memory.GetRegister(idx);
+    return rtn;
 }
 
-using TickHandler = TickResult (*)(Memory& memory, uint32_t current);
+}
+
+template <typename Policy>
+TickResult Tick(Memory& memory, Policy& policy) noexcept
+{
+    if (memory.IsTerminated())
+        return TickResult::AlreadyTerminated;
+
+    try
+    {
+        uint32_t const    pc          = memory.GetRegister(Memory::PC);
+        Instruction const instruction = Decode(memory.GetWord(Address::MakeFromWord(pc)));
 
-TickHandler _handlers[] = {
-    TickHandleR,
-    TickHandleI,
-    TickHandleJ,
-};
+        policy.OnFetch(pc, instruction);
+        TickResult const rtn = Execute(memory, instruction, policy);
+        if (rtn == TickResult::Success)
+            policy.OnRetire(pc, instruction);
 
+        return rtn;
+    }
+    catch (std::out_of_range const&)
+    {
+        return TickResult::MemoryOutOfRange;
+    }
 }
 
 TickResult Tick(Memory& memory) noexcept
 {
-    if (memory.IsTerminated())
-        return TickResult::AlreadyTerminated;
+    NoInstrumentation policy;
+    return Tick(memory, policy);
+}
+
+namespace
+{
+
+/// <summary>
+/// Runs the program as <c>RunProgram</c> does, except that a fast-forwarded loop may retire up to
+/// <c>maxFastForwarded</c> instructions, which is not less than <c>maxInstructions</c>. Runs in
+/// chunks thus skip a loop in one step rather than one chunk at a time.
+/// </summary>
+template <typename Policy>
+RunResult RunChunk(Memory&        memory,
+                   Program const& program,
+                   uint64_t       maxInstructions,
+                   uint64_t       maxFastForwarded,
+                   Policy&        policy) noexcept
+{
+    RunResult rtn { TickResult::Success, 0, 0 };
 
     try
     {
-        uint32_t current = memory.GetWord(Address::MakeFromWord(memory.GetRegister(Memory::PC)));
-        for (auto handler : _handlers)
+        // The data segment only grows while the program runs.
+        if (memory.GetTextVersion() == program.GetTextVersion()
+            && memory.GetDataSize() >= program.GetProvenDataSize()
+            && RunDecoded(memory, program, maxInstructions, maxFastForwarded, rtn, policy))
+            return rtn;
+    }
+    catch (std::out_of_range const&)
+    {
+        rtn.result = TickResult::MemoryOutOfRange;
+        return rtn;
+    }
+
+    while (rtn.numInstructions < maxInstructions && !memory.IsTerminated())
+    {
+        if (program.HasBreakpoint(memory.GetRegister(Memory::PC)))
         {
-            if (auto res = handler(memory, current); res != TickResult::InvalidInstruction)
-                return res;
+            rtn.result = TickResult::BreakpointHit;
+            break;
         }
 
-        return TickResult::InvalidInstruction;
+        if (TickResult result = Tick(memory, policy); result != TickResult::Success)
+        {
+            rtn.result = result;
+            break;
+        }
+        ++rtn.numInstructions;
     }
-    catch (std::out_of_range const&)
+
+    return rtn;
+}
+
+}
+
+template <typename Policy>
+RunResult RunProgram(Memory&        memory,
+                     Program const& program,
+                     uint64_t       maxInstructions,
+                     Policy&        policy) noexcept
+{
+    return RunChunk(memory, program, maxInstructions, maxInstructions, policy);
+}
+
+RunResult RunProgram(Memory&        memory,
+                     Program const& program,
+                     uint64_t       maxInstructions) noexcept
+{
+    NoInstrumentation policy;
+    return RunProgram(memory, program, maxInstructions, policy);
+}
+
+StuckDetector::StuckDetector() noexcept :
+    _savedHash { 0 },
+    _saved {},
+    _power { 1 },
+    _numCompared { 0 }
+{
+}
+
+void StuckDetector::Reset() noexcept
+{
+    _savedHash = 0;
+    _saved.clear();
+    _power       = 1;
+    _numCompared = 0;
+}
+
+bool StuckDetector::IsStuck(Memory const& memory)
+{
+    if (memory.IsTerminated())
+        return false;
+
+    if (JumpsToItself(memory))
+        return true;
+
+    uint64_t const hash = memory.GetStateHash();
+    if (!_saved.empty() && hash == _savedHash && IsSaved(memory))
+        return true;
+
+    if (_saved.empty() || ++_numCompared == _power)
     {
-        return TickResult::MemoryOutOfRange;
+        Save(memory, hash);
+        _power *= 2;
+        _numCompared = 0;
+    }
+
+    return false;
+}
+
+void StuckDetector::Save(Memory const& memory, uint64_t hash)
+{
+    auto const registers = GetRegisters(memory);
+    auto const bytes     = reinterpret_cast<uint8_t const*>(registers.data());
+
+    _savedHash = hash;
+    _saved.assign(bytes, bytes + sizeof(registers));
+    for (Address::BaseType base : { Address::BaseType::Text, Address::BaseType::Data })
+    {
+        Memory::Segment const& segment = memory.GetSegmentByBase(base);
+        _saved.insert(_saved.end(), segment.begin(), segment.end());
+    }
+}
+
+bool StuckDetector::IsSaved(Memory const& memory) const noexcept
+{
+    auto const registers = GetRegisters(memory);
+    if (std::memcmp(_saved.data(), registers.data(), sizeof(registers)) != 0)
+        return false;
+
+    size_t offset = sizeof(registers);
+    for (Address::BaseType base : { Address::BaseType::Text, Address::BaseType::Data })
+    {
+        Memory::Segment const& segment = memory.GetSegmentByBase(base);
+        if (_saved.size() - offset < segment.size()
+            || std::memcmp(_saved.data() + offset, segment.data(), segment.size()) != 0)
+            return false;
+        offset += segment.size();
+    }
+
+    return offset == _saved.size();
+}
+
+TickResult CheckLimits(Memory const& memory, RunLimits const& limits)
+{
+    if (limits.deadline && std::chrono::steady_clock::now() >= *limits.deadline)
+        return TickResult::TimeLimitExceeded;
+
+    if (limits.stuckDetector && limits.stuckDetector->IsStuck(memory))
+        return TickResult::Stuck;
+
+    return TickResult::Success;
+}
+
+TickResult ServiceSyscall(Memory& memory, RunLimits const& limits)
+{
+    if (!limits.syscallHost)
+        return TickResult::Syscall;
+
+    bool const reads =
+        memory.GetRegister(Memory::V0) == static_cast<uint32_t>(SyscallCode::ReadInt);
+
+    TickResult const rtn = limits.syscallHost->Service(memory);
+    if (rtn == TickResult::Success && reads && limits.stuckDetector)
+        limits.stuckDetector->Reset();
+
+    return rtn;
+}
+
+template <typename Policy>
+RunResult RunProgram(Memory&          memory,
+                     Program const&   program,
+                     RunLimits const& limits,
+                     Policy&          policy)
+{
+    RunResult      rtn { TickResult::Success, 0, 0 };
+    uint64_t const interval = std::max<uint64_t>(limits.checkInterval, 1);
+
+    while (rtn.numInstructions < limits.maxInstructions && !memory.IsTerminated())
+    {
+        if (TickResult result = CheckLimits(memory, limits); result != TickResult::Success)
+        {
+            rtn.result = result;
+            break;
+        }
+
+        // A fast-forwarded loop costs the same however long it is, so it may run to the end of
+        // the whole budget without checking the limits in between.
+        uint64_t const remaining = limits.maxInstructions - rtn.numInstructions;
+        uint64_t const step      = std::min(interval, remaining);
+        RunResult      result    = RunChunk(memory, program, step, remaining, policy);
+        rtn.numInstructions += result.numInstructions;
+        rtn.numFastForwarded += result.numFastForwarded;
+
+        // A system call is never past the limit, as it stops the run before it is retired.
+        if (result.result == TickResult::Syscall)
+        {
+            uint32_t const pc = memory.GetRegister(Memory::PC);
+
+            result.result = ServiceSyscall(memory, limits);
+            if (result.result == TickResult::Success)
+            {
+                ++rtn.numInstructions;
+                if constexpr (Policy::IsEnabled)
+                    policy.OnRetire(pc, Decode(memory.GetWord(Address::MakeFromWord(pc))));
+            }
+        }
+        if (result.result != TickResult::Success)
+        {
+            rtn.result = result.result;
+            break;
+        }
     }
+
+    return rtn;
 }
+
+RunResult RunProgram(Memory& memory, Program const& program, RunLimits const& limits)
+{
+    NoInstrumentation policy;
+    return RunProgram(memory, program, limits, policy);
+}
+
+#define SIMPLE_MIPS_EMU_INSTANTIATE_ENGINE(Policy)                                                 \
+    template TickResult Tick<Policy>(Memory&, Policy&) noexcept;                                   \
+    template RunResult  RunProgram<Policy>(Memory&, Program const&, uint64_t, Policy&) noexcept;   \
+    template RunResult  RunProgram<Policy>(Memory&, Program const&, RunLimits const&, Policy&);
+SIMPLE_MIPS_EMU_INSTANTIATE_ENGINE(NoInstrumentation)
+SIMPLE_MIPS_EMU_INSTANTIATE_ENGINE(TracingPolicy)
+SIMPLE_MIPS_EMU_INSTANTIATE_ENGINE(ProfilingPolicy)
+SIMPLE_MIPS_EMU_INSTANTIATE_ENGINE(StatsPolicy)
+SIMPLE_MIPS_EMU_INSTANTIATE_ENGINE(CallGraphPolicy)
+#undef SIMPLE_MIPS_EMU_INSTANTIATE_ENGINE
@@ -0,0 +1,76 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Emulator.hh>
+
+#include <variant>
+
+Emulator::Emulator(ProgramOptions const& options) :
+    _memory { 0, 0 },
+    _program {},
+    _image {},
+    _options { options },
+    _stats {}
+{
+}
+
+void Emulator::Reset(uint8_t const* text, size_t textSize, uint8_t const* data, size_t dataSize)
+{
+    _memory.Reset(text, textSize, data, dataSize);
+    _image.reset();
+    ++_stats.numLoads;
+}
+
+void Emulator::Reset(std::shared_ptr<ProgramImage const> image)
+{
+    // The image is kept alive, so the memory can refer to its text.
+    _memory.ResetFrom(image->GetMemory());
+    _image = std::move(image);
+    ++_stats.numLoads;
+}
+
+std::optional<FileReadError> Emulator::Load(ImageCache& cache, std::filesystem::path const& path)
+{
+    ImageLoadResult result = cache.Load(path);
+    if (CannotRead const* error = std::get_if<CannotRead>(&result))
+        return error->error;
+
+    Reset(std::get<std::shared_ptr<ProgramImage const>>(std::move(result)));
+    return std::nullopt;
+}
+
+std::optional<FileReadError> Emulator::Load(std::filesystem::path const& path)
+{
+    FileReadResult result = ReadFile(path);
+    if (CannotRead const* error = std::get_if<CannotRead>(&result))
+        return error->error;
+
+    CanRead const& file = std::get<CanRead>(result);
+    Reset(file.text.data(), file.text.size(), file.data.data(), file.data.size());
+    return std::nullopt;
+}
+
+RunResult Emulator::Run(RunLimits const& limits)
+{
+    // The memory keeps its text version when the same text is loaded again, so the decoded
+    // program stays valid across such loads.
+    Program const* program;
+    if (_image && _image->GetProgram().GetTextVersion() == _memory.GetTextVersion())
+    {
+        program = &_image->GetProgram();
+    }
+    else
+    {
+        if (!_program || _program->GetTextVersion() != _memory.GetTextVersion())
+        {
+            _program.emplace(_memory, _options);
+            ++_stats.numDecodes;
+        }
+        program = &*_program;
+    }
+
+    RunResult rtn = RunProgram(_memory, *program, limits);
+    _stats.numInstructions += rtn.numInstructions;
+    _stats.numFastForwarded += rtn.numFastForwarded;
+    return rtn;
+}
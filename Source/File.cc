@@ -5,8 +5,19 @@
 #include <simple-mips-emu/File.hh>
 
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    define SIMPLE_MIPS_EMU_USE_MMAP 1
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#else
+#    define SIMPLE_MIPS_EMU_USE_MMAP 0
+#endif
 
 namespace fs = std::filesystem;
 
@@ -34,11 +45,108 @@ std::vector<uint8_t> MakeBytesFromWords(std::vector<uint32_t>::iterator begin,
     return rtn;
 }
 
+void StoreLittleEndian(uint8_t* ptr, uint32_t value) noexcept
+{
+    ptr[0] = static_cast<uint8_t>(value >> 0 & 0xFF);
+    ptr[1] = static_cast<uint8_t>(value >> 8 & 0xFF);
+    ptr[2] = static_cast<uint8_t>(value >> 16 & 0xFF);
+    ptr[3] = static_cast<uint8_t>(value >> 24 & 0xFF);
+}
+
+/// <summary>
+/// Copies the bytes in [begin, begin + length) of the segments into <c>out</c>, which must be
+/// filled with zeros. The bytes of each segment are copied at once.
+/// </summary>
+void CopyMemory(Memory const& memory, uint32_t begin, uint32_t length, uint8_t* out) noexcept
+{
+    uint64_t const end = static_cast<uint64_t>(begin) + length;
+    for (Address::BaseType base : { Address::BaseType::Text, Address::BaseType::Data })
+    {
+        Memory::Segment const& segment = memory.GetSegmentByBase(base);
+
+        uint64_t const segmentBegin = static_cast<uint32_t>(base);
+        uint64_t const segmentEnd   = segmentBegin + segment.size();
+        uint64_t const from         = std::max<uint64_t>(begin, segmentBegin);
+        uint64_t const to           = std::min(end, segmentEnd);
+        if (from < to)
+            std::memcpy(out + (from - begin), segment.data() + (from - segmentBegin), to - from);
+    }
+}
+
+/// <summary>
+/// Reverses the bytes of each whole word. Trailing bytes are left as they are.
+/// </summary>
+void SwapWords(uint8_t* bytes, size_t length) noexcept
+{
+    for (size_t i = 0; i + 4 <= length; i += 4)
+    {
+        uint32_t word;
+        std::memcpy(&word, bytes + i, 4);
+        word = (word >> 24) | (word >> 8 & 0xFF00) | (word << 8 & 0xFF0000) | (word << 24);
+        std::memcpy(bytes + i, &word, 4);
+    }
+}
+
+std::optional<FileWriteError> WriteImage(std::filesystem::path const& path,
+                                         Memory const&                memory,
+                                         uint32_t                     begin,
+                                         uint32_t                     length,
+                                         ByteOrder                    byteOrder)
+{
+    size_t const size = sizeof(MemoryImageHeader) + static_cast<size_t>(length);
+
+    auto fill = [&](uint8_t* image) {
+        std::memcpy(image, MemoryImageHeader::Magic, sizeof(MemoryImageHeader::Magic));
+        StoreLittleEndian(image + 4, MemoryImageHeader::Version);
+        StoreLittleEndian(image + 8, static_cast<uint32_t>(byteOrder));
+        StoreLittleEndian(image + 12, begin);
+        StoreLittleEndian(image + 16, length);
+
+        // The memory holds big-endian words.
+        uint8_t* const bytes = image + sizeof(MemoryImageHeader);
+        CopyMemory(memory, begin, length, bytes);
+        if (byteOrder == ByteOrder::Little)
+            SwapWords(bytes, length);
+    };
+
+#if SIMPLE_MIPS_EMU_USE_MMAP
+    // A new file reads as zeros, so only the segments have to be copied.
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return FileWriteError { FileWriteError::Type::CannotWrite };
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        close(fd);
+        return FileWriteError { FileWriteError::Type::CannotWrite };
+    }
+
+    void* image = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+        return FileWriteError { FileWriteError::Type::CannotWrite };
+
+    fill(static_cast<uint8_t*>(image));
+    munmap(image, size);
+#else
+    std::vector<uint8_t> image(size, 0);
+    fill(image.data());
+
+    std::ofstream ofs { path, std::ios::binary | std::ios::trunc };
+    if (!ofs.write(reinterpret_cast<char const*>(image.data()), static_cast<std::streamsize>(size)))
+        return FileWriteError { FileWriteError::Type::CannotWrite };
+#endif
+
+    return std::nullopt;
+}
+
 }
 
 FileReadResult ReadFile(std::filesystem::path const& path)
 {
-    if (fs::is_directory(path))
+    // Paths which cannot be examined, e.g. because they are too long, cannot be opened either.
+    std::error_code ec;
+    if (fs::is_directory(path, ec))
         return CannotRead { FileReadError::Type::GivenPathIsDirectory };
 
     std::ifstream ifs { path };
@@ -82,4 +190,35 @@ FileReadResult ReadFile(std::istream& is)
         MakeBytesFromWords(words.begin() + 2, words.begin() + 2 + (words[0] / 4)),
         MakeBytesFromWords(words.end() - (words[1] / 4), words.end()),
     };
-}
\ No newline at end of file
+}
+
+ByteOrder GetHostByteOrder() noexcept
+{
+    uint32_t const one = 1;
+    uint8_t        firstByte;
+    std::memcpy(&firstByte, &one, 1);
+
+    return firstByte == 1 ? ByteOrder::Little : ByteOrder::Big;
+}
+
+std::optional<FileWriteError> ExportMemory(std::filesystem::path const& path,
+                                           Memory const&                memory,
+                                           Address                      start,
+                                           Address                      end,
+                                           ByteOrder                    byteOrder)
+{
+    uint32_t const begin = start;
+    if (begin > static_cast<uint32_t>(end) || static_cast<uint32_t>(end) > UINT32_MAX - 4)
+        return FileWriteError { FileWriteError::Type::InvalidRange };
+
+    return WriteImage(path, memory, begin, static_cast<uint32_t>(end) + 4 - begin, byteOrder);
+}
+
+std::optional<FileWriteError> ExportSegment(std::filesystem::path const& path,
+                                            Memory const&                memory,
+                                            Address::BaseType            base,
+                                            ByteOrder                    byteOrder)
+{
+    uint32_t const length = static_cast<uint32_t>(memory.GetSegmentByBase(base).size());
+    return WriteImage(path, memory, static_cast<uint32_t>(base), length, byteOrder);
+}
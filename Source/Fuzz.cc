@@ -0,0 +1,404 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Disassembly.hh>
+#include <simple-mips-emu/Fuzz.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <sstream>
+
+namespace
+{
+
+constexpr Operation Operations[] = {
+#define SIMPLE_MIPS_EMU_OPERATION_ENTRY(format, name, code) Operation::name,
+    SIMPLE_MIPS_EMU_ALL_INSTRUCTIONS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+#undef SIMPLE_MIPS_EMU_OPERATION_ENTRY
+};
+
+bool IsStore(Operation operation) noexcept
+{
+    switch (operation)
+    {
+        case Operation::SB:
+        case Operation::SH:
+        case Operation::SW:
+        case Operation::SWL:
+        case Operation::SWR: return true;
+        default: return false;
+    }
+}
+
+/// <summary>
+/// Returns the size and the alignment of the accesses of the given operation. lwl, lwr, swl and
+/// swr never leave the word containing their address, so any address works for them.
+/// </summary>
+uint32_t GetAccessSize(Operation operation) noexcept
+{
+    switch (operation)
+    {
+        case Operation::LW:
+        case Operation::SW:
+        case Operation::LL:
+        case Operation::SC: return 4;
+        case Operation::LH:
+        case Operation::LHU:
+        case Operation::SH: return 2;
+        default: return 1;
+    }
+}
+
+/// <summary>
+/// Generates the instruction at <c>index</c> of a program of <c>length</c> instructions.
+/// </summary>
+Instruction GenerateInstruction(std::mt19937_64&   random,
+                                FuzzOptions const& options,
+                                size_t             index,
+                                size_t             length)
+{
+    auto uniform = [&random](uint32_t min, uint32_t max) {
+        return std::uniform_int_distribution<uint32_t> { min, max }(random);
+    };
+
+    // Destinations never overwrite the data register.
+    auto destination = [&]() {
+        uint8_t reg = static_cast<uint8_t>(uniform(0, NumRegisters - 1));
+        return reg == options.dataRegister ? uint8_t { 0 } : reg;
+    };
+
+    // Branches and jumps land on an instruction of the program or right after its end.
+    auto target = [&]() { return uniform(0, static_cast<uint32_t>(length)); };
+
+    Instruction rtn {};
+    rtn.operation = Operations[uniform(0, std::size(Operations) - 1)];
+    rtn.rs        = static_cast<uint8_t>(uniform(0, NumRegisters - 1));
+    rtn.rt        = static_cast<uint8_t>(uniform(0, NumRegisters - 1));
+    rtn.immediate = uniform(0, 0xFFFF);
+
+    switch (GetFormat(rtn.operation))
+    {
+        case Format::R:
+        case Format::SV:
+        case Format::SR:
+        {
+            rtn.rd        = destination();
+            rtn.immediate = uniform(0, 31);
+            break;
+        }
+        case Format::JR:
+        {
+            // Mostly return from a call; a random register rarely holds an address in the text.
+            if (uniform(0, 9) != 0)
+                rtn.rs = Memory::RA;
+            if (rtn.operation == Operation::JALR)
+                rtn.rd = destination();
+            break;
+        }
+        case Format::MF:
+        {
+            rtn.rd = destination();
+            break;
+        }
+        case Format::I:
+        case Format::UI:
+        case Format::II:
+        {
+            rtn.rt = destination();
+            break;
+        }
+        case Format::BI:
+        case Format::BZ:
+        case Format::RI:
+        {
+            // Registers are compared with a few others, so both outcomes happen.
+            rtn.rs        = static_cast<uint8_t>(uniform(0, 3));
+            rtn.rt        = static_cast<uint8_t>(uniform(0, 3));
+            rtn.immediate = target() - static_cast<uint32_t>(index + 1);
+            break;
+        }
+        case Format::OI:
+        {
+            if (!IsStore(rtn.operation))
+                rtn.rt = destination();
+
+            uint32_t const size = GetAccessSize(rtn.operation);
+            if (uniform(0, 99) >= options.wildAccessPercent && options.dataSize >= size)
+            {
+                rtn.rs        = options.dataRegister;
+                rtn.immediate = uniform(0, (options.dataSize - size) / size) * size;
+            }
+            break;
+        }
+        case Format::J:
+        {
+            rtn.immediate = Address::MakeText(target() * 4);
+            break;
+        }
+        default: break;
+    }
+
+    return rtn;
+}
+
+std::string Describe(char const* what, uint64_t expected, uint64_t actual)
+{
+    return std::string { what } + " differ: " + std::to_string(expected)
+           + " != " + std::to_string(actual);
+}
+
+/// <summary>
+/// Returns the first difference between the states, or an empty string if there is none.
+/// </summary>
+std::string Compare(Memory const& reference, Memory const& candidate)
+{
+    MemoryDiff const diff = Diff(reference, candidate);
+
+    std::ostringstream os;
+    os << std::hex;
+
+    if (!diff.registers.empty())
+    {
+        uint32_t const idx = diff.registers.front();
+        if (idx == Memory::PC)
+            os << "PC";
+        else if (idx == Memory::HI)
+            os << "HI";
+        else if (idx == Memory::LO)
+            os << "LO";
+        else
+            os << 'R' << std::dec << idx << std::hex;
+        os << ": 0x" << reference.GetRegister(idx) << " != 0x" << candidate.GetRegister(idx);
+        return os.str();
+    }
+
+    if (!diff.ranges.empty())
+    {
+        Address const address = diff.ranges.front().begin;
+        os << address << ": 0x" << reference.GetWord(address) << " != 0x"
+           << candidate.GetWord(address);
+        return os.str();
+    }
+
+    // The same states have the same hashes, however the engines wrote them.
+    if (reference.GetStateHash() != candidate.GetStateHash())
+        return "State hashes differ";
+
+    return std::string {};
+}
+
+}
+
+Memory FuzzProgram::MakeMemory() const
+{
+    Memory  rtn { static_cast<uint32_t>(text.size() * 4), static_cast<uint32_t>(data.size()) };
+    Address address = Address::MakeText(0);
+    for (uint32_t word : text)
+    {
+        rtn.SetWord(address, word);
+        address.MoveToNext();
+    }
+    rtn.Load(Address::BaseType::Data, data);
+
+    for (uint32_t idx = 0; idx < NumRegisters; ++idx) rtn.SetRegister(idx, registers[idx]);
+
+    return rtn;
+}
+
+void FuzzProgram::Print(std::ostream& os) const
+{
+    std::ios_base::fmtflags flags = os.flags();
+
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        Address const address = Address::MakeText(static_cast<uint32_t>(i * 4));
+        os << address << ":  0x" << std::hex << text[i] << "  ";
+        Disassemble(os, Decode(text[i]), address);
+        os << '\n';
+    }
+
+    for (uint32_t idx = 0; idx < NumRegisters; ++idx)
+    {
+        if (registers[idx] != 0)
+            os << "R" << std::dec << idx << ": 0x" << std::hex << registers[idx] << '\n';
+    }
+
+    for (size_t offset = 0; offset + 4 <= data.size(); offset += 4)
+    {
+        uint32_t word = 0;
+        for (size_t i = 0; i < 4; ++i) word = word << 8 | data[offset + i];
+        if (word != 0)
+        {
+            os << Address::MakeData(static_cast<uint32_t>(offset)) << ": 0x" << std::hex << word
+               << '\n';
+        }
+    }
+
+    os.flags(flags);
+}
+
+FuzzProgram GenerateProgram(std::mt19937_64& random, FuzzOptions const& options)
+{
+    size_t const length =
+        std::uniform_int_distribution<size_t> { options.minLength, options.maxLength }(random);
+
+    FuzzProgram rtn;
+    rtn.text.resize(length);
+    for (size_t i = 0; i < length; ++i)
+        rtn.text[i] = Encode(GenerateInstruction(random, options, i, length));
+
+    rtn.data.resize(options.dataSize);
+    for (uint8_t& byte : rtn.data) byte = static_cast<uint8_t>(random());
+
+    // Small values make branches and shifts more interesting than random ones do.
+    for (uint32_t& value : rtn.registers)
+        value = random() % 2 == 0 ? static_cast<uint32_t>(random() % 16)
+                                  : static_cast<uint32_t>(random());
+    rtn.registers[0]                    = 0;
+    rtn.registers[options.dataRegister] = Address::MakeData(0);
+
+    return rtn;
+}
+
+Engine MakeTickEngine(Memory const&)
+{
+    return [](Memory& memory, uint64_t maxInstructions) {
+        RunResult rtn { TickResult::Success, 0, 0 };
+        while (rtn.numInstructions < maxInstructions && !memory.IsTerminated())
+        {
+            if (TickResult result = Tick(memory); result != TickResult::Success)
+            {
+                rtn.result = result;
+                break;
+            }
+            ++rtn.numInstructions;
+        }
+
+        return rtn;
+    };
+}
+
+Engine MakeProgramEngine(Memory const& memory)
+{
+    auto program = std::make_shared<Program>(memory);
+    return [program](Memory& memory, uint64_t maxInstructions) {
+        return RunProgram(memory, *program, maxInstructions);
+    };
+}
+
+Engine MakeFastForwardEngine(Memory const& memory)
+{
+    ProgramOptions options;
+    options.fastForwardLoops = true;
+
+    auto program = std::make_shared<Program>(memory, options);
+    return [program](Memory& memory, uint64_t maxInstructions) {
+        return RunProgram(memory, *program, maxInstructions);
+    };
+}
+
+std::optional<Divergence> RunLockstep(FuzzProgram const&   program,
+                                      EngineFactory const& reference,
+                                      EngineFactory const& candidate,
+                                      uint64_t             maxInstructions,
+                                      uint64_t             interval)
+{
+    Memory referenceMemory = program.MakeMemory();
+    Memory candidateMemory = referenceMemory;
+
+    Engine referenceEngine = reference(referenceMemory);
+    Engine candidateEngine = candidate(candidateMemory);
+
+    uint64_t numInstructions = 0;
+    while (numInstructions < maxInstructions)
+    {
+        uint64_t const  step     = std::min(interval, maxInstructions - numInstructions);
+        RunResult const expected = referenceEngine(referenceMemory, step);
+        RunResult const actual   = candidateEngine(candidateMemory, step);
+
+        if (expected.result != actual.result)
+        {
+            return Divergence { numInstructions,
+                                Describe("Results",
+                                         static_cast<uint64_t>(expected.result),
+                                         static_cast<uint64_t>(actual.result)) };
+        }
+        if (expected.numInstructions != actual.numInstructions)
+        {
+            return Divergence {
+                numInstructions,
+                Describe("Instruction counts", expected.numInstructions, actual.numInstructions)
+            };
+        }
+
+        numInstructions += expected.numInstructions;
+        if (std::string reason = Compare(referenceMemory, candidateMemory); !reason.empty())
+            return Divergence { numInstructions, std::move(reason) };
+
+        if (expected.result != TickResult::Success || expected.numInstructions < step)
+            break;
+    }
+
+    return std::nullopt;
+}
+
+FuzzProgram Shrink(FuzzProgram program, std::function<bool(FuzzProgram const&)> const& fails)
+{
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+
+        auto attempt = [&](FuzzProgram const& candidate) {
+            if (!fails(candidate))
+                return false;
+
+            program  = candidate;
+            progress = true;
+            return true;
+        };
+
+        while (!program.text.empty())
+        {
+            FuzzProgram candidate = program;
+            candidate.text.pop_back();
+            if (!attempt(candidate))
+                break;
+        }
+
+        for (size_t i = 0; i < program.text.size(); ++i)
+        {
+            if (program.text[i] == 0)
+                continue;
+
+            FuzzProgram candidate = program;
+            candidate.text[i]     = 0;
+            attempt(candidate);
+        }
+
+        for (uint32_t idx = 1; idx < NumRegisters; ++idx)
+        {
+            if (program.registers[idx] == 0)
+                continue;
+
+            FuzzProgram candidate    = program;
+            candidate.registers[idx] = 0;
+            attempt(candidate);
+        }
+
+        for (size_t offset = 0; offset + 4 <= program.data.size(); offset += 4)
+        {
+            auto const begin = program.data.begin() + static_cast<ptrdiff_t>(offset);
+            if (std::all_of(begin, begin + 4, [](uint8_t byte) { return byte == 0; }))
+                continue;
+
+            FuzzProgram candidate = program;
+            std::fill_n(candidate.data.begin() + static_cast<ptrdiff_t>(offset), 4, 0);
+            attempt(candidate);
+        }
+    }
+
+    return program;
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Fuzz.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct Options
+{
+    uint64_t numPrograms     = 1000000;
+    uint64_t seed            = 0;
+    uint64_t maxInstructions = 1000;
+    uint64_t interval        = 16;
+    unsigned numThreads      = std::max(1u, std::thread::hardware_concurrency());
+    bool     fastForward     = false;
+};
+
+template <typename T>
+T ParseNumber(char const* input)
+{
+    T    rtn;
+    auto result = std::from_chars(input, input + strlen(input), rtn);
+    if (result.ec != std::errc {} || *result.ptr != '\0')
+        throw std::runtime_error { "Invalid number" };
+
+    return rtn;
+}
+
+Options ParseCommandArgs(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-F") == 0)
+        {
+            options.fastForward = true;
+            continue;
+        }
+
+        if (i == argc - 1)
+            throw std::runtime_error { std::string { "Missing value after '" } + argv[i] + "'" };
+
+        if (strcmp(argv[i], "-n") == 0)
+            options.numPrograms = ParseNumber<uint64_t>(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0)
+            options.seed = ParseNumber<uint64_t>(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0)
+            options.maxInstructions = ParseNumber<uint64_t>(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0)
+            options.interval = std::max<uint64_t>(1, ParseNumber<uint64_t>(argv[++i]));
+        else if (strcmp(argv[i], "-j") == 0)
+            options.numThreads = std::max(1u, ParseNumber<unsigned>(argv[++i]));
+        else
+            throw std::runtime_error { std::string { "Unknown option: " } + argv[i] };
+    }
+
+    return options;
+}
+
+/// <summary>
+/// Runs random programs on the reference engine and the decoded engine in lockstep, on all cores.
+/// Program <c>i</c> is generated from <c>seed + i</c>, so any failure can be reproduced with
+/// <c>-s</c> alone. With <c>-F</c>, the decoded engine fast-forwards loops.
+/// </summary>
+int main(int argc, char* argv[])
+{
+    try
+    {
+        Options const     options = ParseCommandArgs(argc, argv);
+        FuzzOptions const fuzzOptions {};
+
+        EngineFactory const candidate = options.fastForward ? MakeFastForwardEngine
+                                                            : MakeProgramEngine;
+
+        auto check = [&options, &candidate](FuzzProgram const& program) {
+            return RunLockstep(program,
+                               MakeTickEngine,
+                               candidate,
+                               options.maxInstructions,
+                               options.interval);
+        };
+
+        std::atomic<uint64_t>   next { 0 };
+        std::atomic<bool>       failed { false };
+        std::mutex              failureMutex;
+        std::optional<uint64_t> failure;
+
+        auto worker = [&]() {
+            while (!failed.load(std::memory_order_relaxed))
+            {
+                uint64_t const index = next.fetch_add(1, std::memory_order_relaxed);
+                if (index >= options.numPrograms)
+                    break;
+
+                std::mt19937_64 random { options.seed + index };
+                if (check(GenerateProgram(random, fuzzOptions)))
+                {
+                    std::lock_guard<std::mutex> lock { failureMutex };
+                    if (!failure || index < *failure)
+                        failure = index;
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        auto const begin = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < options.numThreads; ++i) threads.emplace_back(worker);
+        for (std::thread& thread : threads) thread.join();
+
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - begin;
+        uint64_t const numRun = std::min(next.load(), options.numPrograms);
+        std::cout << numRun << " programs in " << elapsed.count() << " s ("
+                  << static_cast<uint64_t>(numRun / std::max(elapsed.count(), 1e-9) * 3600)
+                  << " programs per hour)\n";
+
+        if (!failure)
+            return 0;
+
+        std::mt19937_64 random { options.seed + *failure };
+        FuzzProgram     program = GenerateProgram(random, fuzzOptions);
+        program = Shrink(program, [&check](FuzzProgram const& candidate) {
+            return check(candidate).has_value();
+        });
+
+        std::cout << "Divergence in program " << *failure << " (-s " << options.seed + *failure
+                  << " -n 1): " << check(program)->reason << '\n'
+                  << "Reduced program:\n";
+        program.Print(std::cout);
+        return 1;
+    }
+    catch (std::exception const& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return 1;
+    }
+}
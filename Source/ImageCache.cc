@@ -0,0 +1,139 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/ImageCache.hh>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// <summary>
+/// Hashes the given bytes with the given multiplier. Two hashes with different multipliers are
+/// combined into a key, which makes an accidental collision practically impossible.
+/// </summary>
+uint64_t Hash(std::string const& bytes, uint64_t multiplier) noexcept
+{
+    uint64_t rtn = bytes.size();
+
+    size_t i = 0;
+    for (; i + 8 <= bytes.size(); i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + i, 8);
+        rtn = (rtn ^ word) * multiplier;
+        rtn ^= rtn >> 29;
+    }
+    for (; i < bytes.size(); ++i) rtn = (rtn ^ static_cast<uint8_t>(bytes[i])) * multiplier;
+
+    return rtn;
+}
+
+}
+
+ProgramImage::ProgramImage(Memory memory, ProgramOptions const& options) :
+    _memory { std::move(memory) },
+    _program { _memory, options }
+{
+}
+
+size_t ProgramImage::GetFootprint() const noexcept
+{
+    return sizeof(*this) + _memory.GetTextSize() + _memory.GetDataSize()
+           + _program.GetSize() * (sizeof(Instruction) + sizeof(Operation))
+           + _program.GetGraph().GetBlocks().size() * sizeof(BasicBlock);
+}
+
+ImageCache::ImageCache(size_t budget, ProgramOptions const& options) :
+    _budget { budget },
+    _options { options },
+    _stats {}
+{
+}
+
+ImageLoadResult ImageCache::Load(fs::path const& path)
+{
+    std::error_code ec;
+    if (fs::is_directory(path, ec))
+        return CannotRead { FileReadError::Type::GivenPathIsDirectory };
+
+    std::ifstream ifs { path, std::ios::binary };
+    if (!ifs)
+        return CannotRead { FileReadError::Type::FileDoesNotExist };
+
+    std::string const contents { std::istreambuf_iterator<char> { ifs },
+                                 std::istreambuf_iterator<char> {} };
+
+    Key const key { Hash(contents, 0x9E3779B97F4A7C15),
+                    Hash(contents, 0xC2B2AE3D27D4EB4F),
+                    contents.size() };
+
+    {
+        std::lock_guard<std::mutex> lock { _mutex };
+        if (auto it = _index.find(key); it != _index.end())
+        {
+            _entries.splice(_entries.begin(), _entries, it->second);
+            ++_stats.numHits;
+            return it->second->image;
+        }
+        ++_stats.numMisses;
+    }
+
+    // Parse and decode without holding the lock, so that hits on other threads do not wait.
+    std::istringstream iss { contents };
+    FileReadResult     result = ReadFile(iss);
+    if (CannotRead const* error = std::get_if<CannotRead>(&result))
+        return *error;
+
+    CanRead&   file = std::get<CanRead>(result);
+    auto const image =
+        std::make_shared<ProgramImage const>(Memory { file.text, file.data }, _options);
+
+    std::lock_guard<std::mutex> lock { _mutex };
+    if (auto it = _index.find(key); it != _index.end())
+    {
+        // Another thread loaded the same contents meanwhile.
+        _entries.splice(_entries.begin(), _entries, it->second);
+        return it->second->image;
+    }
+
+    size_t const footprint = image->GetFootprint();
+    _entries.push_front(Entry { key, image, footprint });
+    _index.emplace(key, _entries.begin());
+    ++_stats.numImages;
+    _stats.numBytes += footprint;
+    Evict();
+
+    return image;
+}
+
+ImageCacheStats ImageCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock { _mutex };
+    return _stats;
+}
+
+/// <summary>
+/// Evicts the least recently used images until the budget is met. The most recently used image
+/// is kept even if it alone exceeds the budget. The caller must hold the lock.
+/// </summary>
+void ImageCache::Evict()
+{
+    while (_stats.numBytes > _budget && _entries.size() > 1)
+    {
+        Entry const& entry = _entries.back();
+        _stats.numBytes -= entry.footprint;
+        --_stats.numImages;
+        ++_stats.numEvictions;
+
+        _index.erase(entry.key);
+        _entries.pop_back();
+    }
+}
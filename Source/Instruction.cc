@@ -0,0 +1,400 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Common.hh>
+#include <simple-mips-emu/Instruction.hh>
+
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define SIMPLE_MIPS_EMU_USE_SSE2
+#endif
+
+namespace
+{
+
+enum class ImmediateKind : uint8_t
+{
+    None = 0,
+    ZeroExtended,
+    SignExtended,
+    ShiftAmount,
+    Target,
+};
+
+/// <summary>
+/// Describes which fields an instruction of a format uses.
+/// </summary>
+struct FieldLayout
+{
+    uint8_t       rsMask;
+    uint8_t       rtMask;
+    uint8_t       rdMask;
+    ImmediateKind immediate;
+};
+
+constexpr FieldLayout GetLayout(Format format) noexcept
+{
+    switch (format)
+    {
+        case Format::R: return { 0b11111, 0b11111, 0b11111, ImmediateKind::None };
+        case Format::SV: return { 0b11111, 0b11111, 0b11111, ImmediateKind::None };
+        case Format::JR: return { 0b11111, 0, 0b11111, ImmediateKind::None };
+        case Format::SR: return { 0, 0b11111, 0b11111, ImmediateKind::ShiftAmount };
+        case Format::MD: return { 0b11111, 0b11111, 0, ImmediateKind::None };
+        case Format::MF: return { 0, 0, 0b11111, ImmediateKind::None };
+        case Format::MT: return { 0b11111, 0, 0, ImmediateKind::None };
+        case Format::SYS: return { 0, 0, 0, ImmediateKind::None };
+        case Format::I: return { 0b11111, 0b11111, 0, ImmediateKind::SignExtended };
+        case Format::UI: return { 0b11111, 0b11111, 0, ImmediateKind::ZeroExtended };
+        case Format::BI: return { 0b11111, 0b11111, 0, ImmediateKind::SignExtended };
+        case Format::BZ: return { 0b11111, 0, 0, ImmediateKind::SignExtended };
+        case Format::RI: return { 0b11111, 0, 0, ImmediateKind::SignExtended };
+        case Format::II: return { 0, 0b11111, 0, ImmediateKind::ZeroExtended };
+        case Format::OI: return { 0b11111, 0b11111, 0, ImmediateKind::SignExtended };
+        case Format::J: return { 0, 0, 0, ImmediateKind::Target };
+        default: return { 0, 0, 0, ImmediateKind::None };
+    }
+}
+
+template <Operation Op>
+Instruction DecodeAs(uint32_t word) noexcept
+{
+    constexpr FieldLayout layout = GetLayout(GetFormat(Op));
+
+    Instruction rtn {};
+    rtn.operation = Op;
+    rtn.rs        = static_cast<uint8_t>((word >> 21) & layout.rsMask);
+    rtn.rt        = static_cast<uint8_t>((word >> 16) & layout.rtMask);
+    rtn.rd        = static_cast<uint8_t>((word >> 11) & layout.rdMask);
+
+    if constexpr (layout.immediate == ImmediateKind::ZeroExtended)
+        rtn.immediate = (word >> 0) & 0xFFFF;
+    else if constexpr (layout.immediate == ImmediateKind::SignExtended)
+        rtn.immediate = SignExtend((word >> 0) & 0xFFFF, 16);
+    else if constexpr (layout.immediate == ImmediateKind::ShiftAmount)
+        rtn.immediate = (word >> 6) & 0b11111;
+    else if constexpr (layout.immediate == ImmediateKind::Target)
+        rtn.immediate = (word & 0x03FFFFFF) << 2;
+
+    return rtn;
+}
+
+Instruction DecodeInvalid(uint32_t) noexcept
+{
+    return Instruction {};
+}
+
+using Decoder     = Instruction (*)(uint32_t word) noexcept;
+using DecodeTable = std::array<Decoder, 64>;
+
+#define SIMPLE_MIPS_EMU_TABLE_ENTRY(format, name, code) table[code] = DecodeAs<Operation::name>;
+
+constexpr DecodeTable MakeFunctionTable() noexcept
+{
+    DecodeTable table {};
+    for (auto& decoder : table) decoder = DecodeInvalid;
+
+    SIMPLE_MIPS_EMU_R_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_SV_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_JR_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_SR_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_MD_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_MF_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_MT_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_SYS_FORMAT_FNS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+
+    return table;
+}
+
+constexpr DecodeTable FunctionTable = MakeFunctionTable();
+
+Instruction DecodeFunction(uint32_t word) noexcept
+{
+    return FunctionTable[word & 0b111111](word);
+}
+
+constexpr DecodeTable MakeRegisterImmediateTable() noexcept
+{
+    DecodeTable table {};
+    for (auto& decoder : table) decoder = DecodeInvalid;
+
+    SIMPLE_MIPS_EMU_RI_FORMAT_RTS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+
+    return table;
+}
+
+constexpr DecodeTable RegisterImmediateTable = MakeRegisterImmediateTable();
+
+Instruction DecodeRegisterImmediate(uint32_t word) noexcept
+{
+    return RegisterImmediateTable[(word >> 16) & 0b11111](word);
+}
+
+constexpr DecodeTable MakeOperationTable() noexcept
+{
+    DecodeTable table {};
+    for (auto& decoder : table) decoder = DecodeInvalid;
+
+    // Operation 0 selects the instruction with the function field, and operation 1 with the rt
+    // field.
+    table[0] = DecodeFunction;
+    table[1] = DecodeRegisterImmediate;
+
+    SIMPLE_MIPS_EMU_I_FORMAT_OPS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_UI_FORMAT_OPS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_BI_FORMAT_OPS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_BZ_FORMAT_OPS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_II_FORMAT_OPS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_OI_FORMAT_OPS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+    SIMPLE_MIPS_EMU_J_FORMAT_OPS(SIMPLE_MIPS_EMU_TABLE_ENTRY)
+
+    return table;
+}
+
+#undef SIMPLE_MIPS_EMU_TABLE_ENTRY
+
+constexpr DecodeTable OperationTable = MakeOperationTable();
+
+// The bulk decoder cannot call a function per word, so it uses a table of operations instead.
+// Entries 0..63 are indexed by the operation field, entries 64..127 by the function field and
+// entries 128..159 by the rt field.
+
+using OperationInfoTable = std::array<Operation, 160>;
+
+constexpr OperationInfoTable MakeOperationInfoTable() noexcept
+{
+    OperationInfoTable table {};
+    for (auto& operation : table) operation = Operation::Invalid;
+
+#define SIMPLE_MIPS_EMU_FUNCTION_ENTRY(format, name, code) table[64 + code] = Operation::name;
+#define SIMPLE_MIPS_EMU_RT_ENTRY(format, name, code) table[128 + code] = Operation::name;
+#define SIMPLE_MIPS_EMU_OPERATION_ENTRY(format, name, code) table[code] = Operation::name;
+    SIMPLE_MIPS_EMU_R_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_SV_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_JR_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_SR_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_MD_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_MF_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_MT_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_SYS_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_RI_FORMAT_RTS(SIMPLE_MIPS_EMU_RT_ENTRY)
+    SIMPLE_MIPS_EMU_I_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_UI_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_BI_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_BZ_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_II_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_OI_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_J_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+#undef SIMPLE_MIPS_EMU_OPERATION_ENTRY
+#undef SIMPLE_MIPS_EMU_RT_ENTRY
+#undef SIMPLE_MIPS_EMU_FUNCTION_ENTRY
+
+    return table;
+}
+
+constexpr OperationInfoTable OperationInfo = MakeOperationInfoTable();
+
+using LayoutTable = std::array<FieldLayout, 256>;
+
+constexpr LayoutTable MakeLayoutTable() noexcept
+{
+    LayoutTable table {};
+    for (size_t i = 0; i < table.size(); ++i)
+        table[i] = GetLayout(GetFormat(static_cast<Operation>(i)));
+
+    return table;
+}
+
+constexpr LayoutTable Layouts = MakeLayoutTable();
+
+// The fixed bits of each operation: the operation field, the function field for operation 0, or
+// operation 1 and the rt field.
+
+using EncodingTable = std::array<uint32_t, 256>;
+
+constexpr EncodingTable MakeEncodingTable() noexcept
+{
+    EncodingTable table {};
+    for (auto& word : table) word = InvalidWord;
+
+#define SIMPLE_MIPS_EMU_FUNCTION_ENTRY(format, name, code)                                         \
+    table[static_cast<size_t>(Operation::name)] = code;
+#define SIMPLE_MIPS_EMU_RT_ENTRY(format, name, code)                                               \
+    table[static_cast<size_t>(Operation::name)] = uint32_t { 1 } << 26 | code << 16;
+#define SIMPLE_MIPS_EMU_OPERATION_ENTRY(format, name, code)                                        \
+    table[static_cast<size_t>(Operation::name)] = static_cast<uint32_t>(code) << 26;
+    SIMPLE_MIPS_EMU_R_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_SV_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_JR_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_SR_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_MD_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_MF_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_MT_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_SYS_FORMAT_FNS(SIMPLE_MIPS_EMU_FUNCTION_ENTRY)
+    SIMPLE_MIPS_EMU_RI_FORMAT_RTS(SIMPLE_MIPS_EMU_RT_ENTRY)
+    SIMPLE_MIPS_EMU_I_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_UI_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_BI_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_BZ_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_II_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_OI_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+    SIMPLE_MIPS_EMU_J_FORMAT_OPS(SIMPLE_MIPS_EMU_OPERATION_ENTRY)
+#undef SIMPLE_MIPS_EMU_OPERATION_ENTRY
+#undef SIMPLE_MIPS_EMU_RT_ENTRY
+#undef SIMPLE_MIPS_EMU_FUNCTION_ENTRY
+
+    return table;
+}
+
+constexpr EncodingTable Encodings = MakeEncodingTable();
+
+constexpr size_t BlockSize = 8;
+
+/// <summary>
+/// Fields of <c>BlockSize</c> words in structure-of-arrays form.
+/// </summary>
+struct FieldBlock
+{
+    alignas(16) uint32_t operation[BlockSize];
+    alignas(16) uint32_t rs[BlockSize];
+    alignas(16) uint32_t rt[BlockSize];
+    alignas(16) uint32_t rd[BlockSize];
+    alignas(16) uint32_t shiftAmount[BlockSize];
+    alignas(16) uint32_t function[BlockSize];
+    alignas(16) uint32_t zeroExtended[BlockSize];
+    alignas(16) uint32_t signExtended[BlockSize];
+    alignas(16) uint32_t target[BlockSize];
+};
+
+void ExtractFields(uint8_t const* bytes, FieldBlock& block) noexcept
+{
+#ifdef SIMPLE_MIPS_EMU_USE_SSE2
+    __m128i const mask5  = _mm_set1_epi32(0b11111);
+    __m128i const mask6  = _mm_set1_epi32(0b111111);
+    __m128i const mask16 = _mm_set1_epi32(0xFFFF);
+    __m128i const mask26 = _mm_set1_epi32(0x03FFFFFF);
+
+    for (size_t i = 0; i < BlockSize; i += 4)
+    {
+        __m128i word = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes + i * 4));
+
+        // MIPS uses big-endian; swap the bytes in each 16-bit lane, then swap the lanes.
+        word = _mm_or_si128(_mm_slli_epi16(word, 8), _mm_srli_epi16(word, 8));
+        word = _mm_shufflehi_epi16(_mm_shufflelo_epi16(word, 0xB1), 0xB1);
+
+        auto store = [i](uint32_t* dst, __m128i value) {
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + i), value);
+        };
+
+        store(block.operation, _mm_srli_epi32(word, 26));
+        store(block.rs, _mm_and_si128(_mm_srli_epi32(word, 21), mask5));
+        store(block.rt, _mm_and_si128(_mm_srli_epi32(word, 16), mask5));
+        store(block.rd, _mm_and_si128(_mm_srli_epi32(word, 11), mask5));
+        store(block.shiftAmount, _mm_and_si128(_mm_srli_epi32(word, 6), mask5));
+        store(block.function, _mm_and_si128(word, mask6));
+        store(block.zeroExtended, _mm_and_si128(word, mask16));
+        store(block.signExtended, _mm_srai_epi32(_mm_slli_epi32(word, 16), 16));
+        store(block.target, _mm_slli_epi32(_mm_and_si128(word, mask26), 2));
+    }
+#else
+    for (size_t i = 0; i < BlockSize; ++i)
+    {
+        uint8_t const* ptr  = bytes + i * 4;
+        uint32_t const word = static_cast<uint32_t>(ptr[0]) << 24
+                              | static_cast<uint32_t>(ptr[1]) << 16
+                              | static_cast<uint32_t>(ptr[2]) << 8 | static_cast<uint32_t>(ptr[3]);
+
+        block.operation[i]    = word >> 26;
+        block.rs[i]           = (word >> 21) & 0b11111;
+        block.rt[i]           = (word >> 16) & 0b11111;
+        block.rd[i]           = (word >> 11) & 0b11111;
+        block.shiftAmount[i]  = (word >> 6) & 0b11111;
+        block.function[i]     = word & 0b111111;
+        block.zeroExtended[i] = word & 0xFFFF;
+        block.signExtended[i] = SignExtend(word & 0xFFFF, 16);
+        block.target[i]       = (word & 0x03FFFFFF) << 2;
+    }
+#endif
+}
+
+void AssembleInstructions(FieldBlock const& block, size_t count, Instruction* out) noexcept
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t const operationField = block.operation[i];
+        size_t const   index          = operationField == 0   ? 64 + block.function[i]
+                                        : operationField == 1 ? 128 + block.rt[i]
+                                                              : operationField;
+
+        Operation const    operation = OperationInfo[index];
+        FieldLayout const& layout    = Layouts[static_cast<size_t>(operation)];
+
+        uint32_t const immediates[] = {
+            0,
+            block.zeroExtended[i],
+            block.signExtended[i],
+            block.shiftAmount[i],
+            block.target[i],
+        };
+
+        out[i].operation = operation;
+        out[i].rs        = static_cast<uint8_t>(block.rs[i] & layout.rsMask);
+        out[i].rt        = static_cast<uint8_t>(block.rt[i] & layout.rtMask);
+        out[i].rd        = static_cast<uint8_t>(block.rd[i] & layout.rdMask);
+        out[i].immediate = immediates[static_cast<size_t>(layout.immediate)];
+    }
+}
+
+}
+
+Instruction Decode(uint32_t word) noexcept
+{
+    return OperationTable[(word >> 26) & 0b111111](word);
+}
+
+void Decode(uint8_t const* bytes, size_t numWords, Instruction* out) noexcept
+{
+    FieldBlock block;
+
+    size_t i = 0;
+    for (; i + BlockSize <= numWords; i += BlockSize)
+    {
+        ExtractFields(bytes + i * 4, block);
+        AssembleInstructions(block, BlockSize, out + i);
+    }
+
+    if (i < numWords)
+    {
+        uint8_t tail[BlockSize * 4] {};
+        std::memcpy(tail, bytes + i * 4, (numWords - i) * 4);
+
+        ExtractFields(tail, block);
+        AssembleInstructions(block, numWords - i, out + i);
+    }
+}
+
+uint32_t Encode(Instruction const& instruction) noexcept
+{
+    uint32_t rtn = Encodings[static_cast<size_t>(instruction.operation)];
+    if (rtn == InvalidWord)
+        return InvalidWord;
+
+    FieldLayout const& layout = Layouts[static_cast<size_t>(instruction.operation)];
+    rtn |= static_cast<uint32_t>(instruction.rs & layout.rsMask) << 21;
+    rtn |= static_cast<uint32_t>(instruction.rt & layout.rtMask) << 16;
+    rtn |= static_cast<uint32_t>(instruction.rd & layout.rdMask) << 11;
+
+    switch (layout.immediate)
+    {
+        case ImmediateKind::ZeroExtended:
+        case ImmediateKind::SignExtended: rtn |= instruction.immediate & 0xFFFF; break;
+        case ImmediateKind::ShiftAmount: rtn |= (instruction.immediate & 0b11111) << 6; break;
+        case ImmediateKind::Target: rtn |= (instruction.immediate >> 2) & 0x03FFFFFF; break;
+        default: break;
+    }
+
+    return rtn;
+}
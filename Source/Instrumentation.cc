@@ -0,0 +1,189 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Disassembly.hh>
+#include <simple-mips-emu/Instrumentation.hh>
+
+#include <algorithm>
+#include <iomanip>
+
+TracingPolicy::TracingPolicy(std::ostream& os) noexcept :
+    _os { os },
+    _access { std::nullopt },
+    _isStore { false }
+{
+}
+
+void TracingPolicy::OnFetch(uint32_t, Instruction const&) noexcept
+{
+    _access = std::nullopt;
+}
+
+void TracingPolicy::OnRetire(uint32_t pc, Instruction const& instruction)
+{
+    std::ios_base::fmtflags flags = _os.flags();
+
+    _os << "0x" << std::hex << pc << ": ";
+    Disassemble(_os, instruction, pc);
+    if (_access)
+        _os << " [" << (_isStore ? "store" : "load") << " 0x" << uint32_t { *_access } << ']';
+    _os << '\n';
+
+    _os.flags(flags);
+}
+
+void TracingPolicy::OnLoad(Address address, uint32_t) noexcept
+{
+    _access  = address;
+    _isStore = false;
+}
+
+void TracingPolicy::OnStore(Address address, uint32_t) noexcept
+{
+    _access  = address;
+    _isStore = true;
+}
+
+ProfilingPolicy::ProfilingPolicy() noexcept : _counts {}
+{
+}
+
+void ProfilingPolicy::OnRetire(uint32_t pc, Instruction const&)
+{
+    // Only instructions in the text segment are counted.
+    uint32_t const offset = pc - Address::MakeText(0);
+    if (offset >= Address::MakeData(0) - Address::MakeText(0))
+        return;
+
+    size_t const index = offset / 4;
+    if (index >= _counts.size())
+        _counts.resize(std::max(index + 1, _counts.size() * 2));
+    ++_counts[index];
+}
+
+uint64_t ProfilingPolicy::GetCount(uint32_t pc) const noexcept
+{
+    size_t const index = (pc - Address::MakeText(0)) / 4;
+    return pc >= Address::MakeText(0) && index < _counts.size() ? _counts[index] : 0;
+}
+
+void ProfilingPolicy::Print(std::ostream& os, Memory const& memory, size_t maxEntries) const
+{
+    std::vector<size_t> indices;
+    for (size_t index = 0; index < _counts.size(); ++index)
+        if (_counts[index] != 0)
+            indices.push_back(index);
+
+    // The hottest instructions first, and those of the same count by their addresses.
+    size_t const numEntries = std::min(maxEntries, indices.size());
+    std::partial_sort(indices.begin(),
+                      indices.begin() + numEntries,
+                      indices.end(),
+                      [this](size_t lhs, size_t rhs) {
+                          return _counts[lhs] != _counts[rhs] ? _counts[lhs] > _counts[rhs]
+                                                              : lhs < rhs;
+                      });
+
+    std::ios_base::fmtflags flags = os.flags();
+
+    os << "Hottest instructions:\n";
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+        uint32_t const pc = Address::MakeText(static_cast<uint32_t>(indices[i] * 4));
+
+        os << std::dec << std::setw(12) << _counts[indices[i]] << "  0x" << std::hex << pc << ": ";
+        Disassemble(os, Decode(memory.GetWord(Address::MakeFromWord(pc))), pc);
+        os << '\n';
+    }
+
+    os.flags(flags);
+}
+
+CallGraphPolicy::CallGraphPolicy(uint32_t entry) :
+    _nodes { Node { entry, 0, 0 } },
+    _children {},
+    _stack {},
+    _current { 0 },
+    _target { 0 },
+    _taken { false }
+{
+}
+
+void CallGraphPolicy::WriteFolded(std::ostream& os) const
+{
+    std::ios_base::fmtflags flags = os.flags();
+
+    std::vector<uint32_t> path;
+    for (size_t index = 0; index < _nodes.size(); ++index)
+    {
+        if (_nodes[index].numRetired == 0)
+            continue;
+
+        path.clear();
+        for (uint32_t node = static_cast<uint32_t>(index); node != 0; node = _nodes[node].parent)
+            path.push_back(_nodes[node].function);
+        path.push_back(_nodes[0].function);
+
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+            os << (it == path.rbegin() ? "0x" : ";0x") << std::hex << *it;
+        os << ' ' << std::dec << _nodes[index].numRetired << '\n';
+    }
+
+    os.flags(flags);
+}
+
+void CallGraphPolicy::Call(uint32_t target, uint32_t returnAddress)
+{
+    _stack.push_back(Frame { _current, returnAddress });
+    if (_stack.size() > MaxDepth)
+        return;
+
+    uint64_t const key          = uint64_t { _current } << 32 | target;
+    uint32_t const next         = static_cast<uint32_t>(_nodes.size());
+    auto const [it, isInserted] = _children.try_emplace(key, next);
+    if (isInserted)
+        _nodes.push_back(Node { target, _current, 0 });
+    _current = it->second;
+}
+
+void CallGraphPolicy::Return(uint32_t target) noexcept
+{
+    // A return may skip frames, e.g. when a callee never returned by itself.
+    for (size_t depth = _stack.size(); depth > 0; --depth)
+    {
+        if (_stack[depth - 1].returnAddress == target)
+        {
+            _current = _stack[depth - 1].node;
+            _stack.resize(depth - 1);
+            return;
+        }
+    }
+}
+
+void StatsPolicy::Print(std::ostream& os) const
+{
+    std::vector<size_t> operations;
+    for (size_t operation = 0; operation < _stats.numRetiredByOperation.size(); ++operation)
+        if (_stats.numRetiredByOperation[operation] != 0)
+            operations.push_back(operation);
+
+    std::stable_sort(operations.begin(), operations.end(), [this](size_t lhs, size_t rhs) {
+        return _stats.numRetiredByOperation[lhs] > _stats.numRetiredByOperation[rhs];
+    });
+
+    std::ios_base::fmtflags flags = os.flags();
+
+    os << std::dec;
+    os << "Retired instructions: " << _stats.numRetired << '\n';
+    os << "Loads: " << _stats.numLoads << " (" << _stats.numBytesLoaded << " bytes)\n";
+    os << "Stores: " << _stats.numStores << " (" << _stats.numBytesStored << " bytes)\n";
+    os << "Branches: " << _stats.numBranches << " (" << _stats.numTakenBranches << " taken)\n";
+    os << "Operations:\n";
+    for (size_t operation : operations)
+    {
+        os << std::setw(12) << _stats.numRetiredByOperation[operation] << "  "
+           << GetMnemonic(static_cast<Operation>(operation)) << '\n';
+    }
+
+    os.flags(flags);
+}
@@ -3,33 +3,198 @@
 
 #include <simple-mips-emu/Emulation.hh>
 #include <simple-mips-emu/File.hh>
+#include <simple-mips-emu/Instrumentation.hh>
 #include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/Multicore.hh>
+#include <simple-mips-emu/Sampling.hh>
+#include <simple-mips-emu/Server.hh>
+#include <simple-mips-emu/Sweep.hh>
+#include <simple-mips-emu/Syscall.hh>
+#include <simple-mips-emu/Trace.hh>
+#include <simple-mips-emu/Watchpoints.hh>
 
+#include <algorithm>
 #include <charconv>
+#include <chrono>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <optional>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
-struct Range
+struct Watch
 {
-    Address begin;
-    Address end;
+    AddressRange range;
+    WatchAction  action;
+};
+
+struct Export
+{
+    /// <summary>
+    /// The exported range, or <c>std::nullopt</c> to export the whole segment at <c>base</c>.
+    /// </summary>
+    std::optional<AddressRange> range;
+    Address::BaseType           base;
+    std::filesystem::path       path;
+};
+
+struct Sweep
+{
+    std::filesystem::path   inputPath;
+    std::filesystem::path   resultPath;
+    std::vector<SweepField> inputs {};
+    std::vector<SweepField> outputs {};
+};
+
+struct Sampling
+{
+    uint64_t period;
+    uint64_t warmup;
+    uint64_t length;
+};
+
+enum class InstrumentationKind
+{
+    None,
+    Trace,
+    Profile,
+    Stats,
+    CallGraph,
 };
 
 struct Options
 {
-    std::optional<Range>  range           = std::nullopt;
-    bool                  dumpEachTick    = false;
-    uint32_t              numInstructions = std::numeric_limits<uint32_t>::max();
-    std::filesystem::path filePath {};
+    std::optional<AddressRange> range           = std::nullopt;
+    bool                        dumpEachTick    = false;
+    DumpTriggers                triggers {};
+    uint64_t                    numInstructions = std::numeric_limits<uint64_t>::max();
+    std::optional<uint64_t>     timeLimitMs     = std::nullopt;
+    bool                        detectStuck     = false;
+    bool                        printStats      = false;
+    InstrumentationKind         instrumentation = InstrumentationKind::None;
+    std::filesystem::path       foldedPath {};
+    ProgramOptions              engine {};
+    std::optional<std::string>  socketPath      = std::nullopt;
+    size_t                      numWorkers      = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t                    slice           = SchedulerOptions {}.quantum;
+    MulticoreOptions            multicore {};
+    std::optional<Sweep>        sweep           = std::nullopt;
+    std::optional<Sampling>     sampling        = std::nullopt;
+    uint64_t                    cacheSizeMiB    = 64;
+    std::vector<uint32_t>       stopAddresses {};
+    std::vector<uint32_t>       dumpAddresses {};
+    std::vector<Watch>          watches {};
+    std::vector<Export>         exports {};
+    ByteOrder                   exportByteOrder = ByteOrder::Big;
+    std::filesystem::path       filePath {};
 };
 
+AddressRange ParseRange(char const* input)
+{
+    AddressRange range;
+    auto         length   = strlen(input);
+    auto         colonPos = strcspn(input, ":");
+
+    if (length == colonPos)
+        throw std::runtime_error { "Invalid address format" };
+
+    if (!Address::Parse(input, input + colonPos, range.begin))
+        throw std::runtime_error { "Invalid address format" };
+
+    if (!Address::Parse(input + colonPos + 1, input + length, range.end))
+        throw std::runtime_error { "Invalid address format" };
+
+    return range;
+}
+
+uint32_t ParseBreakpoint(char const* input)
+{
+    Address address;
+    if (!Address::Parse(input, input + strlen(input), address))
+        throw std::runtime_error { "Invalid address format" };
+
+    return address;
+}
+
+/// <summary>
+/// Parses a register as <c>rN</c>, a word as an address, or words as an inclusive address range.
+/// </summary>
+SweepField ParseSweepField(char const* input)
+{
+    if (input[0] == 'r')
+    {
+        uint32_t    index;
+        char const* end    = input + strlen(input);
+        auto        result = std::from_chars(input + 1, end, index);
+        if (result.ec != std::errc {} || result.ptr != end || index >= RegisterFileSize)
+            throw std::runtime_error { "Invalid register" };
+
+        return SweepField::MakeRegister(index);
+    }
+
+    if (strchr(input, ':') == nullptr)
+        return SweepField::MakeMemory(Address::MakeFromWord(ParseBreakpoint(input)), 1);
+
+    AddressRange const range = ParseRange(input);
+    if (static_cast<uint32_t>(range.begin) > static_cast<uint32_t>(range.end))
+        throw std::runtime_error { "Invalid address format" };
+
+    uint32_t const numWords = (range.end - range.begin) / 4 + 1;
+    return SweepField::MakeMemory(range.begin, numWords);
+}
+
+uint64_t ParseCount(char const* input)
+{
+    uint64_t rtn;
+
+    auto result = std::from_chars(input, input + strlen(input), rtn);
+    if (result.ec != std::errc {} || *result.ptr != '\0')
+        throw std::runtime_error { "Invalid number of instructions" };
+
+    return rtn;
+}
+
+/// <summary>
+/// Parses the period, the warm-up and the length of sampled simulation as
+/// <c>PERIOD:WARMUP:LENGTH</c>.
+/// </summary>
+Sampling ParseSampling(char const* input)
+{
+    Sampling    rtn;
+    char const* end = input + strlen(input);
+
+    uint64_t* const fields[] = { &rtn.period, &rtn.warmup, &rtn.length };
+    for (size_t i = 0; i < std::size(fields); ++i)
+    {
+        auto       result      = std::from_chars(input, end, *fields[i]);
+        bool const isLast      = i + 1 == std::size(fields);
+        bool const isDelimited =
+            isLast ? result.ptr == end : result.ptr != end && *result.ptr == ':';
+        if (result.ec != std::errc {} || !isDelimited)
+            throw std::runtime_error { "Invalid sampling: expected PERIOD:WARMUP:LENGTH" };
+
+        input = result.ptr + 1;
+    }
+    if (rtn.period == 0 || rtn.length == 0)
+        throw std::runtime_error { "The sampling period and length must be positive" };
+
+    return rtn;
+}
+
 Options ParseCommandArgs(int argc, char* argv[])
 {
     bool filePathGiven = false;
 
+    std::vector<SweepField> sweepInputs;
+    std::vector<SweepField> sweepOutputs;
+
     Options options;
     for (int i = 1; i < argc; ++i)
     {
@@ -38,39 +203,216 @@ Options ParseCommandArgs(int argc, char* argv[])
             if (i == argc - 1)
                 throw std::runtime_error { "Missing addresses after '-m'" };
 
-            char const* input = argv[++i];
+            options.range = ParseRange(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-d") == 0)
+        {
+            if (options.dumpEachTick)
+                throw std::runtime_error { "Duplicate option: '-d'" };
+            options.dumpEachTick = true;
+        }
+        else if (strcmp(argv[i], "-x") == 0)
+        {
+            if (i >= argc - 2)
+                throw std::runtime_error { "Missing addresses or file after '-x'" };
 
-            Range range;
-            auto  length   = strlen(input);
-            auto  colonPos = strcspn(input, ":");
+            AddressRange range = ParseRange(argv[++i]);
+            options.exports.push_back(Export { range, range.begin.base, argv[++i] });
+        }
+        else if (strcmp(argv[i], "-X") == 0)
+        {
+            if (i >= argc - 2)
+                throw std::runtime_error { "Missing segment or file after '-X'" };
 
-            if (length == colonPos)
-                throw std::runtime_error { "Invalid address format" };
+            char const*       segment = argv[++i];
+            Address::BaseType base;
+            if (strcmp(segment, "text") == 0)
+                base = Address::BaseType::Text;
+            else if (strcmp(segment, "data") == 0)
+                base = Address::BaseType::Data;
+            else
+                throw std::runtime_error { "Invalid segment: expected 'text' or 'data'" };
 
-            if (!Address::Parse(input, input + colonPos, range.begin))
-                throw std::runtime_error { "Invalid address format" };
+            options.exports.push_back(Export { std::nullopt, base, argv[++i] });
+        }
+        else if (strcmp(argv[i], "-H") == 0)
+        {
+            options.exportByteOrder = GetHostByteOrder();
+        }
+        else if (strcmp(argv[i], "-e") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing number of instructions after '-e'" };
 
-            if (!Address::Parse(input + colonPos + 1, input + length, range.end))
-                throw std::runtime_error { "Invalid address format" };
+            options.triggers.every = ParseCount(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing addresses after '-r'" };
 
-            options.range = range;
+            options.triggers.pcRange = ParseRange(argv[++i]);
         }
-        else if (strcmp(argv[i], "-d") == 0)
+        else if (strcmp(argv[i], "-c") == 0)
         {
-            if (options.dumpEachTick)
-                throw std::runtime_error { "Duplicate option: '-d'" };
-            options.dumpEachTick = true;
+            options.triggers.onChange = true;
+        }
+        else if (strcmp(argv[i], "-f") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing number of instructions after '-f'" };
+
+            options.triggers.first = ParseCount(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing number of instructions after '-l'" };
+
+            options.triggers.last = ParseCount(argv[++i]);
         }
         else if (strcmp(argv[i], "-n") == 0)
         {
             if (i == argc - 1)
                 throw std::runtime_error { "Missing number of instructions after '-n'" };
 
-            char const* input = argv[++i];
+            options.numInstructions = ParseCount(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing milliseconds after '-t'" };
+
+            options.timeLimitMs = ParseCount(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            options.detectStuck = true;
+        }
+        else if (strcmp(argv[i], "-F") == 0)
+        {
+            options.engine.fastForwardLoops = true;
+        }
+        else if (strcmp(argv[i], "-U") == 0)
+        {
+            options.engine.unchecked = true;
+        }
+        else if (strcmp(argv[i], "-S") == 0)
+        {
+            options.printStats = true;
+        }
+        else if (strcmp(argv[i], "--instrument") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing kind after '--instrument'" };
+
+            ++i;
+            if (strcmp(argv[i], "trace") == 0)
+                options.instrumentation = InstrumentationKind::Trace;
+            else if (strcmp(argv[i], "profile") == 0)
+                options.instrumentation = InstrumentationKind::Profile;
+            else if (strcmp(argv[i], "stats") == 0)
+                options.instrumentation = InstrumentationKind::Stats;
+            else
+                throw std::runtime_error { "Invalid instrumentation: expected 'trace', 'profile' "
+                                           "or 'stats'" };
+        }
+        else if (strcmp(argv[i], "--folded") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing file after '--folded'" };
+
+            options.instrumentation = InstrumentationKind::CallGraph;
+            options.foldedPath      = argv[++i];
+        }
+        else if (strcmp(argv[i], "--serve") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing socket path after '--serve'" };
+
+            options.socketPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--workers") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing number of workers after '--workers'" };
+
+            options.numWorkers = std::max<uint64_t>(ParseCount(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "--slice") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing number of instructions after '--slice'" };
+
+            options.slice = std::max<uint64_t>(ParseCount(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "--cache") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing cache size after '--cache'" };
+
+            options.cacheSizeMiB = ParseCount(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cores") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing number of cores after '--cores'" };
+
+            options.multicore.numCores = std::max<uint64_t>(ParseCount(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "--quantum") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing number of instructions after '--quantum'" };
 
-            auto result = std::from_chars(input, input + strlen(input), options.numInstructions);
-            if (result.ec != std::errc {})
-                throw std::runtime_error { "Invalid number of instructions" };
+            options.multicore.quantum = ParseCount(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sweep") == 0)
+        {
+            if (i >= argc - 2)
+                throw std::runtime_error { "Missing input or result file after '--sweep'" };
+
+            std::filesystem::path const inputPath = argv[++i];
+            options.sweep.emplace(Sweep { inputPath, argv[++i] });
+        }
+        else if (strcmp(argv[i], "--sample") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing sampling after '--sample'" };
+
+            options.sampling = ParseSampling(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--in") == 0 || strcmp(argv[i], "--out") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { std::string { "Missing field after '" } + argv[i]
+                                           + "'" };
+
+            bool const isInput = argv[i][2] == 'i';
+            (isInput ? sweepInputs : sweepOutputs).push_back(ParseSweepField(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing address after '-b'" };
+
+            options.stopAddresses.push_back(ParseBreakpoint(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-p") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { "Missing address after '-p'" };
+
+            options.dumpAddresses.push_back(ParseBreakpoint(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "-W") == 0)
+        {
+            if (i == argc - 1)
+                throw std::runtime_error { std::string { "Missing addresses after '" } + argv[i]
+                                           + "'" };
+
+            WatchAction action = argv[i][1] == 'W' ? WatchAction::Stop : WatchAction::Resume;
+            options.watches.push_back(Watch { ParseRange(argv[++i]), action });
         }
         else
         {
@@ -81,9 +423,56 @@ Options ParseCommandArgs(int argc, char* argv[])
         }
     }
 
-    if (!filePathGiven)
+    if (!filePathGiven && !options.socketPath)
         throw std::runtime_error { "No file is given" };
 
+    if (options.dumpEachTick)
+        options.triggers.every = 1;
+
+    // Watchpoints take over process-wide signal handlers and catch the stores of the main thread
+    // only.
+    if (!options.watches.empty()
+        && (options.sweep || options.multicore.numCores > 1 || options.socketPath))
+        throw std::runtime_error { "Watchpoints watch a single memory on the main thread and "
+                                   "cannot be used with '--sweep', '--cores' or '--serve'" };
+
+    if (options.sweep)
+    {
+        if (sweepInputs.empty())
+            throw std::runtime_error { "A sweep needs at least one '--in'" };
+        if (options.multicore.numCores > 1 || options.triggers.IsEnabled()
+            || !options.stopAddresses.empty() || !options.dumpAddresses.empty()
+            || !options.exports.empty())
+            throw std::runtime_error { "Dumps, breakpoints, exports and cores cannot be used with "
+                                       "'--sweep'" };
+
+        options.sweep->inputs  = std::move(sweepInputs);
+        options.sweep->outputs = std::move(sweepOutputs);
+    }
+    else if (!sweepInputs.empty() || !sweepOutputs.empty())
+    {
+        throw std::runtime_error { "'--in' and '--out' need '--sweep'" };
+    }
+
+    // The cores run on their own, so nothing can stop them in between.
+    if (options.multicore.numCores > 1
+        && (options.triggers.IsEnabled() || options.detectStuck || !options.stopAddresses.empty()
+            || !options.dumpAddresses.empty()))
+        throw std::runtime_error { "Dumps, breakpoints and '-s' need a single core" };
+
+    if (options.instrumentation != InstrumentationKind::None
+        && (options.multicore.numCores > 1 || options.sweep))
+        throw std::runtime_error { "'--instrument' and '--folded' need a single core and cannot "
+                                   "be used with '--sweep'" };
+
+    // Samples run on their own threads, so nothing else can look at them on the way.
+    if (options.sampling
+        && (options.multicore.numCores > 1 || options.sweep || options.triggers.IsEnabled()
+            || !options.stopAddresses.empty() || !options.dumpAddresses.empty()
+            || !options.watches.empty() || options.instrumentation != InstrumentationKind::None))
+        throw std::runtime_error { "Dumps, breakpoints, watchpoints, instrumentation, cores and "
+                                   "'--sweep' cannot be used with '--sample'" };
+
     return options;
 }
 
@@ -139,6 +528,357 @@ void DumpMemory(Memory const& memory, Options const& options, std::ostream& stre
     }
 }
 
+void DumpWatchpointHits(Watchpoints const& watchpoints, std::ostream& stream)
+{
+    std::ios_base::fmtflags flags = stream.flags();
+
+    for (WatchpointHit const& hit : watchpoints.GetHits())
+    {
+        stream << "Watchpoint hit at PC 0x" << std::hex << hit.pc << ": "
+               << Address::MakeFromWord(hit.address) << ": 0x" << hit.oldValue << " -> 0x"
+               << hit.newValue << '\n';
+    }
+    if (watchpoints.GetNumDroppedHits() > 0)
+        stream << std::dec << watchpoints.GetNumDroppedHits() << " more hits are not shown\n";
+    if (!watchpoints.GetHits().empty())
+        stream << '\n';
+
+    stream.flags(flags);
+}
+
+void WriteExports(Memory const& memory, Options const& options)
+{
+    for (Export const& target : options.exports)
+    {
+        ByteOrder const               order = options.exportByteOrder;
+        std::optional<FileWriteError> error;
+        if (target.range)
+            error =
+                ExportMemory(target.path, memory, target.range->begin, target.range->end, order);
+        else
+            error = ExportSegment(target.path, memory, target.base, order);
+
+        if (error)
+        {
+            throw std::runtime_error { error->type == FileWriteError::Type::InvalidRange
+                                           ? "Invalid export range"
+                                           : "Cannot write the exported memory" };
+        }
+    }
+}
+
+/// <summary>
+/// Prints the stats and the stop reason, and returns the exit code.
+/// </summary>
+int Finish(Options const& options,
+           TickResult     stopReason,
+           uint64_t       numInstructions,
+           uint64_t       numFastForwarded)
+{
+    if (options.printStats)
+    {
+        std::cerr << "Retired instructions: " << numInstructions << '\n'
+                  << "Fast-forwarded instructions: " << numFastForwarded << '\n';
+    }
+
+    if (stopReason == TickResult::TimeLimitExceeded)
+    {
+        std::cerr << "Stopped: the time limit is exceeded\n";
+        return 2;
+    }
+    if (stopReason == TickResult::Stuck)
+    {
+        std::cerr << "Stopped: the program is stuck in an infinite loop\n";
+        return 3;
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Runs the program on <c>options.multicore.numCores</c> cores and dumps the registers of each
+/// core followed by the shared memory.
+/// </summary>
+int RunMulticore(Memory const& memory, Options const& options, RunLimits const& limits)
+{
+    Multicore multicore { memory, options.multicore, options.engine };
+
+    RunLimits coreLimits       = limits;
+    coreLimits.maxInstructions = options.numInstructions;
+
+    TickResult stopReason       = TickResult::Success;
+    uint64_t   numInstructions  = 0;
+    uint64_t   numFastForwarded = 0;
+    for (RunResult const& result : multicore.Run(coreLimits))
+    {
+        if (result.result == TickResult::TimeLimitExceeded)
+            stopReason = result.result;
+        numInstructions += result.numInstructions;
+        numFastForwarded += result.numFastForwarded;
+    }
+    limits.syscallHost->Flush();
+
+    for (size_t i = 0; i < multicore.GetNumCores(); ++i)
+    {
+        std::cout << "Core " << i << ":\n";
+        multicore.GetCore(i).DumpRegisters(std::cout);
+        std::cout << '\n';
+    }
+    if (options.range)
+    {
+        multicore.GetCore(0).DumpMemory(std::cout, options.range->begin, options.range->end);
+        std::cout << '\n';
+    }
+
+    WriteExports(multicore.GetCore(0), options);
+    return Finish(options, stopReason, numInstructions, numFastForwarded);
+}
+
+/// <summary>
+/// Runs the program once for each input of the sweep and writes the result file.
+/// </summary>
+int RunSweepMode(Memory memory, Options const& options)
+{
+    Sweep const& sweep = *options.sweep;
+
+    SweepInputsReadResult read =
+        ReadSweepInputs(sweep.inputPath, GetSweepWidth(sweep.inputs), options.exportByteOrder);
+    if (CannotRead const* error = std::get_if<CannotRead>(&read))
+    {
+        throw std::runtime_error { error->error.type == FileReadError::Type::FileDoesNotExist
+                                       ? "Cannot read the sweep inputs"
+                                       : "The size of the sweep inputs does not match '--in'" };
+    }
+
+    SweepOptions sweepOptions;
+    sweepOptions.inputs                 = sweep.inputs;
+    sweepOptions.outputs                = sweep.outputs;
+    sweepOptions.numWorkers             = options.numWorkers;
+    sweepOptions.limits.maxInstructions = options.numInstructions;
+
+    StuckDetector detector;
+    if (options.detectStuck)
+        sweepOptions.limits.stuckDetector = &detector;
+    if (options.timeLimitMs)
+    {
+        std::chrono::milliseconds const timeLimit { *options.timeLimitMs };
+        sweepOptions.limits.deadline = std::chrono::steady_clock::now() + timeLimit;
+    }
+
+    ProgramImage const image { std::move(memory), options.engine };
+    SweepResult const  result =
+        RunSweep(image, std::get<std::vector<uint32_t>>(read), sweepOptions);
+    if (WriteSweepResult(sweep.resultPath, result, options.exportByteOrder))
+        throw std::runtime_error { "Cannot write the sweep result" };
+
+    // Runs past the deadline all stop at once; stuck runs are only reported in the result.
+    auto const     reasonsBegin = result.columns.begin();
+    auto const     reasonsEnd   = reasonsBegin + static_cast<ptrdiff_t>(result.numInputs);
+    uint32_t const timeLimit    = static_cast<uint32_t>(TickResult::TimeLimitExceeded);
+    bool const     timedOut = std::find(reasonsBegin, reasonsEnd, timeLimit) != reasonsEnd;
+    return Finish(options,
+                  timedOut ? TickResult::TimeLimitExceeded : TickResult::Success,
+                  result.numInstructions,
+                  0);
+}
+
+void WriteFolded(CallGraphPolicy const& policy, std::filesystem::path const& path)
+{
+    std::ofstream ofs { path, std::ios::trunc };
+    policy.WriteFolded(ofs);
+    if (!ofs)
+        throw std::runtime_error { "Cannot write the folded call stacks" };
+}
+
+/// <summary>
+/// Prints why the program cannot run unchecked, if it fails validation.
+/// </summary>
+void ReportValidationErrors(Program const& program)
+{
+    std::ios_base::fmtflags flags = std::cerr.flags();
+
+    for (ValidationError const& error : program.GetValidationErrors())
+    {
+        std::cerr << (error.type == ValidationError::Type::InvalidInstruction
+                          ? "Invalid instruction at 0x"
+                          : "Branch target out of the text segment at 0x")
+                  << std::hex << error.address << '\n';
+    }
+    if (!program.GetValidationErrors().empty())
+        std::cerr << "The program fails validation and runs with all checks\n";
+
+    std::cerr.flags(flags);
+}
+
+/// <summary>
+/// Runs the program with sampled detailed simulation, prints the estimates to stderr and dumps the
+/// final state as a plain run does.
+/// </summary>
+int RunSampledMode(Memory& memory, Options const& options, RunLimits const& limits)
+{
+    Program const program { memory, options.engine };
+    if (options.engine.unchecked)
+        ReportValidationErrors(program);
+
+    SamplingOptions sampling;
+    sampling.period                 = options.sampling->period;
+    sampling.warmup                 = options.sampling->warmup;
+    sampling.length                 = options.sampling->length;
+    sampling.numWorkers             = options.numWorkers;
+    sampling.limits                 = limits;
+    sampling.limits.maxInstructions = options.numInstructions;
+
+    SamplingResult const result = RunSampled(memory, program, sampling);
+    limits.syscallHost->Flush();
+
+    PrintEstimates(std::cerr, result);
+    DumpMemory(memory, options, std::cout);
+
+    WriteExports(memory, options);
+    return Finish(options,
+                  result.run.result,
+                  result.run.numInstructions,
+                  result.run.numFastForwarded);
+}
+
+/// <summary>
+/// Runs one instruction with the given policy and services it if it is a system call.
+/// </summary>
+template <typename Policy>
+TickResult Step(Memory& memory, RunLimits const& limits, Policy& policy)
+{
+    uint32_t const pc  = memory.GetRegister(Memory::PC);
+    TickResult     rtn = Tick(memory, policy);
+    if (rtn == TickResult::Syscall)
+    {
+        rtn = ServiceSyscall(memory, limits);
+        if constexpr (Policy::IsEnabled)
+        {
+            if (rtn == TickResult::Success)
+                policy.OnRetire(pc, Decode(memory.GetWord(Address::MakeFromWord(pc))));
+        }
+    }
+
+    return rtn;
+}
+
+/// <summary>
+/// Runs the program on one core with the given instrumentation policy, dumping on the way as the
+/// options say, and prints the report of the policy to stderr. Returns the stop reason and the
+/// number of retired instructions.
+/// </summary>
+template <typename Policy>
+RunResult RunSingleCore(Memory&        memory,
+                        Options const& options,
+                        RunLimits&     limits,
+                        SyscallHost&   host,
+                        Watchpoints&   watchpoints,
+                        Policy&        policy)
+{
+    TickResult stopReason       = TickResult::Success;
+    uint64_t   numInstructions  = 0;
+    uint64_t   numFastForwarded = 0;
+    if (options.triggers.IsEnabled())
+    {
+        DumpSampler sampler { options.triggers, options.range, memory };
+        TraceWriter writer { std::cout, options.range, memory };
+
+        // The writer owns stdout until it is closed, so the program prints into a string of its
+        // own until then.
+        std::ostringstream output;
+        SyscallHost        buffered { output, std::cin };
+        RunLimits          tracedLimits = limits;
+        tracedLimits.syscallHost        = &buffered;
+
+        auto const& stops = options.stopAddresses;
+        auto const& dumps = options.dumpAddresses;
+        for (uint64_t i = 0; i < options.numInstructions && !memory.IsTerminated(); ++i)
+        {
+            if (i % limits.checkInterval == 0)
+            {
+                stopReason = CheckLimits(memory, tracedLimits);
+                if (stopReason != TickResult::Success)
+                    break;
+            }
+
+            uint32_t const pc = memory.GetRegister(Memory::PC);
+            if (std::find(stops.begin(), stops.end(), pc) != stops.end())
+                break;
+            if (std::find(dumps.begin(), dumps.end(), pc) != dumps.end())
+                writer.Dump(memory);
+
+            if (Step(memory, tracedLimits, policy) != TickResult::Success)
+                break;
+            ++numInstructions;
+            if (watchpoints.IsStopped())
+                break;
+            if (sampler.OnTick(memory))
+                writer.Dump(memory);
+        }
+
+        // The trace is written on another thread, so the output of the program follows it.
+        writer.Close();
+        buffered.Flush();
+        host.Flush();
+        std::cout << output.str();
+        sampler.DumpLast(std::cout);
+    }
+    else
+    {
+        Program program { memory, options.engine };
+        if (options.engine.unchecked)
+            ReportValidationErrors(program);
+        for (uint32_t address : options.stopAddresses)
+            if (!program.SetBreakpoint(address))
+                throw std::runtime_error { "Invalid breakpoint address" };
+        for (uint32_t address : options.dumpAddresses)
+            if (!program.SetBreakpoint(address))
+                throw std::runtime_error { "Invalid breakpoint address" };
+
+        auto const& stops     = options.stopAddresses;
+        uint64_t    remaining = options.numInstructions;
+        while (true)
+        {
+            limits.maxInstructions = remaining;
+            RunResult result       = RunProgram(memory, program, limits, policy);
+            remaining -= result.numInstructions;
+            numInstructions += result.numInstructions;
+            numFastForwarded += result.numFastForwarded;
+            if (result.result == TickResult::TimeLimitExceeded
+                || result.result == TickResult::Stuck)
+                stopReason = result.result;
+            if (result.result != TickResult::BreakpointHit || watchpoints.IsStopped())
+                break;
+
+            uint32_t const pc = memory.GetRegister(Memory::PC);
+            if (std::find(stops.begin(), stops.end(), pc) != stops.end())
+                break;
+
+            // Dump at the breakpoint and step over it
+            host.Flush();
+            DumpMemory(memory, options, std::cout);
+            if (remaining == 0)
+                break;
+
+            if (Step(memory, limits, policy) != TickResult::Success)
+                break;
+            --remaining;
+            ++numInstructions;
+        }
+    }
+
+    if constexpr (std::is_same_v<Policy, ProfilingPolicy>)
+        policy.Print(std::cerr, memory, 20);
+    else if constexpr (std::is_same_v<Policy, StatsPolicy>)
+        policy.Print(std::cerr);
+    else if constexpr (std::is_same_v<Policy, CallGraphPolicy>)
+        WriteFolded(policy, options.foldedPath);
+    else if constexpr (Policy::IsEnabled)
+        std::clog.flush();
+
+    return RunResult { stopReason, numInstructions, numFastForwarded };
+}
+
 int main(int argc, char* argv[])
 {
     try
@@ -146,20 +886,91 @@ int main(int argc, char* argv[])
         std::ios::sync_with_stdio(false);
 
         Options options = ParseCommandArgs(argc, argv);
-        Memory  memory  = LoadMemory(options);
+        if (options.socketPath)
+        {
+            // Each job gives its own program, limits and ranges; only the engine options and the
+            // time slice of the scheduler apply.
+            Server server { *options.socketPath,
+                            options.numWorkers,
+                            options.engine,
+                            static_cast<size_t>(options.cacheSizeMiB) << 20,
+                            options.slice };
+            if (!Server::IsSupported())
+                throw std::runtime_error { "Server mode is not supported on this platform" };
+            if (!server.Listen())
+                throw std::runtime_error { "Cannot listen on the socket" };
+
+            server.Serve();
+            return 0;
+        }
+
+        Memory memory = LoadMemory(options);
+        if (options.sweep)
+            return RunSweepMode(std::move(memory), options);
 
-        TickResult result = TickResult::Success;
-        for (uint32_t i = 0; i < options.numInstructions && !memory.IsTerminated(); ++i)
+        Watchpoints watchpoints { memory };
+        if (!options.watches.empty() && !Watchpoints::IsSupported())
+            throw std::runtime_error { "Watchpoints are not supported on this platform" };
+        for (Watch const& watch : options.watches)
+            if (!watchpoints.Watch(watch.range.begin, watch.range.end, watch.action))
+                throw std::runtime_error { "Invalid watchpoint range" };
+
+        // Output of the program goes to stdout ahead of the dumps taken after it.
+        SyscallHost   host { std::cout, std::cin };
+        StuckDetector detector;
+        RunLimits     limits;
+        limits.syscallHost = &host;
+        if (options.timeLimitMs)
         {
-            result = Tick(memory);
-            if (result != TickResult::Success)
+            std::chrono::milliseconds const timeLimit { *options.timeLimitMs };
+            limits.deadline = std::chrono::steady_clock::now() + timeLimit;
+        }
+        if (options.detectStuck)
+            limits.stuckDetector = &detector;
+        if (options.multicore.numCores > 1)
+            return RunMulticore(memory, options, limits);
+        if (options.sampling)
+            return RunSampledMode(memory, options, limits);
+
+        // The engine is instantiated for each policy, so an uninstrumented run pays nothing.
+        using Policy = std::variant<NoInstrumentation,
+                                    TracingPolicy,
+                                    ProfilingPolicy,
+                                    StatsPolicy,
+                                    CallGraphPolicy>;
+
+        Policy instrumentation;
+        switch (options.instrumentation)
+        {
+            case InstrumentationKind::None: break;
+            case InstrumentationKind::Trace:
+            {
+                // The trace goes to buffered stderr, apart from the output of the program.
+                instrumentation.emplace<TracingPolicy>(std::clog);
                 break;
-            if (options.dumpEachTick)
-                DumpMemory(memory, options, std::cout);
+            }
+            case InstrumentationKind::Profile: instrumentation.emplace<ProfilingPolicy>(); break;
+            case InstrumentationKind::Stats: instrumentation.emplace<StatsPolicy>(); break;
+            case InstrumentationKind::CallGraph: instrumentation.emplace<CallGraphPolicy>(); break;
         }
 
+        RunResult const result = std::visit(
+            [&](auto& policy) {
+                return RunSingleCore(memory, options, limits, host, watchpoints, policy);
+            },
+            instrumentation);
+
+        host.Flush();
+
+        // Watchpoints stop with the PC past the text segment; show where the emulation stopped.
+        watchpoints.Resume();
+        watchpoints.Clear();
+        DumpWatchpointHits(watchpoints, std::cout);
+
         DumpMemory(memory, options, std::cout);
-        return 0;
+
+        WriteExports(memory, options);
+        return Finish(options, result.result, result.numInstructions, result.numFastForwarded);
     }
     catch (std::exception const& ex)
     {
@@ -5,6 +5,266 @@
 #include <simple-mips-emu/Memory.hh>
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define SIMPLE_MIPS_EMU_USE_SSE2
+#endif
+
+namespace
+{
+
+/// <summary>
+/// Returns a text version which no memory has had before.
+/// </summary>
+uint64_t NextTextVersion() noexcept
+{
+    static std::atomic<uint64_t> lastVersion { 0 };
+    return lastVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+/// <summary>
+/// Returns the host representation of the big-endian bytes of the given word.
+/// </summary>
+uint32_t ToStored(uint32_t word) noexcept
+{
+    uint8_t bytes[4];
+    bytes[0] = static_cast<uint8_t>(word >> 24 & 0xFF);
+    bytes[1] = static_cast<uint8_t>(word >> 16 & 0xFF);
+    bytes[2] = static_cast<uint8_t>(word >> 8 & 0xFF);
+    bytes[3] = static_cast<uint8_t>(word >> 0 & 0xFF);
+
+    uint32_t rtn;
+    std::memcpy(&rtn, bytes, sizeof(rtn));
+    return rtn;
+}
+
+uint32_t FromStored(uint32_t stored) noexcept
+{
+    uint8_t bytes[4];
+    std::memcpy(bytes, &stored, sizeof(bytes));
+    return static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16
+           | static_cast<uint32_t>(bytes[2]) << 8 | static_cast<uint32_t>(bytes[3]);
+}
+
+// Segments are page-aligned, so the bytes of an aligned word can be accessed as one host word.
+
+uint32_t LoadAtomically(uint8_t const* bytes) noexcept
+{
+#if defined(_MSC_VER)
+    return static_cast<uint32_t>(*reinterpret_cast<long const volatile*>(bytes));
+#else
+    return __atomic_load_n(reinterpret_cast<uint32_t const*>(bytes), __ATOMIC_ACQUIRE);
+#endif
+}
+
+bool CompareExchange(uint8_t* bytes, uint32_t expected, uint32_t desired) noexcept
+{
+#if defined(_MSC_VER)
+    long const previous = _InterlockedCompareExchange(reinterpret_cast<long volatile*>(bytes),
+                                                      static_cast<long>(desired),
+                                                      static_cast<long>(expected));
+    return static_cast<uint32_t>(previous) == expected;
+#else
+    return __atomic_compare_exchange_n(reinterpret_cast<uint32_t*>(bytes),
+                                       &expected,
+                                       desired,
+                                       false,
+                                       __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE);
+#endif
+}
+
+// The bytes of a shared data segment are accessed with relaxed atomics, so that the loads and
+// stores of one core do not race with those of the others or with CompareExchange. An aligned
+// word or half is accessed as a whole, anything else byte by byte.
+
+template <typename T>
+T LoadRelaxed(uint8_t const* bytes) noexcept
+{
+#if defined(_MSC_VER)
+    return *reinterpret_cast<T const volatile*>(bytes);
+#else
+    return __atomic_load_n(reinterpret_cast<T const*>(bytes), __ATOMIC_RELAXED);
+#endif
+}
+
+template <typename T>
+void StoreRelaxed(uint8_t* bytes, T value) noexcept
+{
+#if defined(_MSC_VER)
+    *reinterpret_cast<T volatile*>(bytes) = value;
+#else
+    __atomic_store_n(reinterpret_cast<T*>(bytes), value, __ATOMIC_RELAXED);
+#endif
+}
+
+/// <summary>
+/// Copies <c>size</c> bytes of a shared segment to <c>destination</c> and returns it.
+/// </summary>
+uint8_t const* LoadShared(uint8_t* destination, uint8_t const* source, size_t size) noexcept
+{
+    auto const alignment = reinterpret_cast<uintptr_t>(source) % size;
+    if (size == 4 && alignment == 0)
+    {
+        uint32_t const word = LoadRelaxed<uint32_t>(source);
+        std::memcpy(destination, &word, sizeof(word));
+    }
+    else if (size == 2 && alignment == 0)
+    {
+        uint16_t const half = LoadRelaxed<uint16_t>(source);
+        std::memcpy(destination, &half, sizeof(half));
+    }
+    else
+        for (size_t i = 0; i < size; ++i) destination[i] = LoadRelaxed<uint8_t>(source + i);
+
+    return destination;
+}
+
+/// <summary>
+/// Copies <c>size</c> bytes to a shared segment.
+/// </summary>
+void StoreShared(uint8_t* destination, uint8_t const* source, size_t size) noexcept
+{
+    auto const alignment = reinterpret_cast<uintptr_t>(destination) % size;
+    if (size == 4 && alignment == 0)
+    {
+        uint32_t word;
+        std::memcpy(&word, source, sizeof(word));
+        StoreRelaxed(destination, word);
+    }
+    else if (size == 2 && alignment == 0)
+    {
+        uint16_t half;
+        std::memcpy(&half, source, sizeof(half));
+        StoreRelaxed(destination, half);
+    }
+    else
+        for (size_t i = 0; i < size; ++i) StoreRelaxed(destination + i, source[i]);
+}
+
+uint64_t Combine(uint64_t hash, uint64_t value) noexcept
+{
+    hash = (hash ^ value) * 0x9E3779B97F4A7C15;
+    return hash ^ hash >> 29;
+}
+
+/// <summary>
+/// Adds the word at the given address to the differences, extending the last range if the word
+/// follows it.
+/// </summary>
+void AddDifference(std::vector<AddressRange>& ranges, Address address)
+{
+    if (!ranges.empty() && ranges.back().end.base == address.base
+        && ranges.back().end.offset + 4 == address.offset)
+        ranges.back().end = address;
+    else
+        ranges.push_back(AddressRange { address, address });
+}
+
+/// <summary>
+/// Adds the words in [begin, end) which differ between the segments. Both segments have at least
+/// <c>end</c> bytes, and <c>begin</c> and <c>end</c> are multiples of 4.
+/// </summary>
+void CompareWords(uint8_t const*              lhs,
+                  uint8_t const*              rhs,
+                  Address::BaseType           base,
+                  size_t                      begin,
+                  size_t                      end,
+                  std::vector<AddressRange>& ranges)
+{
+    size_t offset = begin;
+
+#ifdef SIMPLE_MIPS_EMU_USE_SSE2
+    // 64 bytes are compared at once, and words are only looked at in blocks which differ.
+    auto const compare = [lhs, rhs](size_t at) {
+        __m128i const l = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lhs + at));
+        __m128i const r = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rhs + at));
+        return _mm_cmpeq_epi32(l, r);
+    };
+
+    for (; offset + 64 <= end; offset += 64)
+    {
+        __m128i const low   = _mm_and_si128(compare(offset), compare(offset + 16));
+        __m128i const high  = _mm_and_si128(compare(offset + 32), compare(offset + 48));
+        __m128i const equal = _mm_and_si128(low, high);
+        if (_mm_movemask_epi8(equal) == 0xFFFF)
+            continue;
+
+        for (size_t i = offset; i < offset + 64; i += 16)
+        {
+            int const mask = _mm_movemask_epi8(compare(i));
+            for (size_t k = 0; k < 4; ++k)
+                if ((mask >> (k * 4) & 0xF) != 0xF)
+                    AddDifference(ranges, Address { base, static_cast<uint32_t>(i + k * 4) });
+        }
+    }
+#endif
+
+    for (; offset < end; offset += 4)
+        if (std::memcmp(lhs + offset, rhs + offset, 4) != 0)
+            AddDifference(ranges, Address { base, static_cast<uint32_t>(offset) });
+}
+
+}
+
+MemoryDiff Diff(Memory const& lhs, Memory const& rhs)
+{
+    MemoryDiff rtn;
+
+    for (uint32_t idx = 0; idx < RegisterFileSize; ++idx)
+        if (lhs._registerFile[idx] != rhs._registerFile[idx])
+            rtn.registers.push_back(idx);
+
+    for (Address::BaseType base : { Address::BaseType::Text, Address::BaseType::Data })
+    {
+        Memory::Segment const& l = lhs.GetSegmentByBase(base);
+        Memory::Segment const& r = rhs.GetSegmentByBase(base);
+
+        // Only whole words are compared, as GetWord reads nothing else.
+        size_t const lhsEnd = l.size() & ~size_t { 3 };
+        size_t const rhsEnd = r.size() & ~size_t { 3 };
+        size_t const end    = std::min(lhsEnd, rhsEnd);
+
+        for (size_t begin = 0; begin < end; begin += PageHashes::PageSize)
+        {
+            size_t const page    = begin >> PageHashes::PageShift;
+            size_t const pageEnd = begin + PageHashes::PageSize;
+
+            // Hashes cover the bytes of the page in the segment, so they only compare pages
+            // which end at the same offset in both segments.
+            if (std::min(pageEnd, l.size()) == std::min(pageEnd, r.size()))
+            {
+                std::optional<uint64_t> const lhsHash = lhs.GetPageHash(base, page);
+                if (lhsHash && lhsHash == rhs.GetPageHash(base, page))
+                    continue;
+            }
+
+            CompareWords(l.data(), r.data(), base, begin, std::min(pageEnd, end), rtn.ranges);
+        }
+
+        // The words past the end of the shorter segment are compared with zero.
+        uint8_t const* const longer = lhsEnd > rhsEnd ? l.data() : r.data();
+        for (size_t offset = end; offset < std::max(lhsEnd, rhsEnd); offset += 4)
+        {
+            uint32_t word;
+            std::memcpy(&word, longer + offset, 4);
+            if (word != 0)
+                AddDifference(rtn.ranges, Address { base, static_cast<uint32_t>(offset) });
+        }
+    }
+
+    return rtn;
+}
 
 bool Address::Parse(char const* begin, char const* end, Address& out) noexcept
 {
@@ -16,17 +276,42 @@ bool Address::Parse(char const* begin, char const* end, Address& out) noexcept
     return true;
 }
 
-std::vector<uint8_t>& Memory::GetSegmentByBase(Address::BaseType base)
+std::optional<uint64_t> Memory::GetPageHash(Address::BaseType base, size_t page) const noexcept
 {
     if (base == Address::BaseType::Text)
+        return _textHashes.GetPageHash(page);
+    else if (IsDataShared())
+        return std::nullopt;
+    else
+        return _dataHashes.GetPageHash(page);
+}
+
+void Memory::MarkWritten(Address address, uint32_t size) noexcept
+{
+    if (address.base == Address::BaseType::Text)
+    {
+        _textVersion = NextTextVersion();
+        _textHashes.MarkWritten(address.offset, size);
+    }
+    else
+        _dataHashes.MarkWritten(address.offset, size);
+}
+
+Memory::Segment& Memory::GetSegmentByBase(Address::BaseType base)
+{
+    if (base == Address::BaseType::Text)
+    {
+        if (_text.IsBorrowed())
+            _text = Segment { std::as_const(_text) };
         return _text;
+    }
     else if (base == Address::BaseType::Data)
         return _data;
     else
         throw std::invalid_argument { "Invalid address" };
 }
 
-std::vector<uint8_t> const& Memory::GetSegmentByBase(Address::BaseType base) const
+Memory::Segment const& Memory::GetSegmentByBase(Address::BaseType base) const
 {
     if (base == Address::BaseType::Text)
         return _text;
@@ -38,26 +323,103 @@ std::vector<uint8_t> const& Memory::GetSegmentByBase(Address::BaseType base) con
 
 Memory::Memory(uint32_t textSize, uint32_t dataSize) :
     _registerFile {},
-    _text(static_cast<size_t>(textSize), 0),
-    _data(static_cast<size_t>(dataSize), 0),
+    _text(static_cast<size_t>(textSize)),
+    _data(static_cast<size_t>(dataSize)),
     _textSize { textSize },
-    _dataSize { dataSize }
+    _dataSize { dataSize },
+    _textVersion { NextTextVersion() },
+    _coreId { 0 },
+    _textHashes { _text.size() },
+    _dataHashes { _data.size() },
+    _linked { false },
+    _linkAddress { 0 },
+    _linkValue { 0 }
 {
     std::fill(std::begin(_registerFile), std::end(_registerFile), 0);
     _registerFile[PC] = Address::MakeText(0);
 }
 
-Memory::Memory(std::vector<uint8_t>&& text, std::vector<uint8_t>&& data) noexcept :
+Memory::Memory(std::vector<uint8_t> const& text, std::vector<uint8_t> const& data) :
     _registerFile {},
-    _text(std::move(text)),
-    _data(std::move(data)),
+    _text(text.data(), text.size()),
+    _data(data.data(), data.size()),
     _textSize { static_cast<uint32_t>(_text.size()) },
-    _dataSize { static_cast<uint32_t>(_data.size()) }
+    _dataSize { static_cast<uint32_t>(_data.size()) },
+    _textVersion { NextTextVersion() },
+    _coreId { 0 },
+    _textHashes { _text.size() },
+    _dataHashes { _data.size() },
+    _linked { false },
+    _linkAddress { 0 },
+    _linkValue { 0 }
 {
     std::fill(std::begin(_registerFile), std::end(_registerFile), 0);
     _registerFile[PC] = Address::MakeText(0);
 }
 
+void Memory::Reset(uint8_t const* text, size_t textSize, uint8_t const* data, size_t dataSize)
+{
+    if (IsDataPinned())
+        throw std::logic_error { "the data segment is pinned" };
+
+    bool const sameText =
+        _text.size() == textSize && std::equal(text, text + textSize, _text.begin());
+    if (!sameText || _text.IsBorrowed())
+        _text.assign(text, text + textSize);
+    if (!sameText)
+    {
+        _textVersion = NextTextVersion();
+        _textHashes.Reset(textSize);
+    }
+    _data.assign(data, data + dataSize);
+    _dataHashes.Reset(dataSize);
+    _textSize = static_cast<uint32_t>(textSize);
+    _dataSize = static_cast<uint32_t>(dataSize);
+    _linked   = false;
+
+    std::fill(std::begin(_registerFile), std::end(_registerFile), 0);
+    _registerFile[PC] = Address::MakeText(0);
+}
+
+void Memory::ResetFrom(Memory const& initial)
+{
+    if (&initial == this)
+        return;
+    if (IsDataPinned())
+        throw std::logic_error { "the data segment is pinned" };
+
+    // The text is only read through the borrowed block; it is copied before it is written to.
+    if (!_text.IsBorrowed() || _text.data() != initial._text.data())
+        _text.Borrow(const_cast<Segment&>(initial._text));
+    _data.assign(initial._data.begin(), initial._data.end());
+    _textSize     = initial._textSize;
+    _dataSize     = initial._dataSize;
+    _textVersion  = initial._textVersion;
+    _registerFile = initial._registerFile;
+    _linked       = false;
+
+    // The copied segments have the hashes of the initial ones.
+    _textHashes = initial._textHashes;
+    if (initial.IsDataShared())
+        _dataHashes.Reset(_dataSize);
+    else
+        _dataHashes = initial._dataHashes;
+}
+
+void Memory::ResizeData(uint32_t dataSize)
+{
+    _data.resize(dataSize);
+    _dataSize = dataSize;
+    _dataHashes.Reset(dataSize);
+}
+
+void Memory::ShareData(Segment& data) noexcept
+{
+    _data.Borrow(data);
+    _dataSize = static_cast<uint32_t>(_data.size());
+    _dataHashes.Reset(_dataSize);
+}
+
 bool Memory::IsTerminated() const noexcept
 {
     return GetRegister(PC) >= static_cast<uint32_t>(Address::MakeText(_textSize));
@@ -72,6 +434,14 @@ void Memory::Load(Address::BaseType base, std::vector<uint8_t> const& data) noex
 {
     auto& segment = GetSegmentByBase(base);
     std::copy_n(data.begin(), std::min(data.size(), segment.size()), segment.begin());
+
+    if (base == Address::BaseType::Text)
+    {
+        _textVersion = NextTextVersion();
+        _textHashes.Reset(segment.size());
+    }
+    else
+        _dataHashes.Reset(segment.size());
 }
 
 uint32_t Memory::GetRegister(uint32_t registerIdx) const
@@ -88,15 +458,52 @@ void Memory::SetRegister(uint32_t registerIdx, uint32_t newValue)
 uint8_t Memory::GetByte(Address address) const noexcept
 {
     auto& segment = GetSegmentByBase(address.base);
-    if (address.offset < segment.size())
+    if (address.offset >= segment.size())
+        return 0;
+    else if (IsShared(segment))
+        return LoadRelaxed<uint8_t>(std::addressof(segment[address.offset]));
+    else
         return segment[address.offset];
+}
+
+void Memory::SetByte(Address address, uint8_t byte)
+{
+    auto& segment = GetSegmentByBase(address.base);
+    if (IsShared(segment))
+        StoreRelaxed(std::addressof(segment.at(address.offset)), byte);
     else
+        segment.at(address.offset) = byte;
+    MarkWritten(address, 1);
+}
+
+uint16_t Memory::GetHalf(Address address) const noexcept
+{
+    auto& segment = GetSegmentByBase(address.base);
+    if (static_cast<size_t>(address.offset) + 1 >= segment.size())
         return 0;
+
+    uint8_t const* ptr = std::addressof(segment[address.offset]);
+    uint8_t        shared[2];
+    if (IsShared(segment))
+        ptr = LoadShared(shared, ptr, sizeof(shared));
+
+    return static_cast<uint16_t>(ptr[0] << 8 | ptr[1]);
 }
 
-void Memory::SetByte(Address address, uint8_t byte)
+void Memory::SetHalf(Address address, uint16_t half)
 {
-    GetSegmentByBase(address.base).at(address.offset) = byte;
+    auto& segment = GetSegmentByBase(address.base);
+    if (static_cast<size_t>(address.offset) + 1 >= segment.size())
+        throw std::out_of_range { "address out of range" };
+
+    uint8_t bytes[2];
+    bytes[0] = static_cast<uint8_t>(half >> 8 & 0xFF);
+    bytes[1] = static_cast<uint8_t>(half >> 0 & 0xFF);
+    if (IsShared(segment))
+        StoreShared(std::addressof(segment[address.offset]), bytes, sizeof(bytes));
+    else
+        std::memcpy(std::addressof(segment[address.offset]), bytes, sizeof(bytes));
+    MarkWritten(address, sizeof(bytes));
 }
 
 uint32_t Memory::GetWord(Address address) const noexcept
@@ -105,9 +512,12 @@ uint32_t Memory::GetWord(Address address) const noexcept
     if (static_cast<size_t>(address.offset) + 3 >= segment.size())
         return 0;
 
-    uint32_t       rtn = 0;
     uint8_t const* ptr = std::addressof(segment[address.offset]);
+    uint8_t        shared[4];
+    if (IsShared(segment))
+        ptr = LoadShared(shared, ptr, sizeof(shared));
 
+    uint32_t rtn = 0;
     rtn |= static_cast<uint32_t>(ptr[0]) << 24;
     rtn |= static_cast<uint32_t>(ptr[1]) << 16;
     rtn |= static_cast<uint32_t>(ptr[2]) << 8;
@@ -119,15 +529,68 @@ uint32_t Memory::GetWord(Address address) const noexcept
 void Memory::SetWord(Address address, uint32_t word)
 {
     auto& segment = GetSegmentByBase(address.base);
-    if (static_cast<size_t>(address.offset) + 3 > segment.size())
+    if (static_cast<size_t>(address.offset) + 3 >= segment.size())
         throw std::out_of_range { "address out of range" };
 
-    uint8_t* ptr = std::addressof(segment[address.offset]);
+    uint8_t bytes[4];
+    bytes[0] = static_cast<uint8_t>(word >> 24 & 0xFF);
+    bytes[1] = static_cast<uint8_t>(word >> 16 & 0xFF);
+    bytes[2] = static_cast<uint8_t>(word >> 8 & 0xFF);
+    bytes[3] = static_cast<uint8_t>(word >> 0 & 0xFF);
+
+    // Write the word with a single store, so that a watchpoint sees the whole word change at once.
+    if (IsShared(segment))
+        StoreShared(std::addressof(segment[address.offset]), bytes, sizeof(bytes));
+    else
+        std::memcpy(std::addressof(segment[address.offset]), bytes, sizeof(bytes));
+    MarkWritten(address, sizeof(bytes));
+}
+
+uint32_t Memory::LoadLinked(Address address) noexcept
+{
+    auto& segment = std::as_const(*this).GetSegmentByBase(address.base);
+
+    _linked = false;
+    if (static_cast<size_t>(address.offset) + 3 >= segment.size())
+        return 0;
 
-    ptr[0] = static_cast<uint8_t>(word >> 24 & 0xFF);
-    ptr[1] = static_cast<uint8_t>(word >> 16 & 0xFF);
-    ptr[2] = static_cast<uint8_t>(word >> 8 & 0xFF);
-    ptr[3] = static_cast<uint8_t>(word >> 0 & 0xFF);
+    uint32_t const rtn = FromStored(LoadAtomically(std::addressof(segment[address.offset])));
+    _linked            = true;
+    _linkAddress       = address;
+    _linkValue         = rtn;
+
+    return rtn;
+}
+
+bool Memory::StoreConditional(Address address, uint32_t word)
+{
+    auto& segment = GetSegmentByBase(address.base);
+    if (static_cast<size_t>(address.offset) + 3 >= segment.size())
+        throw std::out_of_range { "address out of range" };
+
+    if (!std::exchange(_linked, false) || _linkAddress != static_cast<uint32_t>(address))
+        return false;
+    if (!CompareExchange(std::addressof(segment[address.offset]),
+                         ToStored(_linkValue),
+                         ToStored(word)))
+        return false;
+
+    MarkWritten(address, 4);
+    return true;
+}
+
+uint64_t Memory::GetStateHash() const noexcept
+{
+    auto const registers = reinterpret_cast<uint8_t const*>(_registerFile.data());
+
+    uint64_t const dataHash = IsDataShared() ? PageHashes::Compute(_data.data(), _data.size())
+                                             : _dataHashes.Update(_data.data(), _data.size());
+
+    uint64_t rtn = PageHashes::Compute(registers, sizeof(_registerFile));
+    rtn          = Combine(rtn, _textHashes.Update(_text.data(), _text.size()));
+    rtn          = Combine(rtn, dataHash);
+
+    return rtn;
 }
 
 void Memory::DumpRegisters(std::ostream& os) const
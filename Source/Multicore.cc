@@ -0,0 +1,107 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Multicore.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <algorithm>
+#include <thread>
+
+Multicore::Multicore(Memory const&           memory,
+                     MulticoreOptions const& options,
+                     ProgramOptions const&   programOptions) :
+    _data { memory.GetSegmentByBase(Address::BaseType::Data) },
+    _cores {},
+    _program { memory, programOptions },
+    _options { options },
+    _syscallMutex {}
+{
+    // The cores are copies of the memory, so they keep the text version the program is decoded
+    // for.
+    size_t const numCores = std::max<size_t>(options.numCores, 1);
+    _cores.reserve(numCores);
+    for (size_t i = 0; i < numCores; ++i)
+    {
+        Memory& core = _cores.emplace_back(memory);
+        core.SetCoreId(static_cast<uint32_t>(i));
+        core.ShareData(_data);
+    }
+}
+
+bool Multicore::IsTerminated() const noexcept
+{
+    return std::all_of(
+        _cores.begin(), _cores.end(), [](Memory const& core) { return core.IsTerminated(); });
+}
+
+std::vector<RunResult> Multicore::Run(RunLimits const& limits)
+{
+    std::vector<RunResult> rtn(_cores.size(), RunResult { TickResult::Success, 0, 0 });
+
+    if (_options.quantum == 0)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(_cores.size());
+        for (size_t i = 0; i < _cores.size(); ++i)
+            threads.emplace_back([this, &limits, &rtn, i] { rtn[i] = RunCore(_cores[i], limits); });
+        for (std::thread& thread : threads) thread.join();
+
+        return rtn;
+    }
+
+    RunLimits turnLimits = limits;
+    for (bool anyRan = true; anyRan;)
+    {
+        anyRan = false;
+        for (size_t i = 0; i < _cores.size(); ++i)
+        {
+            RunResult& total = rtn[i];
+            if (total.result != TickResult::Success || _cores[i].IsTerminated()
+                || total.numInstructions >= limits.maxInstructions)
+                continue;
+
+            turnLimits.maxInstructions =
+                std::min(_options.quantum, limits.maxInstructions - total.numInstructions);
+            RunResult const result = RunCore(_cores[i], turnLimits);
+            total.result           = result.result;
+            total.numInstructions += result.numInstructions;
+            total.numFastForwarded += result.numFastForwarded;
+            anyRan = true;
+        }
+    }
+
+    return rtn;
+}
+
+RunResult Multicore::RunCore(Memory& core, RunLimits const& limits)
+{
+    // System calls stop the run, so that they are serviced under the lock.
+    RunLimits coreLimits     = limits;
+    coreLimits.stuckDetector = nullptr;
+    coreLimits.syscallHost   = nullptr;
+
+    RunResult rtn { TickResult::Success, 0, 0 };
+    while (rtn.numInstructions < limits.maxInstructions && !core.IsTerminated())
+    {
+        coreLimits.maxInstructions = limits.maxInstructions - rtn.numInstructions;
+        RunResult result           = RunProgram(core, _program, coreLimits);
+        rtn.numInstructions += result.numInstructions;
+        rtn.numFastForwarded += result.numFastForwarded;
+
+        if (result.result == TickResult::Syscall && limits.syscallHost)
+        {
+            std::lock_guard<std::mutex> lock { _syscallMutex };
+
+            result.result = limits.syscallHost->Service(core);
+            if (result.result == TickResult::Success)
+                ++rtn.numInstructions;
+        }
+        if (result.result != TickResult::Success)
+        {
+            rtn.result = result.result;
+            break;
+        }
+    }
+
+    return rtn;
+}
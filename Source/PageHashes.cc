@@ -0,0 +1,104 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/PageHashes.hh>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+constexpr uint64_t Multiplier = 0x9E3779B97F4A7C15;
+
+uint64_t Mix(uint64_t value) noexcept
+{
+    value = (value ^ value >> 30) * 0xBF58476D1CE4E5B9;
+    value = (value ^ value >> 27) * 0x94D049BB133111EB;
+    return value ^ value >> 31;
+}
+
+uint64_t HashBytes(uint8_t const* bytes, size_t size) noexcept
+{
+    uint64_t rtn = 0;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        rtn = (rtn ^ word) * Multiplier;
+        rtn ^= rtn >> 29;
+    }
+    for (; i < size; ++i) rtn = (rtn ^ bytes[i]) * Multiplier;
+
+    return rtn;
+}
+
+/// <summary>
+/// Returns what the given page adds to the hash of its segment. Pages are mixed with their indices
+/// so that swapping two of them changes the sum.
+/// </summary>
+uint64_t GetTerm(size_t page, uint64_t hash) noexcept
+{
+    return Mix(hash ^ (page + 1) * Multiplier);
+}
+
+uint64_t HashPage(uint8_t const* bytes, size_t size, size_t page) noexcept
+{
+    size_t const offset = page << PageHashes::PageShift;
+    return HashBytes(bytes + offset, std::min<size_t>(PageHashes::PageSize, size - offset));
+}
+
+uint64_t Finish(uint64_t root, size_t size) noexcept
+{
+    return Mix(root ^ Mix(size));
+}
+
+}
+
+PageHashes::PageHashes(size_t size) : _hashes {}, _isStale {}, _hasStale { false }, _root { 0 }
+{
+    Reset(size);
+}
+
+void PageHashes::Reset(size_t size)
+{
+    size_t const numPages = (size + PageSize - 1) >> PageShift;
+
+    _hashes.assign(numPages, 0);
+    _isStale.assign(numPages, 1);
+    _hasStale = numPages != 0;
+
+    _root = 0;
+    for (size_t page = 0; page < numPages; ++page) _root += GetTerm(page, 0);
+}
+
+uint64_t PageHashes::Update(uint8_t const* bytes, size_t size) noexcept
+{
+    if (_hasStale)
+    {
+        for (size_t page = 0; page < _hashes.size(); ++page)
+        {
+            if (!_isStale[page])
+                continue;
+
+            uint64_t const hash = HashPage(bytes, size, page);
+            _root += GetTerm(page, hash) - GetTerm(page, _hashes[page]);
+            _hashes[page]  = hash;
+            _isStale[page] = 0;
+        }
+        _hasStale = false;
+    }
+
+    return Finish(_root, size);
+}
+
+uint64_t PageHashes::Compute(uint8_t const* bytes, size_t size) noexcept
+{
+    uint64_t root = 0;
+    for (size_t page = 0; page << PageShift < size; ++page)
+        root += GetTerm(page, HashPage(bytes, size, page));
+
+    return Finish(root, size);
+}
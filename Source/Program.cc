@@ -0,0 +1,296 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Program.hh>
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+
+std::vector<Instruction> DecodeText(Memory const& memory)
+{
+    Memory::Segment const& text = memory.GetSegmentByBase(Address::BaseType::Text);
+
+    std::vector<Instruction> rtn(text.size() / 4);
+    Decode(text.data(), rtn.size(), rtn.data());
+
+    return rtn;
+}
+
+bool IsFused(Operation operation) noexcept
+{
+    return GetNumRetired(operation) > 1;
+}
+
+uint32_t GetAccessSize(Operation operation) noexcept
+{
+    switch (operation)
+    {
+#define SIMPLE_MIPS_EMU_SIZE_CASE(name, size)                                                      \
+    case Operation::name: return size;
+        SIMPLE_MIPS_EMU_PROVEN_ACCESSES(SIMPLE_MIPS_EMU_SIZE_CASE)
+#undef SIMPLE_MIPS_EMU_SIZE_CASE
+        default: return 0;
+    }
+}
+
+/// <summary>
+/// Returns the general-purpose register the given instruction writes, if any.
+/// </summary>
+std::optional<uint32_t> GetWrittenRegister(Instruction const& instruction) noexcept
+{
+    Operation const operation = instruction.operation;
+    switch (GetFormat(operation))
+    {
+        case Format::R:
+        case Format::SV:
+        case Format::SR:
+        case Format::MF: return instruction.rd;
+        case Format::JR:
+            return operation == Operation::JALR ? std::optional<uint32_t> { instruction.rd }
+                                                : std::nullopt;
+        case Format::I:
+        case Format::UI:
+        case Format::II: return instruction.rt;
+        case Format::RI:
+            return operation == Operation::BLTZAL || operation == Operation::BGEZAL
+                       ? std::optional<uint32_t> { Memory::RA }
+                       : std::nullopt;
+        case Format::J:
+            return operation == Operation::JAL ? std::optional<uint32_t> { Memory::RA }
+                                               : std::nullopt;
+        case Format::OI:
+        {
+            bool const isStore = operation == Operation::SB || operation == Operation::SH
+                                 || operation == Operation::SW || operation == Operation::SWL
+                                 || operation == Operation::SWR;
+            return isStore ? std::nullopt : std::optional<uint32_t> { instruction.rt };
+        }
+        default: return std::nullopt;
+    }
+}
+
+}
+
+/// <summary>
+/// Returns the fused operation which starts at <c>_instructions[index]</c>, or the operation of
+/// the instruction itself if no sequence inside the block matches.
+/// </summary>
+Operation Program::Fuse(size_t index) const noexcept
+{
+    Instruction const& first = _instructions[index];
+
+    // Sequences never cross a block boundary or a breakpoint.
+    size_t remaining = 1;
+    while (index + remaining < _instructions.size() && !_graph.IsLeader(index + remaining)
+           && _dispatch[index + remaining] != Operation::Breakpoint)
+        ++remaining;
+
+    if (remaining >= 2)
+    {
+        Instruction const& second = _instructions[index + 1];
+
+        if (first.operation == Operation::LUI && second.operation == Operation::ORI
+            && second.rs == first.rt)
+            return Operation::LUI_ORI;
+
+        if (first.operation == Operation::ADDIU && second.operation == Operation::BNE)
+        {
+            // The branch goes back to the addiu, and compares its register with another one.
+            if (_options.fastForwardLoops && first.rs == first.rt && first.rt != 0
+                && second.immediate == static_cast<uint32_t>(-2)
+                && (second.rs == first.rt) != (second.rt == first.rt))
+                return Operation::ADDIU_BNE_LOOP;
+
+            return Operation::ADDIU_BNE;
+        }
+
+        if (remaining >= 3)
+        {
+            Instruction const& third = _instructions[index + 2];
+
+            if (first.operation == Operation::LW && second.operation == Operation::LW
+                && third.operation == Operation::ADDU)
+                return Operation::LW_LW_ADDU;
+        }
+    }
+
+    if (index < _provenBases.size() && _provenBases[index])
+        return GetProvenOperation(first.operation);
+
+    return first.operation;
+}
+
+/// <summary>
+/// Recomputes the dispatch stream at the given index and the sequences which may cover it.
+/// </summary>
+void Program::UpdateDispatch(size_t index) noexcept
+{
+    size_t const begin = index >= 2 ? index - 2 : 0;
+    for (size_t i = index + 1; i-- > begin;)
+    {
+        if (_dispatch[i] == Operation::Breakpoint)
+            continue;
+
+        Operation const operation = Fuse(i);
+        if (IsFused(_dispatch[i]))
+            --_numFused;
+        if (IsFused(operation))
+            ++_numFused;
+        _dispatch[i] = operation;
+    }
+}
+
+/// <summary>
+/// Records the words which do not decode or branch outside of the text segment.
+/// </summary>
+void Program::Validate()
+{
+    uint32_t const textBase = Address::MakeText(0);
+    uint32_t const textEnd  = Address::MakeText(static_cast<uint32_t>(_instructions.size() * 4));
+
+    for (size_t i = 0; i < _instructions.size(); ++i)
+    {
+        Instruction const& instruction = _instructions[i];
+        uint32_t const     address     = textBase + static_cast<uint32_t>(i * 4);
+
+        using Type = ValidationError::Type;
+
+        uint32_t target;
+        if (instruction.operation == Operation::Invalid)
+            _errors.push_back(ValidationError { Type::InvalidInstruction, address });
+        else if (GetBranchTarget(instruction, address, target)
+                 && (target < textBase || target > textEnd))
+            _errors.push_back(ValidationError { Type::TargetOutOfText, address });
+    }
+}
+
+/// <summary>
+/// Finds the loads and stores whose addresses are constant within their basic blocks and inside
+/// the data segment of the given memory.
+/// </summary>
+void Program::ProveAccesses(Memory const& memory)
+{
+    uint32_t const dataBase = Address::MakeData(0);
+    uint32_t const dataSize = memory.GetDataSize();
+
+    _provenBases.assign(_instructions.size(), std::nullopt);
+
+    // The constant value of each register at the current instruction, if it is known.
+    std::array<std::optional<uint32_t>, NumRegisters> values;
+    for (size_t i = 0; i < _instructions.size(); ++i)
+    {
+        Instruction const& instruction = _instructions[i];
+
+        // Only the instructions of the block are known to have run before this one.
+        if (_graph.IsLeader(i))
+            values.fill(std::nullopt);
+        values[0] = 0;
+
+        std::optional<uint32_t> const base = values[instruction.rs];
+        if (uint32_t const size = GetAccessSize(instruction.operation); size != 0 && base)
+        {
+            uint32_t const address = *base + instruction.immediate;
+            uint64_t const end     = uint64_t { address } - dataBase + size;
+            if (address >= dataBase && end <= dataSize)
+            {
+                _provenBases[i] = base;
+                _provenDataSize = std::max(_provenDataSize, static_cast<uint32_t>(end));
+                ++_numProven;
+            }
+        }
+
+        switch (instruction.operation)
+        {
+            case Operation::LUI: values[instruction.rt] = instruction.immediate << 16; break;
+            case Operation::ORI:
+            case Operation::ADDIU:
+            {
+                std::optional<uint32_t>& value = values[instruction.rt];
+                if (!base)
+                    value = std::nullopt;
+                else if (instruction.operation == Operation::ORI)
+                    value = *base | instruction.immediate;
+                else
+                    value = *base + instruction.immediate;
+                break;
+            }
+            // The host may write any register the call returns in.
+            case Operation::SYSCALL: values.fill(std::nullopt); break;
+            default:
+            {
+                if (std::optional<uint32_t> const written = GetWrittenRegister(instruction))
+                    values[*written] = std::nullopt;
+                break;
+            }
+        }
+    }
+}
+
+Program::Program(Memory const& memory, ProgramOptions const& options) :
+    _instructions { DecodeText(memory) },
+    _dispatch(_instructions.size(), Operation::Invalid),
+    _graph { _instructions.data(), _instructions.size() },
+    _options { options },
+    _numFused { 0 },
+    _textVersion { memory.GetTextVersion() },
+    _errors {},
+    _provenBases {},
+    _numProven { 0 },
+    _provenDataSize { 0 }
+{
+    Validate();
+    if (_options.unchecked && _errors.empty())
+        ProveAccesses(memory);
+
+    // Fused operations are placed only at the first instruction of each sequence; the following
+    // instructions keep their own operations, so a branch landing in the middle of a sequence
+    // still executes the right instructions.
+    for (size_t i = 0; i < _instructions.size(); ++i)
+    {
+        _dispatch[i] = Fuse(i);
+        if (IsFused(_dispatch[i]))
+            ++_numFused;
+    }
+}
+
+bool Program::SetBreakpoint(uint32_t address) noexcept
+{
+    uint32_t const offset = address - Address::MakeText(0);
+    size_t const   index  = offset / 4;
+    if (offset % 4 != 0 || index >= _instructions.size())
+        return false;
+
+    if (IsFused(_dispatch[index]))
+        --_numFused;
+    _dispatch[index] = Operation::Breakpoint;
+
+    // Sequences covering the breakpoint must not skip it.
+    UpdateDispatch(index);
+
+    return true;
+}
+
+bool Program::RemoveBreakpoint(uint32_t address) noexcept
+{
+    if (!HasBreakpoint(address))
+        return false;
+
+    size_t const index = (address - Address::MakeText(0)) / 4;
+    _dispatch[index]   = _instructions[index].operation;
+    UpdateDispatch(index);
+
+    return true;
+}
+
+bool Program::HasBreakpoint(uint32_t address) const noexcept
+{
+    uint32_t const offset = address - Address::MakeText(0);
+    size_t const   index  = offset / 4;
+    if (offset % 4 != 0 || index >= _instructions.size())
+        return false;
+
+    return _dispatch[index] == Operation::Breakpoint;
+}
@@ -0,0 +1,269 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Sampling.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace
+{
+
+struct Checkpoint
+{
+    uint64_t position;
+    Memory   memory;
+};
+
+/// <summary>
+/// Returns the 97.5th percentile of Student's t-distribution with the given degrees of freedom,
+/// which scales the standard error to the half width of a 95% confidence interval.
+/// </summary>
+double GetCriticalValue(size_t degrees) noexcept
+{
+    constexpr double Table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (degrees <= std::size(Table))
+        return Table[degrees - 1];
+
+    // Past the table, the Cornish-Fisher expansion around the normal quantile is within 0.001.
+    constexpr double z = 1.959964;
+    double const     v = static_cast<double>(degrees);
+    return z + (z * z * z + z) / (4 * v)
+           + (5 * std::pow(z, 5) + 16 * z * z * z + 3 * z) / (96 * v * v);
+}
+
+InstrumentationStats Subtract(InstrumentationStats const& lhs,
+                              InstrumentationStats const& rhs) noexcept
+{
+    InstrumentationStats rtn;
+    rtn.numRetired       = lhs.numRetired - rhs.numRetired;
+    rtn.numLoads         = lhs.numLoads - rhs.numLoads;
+    rtn.numStores        = lhs.numStores - rhs.numStores;
+    rtn.numBytesLoaded   = lhs.numBytesLoaded - rhs.numBytesLoaded;
+    rtn.numBytesStored   = lhs.numBytesStored - rhs.numBytesStored;
+    rtn.numBranches      = lhs.numBranches - rhs.numBranches;
+    rtn.numTakenBranches = lhs.numTakenBranches - rhs.numTakenBranches;
+    for (size_t i = 0; i < rtn.numRetiredByOperation.size(); ++i)
+        rtn.numRetiredByOperation[i] = lhs.numRetiredByOperation[i] - rhs.numRetiredByOperation[i];
+
+    return rtn;
+}
+
+SampleResult RunSample(Checkpoint&            checkpoint,
+                       Program const&         program,
+                       SamplingOptions const& options,
+                       RunLimits              limits)
+{
+    // The warm-up goes through the same policy, so that a model with state starts warm; only the
+    // difference of the counters is measured.
+    StatsPolicy policy;
+    limits.maxInstructions = options.warmup;
+    RunResult const warmup = RunProgram(checkpoint.memory, program, limits, policy);
+
+    SampleResult rtn { checkpoint.position, warmup.numInstructions, warmup.result, {} };
+    if (warmup.result != TickResult::Success || checkpoint.memory.IsTerminated())
+        return rtn;
+
+    InstrumentationStats const before = policy.GetStats();
+    limits.maxInstructions            = options.length;
+    rtn.result = RunProgram(checkpoint.memory, program, limits, policy).result;
+    rtn.stats  = Subtract(policy.GetStats(), before);
+
+    return rtn;
+}
+
+}
+
+SamplingResult RunSampled(Memory& memory, Program const& program, SamplingOptions const& options)
+{
+    if (options.period == 0 || options.length == 0)
+        throw std::invalid_argument { "sampling period and length must be positive" };
+
+    // Checkpoints borrow the text of this copy, which does not change while the samples run. The
+    // memory borrows it as well, and copies it only if the program writes to it.
+    Memory const origin = memory;
+    memory.ResetFrom(origin);
+
+    SamplingResult rtn { RunResult { TickResult::Success, 0, 0 }, {} };
+
+    std::mutex              mutex;
+    std::condition_variable changed;
+    std::deque<Checkpoint>  pending;
+    bool                    isDone = false;
+
+    size_t const numWorkers = std::max<size_t>(options.numWorkers, 1);
+    auto         work       = [&]() {
+        std::ostream output { nullptr };
+        std::istream input { nullptr };
+        SyscallHost  host { output, input };
+
+        RunLimits limits;
+        limits.deadline      = options.limits.deadline;
+        limits.syscallHost   = &host;
+        limits.checkInterval = options.limits.checkInterval;
+
+        while (true)
+        {
+            std::optional<Checkpoint> checkpoint;
+            {
+                std::unique_lock<std::mutex> lock { mutex };
+                changed.wait(lock, [&]() { return isDone || !pending.empty(); });
+                if (pending.empty())
+                    return;
+
+                checkpoint.emplace(std::move(pending.front()));
+                pending.pop_front();
+            }
+            changed.notify_all();
+
+            SampleResult const sample = RunSample(*checkpoint, program, options, limits);
+
+            std::lock_guard<std::mutex> lock { mutex };
+            rtn.samples.push_back(sample);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < numWorkers; ++i) workers.emplace_back(work);
+
+    auto const finish = [&]() {
+        {
+            std::lock_guard<std::mutex> lock { mutex };
+            isDone = true;
+        }
+        changed.notify_all();
+        for (std::thread& worker : workers) worker.join();
+
+        // The memory must not refer to the copy past this call.
+        if (memory.GetTextVersion() == origin.GetTextVersion())
+            memory = Memory { memory };
+    };
+
+    try
+    {
+        RunLimits      limits          = options.limits;
+        uint64_t const maxInstructions = options.limits.maxInstructions;
+        while (rtn.run.numInstructions < maxInstructions && !memory.IsTerminated())
+        {
+            Checkpoint checkpoint { rtn.run.numInstructions, Memory { 0, 0 } };
+            if (memory.GetTextVersion() == origin.GetTextVersion())
+                checkpoint.memory.ResetFrom(memory);
+            else
+                checkpoint.memory = memory;
+
+            // At most two checkpoints per worker wait, which bounds the memory they take.
+            {
+                std::unique_lock<std::mutex> lock { mutex };
+                changed.wait(lock, [&]() { return pending.size() < numWorkers * 2; });
+                pending.push_back(std::move(checkpoint));
+            }
+            changed.notify_all();
+
+            limits.maxInstructions =
+                std::min(options.period, maxInstructions - rtn.run.numInstructions);
+            RunResult const result = RunProgram(memory, program, limits);
+            rtn.run.numInstructions += result.numInstructions;
+            rtn.run.numFastForwarded += result.numFastForwarded;
+            rtn.run.result = result.result;
+            if (result.result != TickResult::Success)
+                break;
+        }
+    }
+    catch (...)
+    {
+        finish();
+        throw;
+    }
+    finish();
+
+    std::sort(rtn.samples.begin(),
+              rtn.samples.end(),
+              [](SampleResult const& lhs, SampleResult const& rhs) {
+                  return lhs.position < rhs.position;
+              });
+
+    return rtn;
+}
+
+SampledRate EstimateRate(SamplingResult const& result, uint64_t InstrumentationStats::*counter)
+{
+    std::vector<double> rates;
+    for (SampleResult const& sample : result.samples)
+    {
+        uint64_t const numRetired = sample.stats.numRetired;
+        if (numRetired != 0)
+            rates.push_back(static_cast<double>(sample.stats.*counter) / numRetired);
+    }
+
+    SampledRate rtn { 0, std::numeric_limits<double>::infinity(), rates.size() };
+    if (rates.empty())
+        return rtn;
+
+    double sum = 0;
+    for (double rate : rates) sum += rate;
+    rtn.mean = sum / rates.size();
+    if (rates.size() < 2)
+        return rtn;
+
+    double squares = 0;
+    for (double rate : rates) squares += (rate - rtn.mean) * (rate - rtn.mean);
+    double const variance = squares / (rates.size() - 1);
+    rtn.halfWidth = GetCriticalValue(rates.size() - 1) * std::sqrt(variance / rates.size());
+
+    return rtn;
+}
+
+void PrintEstimates(std::ostream& os, SamplingResult const& result)
+{
+    struct Counter
+    {
+        char const* name;
+        uint64_t InstrumentationStats::*counter;
+    };
+
+    constexpr Counter Counters[] = {
+        { "Loads", &InstrumentationStats::numLoads },
+        { "Stores", &InstrumentationStats::numStores },
+        { "Bytes loaded", &InstrumentationStats::numBytesLoaded },
+        { "Bytes stored", &InstrumentationStats::numBytesStored },
+        { "Branches", &InstrumentationStats::numBranches },
+        { "Taken branches", &InstrumentationStats::numTakenBranches },
+    };
+
+    uint64_t numMeasured = 0;
+    for (SampleResult const& sample : result.samples) numMeasured += sample.stats.numRetired;
+
+    std::ios_base::fmtflags flags     = os.flags();
+    std::streamsize         precision = os.precision();
+
+    size_t const numSamples = EstimateRate(result, &InstrumentationStats::numRetired).numSamples;
+    double const numRetired = static_cast<double>(result.run.numInstructions);
+    os << std::dec << "Sampled instructions: " << numMeasured << " of "
+       << result.run.numInstructions << " in " << numSamples << " samples\n";
+    os << "Per instruction, with 95% confidence intervals:\n";
+    for (Counter const& counter : Counters)
+    {
+        SampledRate const rate = EstimateRate(result, counter.counter);
+        os << counter.name << ": " << std::fixed << std::setprecision(4) << rate.mean << " +- "
+           << rate.halfWidth << " (about " << std::setprecision(0) << rate.mean * numRetired
+           << " in total)\n";
+    }
+
+    os.precision(precision);
+    os.flags(flags);
+}
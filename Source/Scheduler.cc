@@ -0,0 +1,217 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Scheduler.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+
+/// <summary>
+/// Guests print into strings, so their hosts need only small buffers.
+/// </summary>
+constexpr size_t GuestBufferSize = 1 << 12;
+
+}
+
+struct Scheduler::Guest
+{
+    uint64_t                         id;
+    Emulator                         emulator;
+    uint32_t                         priority;
+    uint64_t                         maxInstructions;
+    std::optional<Clock::time_point> deadline;
+    Callback                         onFinished;
+    std::ostringstream               output;
+    std::istringstream               input;
+    SyscallHost                      host;
+
+    // The instructions retired for each unit of priority, less the start credit. Workers take the
+    // guest with the least.
+    double virtualTime;
+
+    Clock::time_point submitted;
+    Clock::time_point queued;
+    GuestResult       result;
+
+    Guest(Emulator emulator, GuestOptions options, Callback onFinished) :
+        id { 0 },
+        emulator { std::move(emulator) },
+        priority { options.priority },
+        maxInstructions { options.maxInstructions },
+        deadline { options.deadline },
+        onFinished { std::move(onFinished) },
+        output {},
+        input { std::move(options.input) },
+        host { output,
+               input,
+               GuestBufferSize,
+               SyscallHost::DefaultMaxDataSize,
+               options.maxOutputSize },
+        virtualTime { 0 },
+        submitted {},
+        queued {},
+        result { 0, RunResult { TickResult::Success, 0, 0 }, 0, {}, {}, {}, {} }
+    {
+    }
+};
+
+bool Scheduler::IsLater(std::unique_ptr<Guest> const& lhs,
+                        std::unique_ptr<Guest> const& rhs) noexcept
+{
+    return std::tie(lhs->virtualTime, lhs->id) > std::tie(rhs->virtualTime, rhs->id);
+}
+
+Scheduler::Scheduler(SchedulerOptions const& options, ProgramOptions const& programOptions) :
+    _options { options },
+    _programOptions { programOptions },
+    _queue {},
+    _idle {},
+    _virtualTime { 0 },
+    _stats {},
+    _stopping { false },
+    _workers {}
+{
+    if (_options.quantum == 0)
+        throw std::invalid_argument { "quantum must be positive" };
+
+    size_t const numWorkers = std::max<size_t>(_options.numWorkers, 1);
+    for (size_t i = 0; i < numWorkers; ++i) _workers.emplace_back([this]() { Work(); });
+}
+
+Scheduler::~Scheduler() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock { _mutex };
+        _stopping = true;
+    }
+    _changed.notify_all();
+
+    for (std::thread& worker : _workers) worker.join();
+}
+
+Emulator Scheduler::Acquire()
+{
+    std::lock_guard<std::mutex> lock { _mutex };
+    if (_idle.empty())
+        return Emulator { _programOptions };
+
+    Emulator rtn = std::move(_idle.back());
+    _idle.pop_back();
+    return rtn;
+}
+
+uint64_t Scheduler::Submit(Emulator emulator, GuestOptions options, Callback onFinished)
+{
+    if (options.priority == 0)
+        throw std::invalid_argument { "priority must be positive" };
+
+    auto guest =
+        std::make_unique<Guest>(std::move(emulator), std::move(options), std::move(onFinished));
+
+    std::lock_guard<std::mutex> lock { _mutex };
+    double const credit = static_cast<double>(_options.startCredit * _options.quantum);
+    guest->id           = _stats.numSubmitted++;
+    guest->result.id    = guest->id;
+    guest->submitted    = Clock::now();
+    guest->queued       = guest->submitted;
+    guest->virtualTime  = _virtualTime - credit / guest->priority;
+
+    uint64_t const rtn = guest->id;
+    _queue.push_back(std::move(guest));
+    std::push_heap(_queue.begin(), _queue.end(), IsLater);
+    ++_stats.numGuests;
+
+    _changed.notify_all();
+    return rtn;
+}
+
+void Scheduler::Wait()
+{
+    std::unique_lock<std::mutex> lock { _mutex };
+    _changed.wait(lock, [this]() { return _stats.numGuests == 0; });
+}
+
+SchedulerStats Scheduler::GetStats() const
+{
+    std::lock_guard<std::mutex> lock { _mutex };
+    return _stats;
+}
+
+void Scheduler::Work()
+{
+    std::unique_lock<std::mutex> lock { _mutex };
+    while (true)
+    {
+        _changed.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+        if (_queue.empty())
+            return;
+
+        std::pop_heap(_queue.begin(), _queue.end(), IsLater);
+        std::unique_ptr<Guest> guest = std::move(_queue.back());
+        _queue.pop_back();
+
+        // The clock only moves forward, so that new guests never start behind the ones which ran.
+        _virtualTime = std::max(_virtualTime, guest->virtualTime);
+        lock.unlock();
+
+        GuestResult&          result = guest->result;
+        Clock::duration const waited = Clock::now() - guest->queued;
+        result.waitTime += waited;
+        result.maxWaitTime = std::max(result.maxWaitTime, waited);
+
+        RunLimits limits;
+        limits.maxInstructions = std::min(_options.quantum,
+                                          guest->maxInstructions - result.run.numInstructions);
+        limits.deadline        = guest->deadline;
+        limits.syscallHost     = &guest->host;
+
+        RunResult const quantum = guest->emulator.Run(limits);
+        result.run.result  = quantum.result;
+        result.run.numInstructions += quantum.numInstructions;
+        result.run.numFastForwarded += quantum.numFastForwarded;
+        ++result.numQuanta;
+
+        Clock::time_point const now        = Clock::now();
+        bool const              isFinished = quantum.result != TickResult::Success
+                                || guest->emulator.GetMemory().IsTerminated()
+                                || result.run.numInstructions == guest->maxInstructions;
+        if (isFinished)
+        {
+            guest->host.Flush();
+            result.latency = now - guest->submitted;
+            result.output  = guest->output.str();
+            if (guest->onFinished)
+                guest->onFinished(guest->emulator, std::move(result));
+        }
+
+        lock.lock();
+        ++_stats.numQuanta;
+        _stats.numInstructions += quantum.numInstructions;
+
+        if (!isFinished)
+        {
+            guest->virtualTime += static_cast<double>(quantum.numInstructions) / guest->priority;
+            guest->queued = now;
+            _queue.push_back(std::move(guest));
+            std::push_heap(_queue.begin(), _queue.end(), IsLater);
+            continue;
+        }
+
+        // Keeping an emulator per worker is enough for the guests loaded while others run.
+        if (_idle.size() < _workers.size())
+            _idle.push_back(std::move(guest->emulator));
+
+        ++_stats.numFinished;
+        if (--_stats.numGuests == 0)
+            _changed.notify_all();
+    }
+}
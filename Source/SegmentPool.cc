@@ -0,0 +1,336 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Common.hh>
+#include <simple-mips-emu/SegmentPool.hh>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#    define NOMINMAX
+#    include <Windows.h>
+#else
+#    include <sys/mman.h>
+#endif
+
+namespace
+{
+
+/// <summary>
+/// Set once the pool of the calling thread is destroyed. Segments which outlive it, e.g. those of
+/// static objects, use temporary pools instead.
+/// </summary>
+thread_local bool isLocalPoolDestroyed = false;
+
+struct LocalPool
+{
+    SegmentPool pool;
+
+    ~LocalPool() noexcept
+    {
+        isLocalPoolDestroyed = true;
+    }
+};
+
+/// <summary>
+/// Returns <c>numBytes</c> zero bytes of fresh pages. The pages are only faulted in once they are
+/// touched.
+/// </summary>
+uint8_t* AllocateFromHost(size_t numBytes)
+{
+#ifdef _WIN32
+    void* const rtn = VirtualAlloc(nullptr, numBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (rtn == nullptr)
+        throw std::bad_alloc {};
+#else
+    void* const rtn =
+        mmap(nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (rtn == MAP_FAILED)
+        throw std::bad_alloc {};
+#endif
+
+    return static_cast<uint8_t*>(rtn);
+}
+
+void ReturnToHost(uint8_t* bytes, size_t numBytes) noexcept
+{
+#ifdef _WIN32
+    (void)numBytes;
+    VirtualFree(bytes, 0, MEM_RELEASE);
+#else
+    munmap(bytes, numBytes);
+#endif
+}
+
+SegmentPool::Block AllocateBlock(size_t size, bool zeroed)
+{
+    if (SegmentPool* pool = SegmentPool::GetLocal())
+        return pool->Allocate(size, zeroed);
+
+    SegmentPool pool;
+    return pool.Allocate(size, zeroed);
+}
+
+void ReleaseBlock(SegmentPool::Block block) noexcept
+{
+    if (SegmentPool* pool = SegmentPool::GetLocal())
+        pool->Release(block);
+    else
+        SegmentPool {}.Release(block);
+}
+
+}
+
+SegmentPool::SegmentPool() noexcept : _freeBlocks {}, _maxCachedBytes { 64 << 20 }, _stats {}
+{
+}
+
+SegmentPool::~SegmentPool() noexcept
+{
+    Trim();
+}
+
+SegmentPool* SegmentPool::GetLocal() noexcept
+{
+    if (isLocalPoolDestroyed)
+        return nullptr;
+
+    thread_local LocalPool local;
+    return &local.pool;
+}
+
+SegmentPool::Block SegmentPool::Allocate(size_t size, bool zeroed)
+{
+    if (size == 0)
+        return Block {};
+
+    ++_stats.numAllocations;
+
+    size_t const sizeClass = GetClass(size);
+    if (sizeClass < NumClasses && !_freeBlocks[sizeClass].empty())
+    {
+        Block rtn = _freeBlocks[sizeClass].back();
+        _freeBlocks[sizeClass].pop_back();
+        _stats.numCachedBytes -= rtn.capacity;
+        ++_stats.numReuses;
+
+        if (zeroed)
+        {
+            size_t const numBytes = std::min(rtn.dirty, size);
+            std::memset(rtn.bytes, 0, numBytes);
+            _stats.numBytesZeroed += numBytes;
+        }
+        rtn.dirty = std::max(rtn.dirty, size);
+
+        return rtn;
+    }
+
+    size_t const pageSize = GetPageSize();
+    size_t const capacity = sizeClass < NumClasses ? pageSize << sizeClass
+                                                   : (size + pageSize - 1) / pageSize * pageSize;
+
+    return Block { AllocateFromHost(capacity), capacity, size };
+}
+
+void SegmentPool::Release(Block block) noexcept
+{
+    if (block.bytes == nullptr)
+        return;
+
+    size_t const sizeClass = GetClass(block.capacity);
+    if (sizeClass < NumClasses && block.capacity == GetPageSize() << sizeClass
+        && _stats.numCachedBytes + block.capacity <= _maxCachedBytes)
+    {
+        try
+        {
+            _freeBlocks[sizeClass].push_back(block);
+            _stats.numCachedBytes += block.capacity;
+            return;
+        }
+        catch (std::bad_alloc const&)
+        {
+        }
+    }
+
+    ReturnToHost(block.bytes, block.capacity);
+}
+
+void SegmentPool::Trim() noexcept
+{
+    for (std::vector<Block>& blocks : _freeBlocks)
+    {
+        for (Block const& block : blocks) ReturnToHost(block.bytes, block.capacity);
+        blocks.clear();
+    }
+    _stats.numCachedBytes = 0;
+}
+
+void SegmentPool::SetMaxCachedBytes(size_t maxCachedBytes) noexcept
+{
+    _maxCachedBytes = maxCachedBytes;
+    if (_stats.numCachedBytes > _maxCachedBytes)
+        Trim();
+}
+
+size_t SegmentPool::GetClass(size_t size) noexcept
+{
+    size_t const pageSize = GetPageSize();
+    size_t const numPages = (size + pageSize - 1) / pageSize;
+
+    size_t rtn = 0;
+    while (rtn < NumClasses && (size_t { 1 } << rtn) < numPages) ++rtn;
+
+    return rtn;
+}
+
+SegmentBuffer::SegmentBuffer() noexcept :
+    _block {},
+    _size { 0 },
+    _borrowed { false },
+    _pinned { false }
+{
+}
+
+SegmentBuffer::SegmentBuffer(size_t size) :
+    _block { AllocateBlock(size, true) },
+    _size { size },
+    _borrowed { false },
+    _pinned { false }
+{
+}
+
+SegmentBuffer::SegmentBuffer(uint8_t const* bytes, size_t size) :
+    _block {},
+    _size { 0 },
+    _borrowed { false },
+    _pinned { false }
+{
+    assign(bytes, bytes + size);
+}
+
+SegmentBuffer::SegmentBuffer(SegmentBuffer const& other) :
+    SegmentBuffer { other.data(), other.size() }
+{
+}
+
+SegmentBuffer::SegmentBuffer(SegmentBuffer&& other) noexcept :
+    _block { std::exchange(other._block, SegmentPool::Block {}) },
+    _size { std::exchange(other._size, 0) },
+    _borrowed { std::exchange(other._borrowed, false) },
+    _pinned { std::exchange(other._pinned, false) }
+{
+}
+
+SegmentBuffer& SegmentBuffer::operator=(SegmentBuffer const& other)
+{
+    if (this != &other)
+        assign(other.begin(), other.end());
+
+    return *this;
+}
+
+SegmentBuffer& SegmentBuffer::operator=(SegmentBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        _block    = std::exchange(other._block, SegmentPool::Block {});
+        _size     = std::exchange(other._size, 0);
+        _borrowed = std::exchange(other._borrowed, false);
+        _pinned   = std::exchange(other._pinned, false);
+    }
+
+    return *this;
+}
+
+SegmentBuffer::~SegmentBuffer() noexcept
+{
+    Release();
+}
+
+void SegmentBuffer::assign(uint8_t const* first, uint8_t const* last)
+{
+    if (_pinned)
+        throw std::logic_error { "a pinned segment cannot be replaced" };
+
+    size_t const size = static_cast<size_t>(last - first);
+    if (_borrowed || size > _block.capacity)
+    {
+        Release();
+        _block = AllocateBlock(size, false);
+    }
+
+    if (size != 0)
+        std::memcpy(_block.bytes, first, size);
+    _size        = size;
+    _block.dirty = std::max(_block.dirty, size);
+}
+
+void SegmentBuffer::resize(size_t size)
+{
+    if (_pinned)
+        throw std::logic_error { "a pinned segment cannot be resized" };
+
+    if (_borrowed || size > _block.capacity)
+    {
+        SegmentPool::Block block = AllocateBlock(size, true);
+        if (std::min(size, _size) != 0)
+            std::memcpy(block.bytes, _block.bytes, std::min(size, _size));
+
+        // The old block goes back to the host rather than to the pool, as watchpoints may still
+        // protect some of its pages.
+        if (!_borrowed && _block.bytes != nullptr)
+            ReturnToHost(_block.bytes, _block.capacity);
+        _block    = block;
+        _borrowed = false;
+    }
+    else if (size > _size)
+    {
+        // Bytes from the dirty offset on are zero already.
+        size_t const end = std::min(_block.dirty, size);
+        if (end > _size)
+            std::memset(_block.bytes + _size, 0, end - _size);
+    }
+
+    _size        = size;
+    _block.dirty = std::max(_block.dirty, size);
+}
+
+uint8_t& SegmentBuffer::at(size_t offset)
+{
+    if (offset >= _size)
+        throw std::out_of_range { "segment offset out of range" };
+
+    return _block.bytes[offset];
+}
+
+uint8_t const& SegmentBuffer::at(size_t offset) const
+{
+    if (offset >= _size)
+        throw std::out_of_range { "segment offset out of range" };
+
+    return _block.bytes[offset];
+}
+
+void SegmentBuffer::Borrow(SegmentBuffer& owner) noexcept
+{
+    if (&owner == this)
+        return;
+
+    Release();
+    _block    = owner._block;
+    _size     = owner._size;
+    _borrowed = true;
+}
+
+void SegmentBuffer::Release() noexcept
+{
+    SegmentPool::Block block = std::exchange(_block, SegmentPool::Block {});
+    if (!std::exchange(_borrowed, false))
+        ReleaseBlock(block);
+    _size = 0;
+}
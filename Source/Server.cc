@@ -0,0 +1,797 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Server.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    define SIMPLE_MIPS_EMU_SERVER_SUPPORTED 1
+#    include <cerrno>
+#    include <sys/socket.h>
+#    include <sys/un.h>
+#    include <unistd.h>
+#else
+#    define SIMPLE_MIPS_EMU_SERVER_SUPPORTED 0
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// <summary>
+/// Messages longer than this close the connection instead of being read.
+/// </summary>
+constexpr size_t MaxMessageSize = 256 << 20;
+
+/// <summary>
+/// Ranges longer than this make a job invalid, which bounds the size of its output.
+/// </summary>
+constexpr uint32_t MaxRangeSize = 4 << 20;
+
+/// <summary>
+/// Jobs whose ranges span this much in total are invalid as well, however many ranges there are.
+/// Their dump stays well below <c>MaxMessageSize</c>.
+/// </summary>
+constexpr uint64_t MaxDumpSize = 16 << 20;
+
+/// <summary>
+/// Paths longer than this make a request malformed; no host accepts them anyway.
+/// </summary>
+constexpr size_t MaxPathLength = 4096;
+
+/// <summary>
+/// Jobs run at most this many instructions and this many milliseconds, whatever they ask for, so
+/// that no client holds a worker for good.
+/// </summary>
+constexpr uint64_t MaxJobInstructions = uint64_t { 1 } << 36;
+constexpr uint64_t MaxJobTimeMs       = 60 * 1000;
+
+/// <summary>
+/// What jobs print past this many bytes is dropped.
+/// </summary>
+constexpr uint64_t MaxJobOutputSize = 16 << 20;
+
+/// <summary>
+/// A connection stops being read while this many of its jobs are queued, running or waiting for
+/// their responses to be written, which bounds what a client which does not read can hold.
+/// </summary>
+constexpr size_t MaxPendingJobs = 16;
+
+enum class ProgramKind : uint8_t
+{
+    Image = 0,
+    Path  = 1,
+};
+
+class ByteWriter
+{
+  private:
+    std::vector<uint8_t> _bytes;
+
+  public:
+    template <typename T>
+    void Write(T value)
+    {
+        for (size_t i = 0; i < sizeof(T); ++i)
+            _bytes.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8) & 0xFF));
+    }
+
+    void Write(uint8_t const* bytes, size_t size)
+    {
+        _bytes.insert(_bytes.end(), bytes, bytes + size);
+    }
+
+    std::vector<uint8_t> Take() noexcept
+    {
+        return std::move(_bytes);
+    }
+};
+
+class ByteReader
+{
+  private:
+    uint8_t const* _bytes;
+    size_t         _remaining;
+
+  public:
+    ByteReader(uint8_t const* bytes, size_t size) noexcept : _bytes { bytes }, _remaining { size }
+    {
+    }
+
+    template <typename T>
+    bool Read(T& out) noexcept
+    {
+        if (_remaining < sizeof(T))
+            return false;
+
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) value |= static_cast<uint64_t>(_bytes[i]) << (i * 8);
+        out = static_cast<T>(value);
+
+        _bytes += sizeof(T);
+        _remaining -= sizeof(T);
+        return true;
+    }
+
+    bool Read(size_t size, uint8_t const*& out) noexcept
+    {
+        if (_remaining < size)
+            return false;
+
+        out = _bytes;
+        _bytes += size;
+        _remaining -= size;
+        return true;
+    }
+
+    size_t GetRemaining() const noexcept
+    {
+        return _remaining;
+    }
+};
+
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+
+bool ReadAll(int fd, uint8_t* bytes, size_t size) noexcept
+{
+    while (size > 0)
+    {
+        ssize_t const result = read(fd, bytes, size);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+
+        bytes += result;
+        size -= static_cast<size_t>(result);
+    }
+
+    return true;
+}
+
+bool WriteAll(int fd, uint8_t const* bytes, size_t size) noexcept
+{
+#    ifdef MSG_NOSIGNAL
+    constexpr int Flags = MSG_NOSIGNAL;
+#    else
+    constexpr int Flags = 0;
+#    endif
+
+    while (size > 0)
+    {
+        ssize_t const result = send(fd, bytes, size, Flags);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+
+        bytes += result;
+        size -= static_cast<size_t>(result);
+    }
+
+    return true;
+}
+
+bool ReadMessage(int fd, std::vector<uint8_t>& out)
+{
+    uint8_t header[4];
+    if (!ReadAll(fd, header, sizeof(header)))
+        return false;
+
+    uint32_t size = 0;
+    ByteReader { header, sizeof(header) }.Read(size);
+    if (size > MaxMessageSize)
+        return false;
+
+    out.resize(size);
+    return ReadAll(fd, out.data(), out.size());
+}
+
+bool WriteMessage(int fd, std::vector<uint8_t> const& payload)
+{
+    ByteWriter header;
+    header.Write(static_cast<uint32_t>(payload.size()));
+
+    std::vector<uint8_t> const bytes = header.Take();
+    return WriteAll(fd, bytes.data(), bytes.size()) && WriteAll(fd, payload.data(), payload.size());
+}
+
+/// <summary>
+/// Makes writes to a closed connection fail instead of raising <c>SIGPIPE</c> on hosts without
+/// <c>MSG_NOSIGNAL</c>.
+/// </summary>
+void DisableSigPipe([[maybe_unused]] int fd) noexcept
+{
+#    ifdef SO_NOSIGPIPE
+    int const value = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#    endif
+}
+
+/// <summary>
+/// Fills the address of the socket at the given path. Returns <c>false</c> if the path is too long.
+/// </summary>
+bool MakeAddress(fs::path const& path, sockaddr_un& out) noexcept
+{
+    std::string const native = path.string();
+
+    out            = sockaddr_un {};
+    out.sun_family = AF_UNIX;
+    if (native.size() >= sizeof(out.sun_path))
+        return false;
+
+    std::memcpy(out.sun_path, native.c_str(), native.size() + 1);
+    return true;
+}
+
+#endif
+
+}
+
+std::vector<uint8_t> EncodeJobRequest(JobRequest const& request)
+{
+    ByteWriter writer;
+    writer.Write(request.id);
+    writer.Write(request.maxInstructions);
+    writer.Write(request.timeLimitMs);
+    writer.Write(static_cast<uint32_t>(request.ranges.size()));
+    for (AddressRange const& range : request.ranges)
+    {
+        writer.Write(static_cast<uint32_t>(range.begin));
+        writer.Write(static_cast<uint32_t>(range.end));
+    }
+
+    if (request.path.empty())
+    {
+        writer.Write(static_cast<uint8_t>(ProgramKind::Image));
+        writer.Write(static_cast<uint32_t>(request.text.size()));
+        writer.Write(request.text.data(), request.text.size());
+        writer.Write(static_cast<uint32_t>(request.data.size()));
+        writer.Write(request.data.data(), request.data.size());
+    }
+    else
+    {
+        writer.Write(static_cast<uint8_t>(ProgramKind::Path));
+        writer.Write(reinterpret_cast<uint8_t const*>(request.path.data()), request.path.size());
+    }
+
+    return writer.Take();
+}
+
+std::optional<JobRequest> DecodeJobRequest(uint8_t const* bytes, size_t size)
+{
+    ByteReader reader { bytes, size };
+    JobRequest rtn;
+
+    uint32_t numRanges;
+    if (!reader.Read(rtn.id) || !reader.Read(rtn.maxInstructions) || !reader.Read(rtn.timeLimitMs)
+        || !reader.Read(numRanges) || numRanges > reader.GetRemaining() / 8)
+        return std::nullopt;
+
+    for (uint32_t i = 0; i < numRanges; ++i)
+    {
+        uint32_t begin, end;
+        if (!reader.Read(begin) || !reader.Read(end))
+            return std::nullopt;
+
+        rtn.ranges.push_back(
+            AddressRange { Address::MakeFromWord(begin), Address::MakeFromWord(end) });
+    }
+
+    uint8_t kind;
+    if (!reader.Read(kind))
+        return std::nullopt;
+
+    if (kind == static_cast<uint8_t>(ProgramKind::Image))
+    {
+        uint32_t       textSize, dataSize;
+        uint8_t const* text;
+        uint8_t const* data;
+        if (!reader.Read(textSize) || !reader.Read(textSize, text) || !reader.Read(dataSize)
+            || !reader.Read(dataSize, data) || reader.GetRemaining() != 0)
+            return std::nullopt;
+
+        rtn.text.assign(text, text + textSize);
+        rtn.data.assign(data, data + dataSize);
+    }
+    else if (kind == static_cast<uint8_t>(ProgramKind::Path))
+    {
+        uint8_t const* path;
+        size_t const   length = reader.GetRemaining();
+        if (length == 0 || length > MaxPathLength || !reader.Read(length, path))
+            return std::nullopt;
+
+        rtn.path.assign(reinterpret_cast<char const*>(path), length);
+    }
+    else
+    {
+        return std::nullopt;
+    }
+
+    return rtn;
+}
+
+std::vector<uint8_t> EncodeJobResponse(JobResponse const& response)
+{
+    ByteWriter writer;
+    writer.Write(response.id);
+    writer.Write(response.status);
+    writer.Write(response.numInstructions);
+    writer.Write(reinterpret_cast<uint8_t const*>(response.output.data()), response.output.size());
+
+    return writer.Take();
+}
+
+std::optional<JobResponse> DecodeJobResponse(uint8_t const* bytes, size_t size)
+{
+    ByteReader  reader { bytes, size };
+    JobResponse rtn;
+
+    if (!reader.Read(rtn.id) || !reader.Read(rtn.status) || !reader.Read(rtn.numInstructions))
+        return std::nullopt;
+
+    uint8_t const* output;
+    size_t const   length = reader.GetRemaining();
+    reader.Read(length, output);
+    rtn.output.assign(reinterpret_cast<char const*>(output), length);
+    return rtn;
+}
+
+namespace
+{
+
+/// <summary>
+/// Loads the program of the given job into the emulator. Returns why the job is invalid if it
+/// cannot be run.
+/// </summary>
+std::optional<std::string> LoadJob(Emulator& emulator, JobRequest const& request, ImageCache* cache)
+{
+    uint64_t dumpSize = 0;
+    for (AddressRange const& range : request.ranges)
+    {
+        if (range.begin.base != range.end.base || range.end.offset < range.begin.offset
+            || range.end.offset - range.begin.offset >= MaxRangeSize)
+            return "Invalid range";
+
+        dumpSize += range.end.offset - range.begin.offset + 4;
+        if (dumpSize > MaxDumpSize)
+            return "Invalid range";
+    }
+
+    if (!request.path.empty())
+    {
+        if (cache ? emulator.Load(*cache, request.path) : emulator.Load(request.path))
+            return "Cannot read the program";
+    }
+    else
+    {
+        if (request.text.size() % 4 != 0)
+            return "Invalid text size";
+        emulator.Reset(
+            request.text.data(), request.text.size(), request.data.data(), request.data.size());
+    }
+
+    return std::nullopt;
+}
+
+/// <summary>
+/// Dumps the registers and the given ranges after the output of a job.
+/// </summary>
+void DumpJob(std::ostream& os, Memory const& memory, std::vector<AddressRange> const& ranges)
+{
+    memory.DumpRegisters(os);
+    os << '\n';
+    for (AddressRange const& range : ranges)
+    {
+        memory.DumpMemory(os, range.begin, range.end);
+        os << '\n';
+    }
+}
+
+}
+
+JobResponse RunJob(Emulator& emulator, JobRequest const& request, ImageCache* cache)
+{
+    JobResponse rtn;
+    rtn.id = request.id;
+
+    if (std::optional<std::string> error = LoadJob(emulator, request, cache))
+    {
+        rtn.output = std::move(*error);
+        return rtn;
+    }
+
+    // Jobs have no input; their output comes before the dump.
+    std::ostringstream os;
+    std::istringstream input;
+    SyscallHost        host { os, input };
+
+    RunLimits limits;
+    limits.maxInstructions = request.maxInstructions;
+    limits.syscallHost     = &host;
+    if (request.timeLimitMs != 0)
+    {
+        std::chrono::milliseconds const timeLimit { request.timeLimitMs };
+        limits.deadline = std::chrono::steady_clock::now() + timeLimit;
+    }
+
+    RunResult const result = emulator.Run(limits);
+    rtn.status             = static_cast<uint32_t>(result.result);
+    rtn.numInstructions    = result.numInstructions;
+
+    host.Flush();
+    DumpJob(os, emulator.GetMemory(), request.ranges);
+    rtn.output = os.str();
+
+    return rtn;
+}
+
+struct Server::Connection
+{
+    int fd;
+
+    // Workers queue responses here for the writer of the connection, so that they never block on
+    // a client which does not read.
+    std::mutex              mutex;
+    std::condition_variable changed;
+    std::deque<JobResponse> responses;
+    size_t                  numPending;
+    bool                    isReading;
+
+    explicit Connection(int fd) noexcept :
+        fd { fd },
+        responses {},
+        numPending { 0 },
+        isReading { true }
+    {
+    }
+
+    ~Connection() noexcept
+    {
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+        close(fd);
+#endif
+    }
+};
+
+Server::Server(fs::path              path,
+               size_t                numWorkers,
+               ProgramOptions const& options,
+               size_t                cacheBudget,
+               uint64_t              quantum) :
+    _path { std::move(path) },
+    _cache { cacheBudget, options },
+    _listener { -1 },
+    _numReaders { 0 },
+    _stopping { false },
+    _scheduler { SchedulerOptions { numWorkers, quantum }, options }
+{
+}
+
+Server::~Server() noexcept
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    if (_listener >= 0)
+    {
+        close(_listener);
+        std::error_code ec;
+        fs::remove(_path, ec);
+    }
+#endif
+}
+
+bool Server::IsSupported() noexcept
+{
+    return SIMPLE_MIPS_EMU_SERVER_SUPPORTED;
+}
+
+bool Server::Listen() noexcept
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    sockaddr_un address;
+    if (_listener >= 0 || !MakeAddress(_path, address))
+        return false;
+
+    // A socket file left by a server which did not stop cleanly would make bind fail.
+    std::error_code ec;
+    if (fs::is_socket(_path, ec))
+        fs::remove(_path, ec);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+
+    if (bind(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0
+        || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    _listener = fd;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Server::Serve()
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    while (true)
+    {
+        int fd = accept(_listener, nullptr, nullptr);
+        if (fd < 0 && errno == EINTR)
+            continue;
+        if (fd < 0)
+            break;
+
+        std::lock_guard<std::mutex> lock { _mutex };
+        if (_stopping)
+        {
+            close(fd);
+            break;
+        }
+        DisableSigPipe(fd);
+
+        auto connection = std::make_shared<Connection>(fd);
+        _connections.erase(std::remove_if(_connections.begin(),
+                                          _connections.end(),
+                                          [](auto const& weak) { return weak.expired(); }),
+                           _connections.end());
+        _connections.push_back(connection);
+
+        // Readers are detached so that finished ones do not pile up; Serve waits for them below.
+        ++_numReaders;
+        std::thread { [this, connection]() { Read(connection); } }.detach();
+    }
+
+    // Also stops the readers if accept failed by itself.
+    Stop();
+
+    // Once the readers are gone, no more jobs come in.
+    std::unique_lock<std::mutex> lock { _mutex };
+    _changed.wait(lock, [this]() { return _numReaders == 0; });
+    lock.unlock();
+    _scheduler.Wait();
+
+    close(_listener);
+    _listener = -1;
+    std::error_code ec;
+    fs::remove(_path, ec);
+#endif
+}
+
+void Server::Stop() noexcept
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    std::lock_guard<std::mutex> lock { _mutex };
+    _stopping = true;
+
+    // Shutting the sockets down wakes the threads blocked on them.
+    if (_listener >= 0)
+        shutdown(_listener, SHUT_RDWR);
+    for (std::weak_ptr<Connection> const& weak : _connections)
+        if (std::shared_ptr<Connection> connection = weak.lock())
+            shutdown(connection->fd, SHUT_RDWR);
+
+    _changed.notify_all();
+#endif
+}
+
+void Server::Read(std::shared_ptr<Connection> connection)
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    std::thread writer { [this, connection]() { Write(*connection); } };
+
+    std::vector<uint8_t> message;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock { connection->mutex };
+            connection->changed.wait(
+                lock, [&connection]() { return connection->numPending < MaxPendingJobs; });
+        }
+        if (!ReadMessage(connection->fd, message))
+            break;
+
+        {
+            std::lock_guard<std::mutex> lock { _mutex };
+            if (_stopping)
+                break;
+        }
+
+        // Every request read from here on gets exactly one response.
+        {
+            std::lock_guard<std::mutex> lock { connection->mutex };
+            ++connection->numPending;
+        }
+
+        std::optional<JobRequest> request = DecodeJobRequest(message.data(), message.size());
+        if (!request)
+        {
+            JobResponse response;
+            response.output = "Malformed request";
+            Respond(*connection, std::move(response));
+            break;
+        }
+
+        // Nothing a client sends may take the server down, so a job which throws is only invalid.
+        uint64_t const id = request->id;
+        try
+        {
+            Submit(connection, std::move(*request));
+        }
+        catch (std::exception const& e)
+        {
+            JobResponse response;
+            response.id     = id;
+            response.output = std::string { "Cannot run the job: " } + e.what();
+            Respond(*connection, std::move(response));
+        }
+    }
+
+    // The writer stops once the jobs which were read have been answered.
+    {
+        std::lock_guard<std::mutex> lock { connection->mutex };
+        connection->isReading = false;
+    }
+    connection->changed.notify_all();
+    writer.join();
+#endif
+
+    connection.reset();
+
+    std::lock_guard<std::mutex> lock { _mutex };
+    --_numReaders;
+    _changed.notify_all();
+}
+
+void Server::Submit(std::shared_ptr<Connection> const& connection, JobRequest request)
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    // Programs are loaded here, so that workers only run them.
+    Emulator emulator = _scheduler.Acquire();
+    if (std::optional<std::string> error = LoadJob(emulator, request, &_cache))
+    {
+        JobResponse response;
+        response.id     = request.id;
+        response.output = std::move(*error);
+        Respond(*connection, std::move(response));
+        return;
+    }
+
+    // The time limit counts from now, including the time the job waits for a worker.
+    uint64_t const timeLimitMs =
+        request.timeLimitMs != 0 ? std::min(request.timeLimitMs, MaxJobTimeMs) : MaxJobTimeMs;
+    std::chrono::milliseconds const timeLimit { timeLimitMs };
+
+    GuestOptions options;
+    options.maxInstructions = std::min(request.maxInstructions, MaxJobInstructions);
+    options.deadline        = std::chrono::steady_clock::now() + timeLimit;
+    options.maxOutputSize   = MaxJobOutputSize;
+
+    auto onFinished = [this, connection, id = request.id, ranges = std::move(request.ranges)](
+                          Emulator& emulator, GuestResult result) {
+        JobResponse response;
+        response.id              = id;
+        response.status          = static_cast<uint32_t>(result.run.result);
+        response.numInstructions = result.run.numInstructions;
+
+        std::ostringstream os { std::move(result.output), std::ios_base::ate };
+        DumpJob(os, emulator.GetMemory(), ranges);
+        response.output = os.str();
+        Respond(*connection, std::move(response));
+    };
+    _scheduler.Submit(std::move(emulator), std::move(options), std::move(onFinished));
+#endif
+}
+
+void Server::Respond(Connection& connection, JobResponse response)
+{
+    {
+        std::lock_guard<std::mutex> lock { connection.mutex };
+        connection.responses.push_back(std::move(response));
+    }
+    connection.changed.notify_all();
+}
+
+void Server::Write(Connection& connection)
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    // Once a write fails, the remaining responses are dropped, so that the jobs still count as
+    // answered.
+    bool isOpen = true;
+
+    std::unique_lock<std::mutex> lock { connection.mutex };
+    while (true)
+    {
+        connection.changed.wait(lock, [&connection]() {
+            return !connection.responses.empty()
+                || (!connection.isReading && connection.numPending == 0);
+        });
+        if (connection.responses.empty())
+            return;
+
+        JobResponse const response = std::move(connection.responses.front());
+        connection.responses.pop_front();
+        lock.unlock();
+
+        if (isOpen)
+            isOpen = WriteMessage(connection.fd, EncodeJobResponse(response));
+
+        lock.lock();
+        --connection.numPending;
+        connection.changed.notify_all();
+    }
+#endif
+}
+
+ServerClient::ServerClient() noexcept : _fd { -1 }
+{
+}
+
+ServerClient::~ServerClient() noexcept
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    if (_fd >= 0)
+        close(_fd);
+#endif
+}
+
+bool ServerClient::Connect(fs::path const& path) noexcept
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    sockaddr_un address;
+    if (_fd >= 0 || !MakeAddress(path, address))
+        return false;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+
+    if (connect(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    DisableSigPipe(fd);
+    _fd = fd;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ServerClient::Send(JobRequest const& request)
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    return _fd >= 0 && WriteMessage(_fd, EncodeJobRequest(request));
+#else
+    return false;
+#endif
+}
+
+std::optional<JobResponse> ServerClient::Receive()
+{
+#if SIMPLE_MIPS_EMU_SERVER_SUPPORTED
+    std::vector<uint8_t> message;
+    if (_fd < 0 || !ReadMessage(_fd, message))
+        return std::nullopt;
+
+    return DecodeJobResponse(message.data(), message.size());
+#else
+    return std::nullopt;
+#endif
+}
@@ -0,0 +1,192 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Sweep.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+/// <summary>
+/// The number of inputs a worker claims at a time. Claiming several keeps the workers from
+/// contending on the counter and from writing to the same cache lines of the columns.
+/// </summary>
+constexpr size_t ChunkSize = 64;
+
+void CheckFields(Memory const& memory, std::vector<SweepField> const& fields)
+{
+    for (SweepField const& field : fields)
+    {
+        if (field.kind == SweepField::Kind::Register)
+        {
+            if (field.location >= RegisterFileSize)
+                throw std::invalid_argument { "sweep register out of range" };
+            continue;
+        }
+
+        Address const  address = Address::MakeFromWord(field.location);
+        uint64_t const end     = uint64_t { address.offset } + uint64_t { field.numWords } * 4;
+        if (field.location < static_cast<uint32_t>(Address::BaseType::Text)
+            || end > memory.GetSegmentByBase(address.base).size())
+            throw std::invalid_argument { "sweep address out of range" };
+    }
+}
+
+uint32_t LoadWord(uint8_t const* ptr, ByteOrder byteOrder) noexcept
+{
+    if (byteOrder == ByteOrder::Big)
+        return uint32_t { ptr[0] } << 24 | uint32_t { ptr[1] } << 16 | uint32_t { ptr[2] } << 8
+               | uint32_t { ptr[3] };
+    else
+        return uint32_t { ptr[3] } << 24 | uint32_t { ptr[2] } << 16 | uint32_t { ptr[1] } << 8
+               | uint32_t { ptr[0] };
+}
+
+void StoreWord(uint8_t* ptr, uint32_t value, ByteOrder byteOrder) noexcept
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        int const shift = byteOrder == ByteOrder::Big ? 24 - i * 8 : i * 8;
+        ptr[i]          = static_cast<uint8_t>(value >> shift & 0xFF);
+    }
+}
+
+}
+
+size_t GetSweepWidth(std::vector<SweepField> const& fields) noexcept
+{
+    size_t rtn = 0;
+    for (SweepField const& field : fields) rtn += field.numWords;
+
+    return rtn;
+}
+
+SweepResult RunSweep(ProgramImage const&          image,
+                     std::vector<uint32_t> const& inputs,
+                     SweepOptions const&          options)
+{
+    Memory const& initial = image.GetMemory();
+    CheckFields(initial, options.inputs);
+    CheckFields(initial, options.outputs);
+
+    size_t const inputWidth = GetSweepWidth(options.inputs);
+    size_t const numColumns = 1 + GetSweepWidth(options.outputs);
+
+    SweepResult rtn;
+    rtn.numInputs = inputWidth == 0 ? 0 : inputs.size() / inputWidth;
+    rtn.columns.resize(numColumns * rtn.numInputs);
+
+    std::atomic<size_t>   next { 0 };
+    std::atomic<uint64_t> numInstructions { 0 };
+
+    auto work = [&]() {
+        // Each worker keeps its buffers across runs; only the data segment is copied per run.
+        Memory        memory { 0, 0 };
+        std::ostream  output { nullptr };
+        std::istream  input { nullptr };
+        SyscallHost   host { output, input };
+        StuckDetector detector;
+
+        RunLimits limits     = options.limits;
+        limits.syscallHost   = &host;
+        limits.stuckDetector = options.limits.stuckDetector ? &detector : nullptr;
+
+        uint64_t workerInstructions = 0;
+        for (size_t begin; (begin = next.fetch_add(ChunkSize)) < rtn.numInputs;)
+        {
+            size_t const end = std::min(begin + ChunkSize, rtn.numInputs);
+            for (size_t i = begin; i < end; ++i)
+            {
+                memory.ResetFrom(initial);
+                detector.Reset();
+
+                uint32_t const* word = inputs.data() + i * inputWidth;
+                for (SweepField const& field : options.inputs)
+                {
+                    for (uint32_t k = 0; k < field.numWords; ++k, ++word)
+                    {
+                        if (field.kind == SweepField::Kind::Register)
+                            memory.SetRegister(field.location, *word);
+                        else
+                            memory.SetWord(Address::MakeFromWord(field.location + k * 4), *word);
+                    }
+                }
+
+                RunResult const result = RunProgram(memory, image.GetProgram(), limits);
+                workerInstructions += result.numInstructions;
+
+                size_t column = 0;
+
+                rtn.columns[column++ * rtn.numInputs + i] = static_cast<uint32_t>(result.result);
+                for (SweepField const& field : options.outputs)
+                {
+                    for (uint32_t k = 0; k < field.numWords; ++k)
+                    {
+                        uint32_t const value =
+                            field.kind == SweepField::Kind::Register
+                                ? memory.GetRegister(field.location)
+                                : memory.GetWord(Address::MakeFromWord(field.location + k * 4));
+                        rtn.columns[column++ * rtn.numInputs + i] = value;
+                    }
+                }
+            }
+        }
+
+        numInstructions.fetch_add(workerInstructions, std::memory_order_relaxed);
+    };
+
+    size_t const numChunks  = (rtn.numInputs + ChunkSize - 1) / ChunkSize;
+    size_t const numWorkers = std::min(std::max<size_t>(options.numWorkers, 1), numChunks);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < numWorkers; ++i) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+
+    rtn.numInstructions = numInstructions.load();
+    return rtn;
+}
+
+SweepInputsReadResult
+    ReadSweepInputs(std::filesystem::path const& path, size_t width, ByteOrder byteOrder)
+{
+    if (std::filesystem::is_directory(path))
+        return CannotRead { FileReadError::Type::GivenPathIsDirectory };
+
+    std::ifstream ifs { path, std::ios::binary };
+    if (!ifs)
+        return CannotRead { FileReadError::Type::FileDoesNotExist };
+
+    std::vector<uint8_t> const bytes { std::istreambuf_iterator<char> { ifs },
+                                       std::istreambuf_iterator<char> {} };
+    if (width == 0 || bytes.size() % (width * 4) != 0)
+        return CannotRead { FileReadError::Type::SectionSizeDoesNotMatch };
+
+    std::vector<uint32_t> rtn(bytes.size() / 4);
+    for (size_t i = 0; i < rtn.size(); ++i) rtn[i] = LoadWord(bytes.data() + i * 4, byteOrder);
+
+    return rtn;
+}
+
+std::optional<FileWriteError> WriteSweepResult(std::filesystem::path const& path,
+                                               SweepResult const&           result,
+                                               ByteOrder                    byteOrder)
+{
+    std::vector<uint8_t> bytes(result.columns.size() * 4);
+    for (size_t i = 0; i < result.columns.size(); ++i)
+        StoreWord(bytes.data() + i * 4, result.columns[i], byteOrder);
+
+    std::ofstream ofs { path, std::ios::binary | std::ios::trunc };
+    ofs.write(reinterpret_cast<char const*>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+    if (!ofs)
+        return FileWriteError { FileWriteError::Type::CannotWrite };
+
+    return std::nullopt;
+}
@@ -0,0 +1,166 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Syscall.hh>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace
+{
+
+constexpr uint32_t AlignToWord(uint32_t value) noexcept
+{
+    return (value + 3) & ~uint32_t { 3 };
+}
+
+}
+
+SyscallHost::SyscallHost(std::ostream& output,
+                         std::istream& input,
+                         size_t        bufferSize,
+                         uint32_t      maxDataSize,
+                         uint64_t      maxOutputSize) :
+    _output { output },
+    _input { input },
+    _buffer {},
+    _bufferSize { bufferSize },
+    _maxDataSize { maxDataSize },
+    _maxOutputSize { maxOutputSize },
+    _outputSize { 0 }
+{
+    _buffer.reserve(_bufferSize);
+}
+
+SyscallHost::~SyscallHost() noexcept
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+    }
+}
+
+TickResult SyscallHost::Service(Memory& memory)
+{
+    uint32_t const argument = memory.GetRegister(Memory::A0);
+    switch (static_cast<SyscallCode>(memory.GetRegister(Memory::V0)))
+    {
+        case SyscallCode::PrintInt:
+        {
+            char       text[16];
+            auto const result =
+                std::to_chars(text, text + sizeof(text), static_cast<int32_t>(argument));
+            Write(text, static_cast<size_t>(result.ptr - text));
+            break;
+        }
+        case SyscallCode::PrintString:
+        {
+            Address const          address = Address::MakeFromWord(argument);
+            Memory::Segment const& segment = std::as_const(memory).GetSegmentByBase(address.base);
+            if (address.offset >= segment.size())
+                return TickResult::MemoryOutOfRange;
+
+            uint8_t const* const begin = segment.data() + address.offset;
+            void const* const    end   = std::memchr(begin, 0, segment.size() - address.offset);
+            if (end == nullptr)
+                return TickResult::MemoryOutOfRange;
+
+            Write(reinterpret_cast<char const*>(begin),
+                  static_cast<size_t>(static_cast<uint8_t const*>(end) - begin));
+            break;
+        }
+        case SyscallCode::ReadInt:
+        {
+            // Prompts printed before must be visible while the program waits.
+            Flush();
+
+            int64_t value = 0;
+            if (!(_input >> value))
+            {
+                value = 0;
+                if (!_input.eof())
+                {
+                    _input.clear();
+                    _input.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                }
+            }
+            memory.SetRegister(Memory::V0, static_cast<uint32_t>(value));
+            break;
+        }
+        case SyscallCode::Sbrk:
+        {
+            uint32_t const oldEnd = AlignToWord(memory.GetDataSize());
+            uint64_t const newEnd = uint64_t { oldEnd } + AlignToWord(argument);
+            // Other cores keep referring to a shared segment, and watchpoints to a pinned one, so
+            // neither can move.
+            if (static_cast<int32_t>(argument) < 0 || newEnd > _maxDataSize
+                || memory.IsDataShared() || memory.IsDataPinned())
+            {
+                memory.SetRegister(Memory::V0, static_cast<uint32_t>(-1));
+                break;
+            }
+
+            memory.ResizeData(static_cast<uint32_t>(newEnd));
+            memory.SetRegister(Memory::V0, Address::MakeData(oldEnd));
+            break;
+        }
+        case SyscallCode::Exit:
+        {
+            memory.SetRegister(Memory::PC, Address::MakeText(memory.GetTextSize()));
+            return TickResult::Success;
+        }
+        case SyscallCode::PrintChar:
+        {
+            char const c = static_cast<char>(argument & 0xFF);
+            Write(&c, 1);
+            break;
+        }
+        case SyscallCode::GetCoreId:
+        {
+            memory.SetRegister(Memory::V0, memory.GetCoreId());
+            break;
+        }
+        default: return TickResult::InvalidInstruction;
+    }
+
+    memory.AdvancePC();
+    return TickResult::Success;
+}
+
+void SyscallHost::Flush()
+{
+    if (_buffer.empty())
+        return;
+
+    _output.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+    _output.flush();
+    _buffer.clear();
+}
+
+void SyscallHost::Write(char const* bytes, size_t size)
+{
+    size = static_cast<size_t>(std::min<uint64_t>(size, _maxOutputSize - _outputSize));
+    _outputSize += size;
+    if (size == 0)
+        return;
+
+    if (_buffer.size() + size > _bufferSize)
+    {
+        Flush();
+
+        // Long strings skip the buffer.
+        if (size > _bufferSize)
+        {
+            _output.write(bytes, static_cast<std::streamsize>(size));
+            return;
+        }
+    }
+
+    _buffer.append(bytes, size);
+}
@@ -0,0 +1,291 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Trace.hh>
+
+#include <algorithm>
+
+StateSnapshot::StateSnapshot(std::optional<AddressRange> range) : _registers {}, _range { range }
+{
+    if (_range)
+    {
+        uint32_t const begin = _range->begin;
+        uint32_t const end   = _range->end;
+        if (begin > end)
+            throw std::invalid_argument { "invalid memory range" };
+
+        _words.resize((end - begin) / 4 + 1);
+    }
+}
+
+void StateSnapshot::Capture(Memory const& memory) noexcept
+{
+    for (uint32_t idx = 0; idx <= NumRegisters; ++idx) _registers[idx] = memory.GetRegister(idx);
+
+    if (_range)
+    {
+        uint32_t current = _range->begin;
+        for (uint32_t& word : _words)
+        {
+            word = memory.GetWord(Address::MakeFromWord(current));
+            current += 4;
+        }
+    }
+}
+
+bool StateSnapshot::HasSameValues(StateSnapshot const& other) const noexcept
+{
+    auto const end = _registers.begin() + NumRegisters;
+    return std::equal(_registers.begin(), end, other._registers.begin()) && _words == other._words;
+}
+
+void StateSnapshot::Dump(std::ostream& os) const
+{
+    std::ios_base::fmtflags flags = os.flags();
+
+    os << "Current register values:\n";
+    os << "------------------------------------\n";
+    os << "PC: 0x" << std::hex << _registers[Memory::PC] << '\n';
+    os << "Registers:\n";
+
+    for (uint32_t idx = 0; idx < NumRegisters; ++idx)
+    {
+        os << "R" << std::dec << idx << ": 0x" << std::hex << _registers[idx] << '\n';
+    }
+    os << '\n';
+
+    if (_range)
+    {
+        os << std::hex;
+        os << "Memory content [" << _range->begin << ".." << _range->end << "]:\n";
+        os << "------------------------------------\n";
+
+        uint32_t current = _range->begin;
+        for (uint32_t word : _words)
+        {
+            os << Address::MakeFromWord(current) << ": 0x" << word << '\n';
+            current += 4;
+        }
+        os << '\n';
+    }
+
+    os.flags(flags);
+}
+
+DumpSampler::DumpSampler(DumpTriggers const&         triggers,
+                         std::optional<AddressRange> range,
+                         Memory const&               memory) :
+    _triggers { triggers },
+    _pcBegin { 1 },
+    _pcEnd { 0 },
+    _numTicks { 0 },
+    _nextSample { triggers.every },
+    _wasInRange { false },
+    _ringCapacity { 0 },
+    _ringPos { 0 }
+{
+    if (_triggers.pcRange)
+    {
+        _pcBegin = _triggers.pcRange->begin;
+        _pcEnd   = _triggers.pcRange->end;
+    }
+
+    uint32_t const pc = memory.GetRegister(Memory::PC);
+    _wasInRange       = _pcBegin <= pc && pc <= _pcEnd;
+
+    // The change trigger compares each state with the previous one, so it needs two entries even
+    // without the last ticks.
+    _ringCapacity = _triggers.onChange ? std::max<uint64_t>(_triggers.last, 2) : _triggers.last;
+    if (_ringCapacity > 0)
+    {
+        _ring.push_back(Entry { StateSnapshot { range }, true });
+        _ring[0].state.Capture(memory);
+    }
+}
+
+bool DumpSampler::OnTick(Memory const& memory)
+{
+    ++_numTicks;
+
+    // Combine the triggers without branching on each of them.
+    uint32_t const pc      = memory.GetRegister(Memory::PC);
+    bool const     inRange = _pcBegin <= pc && pc <= _pcEnd;
+    bool const     sampled = _numTicks == _nextSample;
+    bool           rtn     = sampled | (inRange & !_wasInRange) | (_numTicks <= _triggers.first);
+
+    _wasInRange = inRange;
+    _nextSample += sampled * _triggers.every;
+
+    if (!_ring.empty())
+    {
+        // The ring grows up to its capacity, so a large number of last ticks costs nothing for
+        // short runs.
+        size_t const previous = _ringPos;
+        if (_ring.size() < _ringCapacity)
+        {
+            _ring.push_back(_ring[previous]);
+            _ringPos = _ring.size() - 1;
+        }
+        else
+        {
+            _ringPos = (_ringPos + 1) % _ring.size();
+        }
+
+        Entry& entry = _ring[_ringPos];
+        entry.state.Capture(memory);
+
+        rtn |= _triggers.onChange & !entry.state.HasSameValues(_ring[previous].state);
+        entry.dumped = rtn;
+    }
+
+    return rtn;
+}
+
+void DumpSampler::DumpLast(std::ostream& os)
+{
+    size_t const count = static_cast<size_t>(std::min<uint64_t>(_triggers.last, _numTicks));
+    for (size_t i = count; i-- > 0;)
+    {
+        Entry& entry = _ring[(_ringPos + _ring.size() - i) % _ring.size()];
+        if (entry.dumped)
+            continue;
+
+        entry.state.Dump(os);
+        entry.dumped = true;
+    }
+}
+
+TraceWriter::TraceWriter(std::ostream&               os,
+                         std::optional<AddressRange> range,
+                         Memory const&               memory,
+                         size_t                      capacity) :
+    _os { os },
+    _sent { range },
+    _written { range },
+    _records { capacity },
+    _closed { false },
+    _sleeping { false }
+{
+    _sent.Capture(memory);
+    _written = _sent;
+    _thread  = std::thread { &TraceWriter::Run, this };
+}
+
+TraceWriter::~TraceWriter() noexcept
+{
+    Close();
+}
+
+void TraceWriter::Dump(Memory const& memory) noexcept
+{
+    // A tick changes a few values at most, so comparing is much cheaper than formatting.
+    for (uint32_t idx = 0; idx <= NumRegisters; ++idx)
+    {
+        uint32_t const value = memory.GetRegister(idx);
+        if (value != _sent.GetRegister(idx))
+        {
+            _sent.SetRegister(idx, value);
+            Send(TraceRecord { TraceRecord::Kind::Register, idx, value });
+        }
+    }
+
+    for (size_t i = 0; i < _sent.GetNumWords(); ++i)
+    {
+        uint32_t const value = memory.GetWord(Address::MakeFromWord(_sent.GetWordAddress(i)));
+        if (value != _sent.GetWord(i))
+        {
+            _sent.SetWord(i, value);
+            Send(TraceRecord { TraceRecord::Kind::Word, static_cast<uint32_t>(i), value });
+        }
+    }
+
+    Send(TraceRecord { TraceRecord::Kind::Dump, 0, 0 });
+    Wake();
+}
+
+void TraceWriter::Close() noexcept
+{
+    if (!_thread.joinable())
+        return;
+
+    _closed.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock { _mutex };
+        _pushed.notify_one();
+    }
+    _thread.join();
+}
+
+void TraceWriter::Send(TraceRecord const& record) noexcept
+{
+    // The thread may be asleep on an empty buffer which a single dump fills up.
+    if (!_records.TryPush(record))
+    {
+        Wake();
+        _records.Push(record);
+    }
+}
+
+void TraceWriter::Wake() noexcept
+{
+    // Pairs with the fence in Run: either the thread sees the records before it sleeps, or this
+    // sees that it sleeps.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!_sleeping.load(std::memory_order_relaxed))
+        return;
+
+    std::lock_guard<std::mutex> lock { _mutex };
+    _pushed.notify_one();
+}
+
+void TraceWriter::Run() noexcept
+{
+    std::array<TraceRecord, 256> records;
+    while (true)
+    {
+        // Records pushed before closing are visible once the flag is, so the buffer is drained
+        // when it is empty after the flag was seen.
+        bool const   closed = _closed.load(std::memory_order_acquire);
+        size_t const count  = _records.TryPop(records.data(), records.size());
+        if (count == 0)
+        {
+            if (closed)
+                break;
+
+            // The lock is held from the last check until the wait, so that a notification cannot
+            // come in between.
+            std::unique_lock<std::mutex> lock { _mutex };
+            _sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!_closed.load(std::memory_order_acquire) && _records.IsEmpty())
+                _pushed.wait(lock);
+            _sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            TraceRecord const& record = records[i];
+            switch (record.kind)
+            {
+                case TraceRecord::Kind::Register:
+                {
+                    _written.SetRegister(record.index, record.value);
+                    break;
+                }
+                case TraceRecord::Kind::Word:
+                {
+                    _written.SetWord(record.index, record.value);
+                    break;
+                }
+                case TraceRecord::Kind::Dump:
+                {
+                    _written.Dump(_os);
+                    break;
+                }
+            }
+        }
+    }
+
+    _os.flush();
+}
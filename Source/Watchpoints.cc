@@ -0,0 +1,333 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <simple-mips-emu/Common.hh>
+#include <simple-mips-emu/Watchpoints.hh>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__) && defined(__x86_64__)
+#    define SIMPLE_MIPS_EMU_WATCHPOINTS_SUPPORTED 1
+#    include <signal.h>
+#    include <sys/mman.h>
+#    include <ucontext.h>
+#else
+#    define SIMPLE_MIPS_EMU_WATCHPOINTS_SUPPORTED 0
+#endif
+
+#if SIMPLE_MIPS_EMU_WATCHPOINTS_SUPPORTED
+
+namespace
+{
+
+Memory::Segment const& GetData(Memory const& memory) noexcept
+{
+    return memory.GetSegmentByBase(Address::BaseType::Data);
+}
+
+/// <summary>
+/// Returns the host pointer to the data segment. Only the protection of its pages is changed
+/// through it.
+/// </summary>
+uint8_t* GetDataPointer(Memory const& memory) noexcept
+{
+    return const_cast<uint8_t*>(GetData(memory).data());
+}
+
+}
+
+/// <summary>
+/// Signal handlers of the active instance. A store to a protected page raises SIGSEGV; the handler
+/// unprotects the page, takes a snapshot of it and sets the trap flag, so that SIGTRAP is raised
+/// right after the store completes. The second handler compares the watched words with the
+/// snapshot, records the changes and protects the page again.
+/// </summary>
+struct WatchpointsHandler
+{
+    constexpr static greg_t TrapFlag = 0x100;
+
+    // An unaligned word store may touch two pages.
+    constexpr static size_t MaxPendingPages = 2;
+
+    static Watchpoints*     active;
+    static struct sigaction oldSegvAction;
+    static struct sigaction oldTrapAction;
+
+    static std::vector<uint8_t> snapshots;
+    static size_t               pendingPages[MaxPendingPages];
+    static size_t               numPendingPages;
+    static bool                 pendingReport;
+
+    static bool IsWatched(uint32_t offset) noexcept
+    {
+        uint32_t const address = Address::MakeData(offset & ~3u);
+        return std::any_of(active->_ranges.begin(),
+                           active->_ranges.end(),
+                           [address](Watchpoints::Range const& range) {
+                               return range.begin <= address && address <= range.end;
+                           });
+    }
+
+    /// <summary>
+    /// Passes a signal which was not raised by a watched page to the previous action. The handlers
+    /// stay installed, so that the watchpoints keep working after a foreign signal.
+    /// </summary>
+    static void Forward(int signal, siginfo_t* info, void* context) noexcept
+    {
+        struct sigaction const& old = signal == SIGSEGV ? oldSegvAction : oldTrapAction;
+        if ((old.sa_flags & SA_SIGINFO) != 0)
+            return old.sa_sigaction(signal, info, context);
+        if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN)
+            return old.sa_handler(signal);
+        if (old.sa_handler == SIG_IGN && signal == SIGTRAP)
+            return;
+
+        // The default action terminates the process, as does a fault whose signal is ignored, so
+        // the previous action is restored for good. The signal is blocked until the handler
+        // returns; a fault is raised again by the instruction itself.
+        sigaction(signal, &old, nullptr);
+        raise(signal);
+    }
+
+    static void OnSegv(int signal, siginfo_t* info, void* context) noexcept
+    {
+        if (active == nullptr || numPendingPages == MaxPendingPages)
+            return Forward(signal, info, context);
+
+        uint8_t* const data   = GetDataPointer(active->_memory);
+        uint8_t* const fault  = static_cast<uint8_t*>(info->si_addr);
+        size_t const   offset = static_cast<size_t>(fault - data);
+        if (fault < data || offset >= GetData(active->_memory).size())
+            return Forward(signal, info, context);
+
+        size_t const pageSize = GetPageSize();
+        size_t const page     = offset / pageSize;
+        if (!std::binary_search(active->_pages.begin(), active->_pages.end(), page))
+            return Forward(signal, info, context);
+
+        uint8_t* const pageBegin = data + page * pageSize;
+        if (mprotect(pageBegin, pageSize, PROT_READ | PROT_WRITE) != 0)
+            return Forward(signal, info, context);
+
+        // Stores to unwatched words on the page are only stepped over.
+        uint32_t const wordOffset = static_cast<uint32_t>(offset);
+        if (IsWatched(wordOffset) || IsWatched(wordOffset + 3))
+            pendingReport = true;
+
+        std::memcpy(snapshots.data() + numPendingPages * pageSize, pageBegin, pageSize);
+        pendingPages[numPendingPages++] = page;
+
+        static_cast<ucontext_t*>(context)->uc_mcontext.gregs[REG_EFL] |= TrapFlag;
+    }
+
+    static void OnTrap(int signal, siginfo_t* info, void* context) noexcept
+    {
+        if (active == nullptr || numPendingPages == 0)
+            return Forward(signal, info, context);
+
+        static_cast<ucontext_t*>(context)->uc_mcontext.gregs[REG_EFL] &= ~TrapFlag;
+
+        uint8_t* const data     = GetDataPointer(active->_memory);
+        size_t const   pageSize = GetPageSize();
+        for (size_t i = 0; i < numPendingPages; ++i)
+        {
+            uint8_t* const pageBegin = data + pendingPages[i] * pageSize;
+            if (pendingReport)
+                Report(pendingPages[i], snapshots.data() + i * pageSize);
+            mprotect(pageBegin, pageSize, PROT_READ);
+        }
+
+        numPendingPages = 0;
+        pendingReport   = false;
+    }
+
+    static void Report(size_t page, uint8_t const* snapshot) noexcept
+    {
+        Memory&        memory   = active->_memory;
+        uint32_t const pc       = memory.GetRegister(Memory::PC);
+        size_t const   pageSize = GetPageSize();
+        uint32_t const begin    = Address::MakeData(static_cast<uint32_t>(page * pageSize));
+        uint32_t const end      = begin + static_cast<uint32_t>(pageSize);
+
+        for (Watchpoints::Range const& range : active->_ranges)
+        {
+            for (uint32_t address = std::max(range.begin, begin);
+                 address <= range.end && address < end;
+                 address += 4)
+            {
+                uint8_t const* before = snapshot + (address - begin);
+                uint32_t       newValue = memory.GetWord(Address::MakeFromWord(address));
+                uint32_t       oldValue = static_cast<uint32_t>(before[0]) << 24
+                                    | static_cast<uint32_t>(before[1]) << 16
+                                    | static_cast<uint32_t>(before[2]) << 8
+                                    | static_cast<uint32_t>(before[3]) << 0;
+                if (oldValue == newValue)
+                    continue;
+
+                if (active->_hits.size() < active->_maxHits)
+                    active->_hits.push_back(WatchpointHit { pc, address, oldValue, newValue });
+                else
+                    ++active->_numDroppedHits;
+
+                if (range.action == WatchAction::Stop && !active->_stopped)
+                {
+                    // The store completes, and the engine stops as the PC is past the text
+                    // segment. Resume() puts the PC back.
+                    active->_stopped   = true;
+                    active->_stoppedPC = pc;
+                    memory.SetRegister(Memory::PC, Address::MakeText(memory.GetTextSize()));
+                }
+            }
+        }
+    }
+
+    static bool Install() noexcept
+    {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_SIGINFO;
+
+        action.sa_sigaction = OnSegv;
+        if (sigaction(SIGSEGV, &action, &oldSegvAction) != 0)
+            return false;
+
+        action.sa_sigaction = OnTrap;
+        if (sigaction(SIGTRAP, &action, &oldTrapAction) != 0)
+        {
+            sigaction(SIGSEGV, &oldSegvAction, nullptr);
+            return false;
+        }
+
+        return true;
+    }
+
+    static void Uninstall() noexcept
+    {
+        sigaction(SIGSEGV, &oldSegvAction, nullptr);
+        sigaction(SIGTRAP, &oldTrapAction, nullptr);
+    }
+};
+
+Watchpoints*         WatchpointsHandler::active = nullptr;
+struct sigaction     WatchpointsHandler::oldSegvAction;
+struct sigaction     WatchpointsHandler::oldTrapAction;
+std::vector<uint8_t> WatchpointsHandler::snapshots;
+size_t               WatchpointsHandler::pendingPages[MaxPendingPages];
+size_t               WatchpointsHandler::numPendingPages = 0;
+bool                 WatchpointsHandler::pendingReport   = false;
+
+#endif
+
+Watchpoints::Watchpoints(Memory& memory, size_t maxHits) :
+    _memory { memory },
+    _maxHits { maxHits },
+    _numDroppedHits { 0 },
+    _stopped { false },
+    _stoppedPC { 0 }
+{
+    // The handler must not allocate.
+    _hits.reserve(maxHits);
+}
+
+Watchpoints::~Watchpoints() noexcept
+{
+    Clear();
+}
+
+bool Watchpoints::IsSupported() noexcept
+{
+    return SIMPLE_MIPS_EMU_WATCHPOINTS_SUPPORTED;
+}
+
+bool Watchpoints::Watch(Address start, Address end, WatchAction action)
+{
+#if SIMPLE_MIPS_EMU_WATCHPOINTS_SUPPORTED
+    using Handler = WatchpointsHandler;
+
+    size_t const dataSize = GetData(_memory).size();
+    if (start.base != Address::BaseType::Data || end.base != Address::BaseType::Data
+        || start.offset > end.offset || static_cast<size_t>(end.offset) + 4 > dataSize)
+        return false;
+
+    if (Handler::active != nullptr && Handler::active != this)
+        return false;
+
+    size_t const pageSize = GetPageSize();
+    if (Handler::active == nullptr)
+    {
+        Handler::snapshots.resize(pageSize * Handler::MaxPendingPages);
+        if (!Handler::Install())
+            return false;
+        Handler::active = this;
+    }
+
+    // The protected pages must stay where they are.
+    _memory.PinData(true);
+
+    uint8_t* const      data = GetDataPointer(_memory);
+    std::vector<size_t> added;
+    for (size_t page = (start.offset & ~3u) / pageSize; page <= (end.offset + 3) / pageSize; ++page)
+    {
+        auto it = std::lower_bound(_pages.begin(), _pages.end(), page);
+        if (it != _pages.end() && *it == page)
+            continue;
+
+        if (mprotect(data + page * pageSize, pageSize, PROT_READ) != 0)
+        {
+            // The range is not watched at all, rather than only on some of its pages.
+            for (size_t addedPage : added)
+            {
+                mprotect(data + addedPage * pageSize, pageSize, PROT_READ | PROT_WRITE);
+                _pages.erase(std::lower_bound(_pages.begin(), _pages.end(), addedPage));
+            }
+            if (_pages.empty())
+                Clear();
+            return false;
+        }
+
+        _pages.insert(it, page);
+        added.push_back(page);
+    }
+
+    uint32_t const begin = Address::MakeData(start.offset & ~3u);
+    _ranges.push_back(Range { begin, end, action });
+    return true;
+#else
+    (void)start;
+    (void)end;
+    (void)action;
+    return false;
+#endif
+}
+
+void Watchpoints::Clear() noexcept
+{
+#if SIMPLE_MIPS_EMU_WATCHPOINTS_SUPPORTED
+    using Handler = WatchpointsHandler;
+
+    if (Handler::active != this)
+        return;
+
+    size_t const   pageSize = GetPageSize();
+    uint8_t* const data     = GetDataPointer(_memory);
+    for (size_t page : _pages) mprotect(data + page * pageSize, pageSize, PROT_READ | PROT_WRITE);
+    _memory.PinData(false);
+
+    Handler::Uninstall();
+    Handler::active = nullptr;
+#endif
+
+    _ranges.clear();
+    _pages.clear();
+}
+
+void Watchpoints::Resume() noexcept
+{
+    if (!_stopped)
+        return;
+
+    _memory.SetRegister(Memory::PC, _stoppedPC + 4);
+    _stopped = false;
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Disassembly.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <random>
+#include <sstream>
+
+namespace
+{
+
+std::vector<uint8_t> MakeBytesFromWords(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+    {
+        rtn.push_back(static_cast<uint8_t>(word >> 24));
+        rtn.push_back(static_cast<uint8_t>(word >> 16));
+        rtn.push_back(static_cast<uint8_t>(word >> 8));
+        rtn.push_back(static_cast<uint8_t>(word >> 0));
+    }
+
+    return rtn;
+}
+
+bool operator==(Instruction const& l, Instruction const& r)
+{
+    return l.operation == r.operation && l.rs == r.rs && l.rt == r.rt && l.rd == r.rd
+           && l.immediate == r.immediate;
+}
+
+// The text segment of the GCD program in EmulationTest.cc
+std::vector<uint32_t> const _gcd {
+    0x3c1d1000, 0x37bd0080, 0x3c040013, 0x34840c02, 0x3c05005e, 0x34a55e67, 0xc100008,
+    0x810001b,  0x27bdfffc, 0xafbf0000, 0x14850004, 0x41021,    0x8fbf0000, 0x27bd0004,
+    0x3e00008,  0xa4082b,   0x10200005, 0x852023,   0xc100008,  0x8fbf0000, 0x27bd0004,
+    0x3e00008,  0xa42823,   0xc100008,  0x8fbf0000, 0x27bd0004, 0x3e00008,
+};
+
+}
+
+TEST(DisassemblyTest, BulkDecodeMatchesDecode)
+{
+    std::mt19937          random { 42 };
+    std::vector<uint32_t> words;
+
+    // Every operation, function and rt field, plus random words
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        words.push_back(i << 26 | (random() & 0x03FFFFFF));
+        words.push_back((random() & 0x03FFFFC0) | i);
+        words.push_back(0x04000000 | (i & 0b11111) << 16 | (random() & 0x03E0FFFF));
+    }
+    for (uint32_t i = 0; i < 1003; ++i) words.push_back(static_cast<uint32_t>(random()));
+
+    std::vector<uint8_t>     bytes = MakeBytesFromWords(words);
+    std::vector<Instruction> instructions(words.size());
+    Decode(bytes.data(), words.size(), instructions.data());
+
+    for (size_t i = 0; i < words.size(); ++i) ASSERT_TRUE(instructions[i] == Decode(words[i]));
+}
+
+TEST(DisassemblyTest, ControlFlowGraph)
+{
+    std::vector<uint8_t>     bytes = MakeBytesFromWords(_gcd);
+    std::vector<Instruction> instructions(_gcd.size());
+    Decode(bytes.data(), _gcd.size(), instructions.data());
+
+    ControlFlowGraph graph { instructions.data(), instructions.size() };
+
+    std::vector<uint32_t> expectedBegins { 0x400000, 0x40001c, 0x400020, 0x40002c, 0x40003c,
+                                           0x400044, 0x40004c, 0x400058, 0x400060 };
+    auto const&           blocks = graph.GetBlocks();
+    ASSERT_EQ(blocks.size(), expectedBegins.size());
+    for (size_t i = 0; i < blocks.size(); ++i) ASSERT_EQ(blocks[i].begin, expectedBegins[i]);
+
+    // jal gcd
+    ASSERT_EQ(blocks[0].successors, (std::vector<uint32_t> { 0x400020, 0x40001c }));
+    // j end, which is outside of the text segment
+    ASSERT_TRUE(blocks[1].successors.empty());
+    // bne $4, $5, elif
+    ASSERT_EQ(blocks[2].successors, (std::vector<uint32_t> { 0x40003c, 0x40002c }));
+    // jr $31
+    ASSERT_TRUE(blocks[3].successors.empty());
+
+    ASSERT_EQ(graph.GetCallTargets(), std::vector<uint32_t> { 0x400020 });
+
+    ASSERT_EQ(graph.FindBlock(0x400034), std::addressof(blocks[3]));
+    ASSERT_EQ(graph.FindBlock(0x40006c), nullptr);
+    ASSERT_TRUE(graph.IsLeader(8));
+    ASSERT_FALSE(graph.IsLeader(9));
+}
+
+TEST(DisassemblyTest, Disassemble)
+{
+    auto disassemble = [](uint32_t word, uint32_t address) {
+        std::ostringstream oss;
+        Disassemble(oss, Decode(word), address);
+        return oss.str();
+    };
+
+    ASSERT_EQ(disassemble(0x2529fff8, 0x400000), "addiu $9, $9, -8");
+    ASSERT_EQ(disassemble(0x35290028, 0x400000), "ori $9, $9, 0x28");
+    ASSERT_EQ(disassemble(0x014b5021, 0x400000), "addu $10, $10, $11");
+    ASSERT_EQ(disassemble(0xad0a0008, 0x400000), "sw $10, 8($8)");
+    ASSERT_EQ(disassemble(0x1509fffa, 0x40001c), "bne $8, $9, 0x400008");
+    ASSERT_EQ(disassemble(0x0c100008, 0x400018), "jal 0x400020");
+    ASSERT_EQ(disassemble(0x03e00008, 0x400000), "jr $31");
+    ASSERT_EQ(disassemble(0x3c1d1000, 0x400000), "lui $29, 0x1000");
+    ASSERT_EQ(disassemble(0x01095004, 0x400000), "sllv $10, $9, $8");
+    ASSERT_EQ(disassemble(0x0100f809, 0x400000), "jalr $31, $8");
+    ASSERT_EQ(disassemble(0x0109001a, 0x400000), "div $8, $9");
+    ASSERT_EQ(disassemble(0x00005012, 0x400000), "mflo $10");
+    ASSERT_EQ(disassemble(0x1900fffe, 0x400008), "blez $8, 0x400004");
+    ASSERT_EQ(disassemble(0x0511fffe, 0x400008), "bgezal $8, 0x400004");
+    ASSERT_EQ(disassemble(0x950afffe, 0x400000), "lhu $10, -2($8)");
+    ASSERT_EQ(disassemble(0x0000000d, 0x400000), "break");
+    ASSERT_EQ(disassemble(0xFC000000, 0x400000), "invalid");
+}
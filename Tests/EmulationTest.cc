@@ -418,7 +418,7 @@ TEST(EmulationTest, SelectionSort)
 main:
     addiu   $8,  $0,  5
 while_cond:
-    sltiu   $1,  $8,  -5
+    slti    $1,  $8,  -5
     bne     $1,  $0,  end
 while_body:
     addiu   $8,  $8,  -1
@@ -439,7 +439,7 @@ char const _simpleLoop[] = R"===(
     0x14
     0x0
     0x24080005
-    0x2d01fffb
+    0x2901fffb
     0x14200002
     0x2508ffff
     0x8100001
@@ -524,3 +524,190 @@ TEST(EmulationTest, Strlen)
 
     ASSERT_EQ(memory.GetRegister(8), 13);
 }
+
+/*
+    .data
+values:
+    .word 0xFFFFFFF9
+    .word 0x00000002
+    .word 0x12345678
+    .word 0
+    .text
+main:
+    la      $8,  values
+    lw      $9,  0($8)
+    lw      $10, 4($8)
+    div     $9,  $10
+    mflo    $11
+    mfhi    $12
+    mult    $9,  $9
+    mflo    $13
+    multu   $9,  $10
+    mfhi    $14
+    sra     $15, $9,  1
+    srav    $16, $9,  $10
+    slt     $17, $9,  $10
+    lh      $18, 8($8)
+    lhu     $19, 2($8)
+    lbu     $20, 0($8)
+    sh      $9,  12($8)
+    lwl     $21, 9($8)
+    lwr     $21, 9($8)
+    bgtz    $9,  end
+    bltz    $9,  skip
+    addiu   $22, $0,  1
+skip:
+    la      $23, func
+    jalr    $31, $23
+    j       end
+func:
+    xori    $24, $10, 0xF
+    jr      $31
+end:
+*/
+
+char const _mipsI[] = R"===(
+    0x70
+    0x10
+    0x3c081000
+    0x8d090000
+    0x8d0a0004
+    0x12a001a
+    0x5812
+    0x6010
+    0x1290018
+    0x6812
+    0x12a0019
+    0x7010
+    0x97843
+    0x1498007
+    0x12a882a
+    0x85120008
+    0x95130002
+    0x91140000
+    0xa509000c
+    0x89150009
+    0x99150009
+    0x1d200008
+    0x5200001
+    0x24160001
+    0x3c170040
+    0x36f70068
+    0x2e0f809
+    0x810001c
+    0x3958000f
+    0x3e00008
+    0xfffffff9
+    0x2
+    0x12345678
+    0x0
+)===";
+
+TEST(EmulationTest, MipsI)
+{
+    std::istringstream iss { _mipsI };
+
+    FileReadResult result = ReadFile(iss);
+    ASSERT_TRUE(std::holds_alternative<CanRead>(result));
+
+    CanRead file = std::get<CanRead>(result);
+    Memory  memory { std::move(file.text), std::move(file.data) };
+
+    while (!memory.IsTerminated())
+    {
+        auto result = Tick(memory);
+        ASSERT_EQ(result, TickResult::Success);
+    }
+
+    ASSERT_EQ(memory.GetRegister(11), static_cast<uint32_t>(-3));
+    ASSERT_EQ(memory.GetRegister(12), static_cast<uint32_t>(-1));
+    ASSERT_EQ(memory.GetRegister(13), 49);
+    ASSERT_EQ(memory.GetRegister(14), 1);
+    ASSERT_EQ(memory.GetRegister(Memory::LO), 0xFFFFFFF2);
+    ASSERT_EQ(memory.GetRegister(15), static_cast<uint32_t>(-4));
+    ASSERT_EQ(memory.GetRegister(16), static_cast<uint32_t>(-2));
+    ASSERT_EQ(memory.GetRegister(17), 1);
+    ASSERT_EQ(memory.GetRegister(18), 0x1234);
+    ASSERT_EQ(memory.GetRegister(19), 0xFFF9);
+    ASSERT_EQ(memory.GetRegister(20), 0xFF);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(12)), 0xFFF90000);
+    ASSERT_EQ(memory.GetRegister(21), 0x34561234);
+    ASSERT_EQ(memory.GetRegister(22), 0);
+    ASSERT_EQ(memory.GetRegister(24), 13);
+    ASSERT_EQ(memory.GetRegister(Memory::RA), 0x400064);
+}
+
+TEST(EmulationTest, Trap)
+{
+    // lui $8, 0x7fff; add $9, $8, $8; addi $9, $8, -1; break
+    Memory  memory { 16, 0 };
+    Address address = Address::MakeText(0);
+    for (uint32_t word : { 0x3c087fff, 0x01084820, 0x2109ffff, 0x0000000d })
+    {
+        memory.SetWord(address, word);
+        address.MoveToNext();
+    }
+
+    ASSERT_EQ(Tick(memory), TickResult::Success);
+    ASSERT_EQ(Tick(memory), TickResult::Trap);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(4));
+    ASSERT_EQ(memory.GetRegister(9), 0);
+
+    // Only the overflowing operations trap.
+    memory.SetRegister(Memory::PC, Address::MakeText(8));
+    ASSERT_EQ(Tick(memory), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(9), 0x7ffeffff);
+    ASSERT_EQ(Tick(memory), TickResult::Trap);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(12));
+}
+
+TEST(EmulationTest, SetLessThanImmediate)
+{
+    // slti $9, $8, -1; sltiu $10, $8, -1; sltiu $11, $8, 1
+    Memory  memory { 12, 0 };
+    Address address = Address::MakeText(0);
+    for (uint32_t word : { 0x2909ffff, 0x2d0affff, 0x2d0b0001 })
+    {
+        memory.SetWord(address, word);
+        address.MoveToNext();
+    }
+    memory.SetRegister(8, 5);
+
+    // Both sign-extend the immediate, but only slti compares as signed.
+    for (int i = 0; i < 3; ++i) ASSERT_EQ(Tick(memory), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(9), 0);
+    ASSERT_EQ(memory.GetRegister(10), 1);
+    ASSERT_EQ(memory.GetRegister(11), 0);
+}
+
+TEST(EmulationTest, RunMatchesTick)
+{
+    for (char const* source : { _fibonacci, _gcd, _selectionSort, _simpleLoop, _strlen, _mipsI })
+    {
+        std::istringstream iss { source };
+
+        FileReadResult result = ReadFile(iss);
+        ASSERT_TRUE(std::holds_alternative<CanRead>(result));
+
+        CanRead file = std::get<CanRead>(result);
+        Memory  expected { std::move(file.text), std::move(file.data) };
+        Memory  actual { expected };
+
+        uint64_t numInstructions = 0;
+        while (!expected.IsTerminated())
+        {
+            ASSERT_EQ(Tick(expected), TickResult::Success);
+            ++numInstructions;
+        }
+
+        Program   program { actual };
+        RunResult runResult = RunProgram(actual, program, numInstructions + 1);
+        ASSERT_EQ(runResult.result, TickResult::Success);
+        ASSERT_EQ(runResult.numInstructions, numInstructions);
+
+        for (uint32_t i = 0; i < RegisterFileSize; ++i)
+            ASSERT_EQ(actual.GetRegister(i), expected.GetRegister(i));
+        for (uint32_t i = 0; i < expected.GetDataSize(); ++i)
+            ASSERT_EQ(actual.GetByte(Address::MakeData(i)), expected.GetByte(Address::MakeData(i)));
+    }
+}
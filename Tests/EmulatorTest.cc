@@ -0,0 +1,126 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Emulator.hh>
+#include <simple-mips-emu/sme.h>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t> ToBytes(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rtn.push_back(static_cast<uint8_t>(word >> shift & 0xFF));
+
+    return rtn;
+}
+
+// Doubles the first data word into the second one.
+std::vector<uint8_t> const Text = ToBytes({
+    0x3c081000, // lui  $8, 0x1000
+    0x8d090000, // lw   $9, 0($8)
+    0x01294821, // addu $9, $9, $9
+    0xad090004, // sw   $9, 4($8)
+});
+
+}
+
+TEST(EmulatorTest, Reuse)
+{
+    Emulator      emulator;
+    Memory const& memory = emulator.GetMemory();
+
+    std::vector<uint8_t> const data = ToBytes({ 21, 0 });
+    emulator.Reset(Text.data(), Text.size(), data.data(), data.size());
+    RunResult result = emulator.Run(RunLimits {});
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 4);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 42);
+
+    uint8_t const* dataBuffer = memory.GetSegmentByBase(Address::BaseType::Data).data();
+
+    // The same text with other data neither decodes again nor allocates.
+    std::vector<uint8_t> const otherData = ToBytes({ 5, 0 });
+    emulator.Reset(Text.data(), Text.size(), otherData.data(), otherData.size());
+    ASSERT_EQ(memory.GetRegister(9), 0);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(0));
+    ASSERT_EQ(memory.GetSegmentByBase(Address::BaseType::Data).data(), dataBuffer);
+
+    result = emulator.Run(RunLimits {});
+    ASSERT_EQ(result.numInstructions, 4);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 10);
+    ASSERT_EQ(emulator.GetStats().numDecodes, 1);
+
+    std::vector<uint8_t> const shorterText(Text.begin(), Text.end() - 4);
+    emulator.Reset(shorterText.data(), shorterText.size(), data.data(), data.size());
+    result = emulator.Run(RunLimits {});
+    ASSERT_EQ(result.numInstructions, 3);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 0);
+
+    EmulatorStats const& stats = emulator.GetStats();
+    ASSERT_EQ(stats.numLoads, 3);
+    ASSERT_EQ(stats.numDecodes, 2);
+    ASSERT_EQ(stats.numInstructions, 11);
+}
+
+TEST(EmulatorTest, CApi)
+{
+    sme_emulator* emulator = sme_create();
+    ASSERT_NE(emulator, nullptr);
+
+    std::vector<uint8_t> const data = ToBytes({ 21, 0 });
+    ASSERT_EQ(sme_load(emulator, Text.data(), 3, data.data(), data.size()), SME_INVALID_ARGUMENT);
+    ASSERT_EQ(sme_load(emulator, Text.data(), Text.size(), data.data(), data.size()), SME_OK);
+
+    uint64_t numInstructions = 0;
+    ASSERT_EQ(sme_run(emulator, 2, 0, &numInstructions), SME_OK);
+    ASSERT_EQ(numInstructions, 2);
+    ASSERT_EQ(sme_is_terminated(emulator), 0);
+    ASSERT_EQ(sme_run(emulator, 100, 1000, &numInstructions), SME_OK);
+    ASSERT_EQ(numInstructions, 2);
+    ASSERT_EQ(sme_is_terminated(emulator), 1);
+
+    uint32_t value = 0;
+    ASSERT_EQ(sme_read_register(emulator, 9, &value), SME_OK);
+    ASSERT_EQ(value, 42);
+    ASSERT_EQ(sme_read_register(emulator, 34, &value), SME_OK);
+    ASSERT_EQ(value, 0);
+    ASSERT_EQ(sme_read_register(emulator, 35, &value), SME_INVALID_ARGUMENT);
+
+    uint8_t bytes[4];
+    ASSERT_EQ(sme_read_mem(emulator, 0x10000004, bytes, 4), SME_OK);
+    ASSERT_EQ(bytes[3], 42);
+    ASSERT_EQ(sme_read_mem(emulator, 0x10000006, bytes, 4), SME_MEMORY_OUT_OF_RANGE);
+    ASSERT_EQ(sme_read_mem(emulator, 0x1000, bytes, 4), SME_MEMORY_OUT_OF_RANGE);
+    ASSERT_EQ(sme_load_file(emulator, "/nonexistent"), SME_CANNOT_READ_FILE);
+
+    sme_destroy(emulator);
+}
+
+TEST(EmulatorTest, CApiBadPaths)
+{
+    sme_emulator* emulator = sme_create();
+    ASSERT_NE(emulator, nullptr);
+
+    std::vector<uint8_t> const data = ToBytes({ 21, 0 });
+    ASSERT_EQ(sme_load(emulator, Text.data(), Text.size(), data.data(), data.size()), SME_OK);
+
+    // Neither a path longer than the host allows nor a too long file name escapes as an
+    // exception, and the loaded program stays.
+    std::string const longPath(6000, 'a');
+    ASSERT_EQ(sme_load_file(emulator, longPath.c_str()), SME_CANNOT_READ_FILE);
+    std::string const longName = "/tmp/" + std::string(300, 'a');
+    ASSERT_EQ(sme_load_file(emulator, longName.c_str()), SME_CANNOT_READ_FILE);
+
+    uint64_t numInstructions = 0;
+    ASSERT_EQ(sme_run(emulator, 100, 0, &numInstructions), SME_OK);
+    ASSERT_EQ(sme_is_terminated(emulator), 1);
+
+    sme_destroy(emulator);
+}
@@ -5,6 +5,8 @@
 #include <simple-mips-emu/File.hh>
 
 #include "TestCommon.hh"
+#include <fstream>
+#include <iterator>
 #include <sstream>
 
 char const _validCase[] = R"===(
@@ -86,4 +88,60 @@ TEST(FileTest, InvalidSectionSize)
 
     CannotRead error = std::get<CannotRead>(result);
     ASSERT_EQ(error.error.type, FileReadError::Type::SectionSizeDoesNotMatch);
-}
\ No newline at end of file
+}
+
+TEST(FileTest, ExportMemory)
+{
+    Memory memory { 8, 12 };
+    memory.SetWord(Address::MakeText(4), 0x01020304);
+    memory.SetWord(Address::MakeData(0), 0x11223344);
+    memory.SetWord(Address::MakeData(8), 0xAABBCCDD);
+
+    auto readFile = [](std::filesystem::path const& path) {
+        std::ifstream ifs { path, std::ios::binary };
+        return std::vector<uint8_t> { std::istreambuf_iterator<char> { ifs }, {} };
+    };
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "file-test-export.bin";
+
+    // The range runs past the end of the data segment, which reads as zeros.
+    ASSERT_FALSE(
+        ExportMemory(path, memory, Address::MakeData(4), Address::MakeData(12), ByteOrder::Big));
+    {
+        // clang-format off
+        std::vector<uint8_t> expected {
+            'S', 'M', 'E', 'I',
+            0x01, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00,
+            0x04, 0x00, 0x00, 0x10,
+            0x0C, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00,
+            0xAA, 0xBB, 0xCC, 0xDD,
+            0x00, 0x00, 0x00, 0x00,
+        };
+        // clang-format on
+
+        std::vector<uint8_t> actual = readFile(path);
+        ASSERT_EQ_VECTOR(actual, expected, *lit, *rit);
+    }
+
+    ASSERT_FALSE(ExportSegment(path, memory, Address::BaseType::Text, ByteOrder::Little));
+    {
+        std::vector<uint8_t> actual = readFile(path);
+        ASSERT_EQ(actual.size(), sizeof(MemoryImageHeader) + 8);
+        ASSERT_EQ(actual[8], 1);
+        ASSERT_EQ(actual[12], 0x00);
+        ASSERT_EQ(actual[14], 0x40);
+
+        std::vector<uint8_t> text(actual.begin() + sizeof(MemoryImageHeader), actual.end());
+        std::vector<uint8_t> expected { 0, 0, 0, 0, 0x04, 0x03, 0x02, 0x01 };
+        ASSERT_EQ_VECTOR(text, expected, *lit, *rit);
+    }
+
+    ASSERT_TRUE(
+        ExportMemory(path, memory, Address::MakeData(8), Address::MakeData(4), ByteOrder::Big));
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Fuzz.hh>
+
+#include <algorithm>
+
+TEST(FuzzTest, EncodeMatchesDecode)
+{
+    std::mt19937_64 random { 1 };
+    for (size_t i = 0; i < 100; ++i)
+    {
+        FuzzProgram program = GenerateProgram(random, FuzzOptions {});
+        for (uint32_t word : program.text)
+        {
+            Instruction instruction = Decode(word);
+            ASSERT_NE(instruction.operation, Operation::Invalid);
+            ASSERT_EQ(Encode(instruction), word);
+        }
+    }
+
+    ASSERT_EQ(Encode(Instruction { Operation::LUI_ORI, 0, 0, 0, 0 }), InvalidWord);
+}
+
+TEST(FuzzTest, Lockstep)
+{
+    std::mt19937_64 random { 2 };
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        FuzzProgram program = GenerateProgram(random, FuzzOptions {});
+
+        auto divergence = RunLockstep(program, MakeTickEngine, MakeProgramEngine, 500, 7);
+        ASSERT_FALSE(divergence) << divergence->reason;
+    }
+}
+
+TEST(FuzzTest, FastForward)
+{
+    std::mt19937_64 random { 0 };
+    for (int i = 0; i < 1000; ++i)
+    {
+        // loop: addiu $8, $8, k; bne $8, $9, loop (or bne $9, $8, loop); addiu $10, $8, 0
+        uint32_t const immediate = random() % 2 == 0
+                                       ? static_cast<uint32_t>(random() % 17 + 0xFFF8) & 0xFFFF
+                                       : static_cast<uint32_t>(random() << random() % 16) & 0xFFFF;
+        FuzzProgram program;
+        program.text = { 0x25080000 | immediate,
+                         random() % 2 == 0 ? 0x1509fffeu : 0x1528fffeu,
+                         0x250a0000 };
+        program.registers.fill(0);
+        program.registers[8] = static_cast<uint32_t>(random() % 64);
+        program.registers[9] = static_cast<uint32_t>(random() % 64);
+
+        uint64_t const interval   = random() % 2000 + 1;
+        auto           divergence = RunLockstep(
+            program, MakeTickEngine, MakeFastForwardEngine, 10000, interval);
+        ASSERT_FALSE(divergence) << divergence->reason;
+    }
+}
+
+TEST(FuzzTest, Shrink)
+{
+    // An engine which gets NOR wrong.
+    auto makeBrokenEngine = [](Memory const&) -> Engine {
+        return [](Memory& memory, uint64_t maxInstructions) {
+            RunResult rtn { TickResult::Success, 0, 0 };
+            while (rtn.numInstructions < maxInstructions && !memory.IsTerminated())
+            {
+                Instruction instruction =
+                    Decode(memory.GetWord(Address::MakeFromWord(memory.GetRegister(Memory::PC))));
+                if (TickResult result = Tick(memory); result != TickResult::Success)
+                {
+                    rtn.result = result;
+                    break;
+                }
+                if (instruction.operation == Operation::NOR)
+                    memory.SetRegister(instruction.rd, memory.GetRegister(instruction.rd) ^ 1);
+                ++rtn.numInstructions;
+            }
+
+            return rtn;
+        };
+    };
+
+    auto fails = [&](FuzzProgram const& program) {
+        return RunLockstep(program, MakeTickEngine, makeBrokenEngine, 500, 7).has_value();
+    };
+
+    std::mt19937_64 random { 3 };
+    FuzzProgram     program;
+    do
+    {
+        program = GenerateProgram(random, FuzzOptions {});
+    } while (!fails(program));
+
+    program = Shrink(program, fails);
+    ASSERT_TRUE(fails(program));
+
+    // Only the NOR is left, at the end of the program.
+    ASSERT_EQ(Decode(program.text.back()).operation, Operation::NOR);
+    ASSERT_EQ(std::count(program.text.begin(), program.text.end(), 0), program.text.size() - 1);
+    ASSERT_TRUE(std::all_of(program.data.begin(), program.data.end(), [](uint8_t byte) {
+        return byte == 0;
+    }));
+}
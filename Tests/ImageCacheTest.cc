@@ -0,0 +1,158 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Emulator.hh>
+#include <simple-mips-emu/ImageCache.hh>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Doubles the first data word into the second one.
+std::vector<uint32_t> const TextWords = {
+    0x3c081000, // lui  $8, 0x1000
+    0x8d090000, // lw   $9, 0($8)
+    0x01294821, // addu $9, $9, $9
+    0xad090004, // sw   $9, 4($8)
+};
+
+// Overwrites the last instruction with the first one before reaching it.
+std::vector<uint32_t> const SelfModifyingWords = {
+    0x3c080040, // lui  $8, 0x0040
+    0x8d090000, // lw   $9, 0($8)
+    0xad09000c, // sw   $9, 12($8)
+    0x00000000, // nop, replaced with lui $8, 0x0040
+};
+
+fs::path WriteProgram(char const* name, std::vector<uint32_t> const& text, uint32_t value)
+{
+    auto const     now  = std::chrono::steady_clock::now().time_since_epoch().count();
+    fs::path const path = fs::temp_directory_path()
+                          / ("sme-image-cache-test-" + std::to_string(now) + "-" + name + ".txt");
+
+    std::ofstream ofs { path };
+    ofs << "0x" << std::hex << text.size() * 4 << "\n0x8\n";
+    for (uint32_t word : text) ofs << "0x" << word << '\n';
+    ofs << "0x" << value << "\n0x0\n";
+    return path;
+}
+
+std::shared_ptr<ProgramImage const> LoadImage(ImageCache& cache, fs::path const& path)
+{
+    ImageLoadResult result = cache.Load(path);
+    if (!std::holds_alternative<std::shared_ptr<ProgramImage const>>(result))
+        return nullptr;
+    return std::get<std::shared_ptr<ProgramImage const>>(std::move(result));
+}
+
+}
+
+TEST(ImageCacheTest, HitsAndMisses)
+{
+    fs::path const first  = WriteProgram("first", TextWords, 21);
+    fs::path const second = WriteProgram("second", TextWords, 21);
+    fs::path const other  = WriteProgram("other", TextWords, 5);
+
+    ImageCache cache { 1 << 20 };
+
+    auto const image = LoadImage(cache, first);
+    ASSERT_NE(image, nullptr);
+    ASSERT_EQ(image->GetProgram().GetTextVersion(), image->GetMemory().GetTextVersion());
+    ASSERT_EQ(LoadImage(cache, first), image);
+
+    // The same contents under another path share the image; other contents do not.
+    ASSERT_EQ(LoadImage(cache, second), image);
+    ASSERT_NE(LoadImage(cache, other), image);
+
+    ImageCacheStats stats = cache.GetStats();
+    ASSERT_EQ(stats.numHits, 2);
+    ASSERT_EQ(stats.numMisses, 2);
+    ASSERT_EQ(stats.numImages, 2);
+
+    // A file which changed is loaded again.
+    fs::remove(first);
+    fs::rename(other, first);
+    auto const changed = LoadImage(cache, first);
+    ASSERT_NE(changed, image);
+    ASSERT_EQ(changed->GetMemory().GetWord(Address::MakeData(0)), 5);
+
+    ASSERT_TRUE(std::holds_alternative<CannotRead>(cache.Load(first.string() + ".missing")));
+
+    stats = cache.GetStats();
+    ASSERT_EQ(stats.numHits, 3);
+    ASSERT_EQ(stats.numMisses, 2);
+
+    fs::remove(first);
+    fs::remove(second);
+}
+
+TEST(ImageCacheTest, Eviction)
+{
+    fs::path const first  = WriteProgram("first", TextWords, 1);
+    fs::path const second = WriteProgram("second", TextWords, 2);
+
+    // The budget holds one image only, but the image just loaded is always kept.
+    ImageCache cache { 1 };
+
+    auto const image = LoadImage(cache, first);
+    ASSERT_NE(image, nullptr);
+    ASSERT_NE(LoadImage(cache, second), nullptr);
+
+    ImageCacheStats stats = cache.GetStats();
+    ASSERT_EQ(stats.numImages, 1);
+    ASSERT_EQ(stats.numEvictions, 1);
+    ASSERT_GE(stats.numBytes, image->GetFootprint());
+
+    // The evicted image stays valid for those who hold it.
+    ASSERT_EQ(image->GetMemory().GetWord(Address::MakeData(0)), 1);
+    ASSERT_NE(LoadImage(cache, first), image);
+    ASSERT_EQ(cache.GetStats().numMisses, 3);
+
+    fs::remove(first);
+    fs::remove(second);
+}
+
+TEST(ImageCacheTest, Emulator)
+{
+    fs::path const path          = WriteProgram("emulator", TextWords, 21);
+    fs::path const modifyingPath = WriteProgram("modifying", SelfModifyingWords, 0);
+
+    ImageCache    cache { 1 << 20 };
+    Emulator      emulator;
+    Memory const& memory = emulator.GetMemory();
+
+    // Runs copy the data of the image, so each starts from the initial state.
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT_FALSE(emulator.Load(cache, path).has_value());
+        RunResult const result = emulator.Run(RunLimits {});
+        ASSERT_EQ(result.result, TickResult::Success);
+        ASSERT_EQ(result.numInstructions, 4);
+        ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 42);
+    }
+    ASSERT_EQ(emulator.GetStats().numDecodes, 0);
+    ASSERT_EQ(cache.GetStats().numHits, 2);
+
+    // A program which writes its text cannot use the shared decoded program.
+    ASSERT_FALSE(emulator.Load(cache, modifyingPath).has_value());
+    RunResult const result = emulator.Run(RunLimits {});
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(8), 0x00400000);
+    ASSERT_EQ(memory.GetWord(Address::MakeText(12)), 0x3c080040);
+
+    auto const image = LoadImage(cache, modifyingPath);
+    ASSERT_EQ(image->GetMemory().GetWord(Address::MakeText(12)), 0);
+
+    ASSERT_TRUE(emulator.Load(cache, path.string() + ".missing").has_value());
+
+    fs::remove(path);
+    fs::remove(modifyingPath);
+}
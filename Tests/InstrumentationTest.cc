@@ -0,0 +1,238 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/File.hh>
+#include <simple-mips-emu/Instrumentation.hh>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/*
+    .data
+array:
+    .word 0
+    .word 1
+    .space 32
+array_end:
+
+    .text
+main:
+    la     $8,   array
+    la     $9,   array_end
+    addiu  $9,   $9,   -8
+loop:
+    lw     $10,  0($8)
+    lw     $11,  4($8)
+    addu   $10,  $10,  $11
+    sw     $10,  8($8)
+    addiu  $8,   4
+    bne    $8,   $9,   loop
+*/
+char const Fibonacci[] = R"===(
+    0x28
+    0x28
+    0x3c081000
+    0x3c091000
+    0x35290028
+    0x2529fff8
+    0x8d0a0000
+    0x8d0b0004
+    0x14b5021
+    0xad0a0008
+    0x25080004
+    0x1509fffa
+    0x0
+    0x1
+    0x0
+    0x0
+    0x0
+    0x0
+    0x0
+    0x0
+    0x0
+    0x0
+)===";
+
+// 4 instructions before the loop and 6 in each of its 8 iterations
+constexpr uint64_t NumRetired = 4 + 6 * 8;
+
+Memory LoadFibonacci()
+{
+    std::istringstream iss { Fibonacci };
+    CanRead            file = std::get<CanRead>(ReadFile(iss));
+    return Memory { std::move(file.text), std::move(file.data) };
+}
+
+}
+
+TEST(InstrumentationTest, Stats)
+{
+    for (bool fastForwardLoops : { false, true })
+    {
+        Memory        memory = LoadFibonacci();
+        Program const program { memory, ProgramOptions { fastForwardLoops } };
+        StatsPolicy   policy;
+
+        // Fused instructions are reported one by one.
+        RunResult const result = RunProgram(memory, program, 1000, policy);
+        ASSERT_EQ(result.result, TickResult::Success);
+        ASSERT_EQ(result.numInstructions, NumRetired);
+        ASSERT_EQ(result.numFastForwarded, 0);
+        ASSERT_EQ(memory.GetWord(Address::MakeData(36)), 34);
+
+        InstrumentationStats const& stats = policy.GetStats();
+        ASSERT_EQ(stats.numRetired, NumRetired);
+        ASSERT_EQ(stats.numLoads, 16);
+        ASSERT_EQ(stats.numBytesLoaded, 64);
+        ASSERT_EQ(stats.numStores, 8);
+        ASSERT_EQ(stats.numBranches, 8);
+        ASSERT_EQ(stats.numTakenBranches, 7);
+        ASSERT_EQ(stats.numRetiredByOperation[static_cast<size_t>(Operation::LW)], 16);
+        ASSERT_EQ(stats.numRetiredByOperation[static_cast<size_t>(Operation::LUI)], 2);
+        ASSERT_EQ(stats.numRetiredByOperation[static_cast<size_t>(Operation::LUI_ORI)], 0);
+    }
+}
+
+TEST(InstrumentationTest, NoInstrumentation)
+{
+    Memory        memory = LoadFibonacci();
+    Program const program { memory };
+
+    NoInstrumentation policy;
+    RunResult const   result = RunProgram(memory, program, 1000, policy);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, NumRetired);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(36)), 34);
+}
+
+TEST(InstrumentationTest, Profiling)
+{
+    Memory          memory = LoadFibonacci();
+    ProfilingPolicy policy;
+
+    // Tick reports as RunProgram does.
+    while (!memory.IsTerminated()) ASSERT_EQ(Tick(memory, policy), TickResult::Success);
+
+    ASSERT_EQ(policy.GetCount(Address::MakeText(0)), 1);
+    ASSERT_EQ(policy.GetCount(Address::MakeText(16)), 8);
+    ASSERT_EQ(policy.GetCount(Address::MakeText(36)), 8);
+    ASSERT_EQ(policy.GetCount(Address::MakeText(40)), 0);
+    ASSERT_EQ(policy.GetCount(Address::MakeData(0)), 0);
+
+    std::ostringstream oss;
+    policy.Print(oss, memory, 2);
+
+    std::string              line;
+    std::vector<std::string> lines;
+    for (std::istringstream iss { oss.str() }; std::getline(iss, line);) lines.push_back(line);
+    ASSERT_EQ(lines.size(), 3);
+    ASSERT_NE(lines[1].find("0x400010: lw"), std::string::npos);
+    ASSERT_NE(lines[2].find("0x400014: lw"), std::string::npos);
+}
+
+TEST(InstrumentationTest, Tracing)
+{
+    Memory        memory = LoadFibonacci();
+    Program const program { memory };
+
+    std::ostringstream oss;
+    TracingPolicy      policy { oss };
+    ASSERT_EQ(RunProgram(memory, program, 1000, policy).numInstructions, NumRetired);
+
+    std::string              line;
+    std::vector<std::string> lines;
+    for (std::istringstream iss { oss.str() }; std::getline(iss, line);) lines.push_back(line);
+    ASSERT_EQ(lines.size(), NumRetired);
+    ASSERT_EQ(lines[0].rfind("0x400000: lui", 0), 0);
+    ASSERT_EQ(lines[0].find('['), std::string::npos);
+    ASSERT_NE(lines[5].find("[load 0x10000004]"), std::string::npos);
+    ASSERT_NE(lines[7].find("[store 0x10000008]"), std::string::npos);
+}
+
+/*
+main:
+    jal     f
+    jal     f
+    j       end
+f:
+    move    $16,  $31
+    jal     g
+    move    $31,  $16
+    jr      $31
+g:
+    addiu   $8,   $8,   1
+    jr      $31
+end:
+*/
+char const Calls[] = R"===(
+    0x24
+    0x0
+    0x0c100003
+    0x0c100003
+    0x08100009
+    0x03e08021
+    0x0c100007
+    0x0200f821
+    0x03e00008
+    0x25080001
+    0x03e00008
+)===";
+
+TEST(InstrumentationTest, CallGraph)
+{
+    std::istringstream iss { Calls };
+    CanRead            file = std::get<CanRead>(ReadFile(iss));
+    Memory             memory { std::move(file.text), std::move(file.data) };
+    Program const      program { memory };
+
+    CallGraphPolicy policy;
+    ASSERT_EQ(RunProgram(memory, program, 1000, policy).numInstructions, 15);
+    ASSERT_TRUE(memory.IsTerminated());
+    ASSERT_EQ(memory.GetRegister(8), 2);
+    ASSERT_EQ(policy.GetDepth(), 0);
+
+    std::ostringstream oss;
+    policy.WriteFolded(oss);
+    ASSERT_EQ(oss.str(), "0x400000 3\n0x400000;0x40000c 8\n0x400000;0x40000c;0x40001c 4\n");
+}
+
+TEST(InstrumentationTest, CallGraphUnmatchedReturns)
+{
+    Instruction const jal { Operation::JAL, 0, 0, 0, 0 };
+    Instruction const jr { Operation::JR, Memory::RA, 0, 0, 0 };
+    Instruction const addu { Operation::ADDU, 0, 0, 0, 0 };
+
+    CallGraphPolicy policy { 0x400000 };
+    auto const      call = [&](uint32_t pc, uint32_t target) {
+        policy.OnBranch(target, true);
+        policy.OnRetire(pc, jal);
+    };
+    auto const jump = [&](uint32_t pc, uint32_t target) {
+        policy.OnBranch(target, true);
+        policy.OnRetire(pc, jr);
+    };
+
+    call(0x400000, 0x400100);
+    call(0x400100, 0x400200);
+    policy.OnRetire(0x400200, addu);
+
+    // Not a return address on the stack: a jump within the function.
+    jump(0x400204, 0x400300);
+    ASSERT_EQ(policy.GetDepth(), 2);
+    policy.OnRetire(0x400300, addu);
+
+    // Returns to main past the frame of 0x400100.
+    jump(0x400304, 0x400004);
+    ASSERT_EQ(policy.GetDepth(), 0);
+    policy.OnRetire(0x400004, addu);
+
+    std::ostringstream oss;
+    policy.WriteFolded(oss);
+    ASSERT_EQ(oss.str(), "0x400000 2\n0x400000;0x400100 1\n0x400000;0x400100;0x400200 4\n");
+}
@@ -4,6 +4,9 @@
 #include <gtest/gtest.h>
 #include <simple-mips-emu/Memory.hh>
 
+#include <utility>
+#include <vector>
+
 TEST(MemoryTest, Init)
 {
     Memory memory { 7, 9 };
@@ -36,10 +39,115 @@ TEST(MemoryTest, Register)
 {
     Memory memory { 0, 0 };
 
-    EXPECT_THROW(memory.GetRegister(33), std::out_of_range);
+    EXPECT_THROW(memory.GetRegister(35), std::out_of_range);
 
     memory.SetRegister(18, 0x1234);
     ASSERT_EQ(memory.GetRegister(18), 0x1234);
+
+    // HI and LO follow PC.
+    memory.SetRegister(Memory::LO, 0x5678);
+    ASSERT_EQ(memory.GetRegister(34), 0x5678);
+}
+
+TEST(MemoryTest, StateHash)
+{
+    constexpr uint32_t PageSize = PageHashes::PageSize;
+
+    Memory memory { 8, PageSize * 3 + 8 };
+    Memory copy = memory;
+
+    uint64_t const initial = memory.GetStateHash();
+    ASSERT_EQ(copy.GetStateHash(), initial);
+
+    // The same state has the same hash, however it was written.
+    memory.SetWord(Address::MakeData(PageSize * 2 + 4), 0x01020304);
+    ASSERT_NE(memory.GetStateHash(), initial);
+    for (uint32_t i = 0; i < 4; ++i)
+        copy.SetByte(Address::MakeData(PageSize * 2 + 4 + i), static_cast<uint8_t>(i + 1));
+    ASSERT_EQ(copy.GetStateHash(), memory.GetStateHash());
+
+    memory.SetWord(Address::MakeData(PageSize * 2 + 4), 0);
+    ASSERT_EQ(memory.GetStateHash(), initial);
+
+    // A word across two pages changes both.
+    memory.SetWord(Address::MakeData(PageSize - 2), 0x01020304);
+    memory.SetHalf(Address::MakeData(PageSize - 2), 0);
+    ASSERT_NE(memory.GetStateHash(), initial);
+    memory.SetHalf(Address::MakeData(PageSize), 0);
+    ASSERT_EQ(memory.GetStateHash(), initial);
+
+    memory.SetRegister(Memory::HI, 1);
+    ASSERT_NE(memory.GetStateHash(), initial);
+    memory.SetRegister(Memory::HI, 0);
+    memory.SetWord(Address::MakeText(4), 1);
+    ASSERT_NE(memory.GetStateHash(), initial);
+    memory.SetWord(Address::MakeText(4), 0);
+    ASSERT_EQ(memory.GetStateHash(), initial);
+
+    memory.ResizeData(PageSize * 4);
+    ASSERT_NE(memory.GetStateHash(), initial);
+
+    // Stores of other memories to a shared segment change the hash.
+    Memory::Segment shared { std::as_const(memory).GetSegmentByBase(Address::BaseType::Data) };
+    memory.ShareData(shared);
+    copy.ShareData(shared);
+    uint64_t const before = memory.GetStateHash();
+    copy.SetWord(Address::MakeData(8), 1);
+    ASSERT_NE(memory.GetStateHash(), before);
+}
+
+TEST(MemoryTest, Diff)
+{
+    constexpr uint32_t PageSize = PageHashes::PageSize;
+
+    Memory lhs { 16, PageSize * 3 };
+    Memory rhs = lhs;
+    ASSERT_TRUE(Diff(lhs, rhs).IsEmpty());
+
+    for (bool hashed : { false, true })
+    {
+        Memory changed = rhs;
+        changed.SetRegister(3, 1);
+        changed.SetRegister(Memory::HI, 1);
+        changed.SetWord(Address::MakeText(8), 1);
+        changed.SetWord(Address::MakeData(0), 1);
+        changed.SetByte(Address::MakeData(7), 1);
+        changed.SetWord(Address::MakeData(12), 1);
+        changed.SetWord(Address::MakeData(PageSize - 4), 1);
+        changed.SetWord(Address::MakeData(PageSize), 1);
+        changed.SetWord(Address::MakeData(PageSize * 2 + 100), 1);
+
+        if (hashed)
+        {
+            lhs.GetStateHash();
+            changed.GetStateHash();
+        }
+
+        MemoryDiff const diff = Diff(lhs, changed);
+        ASSERT_EQ(diff.registers, (std::vector<uint32_t> { 3, Memory::HI }));
+        ASSERT_EQ(diff.ranges.size(), 5);
+
+        std::pair<Address, Address> const expected[] = {
+            { Address::MakeText(8), Address::MakeText(8) },
+            { Address::MakeData(0), Address::MakeData(4) },
+            { Address::MakeData(12), Address::MakeData(12) },
+            { Address::MakeData(PageSize - 4), Address::MakeData(PageSize) },
+            { Address::MakeData(PageSize * 2 + 100), Address::MakeData(PageSize * 2 + 100) },
+        };
+        for (size_t i = 0; i < diff.ranges.size(); ++i)
+        {
+            ASSERT_EQ(uint32_t { diff.ranges[i].begin }, uint32_t { expected[i].first });
+            ASSERT_EQ(uint32_t { diff.ranges[i].end }, uint32_t { expected[i].second });
+        }
+    }
+
+    // Words past the end of a segment compare as zero.
+    rhs.ResizeData(PageSize * 3 + 8);
+    ASSERT_TRUE(Diff(lhs, rhs).IsEmpty());
+    rhs.SetWord(Address::MakeData(PageSize * 3 + 4), 1);
+    MemoryDiff const diff = Diff(rhs, lhs);
+    ASSERT_EQ(diff.ranges.size(), 1);
+    ASSERT_EQ(uint32_t { diff.ranges[0].begin }, Address::MakeData(PageSize * 3 + 4));
 }
 
 TEST(MemoryTest, ValidAddressParse)
@@ -0,0 +1,224 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Multicore.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t> ToBytes(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rtn.push_back(static_cast<uint8_t>(word >> shift & 0xFF));
+
+    return rtn;
+}
+
+/*
+    .data
+counter:
+    .word   0
+ids:
+    .space  16
+
+    .text
+main:
+    li      $v0, 100        # get_core_id
+    syscall
+    move    $s0, $v0
+    lui     $t0, 0x1000
+    li      $t1, 1000
+loop:
+    ll      $t2, 0($t0)
+    addiu   $t2, $t2, 1
+    sc      $t2, 0($t0)
+    beq     $t2, $zero, loop
+    addiu   $t1, $t1, -1
+    bne     $t1, $zero, loop
+    sll     $t3, $s0, 2
+    addu    $t3, $t3, $t0
+    sw      $s0, 4($t3)
+*/
+std::vector<uint32_t> const Text = {
+    0x24020064, 0x0000000C, 0x00408021, 0x3C081000, 0x240903E8, 0xC10A0000, 0x254A0001,
+    0xE10A0000, 0x1140FFFC, 0x2529FFFF, 0x1520FFFA, 0x00105880, 0x01685821, 0xAD700004,
+};
+
+constexpr size_t NumCores = 4;
+
+void CheckFinalState(Multicore const& multicore)
+{
+    ASSERT_TRUE(multicore.IsTerminated());
+
+    // Every core sees the stores of the others.
+    for (size_t i = 0; i < NumCores; ++i)
+    {
+        Memory const& core = multicore.GetCore(i);
+        ASSERT_TRUE(core.IsDataShared());
+        ASSERT_EQ(core.GetWord(Address::MakeData(0)), NumCores * 1000);
+        for (uint32_t j = 0; j < NumCores; ++j)
+            ASSERT_EQ(core.GetWord(Address::MakeData(4 + j * 4)), j);
+    }
+}
+
+}
+
+TEST(MulticoreTest, Threads)
+{
+    Memory const       memory { ToBytes(Text), std::vector<uint8_t>(20) };
+    std::ostringstream output;
+    std::istringstream input;
+    SyscallHost        host { output, input };
+
+    MulticoreOptions options;
+    options.numCores = NumCores;
+
+    Multicore multicore { memory, options };
+    ASSERT_EQ(multicore.GetNumCores(), NumCores);
+
+    RunLimits limits;
+    limits.syscallHost = &host;
+
+    std::vector<RunResult> results = multicore.Run(limits);
+    ASSERT_EQ(results.size(), NumCores);
+    for (RunResult const& result : results)
+    {
+        ASSERT_EQ(result.result, TickResult::Success);
+        ASSERT_GE(result.numInstructions, 2 + 3 + 6000 + 3);
+    }
+    CheckFinalState(multicore);
+
+    // The given memory is left as it is.
+    ASSERT_EQ(memory.GetWord(Address::MakeData(0)), 0);
+}
+
+TEST(MulticoreTest, Deterministic)
+{
+    Memory const       memory { ToBytes(Text), std::vector<uint8_t>(20) };
+    std::ostringstream output;
+    std::istringstream input;
+    SyscallHost        host { output, input };
+
+    MulticoreOptions options;
+    options.numCores = NumCores;
+    options.quantum  = 7;
+
+    RunLimits limits;
+    limits.syscallHost = &host;
+
+    // Switching cores between ll and sc makes some sc fail, the same ones in every run.
+    Multicore              first { memory, options };
+    Multicore              second { memory, options };
+    std::vector<RunResult> firstResults  = first.Run(limits);
+    std::vector<RunResult> secondResults = second.Run(limits);
+    CheckFinalState(first);
+    CheckFinalState(second);
+
+    uint64_t numInstructions = 0;
+    for (size_t i = 0; i < NumCores; ++i)
+    {
+        ASSERT_EQ(firstResults[i].result, TickResult::Success);
+        ASSERT_EQ(firstResults[i].numInstructions, secondResults[i].numInstructions);
+        numInstructions += firstResults[i].numInstructions;
+    }
+    ASSERT_GT(numInstructions, NumCores * (2 + 3 + 6000 + 3));
+
+    // Runs may be resumed, a quantum at a time or not.
+    Multicore resumed { memory, options };
+    limits.maxInstructions = 5;
+    ASSERT_EQ(resumed.Run(limits)[3].numInstructions, 5);
+    ASSERT_EQ(resumed.GetCore(3).GetRegister(16), 3);
+    limits.maxInstructions = std::numeric_limits<uint64_t>::max();
+    resumed.Run(limits);
+    CheckFinalState(resumed);
+}
+
+TEST(MulticoreTest, LinkedAccess)
+{
+    uint8_t const   bytes[] = { 0, 0, 0, 1, 0, 0, 0, 2 };
+    Memory::Segment data { bytes, sizeof(bytes) };
+    Memory          memory { ToBytes({ 0 }), {} };
+    Memory          other { memory };
+    memory.ShareData(data);
+    other.ShareData(data);
+
+    // sc stores only at the linked address and only once.
+    ASSERT_FALSE(memory.StoreConditional(Address::MakeData(0), 5));
+    ASSERT_EQ(memory.LoadLinked(Address::MakeData(0)), 1);
+    ASSERT_FALSE(memory.StoreConditional(Address::MakeData(4), 5));
+    ASSERT_FALSE(memory.StoreConditional(Address::MakeData(0), 5));
+    ASSERT_EQ(memory.LoadLinked(Address::MakeData(0)), 1);
+    ASSERT_TRUE(memory.StoreConditional(Address::MakeData(0), 5));
+    ASSERT_FALSE(memory.StoreConditional(Address::MakeData(0), 6));
+    ASSERT_EQ(other.GetWord(Address::MakeData(0)), 5);
+
+    // A store by another memory in between makes sc fail.
+    ASSERT_EQ(memory.LoadLinked(Address::MakeData(4)), 2);
+    ASSERT_EQ(other.LoadLinked(Address::MakeData(4)), 2);
+    ASSERT_TRUE(other.StoreConditional(Address::MakeData(4), 3));
+    ASSERT_FALSE(memory.StoreConditional(Address::MakeData(4), 4));
+    ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 3);
+
+    ASSERT_THROW(memory.StoreConditional(Address::MakeData(8), 0), std::out_of_range);
+
+    // The data segment cannot grow while it is shared, and it is not shared after a reset.
+    std::ostringstream output;
+    std::istringstream input;
+    SyscallHost        host { output, input };
+    other.SetRegister(Memory::V0, static_cast<uint32_t>(SyscallCode::Sbrk));
+    other.SetRegister(Memory::A0, 4);
+    ASSERT_EQ(host.Service(other), TickResult::Success);
+    ASSERT_EQ(other.GetRegister(Memory::V0), static_cast<uint32_t>(-1));
+    ASSERT_EQ(other.GetDataSize(), 8);
+
+    std::vector<uint8_t> const text = ToBytes({ 0 });
+    std::vector<uint8_t> const ownData(4);
+    other.Reset(text.data(), text.size(), ownData.data(), ownData.size());
+    ASSERT_FALSE(other.IsDataShared());
+    ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 3);
+}
+
+TEST(MulticoreTest, SharedAccess)
+{
+    uint8_t const   bytes[12] {};
+    Memory::Segment data { bytes, sizeof(bytes) };
+    Memory          memory { ToBytes({ 0 }), {} };
+    Memory          other { memory };
+    memory.ShareData(data);
+    other.ShareData(data);
+
+    // Aligned and unaligned stores of every size reach the other memory.
+    memory.SetWord(Address::MakeData(0), 0x01020304);
+    memory.SetHalf(Address::MakeData(4), 0x0506);
+    memory.SetHalf(Address::MakeData(7), 0x0708);
+    memory.SetByte(Address::MakeData(11), 0x09);
+    ASSERT_EQ(other.GetWord(Address::MakeData(0)), 0x01020304);
+    ASSERT_EQ(other.GetWord(Address::MakeData(4)), 0x05060007);
+    ASSERT_EQ(other.GetWord(Address::MakeData(8)), 0x08000009);
+    ASSERT_EQ(other.GetHalf(Address::MakeData(1)), 0x0203);
+    ASSERT_EQ(other.GetByte(Address::MakeData(5)), 0x06);
+
+    // Only the value is compared, so sc succeeds after the word is changed and changed back.
+    ASSERT_EQ(memory.LoadLinked(Address::MakeData(0)), 0x01020304);
+    other.SetWord(Address::MakeData(0), 0);
+    other.SetWord(Address::MakeData(0), 0x01020304);
+    ASSERT_TRUE(memory.StoreConditional(Address::MakeData(0), 1));
+    ASSERT_EQ(other.GetWord(Address::MakeData(0)), 1);
+}
+
+TEST(MulticoreTest, UnalignedLinkedAccess)
+{
+    // ll $t2, 2($t0)
+    Memory memory { ToBytes({ 0x3C081000, 0xC10A0002 }), std::vector<uint8_t>(8) };
+    ASSERT_EQ(Tick(memory), TickResult::Success);
+    ASSERT_EQ(Tick(memory), TickResult::Trap);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(4));
+}
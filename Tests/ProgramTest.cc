@@ -0,0 +1,504 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Program.hh>
+
+#include <chrono>
+#include <initializer_list>
+#include <vector>
+
+namespace
+{
+
+Memory MakeMemory(std::initializer_list<uint32_t> words, uint32_t dataSize = 0)
+{
+    Memory  memory { static_cast<uint32_t>(words.size() * 4), dataSize };
+    Address address = Address::MakeText(0);
+    for (uint32_t word : words)
+    {
+        memory.SetWord(address, word);
+        address.MoveToNext();
+    }
+
+    return memory;
+}
+
+}
+
+TEST(ProgramTest, Decode)
+{
+    Instruction addiu = Decode(0x2529fff8);
+    ASSERT_EQ(addiu.operation, Operation::ADDIU);
+    ASSERT_EQ(addiu.rs, 9);
+    ASSERT_EQ(addiu.rt, 9);
+    ASSERT_EQ(addiu.immediate, static_cast<uint32_t>(-8));
+
+    Instruction ori = Decode(0x35290028);
+    ASSERT_EQ(ori.operation, Operation::ORI);
+    ASSERT_EQ(ori.immediate, 0x28);
+
+    Instruction jal = Decode(0xc100008);
+    ASSERT_EQ(jal.operation, Operation::JAL);
+    ASSERT_EQ(jal.immediate, 0x400020);
+
+    ASSERT_EQ(Decode(0xFC000000).operation, Operation::Invalid);
+    ASSERT_EQ(Decode(0x0000003F).operation, Operation::Invalid);
+}
+
+TEST(ProgramTest, DecodeTable)
+{
+#define SIMPLE_MIPS_EMU_CHECK_FUNCTION(format, name, code)                                         \
+    ASSERT_EQ(Decode(static_cast<uint32_t>(code)).operation, Operation::name);
+#define SIMPLE_MIPS_EMU_CHECK_RT(format, name, code)                                               \
+    ASSERT_EQ(Decode(uint32_t { 1 } << 26 | code << 16).operation, Operation::name);
+#define SIMPLE_MIPS_EMU_CHECK_OPERATION(format, name, code)                                        \
+    ASSERT_EQ(Decode(static_cast<uint32_t>(code) << 26).operation, Operation::name);
+
+    SIMPLE_MIPS_EMU_R_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_SV_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_JR_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_SR_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_MD_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_MF_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_MT_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_SYS_FORMAT_FNS(SIMPLE_MIPS_EMU_CHECK_FUNCTION)
+    SIMPLE_MIPS_EMU_RI_FORMAT_RTS(SIMPLE_MIPS_EMU_CHECK_RT)
+    SIMPLE_MIPS_EMU_I_FORMAT_OPS(SIMPLE_MIPS_EMU_CHECK_OPERATION)
+    SIMPLE_MIPS_EMU_UI_FORMAT_OPS(SIMPLE_MIPS_EMU_CHECK_OPERATION)
+    SIMPLE_MIPS_EMU_BI_FORMAT_OPS(SIMPLE_MIPS_EMU_CHECK_OPERATION)
+    SIMPLE_MIPS_EMU_BZ_FORMAT_OPS(SIMPLE_MIPS_EMU_CHECK_OPERATION)
+    SIMPLE_MIPS_EMU_II_FORMAT_OPS(SIMPLE_MIPS_EMU_CHECK_OPERATION)
+    SIMPLE_MIPS_EMU_OI_FORMAT_OPS(SIMPLE_MIPS_EMU_CHECK_OPERATION)
+    SIMPLE_MIPS_EMU_J_FORMAT_OPS(SIMPLE_MIPS_EMU_CHECK_OPERATION)
+
+#undef SIMPLE_MIPS_EMU_CHECK_OPERATION
+#undef SIMPLE_MIPS_EMU_CHECK_RT
+#undef SIMPLE_MIPS_EMU_CHECK_FUNCTION
+
+    // Unused codes under operation 1 are invalid as well.
+    ASSERT_EQ(Decode(0x04020000).operation, Operation::Invalid);
+
+    Instruction andi = Decode(0x3108ffff);
+    ASSERT_EQ(andi.operation, Operation::ANDI);
+    ASSERT_EQ(andi.immediate, 0xFFFF);
+
+    Instruction sll = Decode(0x00084080);
+    ASSERT_EQ(sll.operation, Operation::SLL);
+    ASSERT_EQ(sll.rt, 8);
+    ASSERT_EQ(sll.rd, 8);
+    ASSERT_EQ(sll.immediate, 2);
+}
+
+TEST(ProgramTest, Fusion)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c081000, // lui   $8,  0x1000
+        0x3c091000, // lui   $9,  0x1000
+        0x35290028, // ori   $9,  $9,  0x28
+        0x2529fff8, // addiu $9,  $9,  -8
+        0x8d0a0000, // lw    $10, 0($8)
+        0x8d0b0004, // lw    $11, 4($8)
+        0x14b5021,  // addu  $10, $10, $11
+        0xad0a0008, // sw    $10, 8($8)
+        0x25080004, // addiu $8,  $8,  4
+        0x1509fffa, // bne   $8,  $9,  -6
+    });
+    // clang-format on
+
+    Program program { memory };
+    ASSERT_EQ(program.GetSize(), 10);
+    ASSERT_EQ(program.GetNumFused(), 3);
+
+    ASSERT_EQ(program.GetDispatchOperation(0), Operation::LUI);
+    ASSERT_EQ(program.GetDispatchOperation(1), Operation::LUI_ORI);
+    ASSERT_EQ(program.GetDispatchOperation(2), Operation::ORI);
+    ASSERT_EQ(program.GetDispatchOperation(4), Operation::LW_LW_ADDU);
+    ASSERT_EQ(program.GetDispatchOperation(5), Operation::LW);
+    ASSERT_EQ(program.GetDispatchOperation(8), Operation::ADDIU_BNE);
+    ASSERT_EQ(program.GetDispatchOperation(9), Operation::BNE);
+}
+
+TEST(ProgramTest, BranchIntoFusedSequence)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c010040, // lui   $1,  0x40
+        0x34210010, // ori   $1,  $1,  0x10
+        0x00200008, // jr    $1
+        0x3c080001, // lui   $8,  1
+        0x35080002, // ori   $8,  $8,  2
+    });
+    // clang-format on
+
+    Program program { memory };
+    ASSERT_EQ(program.GetDispatchOperation(3), Operation::LUI_ORI);
+
+    RunResult result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 4);
+    ASSERT_EQ(memory.GetRegister(8), 2);
+}
+
+TEST(ProgramTest, FusionStopsAtBlockBoundary)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x08100002, // j     mid
+        0x3c080001, // lui   $8,  1
+        0x35080002, // mid: ori $8, $8, 2
+    });
+    // clang-format on
+
+    Program program { memory };
+    ASSERT_EQ(program.GetNumFused(), 0);
+    ASSERT_EQ(program.GetDispatchOperation(1), Operation::LUI);
+}
+
+TEST(ProgramTest, FusionRespectsInstructionLimit)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c080001, // lui   $8,  1
+        0x35080002, // ori   $8,  $8,  2
+    });
+    // clang-format on
+
+    Program program { memory };
+
+    RunResult result = RunProgram(memory, program, 1);
+    ASSERT_EQ(result.numInstructions, 1);
+    ASSERT_EQ(memory.GetRegister(8), 0x10000);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(4));
+
+    result = RunProgram(memory, program, 1);
+    ASSERT_EQ(result.numInstructions, 1);
+    ASSERT_EQ(memory.GetRegister(8), 0x10002);
+    ASSERT_TRUE(memory.IsTerminated());
+}
+
+TEST(ProgramTest, SelfModifyingCode)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c010040, // lui   $1,  0x40
+        0x3c093508, // lui   $9,  0x3508
+        0x35290007, // ori   $9,  $9,  7
+        0xac290010, // sw    $9,  16($1)
+        0x24080001, // addiu $8,  $0,  1  (overwritten with ori $8, $8, 7)
+    });
+    // clang-format on
+
+    Program program { memory };
+
+    RunResult result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 5);
+    ASSERT_EQ(memory.GetRegister(8), 7);
+}
+
+TEST(ProgramTest, Breakpoint)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x24080003, // addiu $8,  $0,  3
+        0x3c091000, // loop: lui $9, 0x1000
+        0x35290028, // ori   $9,  $9,  0x28
+        0x2508ffff, // addiu $8,  $8,  -1
+        0x1500fffc, // bne   $8,  $0,  loop
+    });
+    // clang-format on
+
+    Program program { memory };
+    ASSERT_EQ(program.GetNumFused(), 2);
+
+    ASSERT_FALSE(program.SetBreakpoint(0x400014));
+    ASSERT_FALSE(program.SetBreakpoint(0x400002));
+    ASSERT_TRUE(program.SetBreakpoint(0x400008));
+    ASSERT_TRUE(program.HasBreakpoint(0x400008));
+    ASSERT_EQ(program.GetDispatchOperation(1), Operation::LUI);
+    ASSERT_EQ(program.GetNumFused(), 1);
+
+    uint64_t numInstructions = 0;
+    for (uint32_t i = 3; i > 0; --i)
+    {
+        RunResult result = RunProgram(memory, program, 100);
+        numInstructions += result.numInstructions;
+        ASSERT_EQ(result.result, TickResult::BreakpointHit);
+        ASSERT_EQ(memory.GetRegister(Memory::PC), 0x400008);
+        ASSERT_EQ(memory.GetRegister(8), i);
+        ASSERT_EQ(memory.GetRegister(9), 0x10000000);
+
+        ASSERT_EQ(Tick(memory), TickResult::Success);
+        ++numInstructions;
+    }
+
+    ASSERT_TRUE(program.RemoveBreakpoint(0x400008));
+    ASSERT_FALSE(program.RemoveBreakpoint(0x400008));
+    ASSERT_EQ(program.GetDispatchOperation(1), Operation::LUI_ORI);
+    ASSERT_EQ(program.GetNumFused(), 2);
+
+    RunResult result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(numInstructions + result.numInstructions, 13);
+    ASSERT_TRUE(memory.IsTerminated());
+}
+
+TEST(ProgramTest, FastForwardLoop)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c080010, // lui   $8, 0x10
+        0x2508ffff, // loop: addiu $8, $8, -1
+        0x1500fffe, // bne   $8, $0, loop
+    });
+    // clang-format on
+
+    ProgramOptions options;
+    options.fastForwardLoops = true;
+
+    Program program { memory, options };
+    ASSERT_EQ(program.GetDispatchOperation(1), Operation::ADDIU_BNE_LOOP);
+    ASSERT_EQ(Program { memory }.GetDispatchOperation(1), Operation::ADDIU_BNE);
+
+    Memory    partial = memory;
+    RunResult result  = RunProgram(partial, program, 1002);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 1002);
+    ASSERT_EQ(partial.GetRegister(8), 0x100000 - 501);
+    ASSERT_EQ(partial.GetRegister(Memory::PC), 0x400008);
+
+    result = RunProgram(memory, program, 1 << 30);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 1 + 2 * 0x100000);
+    ASSERT_EQ(result.numFastForwarded, 2 * 0x100000);
+    ASSERT_EQ(memory.GetRegister(8), 0);
+    ASSERT_TRUE(memory.IsTerminated());
+}
+
+TEST(ProgramTest, FastForwardLoopWithLimits)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c088000, // lui   $8, 0x8000
+        0x2508ffff, // loop: addiu $8, $8, -1
+        0x1500fffe, // bne   $8, $0, loop
+    });
+    // clang-format on
+
+    ProgramOptions options;
+    options.fastForwardLoops = true;
+
+    // The loop is skipped in one step, not one check interval at a time, which would take 2^30
+    // chunks here.
+    Program   program { memory, options };
+    RunLimits limits;
+    limits.maxInstructions = uint64_t { 1 } << 40;
+    limits.checkInterval   = 2;
+    limits.deadline        = std::chrono::steady_clock::now() + std::chrono::seconds { 10 };
+
+    RunResult const result = RunProgram(memory, program, limits);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 1 + (uint64_t { 2 } << 31));
+    ASSERT_EQ(result.numFastForwarded, uint64_t { 2 } << 31);
+    ASSERT_TRUE(memory.IsTerminated());
+
+    // A loop which never ends runs to the end of the budget.
+    Memory endless = MakeMemory({ 0x24080001, 0x2508fffe, 0x1500fffe });
+    limits.maxInstructions = 1001;
+
+    RunResult const partial = RunProgram(endless, Program { endless, options }, limits);
+    ASSERT_EQ(partial.result, TickResult::Success);
+    ASSERT_EQ(partial.numInstructions, 1001);
+    ASSERT_EQ(endless.GetRegister(8), static_cast<uint32_t>(1 - 2 * 500));
+}
+
+TEST(ProgramTest, Validation)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c081000, // lui   $8,  0x1000
+        0xfc000000, // (invalid)
+        0x10000064, // beq   $0,  $0,  100
+        0x08100004, // j     end
+    });
+    // clang-format on
+
+    ProgramOptions options;
+    options.unchecked = true;
+
+    Program const                       program { memory, options };
+    std::vector<ValidationError> const& errors = program.GetValidationErrors();
+    ASSERT_EQ(errors.size(), 2);
+    ASSERT_EQ(errors[0].type, ValidationError::Type::InvalidInstruction);
+    ASSERT_EQ(errors[0].address, 0x400004);
+    ASSERT_EQ(errors[1].type, ValidationError::Type::TargetOutOfText);
+    ASSERT_EQ(errors[1].address, 0x400008);
+    ASSERT_EQ(program.GetNumProven(), 0);
+}
+
+TEST(ProgramTest, ProvenAccesses)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x3c081000, // lui   $8,  0x1000
+        0x35080004, // ori   $8,  $8,  4
+        0x8d090004, // lw    $9,  4($8)
+        0xad090008, // sw    $9,  8($8)
+        0x8d0a000c, // lw    $10, 12($8)  (past the data segment)
+        0x2508fffc, // addiu $8,  $8,  -4
+        0xa1090000, // sb    $9,  0($8)
+        0x8d080000, // lw    $8,  0($8)
+        0xad090000, // sw    $9,  0($8)   ($8 is loaded)
+    }, 16);
+    // clang-format on
+    memory.SetWord(Address::MakeData(8), 0x11223344);
+
+    ProgramOptions options;
+    options.unchecked = true;
+
+    Program program { memory, options };
+    ASSERT_TRUE(program.GetValidationErrors().empty());
+    ASSERT_EQ(program.GetNumProven(), 4);
+    ASSERT_EQ(program.GetProvenDataSize(), 16);
+    ASSERT_EQ(program.GetNumFused(), 1);
+    ASSERT_EQ(program.GetDispatchOperation(2), Operation::LW_PROVEN);
+    ASSERT_EQ(program.GetDispatchOperation(3), Operation::SW_PROVEN);
+    ASSERT_EQ(program.GetDispatchOperation(4), Operation::LW);
+    ASSERT_EQ(program.GetDispatchOperation(6), Operation::SB_PROVEN);
+    ASSERT_EQ(program.GetDispatchOperation(7), Operation::LW_PROVEN);
+    ASSERT_EQ(program.GetDispatchOperation(8), Operation::SW);
+    ASSERT_EQ(program.GetProvenBase(2), 0x10000004);
+    ASSERT_EQ(program.GetProvenBase(6), 0x10000000);
+    ASSERT_EQ(Program { memory }.GetDispatchOperation(2), Operation::LW);
+
+    ASSERT_TRUE(program.SetBreakpoint(0x40000c));
+    ASSERT_TRUE(program.RemoveBreakpoint(0x40000c));
+    ASSERT_EQ(program.GetDispatchOperation(3), Operation::SW_PROVEN);
+    ASSERT_EQ(program.GetNumFused(), 1);
+
+    // Proven accesses behave as checked ones. The state hashes are up to date before the run, so
+    // that they only agree afterwards if the unchecked stores mark what they write.
+    uint64_t const  initial  = memory.GetStateHash();
+    Memory          checked  = memory;
+    RunResult const expected = RunProgram(checked, Program { checked }, 100);
+    RunResult const result   = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.result, TickResult::MemoryOutOfRange);
+    ASSERT_EQ(result.result, expected.result);
+    ASSERT_EQ(result.numInstructions, expected.numInstructions);
+    for (uint32_t idx = 0; idx < RegisterFileSize; ++idx)
+        ASSERT_EQ(memory.GetRegister(idx), checked.GetRegister(idx));
+    for (uint32_t offset = 0; offset < 16; offset += 4)
+        ASSERT_EQ(memory.GetWord(Address::MakeData(offset)),
+                  checked.GetWord(Address::MakeData(offset)));
+    ASSERT_EQ(memory.GetWord(Address::MakeData(12)), 0x11223344);
+    ASSERT_EQ(memory.GetRegister(8), 0x44000000);
+    ASSERT_TRUE(Diff(memory, checked).IsEmpty());
+    ASSERT_NE(memory.GetStateHash(), initial);
+    ASSERT_EQ(memory.GetStateHash(), checked.GetStateHash());
+
+    // Entering the block in the middle with another base runs the checked access.
+    memory.SetRegister(Memory::PC, 0x400008);
+    memory.SetRegister(8, 0x10000008);
+    ASSERT_EQ(RunProgram(memory, program, 1).numInstructions, 1);
+    ASSERT_EQ(memory.GetRegister(9), 0x11223344);
+
+    // A data segment smaller than the proofs assume is never accessed unchecked: the load past it
+    // gives 0 and the store past it fails.
+    memory.ResizeData(8);
+    memory.SetRegister(Memory::PC, 0x400008);
+    memory.SetRegister(8, 0x10000004);
+    RunResult const small = RunProgram(memory, program, 100);
+    ASSERT_EQ(small.result, TickResult::MemoryOutOfRange);
+    ASSERT_EQ(small.numInstructions, 1);
+    ASSERT_EQ(memory.GetRegister(9), 0);
+}
+
+TEST(ProgramTest, TimeLimit)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x25080001, // loop: addiu $8, $8, 1
+        0x08100000, // j     loop
+    });
+    // clang-format on
+
+    Program   program { memory };
+    RunLimits limits;
+    limits.maxInstructions = 1000;
+    limits.checkInterval   = 16;
+    limits.deadline        = std::chrono::steady_clock::now() + std::chrono::hours { 1 };
+
+    RunResult result = RunProgram(memory, program, limits);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 1000);
+
+    limits.deadline = std::chrono::steady_clock::now();
+    result          = RunProgram(memory, program, limits);
+    ASSERT_EQ(result.result, TickResult::TimeLimitExceeded);
+    ASSERT_EQ(result.numInstructions, 0);
+}
+
+TEST(ProgramTest, SelfJump)
+{
+    for (uint32_t word : { 0x08100001u /* j 0x400004 */, 0x1129ffffu /* beq $9, $9, -1 */ })
+    {
+        Memory memory = MakeMemory({ 0x24080001 /* addiu $8, $0, 1 */, word });
+
+        Program       program { memory };
+        StuckDetector detector;
+        RunLimits     limits;
+        limits.stuckDetector = &detector;
+        limits.checkInterval = 4;
+
+        RunResult result = RunProgram(memory, program, limits);
+        ASSERT_EQ(result.result, TickResult::Stuck);
+        ASSERT_EQ(result.numInstructions, 4);
+        ASSERT_EQ(memory.GetRegister(Memory::PC), 0x400004);
+    }
+}
+
+TEST(ProgramTest, RepeatedState)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x24080001, // loop: addiu $8, $0,  1
+        0x2508ffff, //       addiu $8, $8,  -1
+        0x08100000, //       j     loop
+    });
+    // clang-format on
+
+    Program       program { memory };
+    StuckDetector detector;
+    RunLimits     limits;
+    limits.stuckDetector = &detector;
+    limits.checkInterval = 7;
+
+    RunResult result = RunProgram(memory, program, limits);
+    ASSERT_EQ(result.result, TickResult::Stuck);
+    ASSERT_LE(result.numInstructions, 100);
+}
+
+TEST(ProgramTest, ProgressIsNotStuck)
+{
+    // clang-format off
+    Memory memory = MakeMemory({
+        0x25080001, // loop: addiu $8, $8, 1
+        0x08100000, //       j     loop
+    });
+    // clang-format on
+
+    Program       program { memory };
+    StuckDetector detector;
+    RunLimits     limits;
+    limits.maxInstructions = 100000;
+    limits.stuckDetector   = &detector;
+    limits.checkInterval   = 16;
+
+    RunResult result = RunProgram(memory, program, limits);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 100000);
+    ASSERT_EQ(memory.GetRegister(8), 50000);
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Sampling.hh>
+
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t> ToBytes(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rtn.push_back(static_cast<uint8_t>(word >> shift & 0xFF));
+
+    return rtn;
+}
+
+/*
+    .data
+counter:
+    .word   0
+
+    .text
+main:
+    lui     $t0, 0x1000
+    addiu   $t1, $zero, 10000
+loop:
+    lw      $t2, 0($t0)
+    addiu   $t2, $t2, 1
+    sw      $t2, 0($t0)
+    addiu   $t1, $t1, -1
+    bne     $t1, $zero, loop
+*/
+std::vector<uint32_t> const Text = {
+    0x3C081000, 0x24092710, 0x8D0A0000, 0x254A0001, 0xAD0A0000, 0x2529FFFF, 0x1520FFFB,
+};
+
+// 2 instructions before the loop and 5 in each of its 10000 iterations
+constexpr uint64_t NumRetired = 2 + 5 * 10000;
+
+Memory MakeMemory()
+{
+    return Memory { ToBytes(Text), std::vector<uint8_t>(4) };
+}
+
+}
+
+TEST(SamplingTest, Run)
+{
+    std::vector<SampleResult> reference;
+    for (size_t numWorkers : { 1, 4 })
+    {
+        Memory        memory = MakeMemory();
+        Program const program { memory };
+
+        SamplingOptions options;
+        options.period     = 1000;
+        options.warmup     = 100;
+        options.length     = 500;
+        options.numWorkers = numWorkers;
+
+        // The fast-forwarded run is the whole run.
+        SamplingResult const result = RunSampled(memory, program, options);
+        ASSERT_EQ(result.run.result, TickResult::Success);
+        ASSERT_EQ(result.run.numInstructions, NumRetired);
+        ASSERT_TRUE(memory.IsTerminated());
+        ASSERT_EQ(memory.GetWord(Address::MakeData(0)), 10000);
+
+        // A sample starts at every period, and the last one ends with the program in its warm-up.
+        ASSERT_EQ(result.samples.size(), NumRetired / options.period + 1);
+        for (size_t i = 0; i < result.samples.size(); ++i)
+        {
+            SampleResult const& sample = result.samples[i];
+            ASSERT_EQ(sample.position, i * options.period);
+            ASSERT_EQ(sample.result, TickResult::Success);
+            if (i + 1 < result.samples.size())
+            {
+                ASSERT_EQ(sample.numWarmup, options.warmup);
+                ASSERT_EQ(sample.stats.numRetired, options.length);
+                ASSERT_EQ(sample.stats.numLoads, options.length / 5);
+            }
+        }
+        ASSERT_EQ(result.samples.back().numWarmup, 2);
+        ASSERT_EQ(result.samples.back().stats.numRetired, 0);
+
+        // Every measured window holds whole iterations of the loop.
+        SampledRate const loads = EstimateRate(result, &InstrumentationStats::numLoads);
+        ASSERT_EQ(loads.numSamples, result.samples.size() - 1);
+        ASSERT_DOUBLE_EQ(loads.mean, 0.2);
+        ASSERT_NEAR(loads.halfWidth, 0, 1e-9);
+
+        // The samples do not depend on the number of workers.
+        if (reference.empty())
+            reference = result.samples;
+        for (size_t i = 0; i < reference.size(); ++i)
+            ASSERT_EQ(result.samples[i].stats.numBranches, reference[i].stats.numBranches);
+    }
+}
+
+TEST(SamplingTest, Limits)
+{
+    Memory        memory = MakeMemory();
+    Program const program { memory };
+
+    SamplingOptions options;
+    options.period                 = 1000;
+    options.limits.maxInstructions = 2500;
+
+    SamplingResult const result = RunSampled(memory, program, options);
+    ASSERT_EQ(result.run.numInstructions, 2500);
+    ASSERT_EQ(result.samples.size(), 3);
+    ASSERT_EQ(result.samples[2].position, 2000);
+
+    // Samples run past the limit of the fast-forwarded run.
+    ASSERT_EQ(result.samples[2].stats.numRetired, options.length);
+
+    // The memory does not refer to anything of the run.
+    Memory const copy = memory;
+    ASSERT_EQ(copy.GetRegister(Memory::PC), memory.GetRegister(Memory::PC));
+
+    options.period = 0;
+    ASSERT_THROW(RunSampled(memory, program, options), std::invalid_argument);
+}
+
+TEST(SamplingTest, EstimateRate)
+{
+    SamplingResult result { RunResult { TickResult::Success, 0, 0 }, {} };
+    for (uint64_t numLoads : { 10, 30, 0 })
+    {
+        SampleResult sample { 0, 0, TickResult::Success, {} };
+        sample.stats.numRetired = numLoads == 0 ? 0 : 100;
+        sample.stats.numLoads   = numLoads;
+        result.samples.push_back(sample);
+    }
+
+    // Samples which measured nothing are left out.
+    SampledRate const rate = EstimateRate(result, &InstrumentationStats::numLoads);
+    ASSERT_EQ(rate.numSamples, 2);
+    ASSERT_DOUBLE_EQ(rate.mean, 0.2);
+    ASSERT_NEAR(rate.halfWidth, 12.706 * 0.1, 1e-9);
+
+    result.samples.resize(1);
+    ASSERT_EQ(EstimateRate(result, &InstrumentationStats::numLoads).halfWidth,
+              std::numeric_limits<double>::infinity());
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Scheduler.hh>
+
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t> ToBytes(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rtn.push_back(static_cast<uint8_t>(word >> shift & 0xFF));
+
+    return rtn;
+}
+
+/*
+    .data
+counter:
+    .word   0
+count:
+    .word   N
+
+    .text
+main:
+    lui     $t0, 0x1000
+    lw      $t1, 4($t0)
+loop:
+    lw      $t2, 0($t0)
+    addiu   $t2, $t2, 1
+    sw      $t2, 0($t0)
+    addiu   $t1, $t1, -1
+    bne     $t1, $zero, loop
+*/
+std::vector<uint8_t> const Text = ToBytes({
+    0x3C081000, 0x8D090004, 0x8D0A0000, 0x254A0001, 0xAD0A0000, 0x2529FFFF, 0x1520FFFB,
+});
+
+uint64_t GetNumRetired(uint32_t count)
+{
+    return 2 + 5 * uint64_t { count };
+}
+
+Emulator MakeGuest(Scheduler& scheduler, uint32_t count)
+{
+    std::vector<uint8_t> const data = ToBytes({ 0, count });
+
+    Emulator rtn = scheduler.Acquire();
+    rtn.Reset(Text.data(), Text.size(), data.data(), data.size());
+    return rtn;
+}
+
+}
+
+TEST(SchedulerTest, Run)
+{
+    SchedulerOptions options;
+    options.numWorkers = 4;
+    options.quantum    = 100;
+    Scheduler scheduler { options };
+
+    std::mutex                   mutex;
+    std::map<uint64_t, uint32_t> counters;
+    std::map<uint64_t, uint32_t> counts;
+
+    std::vector<GuestResult>     results;
+    auto const                   onFinished = [&](Emulator& emulator, GuestResult result) {
+        std::lock_guard<std::mutex> lock { mutex };
+        counters[result.id] = emulator.GetMemory().GetWord(Address::MakeData(0));
+        results.push_back(std::move(result));
+    };
+
+    constexpr uint32_t NumGuests = 64;
+    for (uint32_t i = 0; i < NumGuests; ++i)
+    {
+        uint32_t const count = (i + 1) * 37;
+        counts[scheduler.Submit(MakeGuest(scheduler, count), GuestOptions {}, onFinished)] = count;
+    }
+    scheduler.Wait();
+
+    ASSERT_EQ(results.size(), NumGuests);
+    uint64_t numQuanta = 0;
+    for (GuestResult const& result : results)
+    {
+        uint32_t const count = counts[result.id];
+        ASSERT_EQ(result.run.result, TickResult::Success);
+        ASSERT_EQ(result.run.numInstructions, GetNumRetired(count));
+        ASSERT_EQ(result.numQuanta, (GetNumRetired(count) + options.quantum - 1) / options.quantum);
+        ASSERT_GE(result.latency, result.waitTime);
+        ASSERT_GE(result.waitTime, result.maxWaitTime);
+        ASSERT_EQ(counters[result.id], count);
+        numQuanta += result.numQuanta;
+    }
+
+    SchedulerStats const stats = scheduler.GetStats();
+    ASSERT_EQ(stats.numSubmitted, NumGuests);
+    ASSERT_EQ(stats.numFinished, NumGuests);
+    ASSERT_EQ(stats.numQuanta, numQuanta);
+    ASSERT_EQ(stats.numGuests, 0);
+}
+
+TEST(SchedulerTest, Budget)
+{
+    SchedulerOptions options;
+    options.quantum = 100;
+    Scheduler scheduler { options };
+
+    std::promise<GuestResult> promise;
+    GuestOptions              guest;
+    guest.maxInstructions = 250;
+    scheduler.Submit(MakeGuest(scheduler, 1000), guest, [&](Emulator&, GuestResult result) {
+        promise.set_value(std::move(result));
+    });
+
+    GuestResult const result = promise.get_future().get();
+    ASSERT_EQ(result.run.result, TickResult::Success);
+    ASSERT_EQ(result.run.numInstructions, 250);
+    ASSERT_EQ(result.numQuanta, 3);
+
+    guest.priority = 0;
+    ASSERT_THROW(scheduler.Submit(MakeGuest(scheduler, 1), guest, nullptr), std::invalid_argument);
+
+    options.quantum = 0;
+    ASSERT_THROW(Scheduler { options }, std::invalid_argument);
+}
+
+TEST(SchedulerTest, Priority)
+{
+    SchedulerOptions options;
+    options.quantum     = 100;
+    options.startCredit = 0;
+    Scheduler scheduler { options };
+
+    // The only worker waits in the first guest until both others are queued.
+    std::promise<void> release;
+    auto               released = release.get_future().share();
+    scheduler.Submit(MakeGuest(scheduler, 1), GuestOptions {}, [released](Emulator&, GuestResult) {
+        released.wait();
+    });
+
+    std::mutex            mutex;
+    std::vector<uint64_t> finished;
+    uint64_t              numRetiredAtFirst = 0;
+    auto const            onFinished        = [&](Emulator&, GuestResult result) {
+        std::lock_guard<std::mutex> lock { mutex };
+        if (finished.empty())
+            numRetiredAtFirst = scheduler.GetStats().numInstructions;
+        finished.push_back(result.id);
+    };
+
+    GuestOptions high;
+    high.priority        = 3;
+    high.maxInstructions = 30000;
+    GuestOptions low;
+    low.maxInstructions = 30000;
+
+    uint64_t const highId = scheduler.Submit(MakeGuest(scheduler, 100000), high, onFinished);
+    scheduler.Submit(MakeGuest(scheduler, 100000), low, onFinished);
+    release.set_value();
+    scheduler.Wait();
+
+    // The other guest retired a third as many instructions by then, besides the first guest's
+    // and the last quantum, which are not counted yet.
+    ASSERT_EQ(finished.size(), 2);
+    ASSERT_EQ(finished[0], highId);
+    ASSERT_GE(numRetiredAtFirst, 39000);
+    ASSERT_LE(numRetiredAtFirst, 41000);
+}
+
+TEST(SchedulerTest, ShortGuest)
+{
+    SchedulerOptions options;
+    options.quantum = 1000;
+    Scheduler scheduler { options };
+
+    // The long guests are all queued before any of them runs, so that they start together.
+    std::promise<void> release;
+    auto               released = release.get_future().share();
+    scheduler.Submit(MakeGuest(scheduler, 1), GuestOptions {}, [released](Emulator&, GuestResult) {
+        released.wait();
+    });
+
+    constexpr size_t NumLongGuests = 8;
+    for (size_t i = 0; i < NumLongGuests; ++i)
+        scheduler.Submit(MakeGuest(scheduler, 200000), GuestOptions {}, nullptr);
+    release.set_value();
+
+    // Waits until the long guests have used up their credit.
+    while (scheduler.GetStats().numQuanta < 1 + NumLongGuests * (options.startCredit + 1))
+        std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+
+    std::promise<SchedulerStats> promise;
+    scheduler.Submit(MakeGuest(scheduler, 10), GuestOptions {}, [&](Emulator&, GuestResult) {
+        promise.set_value(scheduler.GetStats());
+    });
+    uint64_t const numQuanta = scheduler.GetStats().numQuanta;
+
+    // The short guest runs right after the quantum which is running when it is queued. Quanta
+    // which finish before the count above is taken only loosen the bound.
+    SchedulerStats const stats = promise.get_future().get();
+    ASSERT_LE(stats.numQuanta, numQuanta + 1);
+    ASSERT_EQ(stats.numFinished, 1);
+    ASSERT_EQ(stats.numGuests, NumLongGuests + 1);
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Common.hh>
+#include <simple-mips-emu/Memory.hh>
+#include <simple-mips-emu/SegmentPool.hh>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TEST(SegmentPoolTest, Reuse)
+{
+    SegmentPool  pool;
+    size_t const pageSize = GetPageSize();
+
+    SegmentPool::Block block = pool.Allocate(pageSize + 1, true);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(block.bytes) % pageSize, 0);
+    ASSERT_EQ(block.capacity, pageSize * 2);
+    ASSERT_TRUE(std::all_of(block.bytes, block.bytes + block.capacity, [](uint8_t byte) {
+        return byte == 0;
+    }));
+
+    std::memset(block.bytes, 0xAB, 100);
+    block.dirty = 100;
+    uint8_t* const bytes = block.bytes;
+    pool.Release(block);
+    ASSERT_EQ(pool.GetStats().numCachedBytes, pageSize * 2);
+
+    // A block of the same class is reused, and only its dirty bytes are cleared.
+    block = pool.Allocate(pageSize * 2, true);
+    ASSERT_EQ(block.bytes, bytes);
+    ASSERT_EQ(block.dirty, pageSize * 2);
+    ASSERT_TRUE(std::all_of(block.bytes, block.bytes + block.capacity, [](uint8_t byte) {
+        return byte == 0;
+    }));
+
+    SegmentPoolStats const& stats = pool.GetStats();
+    ASSERT_EQ(stats.numAllocations, 2);
+    ASSERT_EQ(stats.numReuses, 1);
+    ASSERT_EQ(stats.numBytesZeroed, 100);
+    ASSERT_EQ(stats.numCachedBytes, 0);
+
+    // Blocks of other classes are not.
+    SegmentPool::Block other = pool.Allocate(1, true);
+    ASSERT_EQ(other.capacity, pageSize);
+    ASSERT_EQ(stats.numReuses, 1);
+
+    // Nothing is kept beyond the limit.
+    pool.SetMaxCachedBytes(pageSize);
+    pool.Release(block);
+    pool.Release(other);
+    ASSERT_EQ(stats.numCachedBytes, pageSize);
+    pool.Trim();
+    ASSERT_EQ(stats.numCachedBytes, 0);
+}
+
+TEST(SegmentPoolTest, Buffer)
+{
+    SegmentPool* const pool = SegmentPool::GetLocal();
+    ASSERT_NE(pool, nullptr);
+    pool->Trim();
+
+    uint8_t const* bytes = nullptr;
+    {
+        SegmentBuffer buffer { 64 };
+        ASSERT_EQ(buffer.size(), 64);
+        std::fill(buffer.begin(), buffer.end(), 0xFF);
+        EXPECT_THROW(buffer.at(64), std::out_of_range);
+        bytes = buffer.data();
+
+        SegmentBuffer const copy = buffer;
+        ASSERT_NE(copy.data(), buffer.data());
+        ASSERT_TRUE(std::equal(copy.begin(), copy.end(), buffer.begin(), buffer.end()));
+    }
+
+    // A memory of the same size takes the block back, cleared.
+    uint64_t const numZeroed = pool->GetStats().numBytesZeroed;
+    Memory         memory { 16, 4 };
+    ASSERT_EQ(std::as_const(memory).GetSegmentByBase(Address::BaseType::Text).data(), bytes);
+    for (uint32_t i = 0; i < 16; ++i) ASSERT_EQ(memory.GetByte(Address::MakeText(i)), 0);
+    ASSERT_EQ(pool->GetStats().numBytesZeroed - numZeroed, 20);
+
+    // Assigning a memory copies into the blocks the target already has.
+    memory.SetWord(Address::MakeText(0), 0x12345678);
+    Memory         copy { 16, 4 };
+    uint8_t const* copyBytes = std::as_const(copy).GetSegmentByBase(Address::BaseType::Text).data();
+    copy                     = memory;
+    ASSERT_EQ(std::as_const(copy).GetSegmentByBase(Address::BaseType::Text).data(), copyBytes);
+    ASSERT_EQ(copy.GetWord(Address::MakeText(0)), 0x12345678);
+}
+
+TEST(SegmentPoolTest, Threads)
+{
+    // Each thread keeps its own blocks; memories may be released on other threads.
+    std::vector<Memory> memories;
+    for (int i = 0; i < 4; ++i) memories.emplace_back(4096, 4096);
+
+    std::vector<std::thread> threads;
+    for (Memory& memory : memories)
+    {
+        threads.emplace_back([&memory]() {
+            SegmentPool* const pool = SegmentPool::GetLocal();
+            ASSERT_NE(pool, nullptr);
+            ASSERT_EQ(pool->GetStats().numAllocations, 0);
+
+            Memory moved = std::move(memory);
+            for (int run = 0; run < 16; ++run)
+            {
+                Memory copy = moved;
+                copy.SetWord(Address::MakeData(0), static_cast<uint32_t>(run));
+            }
+            ASSERT_EQ(pool->GetStats().numReuses, 30);
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+}
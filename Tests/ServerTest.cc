@@ -0,0 +1,327 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Server.hh>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+std::vector<uint8_t> ToBytes(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rtn.push_back(static_cast<uint8_t>(word >> shift & 0xFF));
+
+    return rtn;
+}
+
+// Doubles the first data word into the second one.
+std::vector<uint32_t> const TextWords = {
+    0x3c081000, // lui  $8, 0x1000
+    0x8d090000, // lw   $9, 0($8)
+    0x01294821, // addu $9, $9, $9
+    0xad090004, // sw   $9, 4($8)
+};
+
+JobRequest MakeRequest(uint64_t id, uint32_t value)
+{
+    JobRequest rtn;
+    rtn.id     = id;
+    rtn.ranges = { AddressRange { Address::MakeData(0), Address::MakeData(4) } };
+    rtn.text   = ToBytes(TextWords);
+    rtn.data   = ToBytes({ value, 0 });
+    return rtn;
+}
+
+fs::path MakeTemporaryPath(char const* suffix)
+{
+    auto const now = std::chrono::steady_clock::now().time_since_epoch().count();
+    return fs::temp_directory_path() / ("sme-server-test-" + std::to_string(now) + suffix);
+}
+
+}
+
+TEST(ServerTest, Codec)
+{
+    JobRequest request      = MakeRequest(7, 21);
+    request.maxInstructions = 3;
+    request.timeLimitMs     = 100;
+
+    std::vector<uint8_t>      bytes   = EncodeJobRequest(request);
+    std::optional<JobRequest> decoded = DecodeJobRequest(bytes.data(), bytes.size());
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(decoded->id, 7);
+    ASSERT_EQ(decoded->maxInstructions, 3);
+    ASSERT_EQ(decoded->timeLimitMs, 100);
+    ASSERT_EQ(decoded->ranges.size(), 1);
+    ASSERT_EQ(static_cast<uint32_t>(decoded->ranges[0].end), 0x10000004);
+    ASSERT_EQ(decoded->text, request.text);
+    ASSERT_EQ(decoded->data, request.data);
+    ASSERT_FALSE(DecodeJobRequest(bytes.data(), bytes.size() - 1));
+
+    request.path = "program.txt";
+    bytes        = EncodeJobRequest(request);
+    decoded      = DecodeJobRequest(bytes.data(), bytes.size());
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(decoded->path, "program.txt");
+    ASSERT_TRUE(decoded->text.empty());
+
+    JobResponse response;
+    response.id              = 3;
+    response.status          = 0;
+    response.numInstructions = 4;
+    response.output          = "output";
+
+    bytes = EncodeJobResponse(response);
+    std::optional<JobResponse> decodedResponse = DecodeJobResponse(bytes.data(), bytes.size());
+    ASSERT_TRUE(decodedResponse);
+    ASSERT_EQ(decodedResponse->id, 3);
+    ASSERT_EQ(decodedResponse->numInstructions, 4);
+    ASSERT_EQ(decodedResponse->output, "output");
+}
+
+TEST(ServerTest, Serve)
+{
+    if (!Server::IsSupported())
+        GTEST_SKIP();
+
+    fs::path const socketPath  = MakeTemporaryPath(".sock");
+    fs::path const programPath = MakeTemporaryPath(".txt");
+    {
+        std::ofstream ofs { programPath };
+        ofs << "0x" << std::hex << TextWords.size() * 4 << "\n0x8\n";
+        for (uint32_t word : TextWords) ofs << "0x" << word << '\n';
+        ofs << "0x10\n0x0\n";
+    }
+
+    Server server { socketPath, 2, ProgramOptions {} };
+    ASSERT_TRUE(server.Listen());
+    std::thread thread { [&server]() { server.Serve(); } };
+
+    ServerClient client;
+    ASSERT_TRUE(client.Connect(socketPath));
+
+    // Jobs are sent at once; responses come back as the workers finish them.
+    constexpr uint64_t NumJobs = 32;
+    for (uint64_t id = 0; id < NumJobs; ++id)
+        ASSERT_TRUE(client.Send(MakeRequest(id, static_cast<uint32_t>(id))));
+
+    JobRequest fromFile = MakeRequest(NumJobs, 0);
+    fromFile.path       = programPath.string();
+    ASSERT_TRUE(client.Send(fromFile));
+
+    JobRequest missing = fromFile;
+    missing.id         = NumJobs + 1;
+    missing.path       = programPath.string() + ".missing";
+    ASSERT_TRUE(client.Send(missing));
+
+    std::map<uint64_t, JobResponse> responses;
+    for (uint64_t i = 0; i < NumJobs + 2; ++i)
+    {
+        std::optional<JobResponse> response = client.Receive();
+        ASSERT_TRUE(response);
+        responses[response->id] = *response;
+    }
+    ASSERT_EQ(responses.size(), NumJobs + 2);
+
+    for (uint64_t id = 0; id < NumJobs; ++id)
+    {
+        Emulator          emulator;
+        JobResponse const expected = RunJob(emulator, MakeRequest(id, static_cast<uint32_t>(id)));
+
+        JobResponse const& actual = responses[id];
+        ASSERT_EQ(actual.status, static_cast<uint32_t>(TickResult::Success));
+        ASSERT_EQ(actual.numInstructions, 4);
+        ASSERT_EQ(actual.output, expected.output);
+    }
+
+    ASSERT_EQ(responses[NumJobs].status, static_cast<uint32_t>(TickResult::Success));
+    ASSERT_NE(responses[NumJobs].output.find("0x10000004: 0x20"), std::string::npos);
+    ASSERT_EQ(responses[NumJobs + 1].status, JobResponse::InvalidJob);
+
+    server.Stop();
+    thread.join();
+    ASSERT_FALSE(fs::exists(socketPath));
+    fs::remove(programPath);
+}
+
+TEST(ServerTest, BadPaths)
+{
+    if (!Server::IsSupported())
+        GTEST_SKIP();
+
+    fs::path const socketPath = MakeTemporaryPath(".sock");
+
+    Server server { socketPath, 1, ProgramOptions {} };
+    ASSERT_TRUE(server.Listen());
+    std::thread thread { [&server]() { server.Serve(); } };
+
+    // A file name longer than any host allows makes the job invalid.
+    {
+        ServerClient client;
+        ASSERT_TRUE(client.Connect(socketPath));
+
+        JobRequest request = MakeRequest(1, 0);
+        request.path       = (fs::temp_directory_path() / std::string(300, 'a')).string();
+        ASSERT_TRUE(client.Send(request));
+
+        std::optional<JobResponse> response = client.Receive();
+        ASSERT_TRUE(response);
+        ASSERT_EQ(response->id, 1);
+        ASSERT_EQ(response->status, JobResponse::InvalidJob);
+    }
+
+    // A path longer than the protocol allows makes the request malformed.
+    {
+        ServerClient client;
+        ASSERT_TRUE(client.Connect(socketPath));
+
+        JobRequest request = MakeRequest(2, 0);
+        request.path       = std::string(6000, 'a');
+        ASSERT_TRUE(client.Send(request));
+
+        std::optional<JobResponse> response = client.Receive();
+        ASSERT_TRUE(response);
+        ASSERT_EQ(response->status, JobResponse::InvalidJob);
+        ASSERT_EQ(response->output, "Malformed request");
+    }
+
+    // The server still runs jobs.
+    ServerClient client;
+    ASSERT_TRUE(client.Connect(socketPath));
+    ASSERT_TRUE(client.Send(MakeRequest(3, 21)));
+
+    std::optional<JobResponse> response = client.Receive();
+    ASSERT_TRUE(response);
+    ASSERT_EQ(response->status, static_cast<uint32_t>(TickResult::Success));
+    ASSERT_NE(response->output.find("0x10000004: 0x2a"), std::string::npos);
+
+    server.Stop();
+    thread.join();
+}
+
+TEST(ServerTest, LargeDumps)
+{
+    if (!Server::IsSupported())
+        GTEST_SKIP();
+
+    fs::path const socketPath = MakeTemporaryPath(".sock");
+
+    Server server { socketPath, 1, ProgramOptions {} };
+    ASSERT_TRUE(server.Listen());
+    std::thread thread { [&server]() { server.Serve(); } };
+
+    ServerClient client;
+    ASSERT_TRUE(client.Connect(socketPath));
+
+    // Every range is short enough by itself, but together they are far too long to dump.
+    JobRequest request = MakeRequest(1, 0);
+    request.ranges.assign(
+        1 << 12, AddressRange { Address::MakeData(0), Address::MakeData((4 << 20) - 4) });
+    ASSERT_TRUE(client.Send(request));
+
+    std::optional<JobResponse> response = client.Receive();
+    ASSERT_TRUE(response);
+    ASSERT_EQ(response->id, 1);
+    ASSERT_EQ(response->status, JobResponse::InvalidJob);
+    ASSERT_EQ(response->output, "Invalid range");
+
+    ASSERT_TRUE(client.Send(MakeRequest(2, 21)));
+    response = client.Receive();
+    ASSERT_TRUE(response);
+    ASSERT_EQ(response->status, static_cast<uint32_t>(TickResult::Success));
+
+    server.Stop();
+    thread.join();
+}
+
+TEST(ServerTest, SlowClient)
+{
+    if (!Server::IsSupported())
+        GTEST_SKIP();
+
+    fs::path const socketPath = MakeTemporaryPath(".sock");
+
+    Server server { socketPath, 1, ProgramOptions {} };
+    ASSERT_TRUE(server.Listen());
+    std::thread thread { [&server]() { server.Serve(); } };
+
+    // The responses of this client are far larger than the socket buffer, and it never reads
+    // them.
+    ServerClient slow;
+    ASSERT_TRUE(slow.Connect(socketPath));
+    for (uint64_t id = 0; id < 4; ++id)
+    {
+        JobRequest request = MakeRequest(id, 0);
+        request.ranges     = { AddressRange { Address::MakeData(0), Address::MakeData(1 << 20) } };
+        ASSERT_TRUE(slow.Send(request));
+    }
+
+    // The only worker still runs the jobs of other clients.
+    ServerClient client;
+    ASSERT_TRUE(client.Connect(socketPath));
+    ASSERT_TRUE(client.Send(MakeRequest(4, 21)));
+
+    auto response = std::async(std::launch::async, [&client]() { return client.Receive(); });
+    bool const isAnswered =
+        response.wait_for(std::chrono::seconds { 10 }) == std::future_status::ready;
+
+    server.Stop();
+    thread.join();
+
+    ASSERT_TRUE(isAnswered);
+    ASSERT_TRUE(response.get());
+}
+
+TEST(ServerTest, OutputLimit)
+{
+    if (!Server::IsSupported())
+        GTEST_SKIP();
+
+    fs::path const socketPath = MakeTemporaryPath(".sock");
+
+    Server server { socketPath, 1, ProgramOptions {} };
+    ASSERT_TRUE(server.Listen());
+    std::thread thread { [&server]() { server.Serve(); } };
+
+    // Prints a string of 1 MiB 40 times.
+    JobRequest request;
+    request.id              = 1;
+    request.maxInstructions = 2 + 2 * 40;
+    request.text            = ToBytes({
+        0x3c041000, // lui   $4, 0x1000
+        0x24020004, // addiu $2, $0, 4
+        0x0000000c, // syscall
+        0x08100002, // j     0x400008
+    });
+    request.data.assign(1 << 20, 'a');
+    request.data.back() = 0;
+
+    ServerClient client;
+    ASSERT_TRUE(client.Connect(socketPath));
+    ASSERT_TRUE(client.Send(request));
+    std::optional<JobResponse> response = client.Receive();
+
+    server.Stop();
+    thread.join();
+
+    // What it prints past the limit is dropped; the registers follow as usual.
+    ASSERT_TRUE(response);
+    ASSERT_EQ(response->status, static_cast<uint32_t>(TickResult::Success));
+    ASSERT_EQ(response->numInstructions, request.maxInstructions);
+    ASSERT_LT(response->output.size(), (16 << 20) + (1 << 12));
+    ASSERT_EQ(response->output.find_first_not_of('a'), 16 << 20);
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Sweep.hh>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t> ToBytes(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rtn.push_back(static_cast<uint8_t>(word >> shift & 0xFF));
+
+    return rtn;
+}
+
+/*
+    .data
+addend:
+    .word   0
+result:
+    .word   0
+
+    .text
+main:
+    lui     $t0, 0x1000
+    lw      $t1, 0($t0)
+    mult    $a0, $a0
+    mflo    $v0
+    addu    $v0, $v0, $t1
+    sw      $v0, 4($t0)
+*/
+std::vector<uint32_t> const Text = {
+    0x3C081000, 0x8D090000, 0x00840018, 0x00001012, 0x00491021, 0xAD020004,
+};
+
+ProgramImage MakeImage()
+{
+    return ProgramImage { Memory { ToBytes(Text), std::vector<uint8_t>(8) }, ProgramOptions {} };
+}
+
+}
+
+TEST(SweepTest, Run)
+{
+    ProgramImage const image = MakeImage();
+
+    SweepOptions options;
+    options.inputs     = { SweepField::MakeRegister(Memory::A0),
+                       SweepField::MakeMemory(Address::MakeData(0), 1) };
+    options.outputs    = { SweepField::MakeMemory(Address::MakeData(4), 1),
+                        SweepField::MakeRegister(Memory::V0) };
+    options.numWorkers = 3;
+
+    size_t const          numInputs = 1000;
+    std::vector<uint32_t> inputs;
+    for (uint32_t i = 0; i < numInputs; ++i)
+    {
+        inputs.push_back(i);
+        inputs.push_back(i * 7);
+    }
+
+    SweepResult const result = RunSweep(image, inputs, options);
+    ASSERT_EQ(result.numInputs, numInputs);
+    ASSERT_EQ(result.columns.size(), numInputs * 3);
+    ASSERT_EQ(result.numInstructions, numInputs * Text.size());
+    for (uint32_t i = 0; i < numInputs; ++i)
+    {
+        ASSERT_EQ(result.columns[i], static_cast<uint32_t>(TickResult::Success));
+        ASSERT_EQ(result.columns[numInputs + i], i * i + i * 7);
+        ASSERT_EQ(result.columns[numInputs * 2 + i], i * i + i * 7);
+    }
+
+    // Every run starts from the image, which is left as it is.
+    ASSERT_EQ(image.GetMemory().GetWord(Address::MakeData(4)), 0);
+
+    // The instruction limit applies to each run.
+    options.limits.maxInstructions = 4;
+    SweepResult const limited      = RunSweep(image, inputs, options);
+    ASSERT_EQ(limited.numInstructions, numInputs * 4);
+    ASSERT_EQ(limited.columns[numInputs + 5], 0);
+    ASSERT_EQ(limited.columns[numInputs * 2 + 5], 25);
+
+    options.outputs = { SweepField::MakeMemory(Address::MakeData(4), 2) };
+    ASSERT_THROW(RunSweep(image, inputs, options), std::invalid_argument);
+    options.outputs = { SweepField::MakeRegister(RegisterFileSize) };
+    ASSERT_THROW(RunSweep(image, inputs, options), std::invalid_argument);
+}
+
+TEST(SweepTest, SharedText)
+{
+    ProgramImage const image = MakeImage();
+    Memory             memory { 0, 0 };
+
+    memory.ResetFrom(image.GetMemory());
+    ASSERT_EQ(memory.GetTextVersion(), image.GetProgram().GetTextVersion());
+    ASSERT_EQ(memory.GetWord(Address::MakeText(0)), Text[0]);
+
+    // The text is copied when it is written to.
+    memory.SetWord(Address::MakeText(0), 0);
+    ASSERT_NE(memory.GetTextVersion(), image.GetProgram().GetTextVersion());
+    ASSERT_EQ(image.GetMemory().GetWord(Address::MakeText(0)), Text[0]);
+
+    memory.ResetFrom(image.GetMemory());
+    ASSERT_EQ(memory.GetWord(Address::MakeText(0)), Text[0]);
+    ASSERT_EQ(memory.GetTextVersion(), image.GetProgram().GetTextVersion());
+}
+
+TEST(SweepTest, Files)
+{
+    namespace fs = std::filesystem;
+
+    fs::path const inputPath  = fs::temp_directory_path() / "sweep-test-inputs.bin";
+    fs::path const resultPath = fs::temp_directory_path() / "sweep-test-results.bin";
+    {
+        std::ofstream ofs { inputPath, std::ios::binary };
+        uint8_t const bytes[] = { 1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0, 4, 0, 0, 0 };
+        ofs.write(reinterpret_cast<char const*>(bytes), sizeof(bytes));
+    }
+
+    SweepInputsReadResult read = ReadSweepInputs(inputPath, 2, ByteOrder::Little);
+    ASSERT_TRUE(std::holds_alternative<std::vector<uint32_t>>(read));
+    std::vector<uint32_t> const inputs = std::get<std::vector<uint32_t>>(read);
+    ASSERT_EQ(inputs, (std::vector<uint32_t> { 1, 2, 3, 4 }));
+
+    read = ReadSweepInputs(inputPath, 3, ByteOrder::Little);
+    ASSERT_TRUE(std::holds_alternative<CannotRead>(read));
+
+    SweepOptions options;
+    options.inputs  = { SweepField::MakeRegister(Memory::A0),
+                       SweepField::MakeMemory(Address::MakeData(0), 1) };
+    options.outputs = { SweepField::MakeRegister(Memory::V0) };
+
+    SweepResult const result = RunSweep(MakeImage(), inputs, options);
+    ASSERT_FALSE(WriteSweepResult(resultPath, result, ByteOrder::Big).has_value());
+
+    std::ifstream              ifs { resultPath, std::ios::binary };
+    std::vector<uint8_t> const bytes { std::istreambuf_iterator<char> { ifs },
+                                       std::istreambuf_iterator<char> {} };
+    ASSERT_EQ(bytes, (std::vector<uint8_t> { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 13 }));
+
+    fs::remove(inputPath);
+    fs::remove(resultPath);
+}
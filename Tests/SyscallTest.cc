@@ -0,0 +1,201 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Syscall.hh>
+
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t> ToBytes(std::vector<uint32_t> const& words)
+{
+    std::vector<uint8_t> rtn;
+    for (uint32_t word : words)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rtn.push_back(static_cast<uint8_t>(word >> shift & 0xFF));
+
+    return rtn;
+}
+
+/*
+    .data
+msg:
+    .asciiz "Hi!"
+    .byte   1, 2
+
+    .text
+main:
+    la      $a0, msg
+    li      $v0, 4          # print_string
+    syscall
+    li      $a0, -42
+    li      $v0, 1          # print_int
+    syscall
+    li      $a0, 10
+    li      $v0, 11         # print_char
+    syscall
+    li      $v0, 5          # read_int
+    syscall
+    addu    $a0, $v0, $v0
+    li      $v0, 1          # print_int
+    syscall
+    li      $a0, 8
+    li      $v0, 9          # sbrk
+    syscall
+    sw      $a0, 0($v0)
+    li      $v0, 10         # exit
+    syscall
+    li      $a0, 1
+*/
+std::vector<uint32_t> const Text = {
+    0x3C041000, 0x34840000, 0x24020004, 0x0000000C, 0x2404FFD6, 0x24020001, 0x0000000C,
+    0x2404000A, 0x2402000B, 0x0000000C, 0x24020005, 0x0000000C, 0x00422021, 0x24020001,
+    0x0000000C, 0x24040008, 0x24020009, 0x0000000C, 0xAC440000, 0x2402000A, 0x0000000C,
+    0x24040001,
+};
+
+std::vector<uint8_t> const Data = { 'H', 'i', '!', 0, 1, 2 };
+
+void CheckFinalState(Memory const& memory)
+{
+    ASSERT_TRUE(memory.IsTerminated());
+    ASSERT_EQ(memory.GetRegister(Memory::A0), 8);
+    ASSERT_EQ(memory.GetDataSize(), 16);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 0x01020000);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(8)), 8);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(12)), 0);
+}
+
+}
+
+TEST(SyscallTest, Tick)
+{
+    Memory             memory { ToBytes(Text), Data };
+    std::ostringstream output;
+    std::istringstream input { "7\n" };
+    SyscallHost        host { output, input };
+
+    RunLimits limits;
+    limits.syscallHost = &host;
+
+    uint64_t numInstructions = 0;
+    while (!memory.IsTerminated())
+    {
+        TickResult result = Tick(memory);
+        if (result == TickResult::Syscall)
+            result = ServiceSyscall(memory, limits);
+        ASSERT_EQ(result, TickResult::Success);
+        ++numInstructions;
+    }
+    host.Flush();
+
+    ASSERT_EQ(numInstructions, 21);
+    ASSERT_EQ(output.str(), "Hi!-42\n14");
+    CheckFinalState(memory);
+}
+
+TEST(SyscallTest, RunProgram)
+{
+    Memory             memory { ToBytes(Text), Data };
+    Program const      program { memory };
+    std::ostringstream output;
+    std::istringstream input { "7\n" };
+    SyscallHost        host { output, input };
+
+    // Without a host, the run stops at the first system call.
+    RunLimits limits;
+    RunResult result = RunProgram(memory, program, limits);
+    ASSERT_EQ(result.result, TickResult::Syscall);
+    ASSERT_EQ(result.numInstructions, 3);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(12));
+
+    limits.syscallHost = &host;
+    limits.checkInterval = 2;
+    result               = RunProgram(memory, program, limits);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 18);
+
+    // Output stays in the buffer until it is flushed.
+    ASSERT_EQ(output.str(), "Hi!-42\n");
+    host.Flush();
+    ASSERT_EQ(output.str(), "Hi!-42\n14");
+    CheckFinalState(memory);
+}
+
+TEST(SyscallTest, Errors)
+{
+    std::ostringstream output;
+    std::istringstream input { "x\n-3" };
+    SyscallHost        host { output, input, 4, 64 };
+
+    Memory memory { ToBytes({ 0x0000000C }), { 'a', 'b', 'c' } };
+    auto   call = [&memory, &host](SyscallCode code, uint32_t argument) {
+        memory.SetRegister(Memory::PC, Address::MakeText(0));
+        memory.SetRegister(Memory::V0, static_cast<uint32_t>(code));
+        memory.SetRegister(Memory::A0, argument);
+        return host.Service(memory);
+    };
+
+    // Strings must end within their segment; the memory is left as it is otherwise.
+    ASSERT_EQ(call(SyscallCode::PrintString, Address::MakeData(0)), TickResult::MemoryOutOfRange);
+    ASSERT_EQ(call(SyscallCode::PrintString, Address::MakeData(3)), TickResult::MemoryOutOfRange);
+    ASSERT_EQ(call(SyscallCode::PrintString, 0x100), TickResult::MemoryOutOfRange);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(0));
+
+    memory.SetRegister(Memory::V0, 99);
+    ASSERT_EQ(host.Service(memory), TickResult::InvalidInstruction);
+
+    // Invalid input reads as 0 and is skipped.
+    ASSERT_EQ(call(SyscallCode::ReadInt, 0), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(Memory::V0), 0);
+    ASSERT_EQ(memory.GetRegister(Memory::PC), Address::MakeText(4));
+    ASSERT_EQ(call(SyscallCode::ReadInt, 0), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(Memory::V0), static_cast<uint32_t>(-3));
+    ASSERT_EQ(call(SyscallCode::ReadInt, 0), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(Memory::V0), 0);
+
+    // The data segment grows up to the limit only.
+    ASSERT_EQ(call(SyscallCode::Sbrk, static_cast<uint32_t>(-4)), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(Memory::V0), static_cast<uint32_t>(-1));
+    ASSERT_EQ(call(SyscallCode::Sbrk, 61), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(Memory::V0), static_cast<uint32_t>(-1));
+    ASSERT_EQ(call(SyscallCode::Sbrk, 60), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(Memory::V0), Address::MakeData(4));
+    ASSERT_EQ(memory.GetDataSize(), 64);
+    ASSERT_EQ(memory.GetByte(Address::MakeData(2)), 'c');
+    ASSERT_EQ(memory.GetByte(Address::MakeData(3)), 0);
+
+    // The buffer is written out when it is full, and longer strings skip it.
+    ASSERT_EQ(call(SyscallCode::PrintInt, 123), TickResult::Success);
+    ASSERT_EQ(output.str(), "");
+    ASSERT_EQ(call(SyscallCode::PrintInt, 45), TickResult::Success);
+    ASSERT_EQ(output.str(), "123");
+    memory.SetWord(Address::MakeData(0), 0x61626364);
+    memory.SetWord(Address::MakeData(4), 0x65000000);
+    ASSERT_EQ(call(SyscallCode::PrintString, Address::MakeData(0)), TickResult::Success);
+    ASSERT_EQ(output.str(), "12345abcde");
+}
+
+TEST(SyscallTest, OutputLimit)
+{
+    Memory             memory { ToBytes(Text), Data };
+    std::ostringstream output;
+    std::istringstream input { "7\n" };
+    SyscallHost        host { output, input, 4, SyscallHost::DefaultMaxDataSize, 5 };
+
+    RunLimits limits;
+    limits.syscallHost = &host;
+
+    // The program runs as usual, but what it prints past the limit is dropped.
+    Program const   program { memory };
+    RunResult const result = RunProgram(memory, program, limits);
+    host.Flush();
+
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(output.str(), "Hi!-4");
+    CheckFinalState(memory);
+}
@@ -0,0 +1,206 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Trace.hh>
+
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+Memory MakeMemory(std::initializer_list<uint32_t> words)
+{
+    Memory  memory { static_cast<uint32_t>(words.size() * 4), 16 };
+    Address address = Address::MakeText(0);
+    for (uint32_t word : words)
+    {
+        memory.SetWord(address, word);
+        address.MoveToNext();
+    }
+
+    return memory;
+}
+
+// clang-format off
+std::initializer_list<uint32_t> const LoopProgram = {
+    0x24080003, // addiu $8,  $0,  3
+    0x3c091000, // lui   $9,  0x1000
+    0x00000000, // loop: sll $0, $0, 0
+    0xad280000, // sw    $8,  0($9)
+    0x2508ffff, // addiu $8,  $8,  -1
+    0x1500fffc, // bne   $8,  $0,  loop
+};
+// clang-format on
+
+/// <summary>
+/// Runs the program to the end and returns the ticks (starting from one) the sampler dumps.
+/// </summary>
+std::vector<uint64_t> Sample(DumpTriggers const& triggers, std::ostream& os)
+{
+    Memory memory = MakeMemory(LoopProgram);
+
+    std::vector<uint64_t> rtn;
+    AddressRange          range { Address::MakeData(0), Address::MakeData(0) };
+    DumpSampler           sampler { triggers, range, memory };
+    for (uint64_t tick = 1; !memory.IsTerminated(); ++tick)
+    {
+        EXPECT_EQ(Tick(memory), TickResult::Success);
+        if (sampler.OnTick(memory))
+            rtn.push_back(tick);
+    }
+    sampler.DumpLast(os);
+
+    return rtn;
+}
+
+size_t CountDumps(std::string const& output)
+{
+    size_t rtn = 0;
+    size_t pos = output.find("Current register values");
+    while (pos != std::string::npos)
+    {
+        ++rtn;
+        pos = output.find("Current register values", pos + 1);
+    }
+
+    return rtn;
+}
+
+}
+
+TEST(TraceTest, Snapshot)
+{
+    Memory memory = MakeMemory(LoopProgram);
+    memory.SetWord(Address::MakeData(4), 0x1234);
+
+    StateSnapshot snapshot { AddressRange { Address::MakeData(0), Address::MakeData(4) } };
+    snapshot.Capture(memory);
+
+    std::ostringstream expected;
+    memory.DumpRegisters(expected);
+    expected << '\n';
+    memory.DumpMemory(expected, Address::MakeData(0), Address::MakeData(4));
+    expected << '\n';
+
+    std::ostringstream actual;
+    snapshot.Dump(actual);
+    ASSERT_EQ(actual.str(), expected.str());
+
+    StateSnapshot other { AddressRange { Address::MakeData(0), Address::MakeData(4) } };
+    other.Capture(memory);
+    ASSERT_TRUE(snapshot.HasSameValues(other));
+
+    memory.SetRegister(Memory::PC, 0x400004);
+    other.Capture(memory);
+    ASSERT_TRUE(snapshot.HasSameValues(other));
+
+    memory.SetWord(Address::MakeData(0), 1);
+    other.Capture(memory);
+    ASSERT_FALSE(snapshot.HasSameValues(other));
+}
+
+TEST(TraceTest, Triggers)
+{
+    // The program runs for 14 ticks; the loop body starts at ticks 2, 6 and 10.
+    std::ostringstream os;
+
+    DumpTriggers every;
+    every.every = 4;
+    ASSERT_EQ(Sample(every, os), (std::vector<uint64_t> { 4, 8, 12 }));
+
+    DumpTriggers pcRange;
+    pcRange.pcRange = AddressRange { Address::MakeText(8), Address::MakeText(8) };
+    ASSERT_EQ(Sample(pcRange, os), (std::vector<uint64_t> { 2, 6, 10 }));
+
+    // The stores change the watched word, and the loop counter changes every iteration.
+    DumpTriggers onChange;
+    onChange.onChange = true;
+    ASSERT_EQ(Sample(onChange, os), (std::vector<uint64_t> { 1, 2, 4, 5, 8, 9, 12, 13 }));
+
+    DumpTriggers first;
+    first.first = 3;
+    first.every = 2;
+    ASSERT_EQ(Sample(first, os), (std::vector<uint64_t> { 1, 2, 3, 4, 6, 8, 10, 12, 14 }));
+    ASSERT_EQ(os.str(), "");
+}
+
+TEST(TraceTest, Last)
+{
+    DumpTriggers triggers;
+    triggers.last  = 4;
+    triggers.every = 6;
+
+    // Tick 12 is dumped already, so only 11, 13 and 14 are left.
+    std::ostringstream os;
+    ASSERT_EQ(Sample(triggers, os), (std::vector<uint64_t> { 6, 12 }));
+    ASSERT_EQ(CountDumps(os.str()), 3);
+
+    triggers.last = 100;
+    os.str("");
+    Sample(triggers, os);
+    ASSERT_EQ(CountDumps(os.str()), 12);
+}
+
+TEST(TraceTest, RingBuffer)
+{
+    constexpr uint32_t NumValues = 100000;
+
+    RingBuffer<uint32_t> buffer { 5 };
+    ASSERT_TRUE(buffer.IsEmpty());
+    ASSERT_TRUE(buffer.TryPush(0));
+    ASSERT_FALSE(buffer.IsEmpty());
+    for (uint32_t i = 1; i < 8; ++i) ASSERT_TRUE(buffer.TryPush(i));
+    ASSERT_FALSE(buffer.TryPush(8));
+
+    uint32_t values[16];
+    ASSERT_EQ(buffer.TryPop(values, 16), 8);
+    ASSERT_EQ(values[7], 7);
+    ASSERT_TRUE(buffer.IsEmpty());
+    ASSERT_EQ(buffer.TryPop(values, 16), 0);
+
+    std::thread producer { [&buffer] {
+        for (uint32_t i = 0; i < NumValues; ++i) buffer.Push(i);
+    } };
+
+    uint32_t expected = 0;
+    while (expected < NumValues)
+    {
+        size_t const count = buffer.TryPop(values, 16);
+        if (count == 0)
+            std::this_thread::yield();
+        for (size_t i = 0; i < count; ++i) ASSERT_EQ(values[i], expected++);
+    }
+    producer.join();
+}
+
+TEST(TraceTest, Writer)
+{
+    AddressRange range { Address::MakeData(0), Address::MakeData(4) };
+
+    // A small buffer makes the emulation wait for the writer.
+    for (size_t capacity : { 4, 1 << 16 })
+    {
+        Memory memory = MakeMemory(LoopProgram);
+
+        std::ostringstream expected, actual;
+        TraceWriter        writer { actual, range, memory, capacity };
+        StateSnapshot      snapshot { range };
+        while (!memory.IsTerminated())
+        {
+            ASSERT_EQ(Tick(memory), TickResult::Success);
+            writer.Dump(memory);
+
+            snapshot.Capture(memory);
+            snapshot.Dump(expected);
+        }
+        writer.Close();
+
+        ASSERT_EQ(actual.str(), expected.str());
+    }
+}
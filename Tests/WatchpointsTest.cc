@@ -0,0 +1,195 @@
+// Copyright (c) 2021 Chanjung Kim. All rights reserved.
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <simple-mips-emu/Emulation.hh>
+#include <simple-mips-emu/Program.hh>
+#include <simple-mips-emu/Syscall.hh>
+#include <simple-mips-emu/Watchpoints.hh>
+
+#include <csignal>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+Memory MakeMemory(std::initializer_list<uint32_t> words)
+{
+    Memory  memory { static_cast<uint32_t>(words.size() * 4), 0x2000 };
+    Address address = Address::MakeText(0);
+    for (uint32_t word : words)
+    {
+        memory.SetWord(address, word);
+        address.MoveToNext();
+    }
+
+    return memory;
+}
+
+// clang-format off
+std::initializer_list<uint32_t> const StoreProgram = {
+    0x3c081000, // lui   $8,  0x1000
+    0x24090005, // addiu $9,  $0,  5
+    0xad090004, // sw    $9,  4($8)
+    0xad090040, // sw    $9,  64($8)
+    0xad091000, // sw    $9,  4096($8)
+    0x25290001, // addiu $9,  $9,  1
+    0xad090004, // sw    $9,  4($8)
+    0xa1090004, // sb    $9,  4($8)
+};
+// clang-format on
+
+volatile std::sig_atomic_t numForeignTraps = 0;
+
+void OnForeignTrap(int)
+{
+    ++numForeignTraps;
+}
+
+}
+
+TEST(WatchpointsTest, Resume)
+{
+    if (!Watchpoints::IsSupported())
+        GTEST_SKIP();
+
+    Memory      memory = MakeMemory(StoreProgram);
+    Program     program { memory };
+    Watchpoints watchpoints { memory };
+    ASSERT_FALSE(watchpoints.Watch(Address::MakeText(0), Address::MakeText(4), WatchAction::Stop));
+    ASSERT_FALSE(
+        watchpoints.Watch(Address::MakeData(0), Address::MakeData(0x2000), WatchAction::Stop));
+    ASSERT_TRUE(watchpoints.Watch(Address::MakeData(4), Address::MakeData(4), WatchAction::Resume));
+
+    RunResult result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(result.numInstructions, 8);
+    ASSERT_FALSE(watchpoints.IsStopped());
+
+    // Stores to other words on the page and to other pages are not reported.
+    auto const& hits = watchpoints.GetHits();
+    ASSERT_EQ(hits.size(), 3);
+    ASSERT_EQ(hits[0].pc, 0x400008);
+    ASSERT_EQ(hits[0].address, 0x10000004);
+    ASSERT_EQ(hits[0].oldValue, 0);
+    ASSERT_EQ(hits[0].newValue, 5);
+    ASSERT_EQ(hits[1].pc, 0x400018);
+    ASSERT_EQ(hits[1].oldValue, 5);
+    ASSERT_EQ(hits[1].newValue, 6);
+    ASSERT_EQ(hits[2].pc, 0x40001c);
+    ASSERT_EQ(hits[2].newValue, 0x06000006);
+
+    ASSERT_EQ(memory.GetWord(Address::MakeData(0x40)), 5);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(0x1000)), 5);
+
+    // The memory is writable again once the watchpoints are gone.
+    watchpoints.Clear();
+    memory.SetWord(Address::MakeData(4), 7);
+    ASSERT_EQ(watchpoints.GetHits().size(), 3);
+}
+
+TEST(WatchpointsTest, Stop)
+{
+    if (!Watchpoints::IsSupported())
+        GTEST_SKIP();
+
+    Memory      memory = MakeMemory(StoreProgram);
+    Program     program { memory };
+    Watchpoints watchpoints { memory };
+    ASSERT_TRUE(watchpoints.Watch(Address::MakeData(0), Address::MakeData(8), WatchAction::Stop));
+
+    RunResult result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.numInstructions, 3);
+    ASSERT_TRUE(watchpoints.IsStopped());
+    ASSERT_EQ(watchpoints.GetHits().size(), 1);
+
+    watchpoints.Resume();
+    ASSERT_FALSE(watchpoints.IsStopped());
+    ASSERT_EQ(memory.GetRegister(Memory::PC), 0x40000c);
+
+    result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.numInstructions, 4);
+    ASSERT_TRUE(watchpoints.IsStopped());
+    ASSERT_EQ(watchpoints.GetHits().size(), 2);
+
+    watchpoints.Resume();
+    result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.numInstructions, 1);
+    ASSERT_TRUE(watchpoints.IsStopped());
+
+    auto const& hits = watchpoints.GetHits();
+    ASSERT_EQ(hits.size(), 3);
+    ASSERT_EQ(hits[2].address, 0x10000004);
+    ASSERT_EQ(hits[2].oldValue, 6);
+}
+
+TEST(WatchpointsTest, Resize)
+{
+    if (!Watchpoints::IsSupported())
+        GTEST_SKIP();
+
+    Memory      memory = MakeMemory(StoreProgram);
+    Program     program { memory };
+    Watchpoints watchpoints { memory };
+    ASSERT_TRUE(watchpoints.Watch(Address::MakeData(4), Address::MakeData(4), WatchAction::Resume));
+    ASSERT_TRUE(memory.IsDataPinned());
+
+    // The watched pages cannot move, so the data segment cannot grow meanwhile.
+    ASSERT_THROW(memory.ResizeData(0x10000), std::logic_error);
+
+    std::ostringstream output;
+    std::istringstream input;
+    SyscallHost        host { output, input };
+    memory.SetRegister(Memory::V0, static_cast<uint32_t>(SyscallCode::Sbrk));
+    memory.SetRegister(Memory::A0, 0x10000);
+    ASSERT_EQ(host.Service(memory), TickResult::Success);
+    ASSERT_EQ(memory.GetRegister(Memory::V0), static_cast<uint32_t>(-1));
+    ASSERT_EQ(memory.GetDataSize(), 0x2000);
+
+    // Stores are still watched.
+    memory.SetRegister(Memory::PC, Address::MakeText(0));
+    RunResult const result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(watchpoints.GetHits().size(), 3);
+
+    watchpoints.Clear();
+    ASSERT_FALSE(memory.IsDataPinned());
+    memory.ResizeData(0x10000);
+    memory.SetWord(Address::MakeData(4), 7);
+    ASSERT_EQ(memory.GetWord(Address::MakeData(4)), 7);
+}
+
+#if defined(SIGTRAP)
+
+TEST(WatchpointsTest, ForeignSignal)
+{
+    if (!Watchpoints::IsSupported())
+        GTEST_SKIP();
+
+    // Another component handles traps of its own.
+    auto const previous = std::signal(SIGTRAP, OnForeignTrap);
+    numForeignTraps     = 0;
+
+    Memory      memory = MakeMemory(StoreProgram);
+    Program     program { memory };
+    Watchpoints watchpoints { memory };
+    ASSERT_TRUE(watchpoints.Watch(Address::MakeData(4), Address::MakeData(4), WatchAction::Resume));
+
+    // Its traps go to its handler, and the watchpoints keep working afterwards.
+    std::raise(SIGTRAP);
+    ASSERT_EQ(numForeignTraps, 1);
+
+    RunResult const result = RunProgram(memory, program, 100);
+    ASSERT_EQ(result.result, TickResult::Success);
+    ASSERT_EQ(watchpoints.GetHits().size(), 3);
+    ASSERT_EQ(numForeignTraps, 1);
+
+    watchpoints.Clear();
+    std::raise(SIGTRAP);
+    ASSERT_EQ(numForeignTraps, 2);
+    std::signal(SIGTRAP, previous);
+}
+
+#endif